@@ -78,6 +78,10 @@ namespace florp {
 			static Application* mySingleton;
 
 		private:
+			// The most recent size the window was changed to, which will be sent to the layers at the start of the next frame
+			uint32_t myPendingWidth, myPendingHeight;
+			bool     isResizePending;
+
 			static void OnWindowSizeChanged(Window& window, uint32_t width, uint32_t height, void* userPointer);
 		};
 		
@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <xmmintrin.h>
+#include <GLM/glm.hpp>
+
+namespace florp {
+	namespace bake {
+
+		/*
+		 * Represents a ray, with a normalized direction
+		 */
+		struct Ray {
+			glm::vec3 Origin;
+			glm::vec3 Direction;
+		};
+
+		/*
+		 * Stores the closest intersection between a ray and the triangles in a BVH
+		 */
+		struct RayHit {
+			// The distance along the ray that the hit occurred at
+			float    Distance;
+			// The index of the triangle that was hit (in the order that triangles were passed to Build)
+			uint32_t Triangle;
+			// The barycentric coordinates of the hit, relative to the triangle's second and third vertices
+			float    U, V;
+		};
+
+		/*
+		 * A bounding volume hierarchy over a static triangle soup, used for CPU ray tracing.
+		 *
+		 * The tree is built with a binned surface area heuristic, and the triangles in each leaf are stored in packets
+		 * of 4, in structure of arrays form, so that a single ray can be tested against 4 triangles at once with SSE.
+		 * Once built, the BVH is read-only, so it is safe to trace rays against it from any number of threads.
+		 */
+		class Bvh {
+		public:
+			Bvh() = default;
+
+			/*
+			 * Builds the hierarchy over a triangle list, any existing tree will be discarded
+			 * @param positions The positions of all the vertices (these should already be in world space)
+			 * @param indices Every 3 indices form a triangle from the positions
+			 */
+			void Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+			/*
+			 * Finds the closest triangle hit by a ray
+			 * @param ray The ray to trace
+			 * @param maxDistance The furthest distance along the ray to consider
+			 * @param hit Receives the closest hit, if there was one
+			 * @returns True if the ray hit something, false if otherwise
+			 */
+			bool Intersect(const Ray& ray, float maxDistance, RayHit& hit) const;
+			/*
+			 * Determines if there is any triangle blocking a ray. This is cheaper than Intersect, since we can stop at the first hit
+			 * @param ray The ray to trace
+			 * @param maxDistance The furthest distance along the ray to consider
+			 * @returns True if the ray hit anything before maxDistance
+			 */
+			bool Occluded(const Ray& ray, float maxDistance) const;
+
+			// Gets the number of triangles in the BVH
+			size_t GetTriangleCount() const { return myTriangleCount; }
+			// Gets the number of nodes in the BVH
+			size_t GetNodeCount() const { return myNodes.size(); }
+
+		protected:
+			// A single node in the tree, leaves have a non-zero packet count
+			struct Node {
+				glm::vec3 Min;
+				// For interior nodes, the index of the left child (the right child is always right after it), for leaves the first packet
+				uint32_t  LeftOrFirst;
+				glm::vec3 Max;
+				// The number of triangle packets in this leaf, or 0 for interior nodes
+				uint32_t  PacketCount;
+			};
+
+			// Stores 4 triangles in SoA form for SSE intersection. Unused lanes are filled with degenerate triangles, which never hit
+			struct alignas(16) TrianglePacket {
+				__m128   V0[3];
+				__m128   Edge1[3];
+				__m128   Edge2[3];
+				uint32_t Ids[4];
+			};
+
+			std::vector<Node>           myNodes;
+			std::vector<TrianglePacket> myPackets;
+			size_t                      myTriangleCount = 0;
+
+			// Traverses the tree, if anyHit is set then we return as soon as we find any intersection
+			bool __Traverse(const Ray& ray, float maxDistance, RayHit& hit, bool anyHit) const;
+		};
+
+	}
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <GLM/glm.hpp>
+#include "florp/graphics/MeshData.h"
+#include "EnumToString.h"
+
+namespace florp {
+	namespace bake {
+
+		/*
+		 * The type of light that will be baked into the scene
+		 */
+		ENUM(BakeLightType, uint32_t,
+			Point       = 0, // Shines in all directions from a position, attenuated by 1 / (1 + a*d)
+			Spot        = 1, // Shines in a cone from a position, attenuated by 1 / (1 + a*d^2)
+			Directional = 2  // Shines along a direction everywhere in the scene, with no attenuation
+		);
+
+		/*
+		 * Describes a single light to bake into the scene. The attenuation models match the runtime lighting shaders, so
+		 * that baked and dynamic lighting look the same
+		 */
+		struct BakeLight {
+			BakeLightType Type = BakeLightType::Point;
+			glm::vec3     Position  = glm::vec3(0.0f);
+			// The direction the light is shining (for spot and directional lights)
+			glm::vec3     Direction = glm::vec3(0.0f, -1.0f, 0.0f);
+			glm::vec3     Color     = glm::vec3(1.0f);
+			float         Attenuation = 0.0f;
+			// The cosine of the half-angle of a spot light's cone
+			float         CosCutoff = 0.0f;
+		};
+
+		/*
+		 * Describes a single piece of geometry in the scene. Instances that have a lightmap size of zero will still block
+		 * and bounce light, but will not receive a lightmap
+		 */
+		struct BakeInstance {
+			// The mesh to bake, this should already have lightmap UVs if it is receiving a lightmap (see LightmapUnwrapper)
+			const graphics::MeshData* Mesh = nullptr;
+			glm::mat4 Transform = glm::mat4(1.0f);
+			// The average diffuse color of the surface, used when bouncing light off of it
+			glm::vec3 Albedo = glm::vec3(0.5f);
+			// The width and height of this instance's lightmap, in texels (0 to not generate a lightmap)
+			uint32_t  LightmapSize = 0;
+		};
+
+		/*
+		 * Settings to control the quality and extents of a bake
+		 */
+		struct BakeSettings {
+			// The number of paths to trace for every lightmap texel
+			uint32_t   SamplesPerTexel = 128;
+			// The number of paths to trace for every light probe
+			uint32_t   SamplesPerProbe = 512;
+			// The maximum number of times light can bounce off of surfaces
+			uint32_t   Bounces = 2;
+			// The number of threads to bake with, 0 will use every core on the machine
+			uint32_t   ThreadCount = 0;
+			// The radiance of any ray that escapes the scene
+			glm::vec3  SkyColor = glm::vec3(0.0f);
+			// The number of texels to grow each lightmap's charts by, to hide seams when filtering
+			uint32_t   DilationPasses = 2;
+			// The world space region covered by the light probe grid, and the number of probes along each axis
+			glm::vec3  ProbeMin = glm::vec3(-10.0f);
+			glm::vec3  ProbeMax = glm::vec3( 10.0f);
+			glm::ivec3 ProbeCount = glm::ivec3(0);
+		};
+
+		/*
+		 * The baked irradiance for a single instance, in linear HDR units that match the lighting accumulation buffer
+		 */
+		struct Lightmap {
+			uint32_t               Size = 0;
+			std::vector<glm::vec3> Texels;
+		};
+
+		/*
+		 * A regular grid of irradiance probes, used to light dynamic objects. Each probe stores L1 spherical harmonics that
+		 * have already been convolved with the cosine lobe, so that the irradiance for a normal n in a color channel c is
+		 * simply max(C.x + dot(C.yzw, n), 0), where C is Coefficients[probe * 3 + c]
+		 */
+		struct ProbeGrid {
+			glm::vec3              Min = glm::vec3(0.0f);
+			glm::vec3              Max = glm::vec3(0.0f);
+			glm::ivec3             Count = glm::ivec3(0);
+			std::vector<glm::vec4> Coefficients;
+
+			// Gets the total number of probes in the grid
+			size_t GetProbeCount() const { return (size_t)Count.x * Count.y * Count.z; }
+		};
+
+		/*
+		 * The output of the light baker, which can be saved to disk and loaded again at runtime
+		 */
+		struct BakeResult {
+			// One lightmap for every instance that was baked, in the same order as the instances (instances without a lightmap have an empty entry)
+			std::vector<Lightmap> Lightmaps;
+			ProbeGrid             Probes;
+
+			/*
+			 * Writes this bake to a binary file
+			 * @param filename The path to the file to write
+			 * @returns True if the file was written, false if otherwise
+			 */
+			bool Save(const std::string& filename) const;
+			/*
+			 * Loads a bake that was written with Save
+			 * @param filename The path to the file to read
+			 * @param result The bake result to load the data into
+			 * @returns True if the file was loaded, false if it does not exist or is not a valid bake file
+			 */
+			static bool Load(const std::string& filename, BakeResult& result);
+		};
+
+		/*
+		 * An offline baker for static lighting. Traces paths through the scene on the CPU (using every core) to generate
+		 * lightmaps for static geometry, and a grid of light probes for dynamic objects to sample from
+		 */
+		class LightBaker {
+		public:
+			/*
+			 * Bakes the lighting for a scene. This is a blocking call, and can take quite a while for large scenes!
+			 * @param instances The geometry in the scene
+			 * @param lights The lights to bake into the scene
+			 * @param settings The settings for the bake
+			 * @returns The lightmaps and light probes for the scene
+			 */
+			static BakeResult Bake(const std::vector<BakeInstance>& instances, const std::vector<BakeLight>& lights, const BakeSettings& settings);
+		};
+
+	}
+}
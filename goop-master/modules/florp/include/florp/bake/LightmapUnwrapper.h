@@ -0,0 +1,30 @@
+#pragma once
+#include "florp/graphics/MeshData.h"
+
+namespace florp {
+	namespace bake {
+
+		/*
+		 * Generates the second (lightmap) UV channel for meshes. Unlike regular texture coordinates, lightmap UVs must
+		 * never overlap, since every texel stores the lighting for exactly one spot on the surface.
+		 *
+		 * Triangles are grouped into charts by connectivity and facing, each chart is planar-projected along its dominant
+		 * axis, and the charts are then packed into the lightmap with some padding between them.
+		 */
+		class LightmapUnwrapper {
+		public:
+			/*
+			 * Fills in the LightmapUV for every vertex in a mesh. Vertices that are shared between charts will be duplicated,
+			 * so this should be called before the mesh is baked, and the triangle order will be preserved.
+			 *
+			 * The result is deterministic, so unwrapping the same mesh data always produces the same UVs
+			 * @param data The mesh data to unwrap
+			 * @param resolution The width and height of the lightmap that these UVs will be used with, in texels
+			 * @param padding The number of texels to leave around every chart, to prevent bleeding when filtering
+			 * @returns True if all the charts fit into the lightmap, false if otherwise
+			 */
+			static bool Unwrap(graphics::MeshData& data, uint32_t resolution, uint32_t padding = 2);
+		};
+
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <GLM/glm.hpp>
+#include "florp/graphics/Mesh.h"
+#include "florp/graphics/MeshBuilder.h"
+
+namespace florp {
+	namespace game {
+
+		/*
+		 * A single level of detail in a LodGroup
+		 */
+		struct LodLevel {
+			// The mesh to draw at this level
+			graphics::Mesh::Sptr Mesh;
+			// The smallest projected size (the fraction of the screen's height covered by the bounds) this level is used at
+			float                ScreenSize;
+		};
+
+		/*
+		 * A component that picks between levels of detail for an entity based on how large it is on screen. The camera pass
+		 * draws the mesh in the entity's RenderableComponent, which is swapped out for the camera's level every frame. The
+		 * shadow pass picks its own level, as if the entity were ShadowScale times its on screen size, since shadows can
+		 * usually get away with much less detail.
+		 *
+		 * Levels only change once the entity is Hysteresis past the threshold, so that entities sitting right on a threshold
+		 * do not flicker between levels
+		 */
+		struct LodGroup {
+			// The levels of detail, from the most detailed to the least
+			std::vector<LodLevel> Levels;
+			// The bounding sphere of the mesh, in the entity's local space
+			glm::vec3 BoundsCenter = glm::vec3(0.0f);
+			float     BoundsRadius = 1.0f;
+			// How far past a level's threshold we need to be to change levels, as a fraction of the threshold
+			float     Hysteresis = 0.15f;
+			// The shadow pass picks levels as if the entity were this much smaller on screen
+			float     ShadowScale = 0.5f;
+			// The levels currently in use by the camera and shadow passes
+			uint32_t  CameraLevel = 0;
+			uint32_t  ShadowLevel = 0;
+
+			/*
+			 * Calculates the fraction of the screen's height that this group's bounds cover
+			 * @param world The world transform of the entity
+			 * @param cameraPosition The world position of the camera
+			 * @param projection The camera's projection matrix
+			 */
+			float GetScreenSize(const glm::mat4& world, const glm::vec3& cameraPosition, const glm::mat4& projection) const;
+
+			/*
+			 * Updates the levels used by the camera and shadow passes
+			 * @param screenSize The fraction of the screen's height that the group covers, see GetScreenSize
+			 */
+			void Update(float screenSize);
+
+			// Gets the mesh that the camera should draw
+			const graphics::Mesh::Sptr& GetCameraMesh() const { return Levels[CameraLevel].Mesh; }
+			// Gets the mesh that shadow maps should draw
+			const graphics::Mesh::Sptr& GetShadowMesh() const { return Levels[ShadowLevel].Mesh; }
+
+			/*
+			 * Picks a level of detail for a given screen size, only moving away from the current level once the size is
+			 * past the threshold by the hysteresis
+			 * @param levels The levels to pick from
+			 * @param current The level that is currently in use
+			 * @param screenSize The fraction of the screen's height that the group covers
+			 * @param hysteresis How far past a threshold the size needs to be, as a fraction of the threshold
+			 * @returns The level to use
+			 */
+			static uint32_t SelectLevel(const std::vector<LodLevel>& levels, uint32_t current, float screenSize, float hysteresis);
+
+			/*
+			 * Creates a LOD group from a chain of meshes, such as the ones from MeshSimplifier::GenerateLods. The screen size
+			 * of each level is scaled down from screenSize by the square root of its fraction of the triangles, so that the
+			 * triangle density on screen stays about the same
+			 * @param levels The meshes for each level, from the most detailed to the least
+			 * @param format The format to bake the meshes with
+			 * @param screenSize The screen size below which we switch away from the most detailed level
+			 */
+			static LodGroup Create(const std::vector<graphics::MeshData>& levels, graphics::VertexFormat format = graphics::VertexFormat::Full, float screenSize = 0.5f);
+		};
+
+	}
+}
@@ -41,6 +41,11 @@ namespace florp {
 			 * Creates a duplicate of this material, with all the same values set
 			 */
 			Sptr Clone();
+			/*
+			 * Creates a duplicate of this material that renders with a different shader, with all the same values set
+			 * @param shader The shader for the new material to use
+			 */
+			Sptr Clone(const graphics::Shader::Sptr& shader);
 
 			/*
 			 * Sets a uniform in this material
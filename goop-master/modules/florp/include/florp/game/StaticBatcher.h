@@ -0,0 +1,51 @@
+#pragma once
+#include <memory>
+#include <entt.hpp>
+#include <GLM/glm.hpp>
+#include "florp/graphics/MeshData.h"
+#include "florp/graphics/MeshBuilder.h"
+
+namespace florp {
+	namespace game {
+
+		/*
+		 * Marks an entity as static, meaning that its transform, mesh and material will never change once the scene has
+		 * been built. Static entities with a RenderableComponent are merged into batches by StaticBatcher::Build. Their
+		 * RenderableComponent's mesh can be left empty, the batcher will only bake one for entities that aren't merged
+		 */
+		struct StaticComponent {
+			// The CPU-side copy of the entity's mesh, in the entity's local space
+			std::shared_ptr<graphics::MeshData> Source;
+		};
+
+		/*
+		 * Attached to the entities created by StaticBatcher::Build. The batch's mesh is already in world space, so the
+		 * entity's transform is left as the identity, and the mesh's bounding sphere is the batch's world space bounds
+		 */
+		struct StaticBatchComponent {
+			// The number of static entities that were merged into this batch
+			uint32_t  EntityCount = 0;
+		};
+
+		/*
+		 * Merges static geometry into a few large meshes when a scene is built, so that it can be drawn with a handful of
+		 * draw calls instead of one per entity
+		 */
+		class StaticBatcher {
+		public:
+			/*
+			 * Merges every static renderable in the registry that shares a material with other static renderables into
+			 * pre-transformed batches. Entities are split between batches by a grid over the world, so that batches stay
+			 * small enough to be culled. Each batch is also split into meshlets, so that the parts of it that are off-screen or
+			 * facing away can be culled as well. The merged entities keep their other components, but lose their
+			 * RenderableComponent. Static entities that are left on their own get their source baked if they have no mesh
+			 * @param ecs The registry to batch the static entities in
+			 * @param format The layout to store the batches' vertices with on the GPU
+			 * @param cellSize The size of the grid cells that batches are split on, in world units
+			 * @returns The number of batches that were created
+			 */
+			static size_t Build(entt::registry& ecs, graphics::VertexFormat format = graphics::VertexFormat::Full, float cellSize = 32.0f);
+		};
+
+	}
+}
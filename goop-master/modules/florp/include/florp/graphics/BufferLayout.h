@@ -26,6 +26,8 @@ namespace florp
 			uint32_t       Offset;
 			bool           IsNormalized;
 			VertexUsage    Usage;
+			// The attribute location to bind this element to, or -1 to use the location after the previous element
+			int32_t        Location;
 
 			BufferElement() = default;
 
@@ -34,9 +36,11 @@ namespace florp
 			 * @param name The name of the attribute in the shader
 			 * @param type The type for this attribute
 			 * @param normalized Whether or not to normalize integer types to the [-1 -> 1] range (or [0 -> 1] for unsigned)
+			 * @param arraySize The number of elements in the array, or 1 if this is not an array
+			 * @param location The attribute location to bind to, or -1 to follow on from the previous element
 			 */
-			BufferElement(const std::string& name, ShaderDataType type, VertexUsage usage = VertexUsage::User, bool normalized = false, uint32_t arraySize = 1) :
-				Name(name), Type(type), SizeInBytes(ShaderDataTypeSize(type)), Offset(0), IsNormalized(normalized), ArraySize(arraySize), Usage(usage) {}
+			BufferElement(const std::string& name, ShaderDataType type, VertexUsage usage = VertexUsage::User, bool normalized = false, uint32_t arraySize = 1, int32_t location = -1) :
+				Name(name), Type(type), SizeInBytes(ShaderDataTypeSize(type)), Offset(0), IsNormalized(normalized), ArraySize(arraySize), Usage(usage), Location(location) {}
 
 			/*
 			 * Returns the number of components that this buffer element has
@@ -119,8 +123,8 @@ namespace florp
 			 */
 			std::vector<BufferElement>::const_iterator end() const { return myElements.end(); }
 
-			inline bool operator ==(const BufferLayout& other) const;
-			inline bool operator !=(const BufferLayout& other) const { return !(*this == other); }
+			bool operator ==(const BufferLayout& other) const;
+			bool operator !=(const BufferLayout& other) const { return !(*this == other); }
 
 		protected:
 			uint32_t myStride;
@@ -1,36 +1,98 @@
 #pragma once
 #include "IGraphicsResource.h"
 #include "BufferLayout.h"
+#include "MeshArena.h"
+#include "Meshlet.h"
+#include <vector>
+#include <GLM/glm.hpp>
 
 namespace florp {
 	namespace graphics {
 		
+		/*
+		 * A mesh is a range of vertices and indices in a MeshArena that is shared with every other mesh with the same layout,
+		 * so creating a mesh does not create any buffers or vertex arrays of its own
+		 */
 		class Mesh : public IGraphicsResource {
 		public:
 			// Shorthand for shared_ptr
 			GraphicsClass(Mesh);
 
 			/*
-			 * Create a new mesh from some arbitrary data
+			 * Create a new mesh from some arbitrary data. Elements are bound to sequential attribute locations unless they
+			 * specify their own. If every index fits in 16 bits, the indices are stored as GL_UNSIGNED_SHORT
 			 * @param vertices The data to load into the mesh's buffer
 			 * @param numVerts the number of vertices to load
 			 * @param layout The layout of the data that will be loaded into the mesh
 			 * @param indices The indices to load into the index buffer for the mesh, or nullptr for no indexing
 			 * @param numIndices The number of indices to load into the index buffer
 			 */
-			Mesh(void* vertices, size_t numVerts, const BufferLayout& layout, uint32_t* indices, size_t numIndices);
+			Mesh(const void* vertices, size_t numVerts, const BufferLayout& layout, const uint32_t* indices, size_t numIndices);
 			~Mesh();
 
-			// Draws this mesh
-			void Draw();
+			/*
+			 * Draws this mesh
+			 * @param baseInstance The instance ID to draw with, shaders can use gl_BaseInstance to look up per-object data
+			 */
+			void Draw(uint32_t baseInstance = 0);
+
+			/*
+			 * Draws multiple instances of this mesh using only it's position stream, for depth-only passes such as shadows.
+			 * Positions are bound to attribute 0, and the per-instance model matrix is bound to attributes 1-4
+			 * @param instanceBuffer The buffer containing a tightly packed mat4 for each instance
+			 * @param offset The offset into the instance buffer of the first instance's matrix, in bytes
+			 * @param instanceCount The number of instances to draw
+			 */
+			void DrawDepthInstanced(GLuint instanceBuffer, size_t offset, uint32_t instanceCount);
 
 			size_t GetVertexCount() const { return myVertexCount; }
 			size_t GetIndexCount() const { return myIndexCount; }
 			size_t GetTriangleCount() const { return myIndexCount / 3ul; }
+			// Gets the type of the indices on the GPU, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+			GLenum GetIndexType() const { return myArena->GetIndexType(); }
+
+			// Gets the arena that this mesh is stored in
+			const MeshArena::Sptr& GetArena() const { return myArena; }
+			// Gets the offset of this mesh's first vertex in its arena, which is added to each of its indices
+			uint32_t GetBaseVertex() const { return myRange.BaseVertex; }
+			// Gets the offset of this mesh's first index in its arena, in indices
+			uint32_t GetFirstIndex() const { return myRange.FirstIndex; }
+
+			/*
+			 * Sets a value for an attribute that is not stored per vertex (for instance, a color that is the same across
+			 * the whole mesh). The value is applied whenever the mesh is drawn
+			 * @param location The attribute location to set, this should not be used by the mesh's layout
+			 * @param value The value to give the attribute
+			 */
+			void SetConstantAttribute(uint32_t location, const glm::vec4& value);
+			// Gets the attributes that were set with SetConstantAttribute
+			const std::vector<std::pair<uint32_t, glm::vec4>>& GetConstantAttributes() const { return myConstantAttributes; }
+			// Applies our constant attributes, this is done by Draw, but is needed when drawing the mesh in some other way
+			void ApplyConstantAttributes() const;
+
+			// Gets a sphere around the mesh in its local space, with the center in xyz and the radius in w
+			const glm::vec4& GetBoundingSphere() const { return myBoundingSphere; }
+
+			/*
+			 * Uploads the meshlets that this mesh was split into (see MeshBuilder::BuildMeshlets), so that it can be culled
+			 * one meshlet at a time instead of as a whole. This replaces any meshlets that were set before
+			 * @param meshlets The meshlets to upload, these must have been built from the same data as the mesh
+			 */
+			void SetMeshlets(const MeshletData& meshlets);
+			// Gets whether this mesh has meshlets to cull with
+			bool HasMeshlets() const { return myMeshletCount > 0; }
+			// Gets the number of meshlets that the mesh was split into
+			uint32_t GetMeshletCount() const { return myMeshletCount; }
+			// Gets the number of indices in all of the meshlets, this is the same as the mesh's index count
+			uint32_t GetMeshletIndexCount() const { return myMeshletIndexCount; }
+			// Gets the storage buffer that holds the mesh's meshlets, in the layout of the Meshlet struct
+			GLuint GetMeshletBuffer() const { return myMeshletBuffers[0]; }
+			// Gets the storage buffer that holds the 32 bit indices of the meshlets' triangles
+			GLuint GetMeshletIndexBuffer() const { return myMeshletBuffers[1]; }
 
 			// Extracts the vertex data from this mesh, uses malloc
 			void* ExtractVertices(size_t& outSize) const;
-			// Extracts the index data from this mesh, uses malloc
+			// Extracts the index data from this mesh, uses malloc. 16 bit indices are widened to 32 bits
 			uint32_t* ExtractIndices(size_t& outSize) const;
 
 			// Gets the layout of the data that is stored in this mesh
@@ -40,10 +102,18 @@ namespace florp {
 			std::string Name;
 
 		private:
-			// 0 is vertices, 1 is indices
-			GLuint myBuffers[2];
+			// The arena that holds our vertices and indices, and where in it they are
+			MeshArena::Sptr  myArena;
+			MeshArena::Range myRange;
 			// The number of vertices and indices in this mesh
 			size_t myVertexCount, myIndexCount;
+			// The sphere around the mesh, see GetBoundingSphere
+			glm::vec4 myBoundingSphere;
+			// 0 holds the meshlets, 1 holds their indices, see SetMeshlets
+			GLuint   myMeshletBuffers[2];
+			uint32_t myMeshletCount, myMeshletIndexCount;
+			// Attributes that are the same for every vertex, see SetConstantAttribute
+			std::vector<std::pair<uint32_t, glm::vec4>> myConstantAttributes;
 			// How this mesh is arranged in memory
 			BufferLayout myLayout;
 		};
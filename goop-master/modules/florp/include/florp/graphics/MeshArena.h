@@ -0,0 +1,120 @@
+#pragma once
+#include "IGraphicsResource.h"
+#include "BufferLayout.h"
+#include "florp/utils/TlsfAllocator.h"
+
+namespace florp {
+	namespace graphics {
+
+		/*
+		 * A set of large vertex and index buffers that many meshes with the same vertex layout are stored in. Each mesh is
+		 * a range of vertices and a range of indices in the arena, which are handed out by a TLSF allocator and drawn with
+		 * the base vertex variants of the draw calls. This means that there is only a handful of buffers and vertex arrays
+		 * for the whole scene, instead of a few per mesh, and that meshes in the same arena can be drawn back to back (or in
+		 * a single multi-draw) without binding anything in between.
+		 *
+		 * The buffers grow when they run out of space. Since meshes only store offsets into the arena, growing does not
+		 * affect them. Arenas are shared between every mesh with the same layout and index type, see MeshArena::Get
+		 */
+		class MeshArena : public IGraphicsResource {
+		public:
+			GraphicsClass(MeshArena);
+
+			/*
+			 * A range of an arena that holds a mesh
+			 */
+			struct Range {
+				utils::TlsfAllocator::Handle VertexHandle = utils::TlsfAllocator::InvalidHandle;
+				utils::TlsfAllocator::Handle IndexHandle = utils::TlsfAllocator::InvalidHandle;
+				// The offset of the mesh's first vertex, which is added to each of its indices
+				uint32_t BaseVertex = 0;
+				// The offset of the mesh's first index, in indices
+				uint32_t FirstIndex = 0;
+			};
+
+			/*
+			 * Creates a new arena
+			 * @param layout The layout of the vertices in this arena
+			 * @param indexType The type of the indices, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+			 * @param vertexCapacity The number of vertices to make room for up front
+			 * @param indexCapacity The number of indices to make room for up front
+			 */
+			MeshArena(const BufferLayout& layout, GLenum indexType, uint32_t vertexCapacity, uint32_t indexCapacity);
+			~MeshArena();
+
+			/*
+			 * Allocates room for a mesh in the arena, and uploads its data. The arena will grow if it does not have room
+			 * @param vertices The vertex data, in this arena's layout
+			 * @param vertexCount The number of vertices
+			 * @param indices The indices, relative to the mesh's first vertex, or nullptr for no indexing
+			 * @param indexCount The number of indices
+			 * @returns The range of the arena that holds the mesh
+			 */
+			Range Allocate(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+			/*
+			 * Returns a mesh's range to the arena
+			 * @param range The range that was returned by Allocate
+			 */
+			void Free(const Range& range);
+
+			// Binds the vertex array for drawing meshes with all of their attributes
+			void Bind() const { glBindVertexArray(myRendererID); }
+			/*
+			 * Binds the vertex array for depth-only instanced drawing. Positions are bound to attribute 0, and the
+			 * per-instance model matrix is bound to attributes 1-4
+			 * @param instanceBuffer The buffer containing a tightly packed mat4 for each instance
+			 * @param offset The offset into the instance buffer of the first instance's matrix, in bytes
+			 */
+			void BindDepth(GLuint instanceBuffer, size_t offset) const;
+			/*
+			 * Binds a vertex array with all of the arena's attributes, but that reads its indices from another buffer. This is
+			 * for drawing indices that were generated on the GPU, which should be 32 bit and relative to each mesh's base vertex
+			 * @param indexBuffer The buffer to read indices from
+			 */
+			void BindWithIndices(GLuint indexBuffer) const;
+
+			// Gets the layout of the vertices in this arena
+			const BufferLayout& GetLayout() const { return myLayout; }
+			// Gets the type of the indices in this arena, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+			GLenum GetIndexType() const { return myIndexType; }
+			// Gets the size of a single index, in bytes
+			uint32_t GetIndexSize() const { return myIndexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t); }
+			// Gets the buffer that holds every mesh's vertices
+			GLuint GetVertexBuffer() const { return myBuffers[0]; }
+			// Gets the buffer that holds every mesh's indices
+			GLuint GetIndexBuffer() const { return myBuffers[1]; }
+
+			// Gets the number of vertices that are in use, and the number that there is room for
+			uint32_t GetVertexCount() const { return myVertices.GetUsed(); }
+			uint32_t GetVertexCapacity() const { return myVertices.GetCapacity(); }
+			// Gets the number of indices that are in use, and the number that there is room for
+			uint32_t GetIndexCount() const { return myIndices.GetUsed(); }
+			uint32_t GetIndexCapacity() const { return myIndices.GetCapacity(); }
+
+			/*
+			 * Gets the arena that meshes with the given layout and index type are stored in, creating one if it does not
+			 * exist. Arenas are destroyed once the last mesh using them is
+			 * @param layout The layout of the vertices
+			 * @param indexType The type of the indices, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+			 */
+			static Sptr Get(const BufferLayout& layout, GLenum indexType);
+
+		private:
+			// 0 is vertices, 1 is indices, 2 is the tightly packed position stream
+			GLuint myBuffers[3];
+			// The vertex array used for depth-only instanced drawing
+			GLuint myDepthVao;
+			// The vertex array used for drawing with indices from outside the arena
+			GLuint myExternalVao;
+			// The position element of the layout, which is copied into the position stream
+			BufferElement myPosition;
+			BufferLayout myLayout;
+			GLenum       myIndexType;
+			utils::TlsfAllocator myVertices, myIndices;
+
+			void __GrowVertices(uint32_t minCapacity);
+			void __GrowIndices(uint32_t minCapacity);
+		};
+
+	}
+}
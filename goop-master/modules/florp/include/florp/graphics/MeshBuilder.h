@@ -2,9 +2,23 @@
 #include "MeshData.h"
 #include "GLM/glm.hpp"
 #include "Mesh.h"
+#include "Meshlet.h"
 
 namespace florp {
 	namespace graphics {
+
+		/*
+		 * The vertex layouts that MeshBuilder can upload meshes with
+		 */
+		ENUM(VertexFormat, uint32_t,
+			// Every attribute is stored as floats, exactly as in florp::graphics::Vertex (80 bytes)
+			Full,
+			// Positions are floats, normals are octahedral encoded as 2 snorm16s, tangents are snorm 10-10-10-2 with the
+			// bitangent's sign in w, UVs are halfs, lightmap UVs are unorm16s and colors are unorm8s (32 bytes). If every
+			// vertex has the same color, it is set as a constant attribute instead (28 bytes). Attribute locations match
+			// the Full format, but shaders need to decode the normal from a vec2, and there is no bitangent at location 4
+			Packed
+		);
 		
 		class MeshBuilder
 		{
@@ -16,7 +30,7 @@ namespace florp {
 			static void AddUvSphere(MeshData& data, const glm::vec3& center, const glm::vec3& radii, int tessellation = 0);
 
 			/*
-			 * Computes the tangent, bitangent, and normals for a given set of vertices and indices
+			 * Computes the tangents and bitangents for a given set of vertices and indices, see MeshProcessor::ComputeTangents
 			 * @param vertices The vertices to modify
 			 * @param indices The indices that form triangles from the vertices
 			 * @param begin The offset into the indices list to start calculating from
@@ -36,9 +50,33 @@ namespace florp {
 			/*
 			 * Turns a mesh data into a mesh on the GPU
 			 * @param data The data to turn into a mesh
+			 * @param format The layout to store the vertices with on the GPU
+			 * @param optimize True to reorder the triangles and vertices of data for the GPU first (see MeshOptimizer)
 			 * @returns A mesh created from the data that was passed in
 			 */
-			static graphics::Mesh::Sptr Bake(MeshData& data);
+			static graphics::Mesh::Sptr Bake(MeshData& data, VertexFormat format = VertexFormat::Full, bool optimize = false);
+			/*
+			 * Uploads vertices that already have their tangents and bitangents calculated to the GPU, without modifying them
+			 * @param vertices The vertices to upload
+			 * @param vertexCount The number of vertices
+			 * @param indices The indices that form triangles from the vertices
+			 * @param indexCount The number of indices
+			 * @param format The layout to store the vertices with on the GPU
+			 * @returns A mesh created from the vertices and indices
+			 */
+			static graphics::Mesh::Sptr Upload(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, VertexFormat format = VertexFormat::Full);
+
+			/*
+			 * Splits a mesh into meshlets, small clusters of neighbouring triangles that can each be culled on their own (see
+			 * Mesh::SetMeshlets). Triangles are added to a meshlet greedily, preferring the ones that share the most vertices
+			 * with it, so meshlets stay compact and their bounds stay tight. This works best on meshes that have already been
+			 * through MeshOptimizer, since the triangles are then already in a spatially coherent order
+			 * @param data The mesh to split up
+			 * @param maxVertices The most unique vertices a meshlet can use
+			 * @param maxTriangles The most triangles a meshlet can have, this can be at most 128
+			 * @returns The meshlets, and the indices for their triangles
+			 */
+			static MeshletData BuildMeshlets(const MeshData& data, uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
 		};
 	}
 }
\ No newline at end of file
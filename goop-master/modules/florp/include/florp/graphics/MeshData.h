@@ -14,6 +14,8 @@ namespace florp {
 			glm::vec3 Tangent;
 			glm::vec3 BiTangent;
 			glm::vec2 UV;
+			// A second, non-overlapping set of texture coordinates used for baked lighting (see florp::bake::LightmapUnwrapper)
+			glm::vec2 LightmapUV;
 
 			Vertex(glm::vec3 pos = glm::vec3(0.0f), glm::vec3 norm = glm::vec3(0.0f), glm::vec2 uv = glm::vec2(0.0f)) :
 				Position(pos),
@@ -21,7 +23,8 @@ namespace florp {
 				Normal(norm),
 				Tangent(glm::vec3(0.0f)),
 				BiTangent(glm::vec3(0.0f)),
-				UV(uv) { }
+				UV(uv),
+				LightmapUV(glm::vec2(0.0f)) { }
 		};
 
 		const BufferLayout VertexLayout = {
@@ -30,7 +33,8 @@ namespace florp {
 			{ "Normal",    ShaderDataType::Float3, VertexUsage::Normal },
 			{ "Tangent",   ShaderDataType::Float3, VertexUsage::Tangent },
 			{ "BiTangent", ShaderDataType::Float3, VertexUsage::Bitangent },
-			{ "UV",        ShaderDataType::Float2, VertexUsage::Texture }
+			{ "UV",        ShaderDataType::Float2, VertexUsage::Texture },
+			{ "LightmapUV", ShaderDataType::Float2, VertexUsage::Texture }
 		};
 
 		struct MeshData {
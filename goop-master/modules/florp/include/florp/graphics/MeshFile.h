@@ -0,0 +1,97 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <GLM/glm.hpp>
+#include "florp/graphics/Mesh.h"
+#include "florp/graphics/MeshData.h"
+#include "florp/utils/FileUtils.h"
+
+namespace florp {
+	namespace graphics {
+
+		/*
+		 * A binary mesh file (.fmesh), which stores a mesh exactly as it will be uploaded to the GPU. Every section of the file
+		 * is aligned so that it can be used straight out of a memory mapping, loading one of these only costs as much as
+		 * reading it from disk.
+		 *
+		 * The file is laid out as:
+		 *    Header - Magic, version, counts, bounds, the hash of the source the mesh came from, and the offsets below
+		 *    Layout - One fixed size descriptor for each element of the BufferLayout
+		 *    Vertices - The vertex data, tightly packed with the layout's stride
+		 *    Indices - The index data, as uint32_t
+		 */
+		class MeshFile {
+		public:
+			typedef std::shared_ptr<MeshFile> Sptr;
+
+			/*
+			 * Maps the given mesh file into memory, use IsValid to check whether it could be loaded
+			 * @param filename The path to the mesh file
+			 */
+			explicit MeshFile(const std::string& filename);
+			~MeshFile() = default;
+
+			MeshFile(const MeshFile& other) = delete;
+			MeshFile& operator =(const MeshFile& other) = delete;
+
+			// Whether the file exists, and has a valid header for this version of the format
+			bool IsValid() const { return myHeader != nullptr; }
+
+			// Gets the hash of the source file this was generated from, used to determine if the file is out of date
+			uint64_t GetSourceHash() const;
+			uint32_t GetVertexCount() const;
+			uint32_t GetIndexCount() const;
+			// Gets the axis aligned bounds of the vertex positions
+			glm::vec3 GetBoundsMin() const;
+			glm::vec3 GetBoundsMax() const;
+			const BufferLayout& GetLayout() const { return myLayout; }
+
+			// Gets the vertex data, which points directly into the mapped file
+			const void* GetVertexData() const;
+			// Gets the index data, which points directly into the mapped file
+			const uint32_t* GetIndexData() const;
+
+			/*
+			 * Copies the mesh into a mesh data for editing on the CPU. This is only possible if the file was saved with
+			 * florp::graphics::VertexLayout
+			 * @param debugName The debug name to give to the mesh data
+			 */
+			MeshData ToMeshData(const std::string& debugName = "") const;
+
+			/*
+			 * Uploads the mesh to the GPU directly from the mapped file, without copying it into any intermediate buffers
+			 * @returns A new mesh containing the data in this file
+			 */
+			Mesh::Sptr Upload() const;
+
+			/*
+			 * Saves a mesh to a file
+			 * @param filename The path to save the mesh to
+			 * @param layout The layout of the vertex data
+			 * @param vertices The vertex data, which must be tightly packed with the layout's stride
+			 * @param vertexCount The number of vertices
+			 * @param indices The index data
+			 * @param indexCount The number of indices
+			 * @param sourceHash The hash of the file this mesh was generated from
+			 * @returns True if the file was saved, false if not
+			 */
+			static bool Save(const std::string& filename, const BufferLayout& layout, const void* vertices, uint32_t vertexCount,
+				const uint32_t* indices, uint32_t indexCount, uint64_t sourceHash);
+			/*
+			 * Saves a mesh data to a file, using florp::graphics::VertexLayout
+			 * @param filename The path to save the mesh to
+			 * @param data The mesh to save
+			 * @param sourceHash The hash of the file this mesh was generated from
+			 * @returns True if the file was saved, false if not
+			 */
+			static bool Save(const std::string& filename, const MeshData& data, uint64_t sourceHash);
+
+		private:
+			struct Header;
+
+			utils::MappedFile myFile;
+			const Header*     myHeader;
+			BufferLayout      myLayout;
+		};
+	}
+}
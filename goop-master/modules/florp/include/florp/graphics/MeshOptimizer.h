@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include "MeshData.h"
+
+namespace florp {
+	namespace graphics {
+
+		/*
+		 * Reorders the triangles and vertices of a mesh so that the GPU does less work drawing it, without changing how it
+		 * looks. None of this has any runtime cost, so it is best done once when a mesh is loaded or cached.
+		 *
+		 * Triangles are ordered with Tipsify (Sander et al. 2007) so that vertices are re-used from the post-transform cache,
+		 * then clusters of triangles are sorted so that outward facing parts of the mesh are drawn first and occlude the
+		 * rest, and finally vertices are ordered by first use so that vertex fetches are sequential
+		 */
+		class MeshOptimizer {
+		public:
+			/*
+			 * Computes the average cache miss ratio (ACMR) of an index buffer, the average number of vertices that have to be
+			 * transformed per triangle, using a simulated FIFO post-transform cache. This is 3 for no re-use at all, and
+			 * approaches 0.5 for a perfectly ordered regular grid
+			 * @param indices The index buffer to examine
+			 * @param indexCount The number of indices
+			 * @param vertexCount The number of vertices the indices refer to
+			 * @param cacheSize The number of vertices in the simulated cache
+			 * @returns The average number of cache misses per triangle
+			 */
+			static float ComputeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+			/*
+			 * Reorders triangles to improve post-transform cache hits, using Tipsify
+			 * @param indices The index buffer to reorder, in place
+			 * @param vertexCount The number of vertices the indices refer to
+			 * @param clusters If not null, receives the first triangle of each cluster. Clusters start wherever the cache is
+			 *                 effectively flushed, so they can be drawn in any order without hurting the cache
+			 * @param cacheSize The number of vertices in the cache to optimize for
+			 */
+			static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>* clusters = nullptr, uint32_t cacheSize = 16);
+
+			/*
+			 * Reorders the clusters from OptimizeVertexCache so that the clusters most likely to occlude the rest of the mesh
+			 * are drawn first. Clusters are split up further where the cache efficiency allows, controlled by threshold
+			 * @param indices The index buffer to reorder, in place
+			 * @param vertices The vertices the indices refer to
+			 * @param clusters The first triangle of each cluster, from OptimizeVertexCache
+			 * @param threshold How much worse the ACMR is allowed to get, 1.05 allows the ACMR to get 5% worse
+			 * @param cacheSize The number of vertices in the cache to optimize for
+			 */
+			static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters, float threshold = 1.05f, uint32_t cacheSize = 16);
+
+			/*
+			 * Reorders the vertices of a mesh so that they appear in the order they are first used by the indices, so that
+			 * vertex fetching walks through memory sequentially. Any vertices that are never used are removed
+			 * @param data The mesh to reorder
+			 */
+			static void OptimizeVertexFetch(MeshData& data);
+
+			/*
+			 * Runs all of the above on a mesh, and logs the ACMR before and after
+			 * @param data The mesh to optimize
+			 * @param overdrawThreshold How much the ACMR may be sacrificed for less overdraw, see OptimizeOverdraw
+			 */
+			static void Optimize(MeshData& data, float overdrawThreshold = 1.05f);
+		};
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <vector>
+#include <GLM/glm.hpp>
+#include "MeshData.h"
+
+namespace florp {
+	namespace graphics {
+
+		/*
+		 * The bounds of a set of vertices
+		 */
+		struct MeshBounds {
+			glm::vec3 Min = glm::vec3(0.0f);
+			glm::vec3 Max = glm::vec3(0.0f);
+			// A sphere around the center of the box, with the center in xyz and the radius in w
+			glm::vec4 Sphere = glm::vec4(0.0f);
+		};
+
+		/*
+		 * Generates the shading data for a mesh, and cleans up its vertices. This is meant for meshes that are imported or
+		 * generated at load time, so everything here is split into jobs that run across all of our threads. Vertices are
+		 * copied out into separate X, Y and Z streams, so that the math can be done on 4 triangles or vertices at a time
+		 * with SSE, and results are accumulated per vertex from a list of the corners that use it, so that threads never
+		 * write to the same vertex
+		 */
+		class MeshProcessor {
+		public:
+			/*
+			 * Computes smooth normals, where each face's normal is weighted by the angle of its corner at the vertex. This
+			 * keeps the normals from leaning towards whichever side of the vertex happens to be more finely tessellated.
+			 * Vertices that share a position (for instance, along a UV seam) share their normal too
+			 * @param vertices The vertices to update
+			 * @param indices The indices that form triangles from the vertices
+			 * @param indexCount The number of indices
+			 * @param weldEpsilon How close vertices need to be to be treated as the same position, 0 for an exact match
+			 */
+			static void ComputeNormals(std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount, float weldEpsilon = 0.0f);
+			static void ComputeNormals(MeshData& data, float weldEpsilon = 0.0f) { ComputeNormals(data.Vertices, data.Indices.data(), data.Indices.size(), weldEpsilon); }
+
+			/*
+			 * Computes the tangents and bitangents of a mesh's vertices from its UVs. Like MikkTSpace, each face's tangent
+			 * frame is weighted by its corner angle and accumulated at each vertex, then orthonormalized against the
+			 * vertex's normal, keeping the handedness of the accumulated bitangent. Vertices that aren't used by any of the
+			 * triangles are left alone
+			 * @param vertices The vertices to update, these should already have their normals
+			 * @param indices The indices that form triangles from the vertices
+			 * @param indexCount The number of indices
+			 */
+			static void ComputeTangents(std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount);
+			static void ComputeTangents(MeshData& data) { ComputeTangents(data.Vertices, data.Indices.data(), data.Indices.size()); }
+
+			/*
+			 * Computes the axis aligned box around a set of vertices, and a sphere around the box's center
+			 * @param vertices The vertices to find the bounds of
+			 * @returns The bounds, which are all zero if there are no vertices
+			 */
+			static MeshBounds ComputeBounds(const std::vector<Vertex>& vertices);
+
+			/*
+			 * Finds the vertices that share a position with an earlier vertex
+			 * @param vertices The vertices to examine
+			 * @param epsilon How close vertices need to be to be treated as the same position, 0 for an exact match
+			 * @param outRemap Receives the index of the first vertex with the same position as each vertex
+			 * @returns The number of unique positions
+			 */
+			static uint32_t GeneratePositionRemap(const std::vector<Vertex>& vertices, float epsilon, std::vector<uint32_t>& outRemap);
+
+			/*
+			 * Merges vertices that are within epsilon of each other and otherwise have the same attributes. If any were
+			 * merged, the triangles that this collapses are removed, followed by any vertices that no remaining triangle
+			 * uses. This cleans up the seams left over when meshes are built from separate pieces
+			 * @param data The mesh to weld
+			 * @param epsilon How close vertices need to be to be merged, 0 for an exact match
+			 * @returns The number of vertices that were removed, either by merging or because they were unused
+			 */
+			static size_t WeldVertices(MeshData& data, float epsilon = 0.0f);
+		};
+
+	}
+}
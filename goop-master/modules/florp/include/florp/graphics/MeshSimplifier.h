@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include "MeshData.h"
+
+namespace florp {
+	namespace graphics {
+
+		/*
+		 * Reduces the number of triangles in a mesh by collapsing edges in order of their quadric error (Garland and
+		 * Heckbert 1997), for generating levels of detail.
+		 *
+		 * Edges are collapsed onto one of their existing vertices rather than onto a new optimal point, so every vertex in
+		 * the result is a vertex from the source, with its normal, UVs and lightmap UVs untouched. Vertices on UV or normal
+		 * seams (where several vertices share a position) and on the open borders of the mesh are never removed, so seams and
+		 * silhouettes of open meshes stay exactly where they were
+		 */
+		class MeshSimplifier {
+		public:
+			/*
+			 * Simplifies a mesh down to a target number of triangles, or as close as it can get without going over the error
+			 * limit. The result has its unused vertices removed and is re-ordered with MeshOptimizer
+			 * @param source The mesh to simplify
+			 * @param targetTriangles The number of triangles to aim for
+			 * @param maxError The largest distance the surface may move, relative to the size of the mesh (0.01 is 1% of the
+			 *                 largest side of the mesh's bounds)
+			 * @param outError If not null, receives the largest error of any collapse that was made, relative to the mesh's size
+			 * @returns The simplified mesh
+			 */
+			static MeshData Simplify(const MeshData& source, size_t targetTriangles, float maxError = 1.0f, float* outError = nullptr);
+
+			/*
+			 * Generates a chain of levels of detail for a mesh, each with a fraction of the triangles of the one before it. The
+			 * chain stops early once a level cannot be simplified far enough without going over the error limit
+			 * @param source The mesh to generate the levels of detail for, this will be the first level
+			 * @param levelCount The most levels to generate, including the source
+			 * @param reduction The fraction of the previous level's triangles that each level keeps
+			 * @param maxError The largest error any level may have, relative to the size of the mesh (see Simplify)
+			 * @returns The levels of detail, from the most detailed (a copy of the source) to the least
+			 */
+			static std::vector<MeshData> GenerateLods(const MeshData& source, uint32_t levelCount, float reduction = 0.5f, float maxError = 0.05f);
+		};
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <GLM/glm.hpp>
+
+namespace florp {
+	namespace graphics {
+
+		// The default limits for the size of a meshlet, see MeshBuilder::BuildMeshlets
+		#define MESHLET_MAX_VERTICES 64
+		#define MESHLET_MAX_TRIANGLES 124
+
+		/*
+		 * A small cluster of neighbouring triangles from a mesh, with bounds that let us cull it by itself. This matches the
+		 * layout that the meshlet culling shaders expect, so it can be uploaded as-is
+		 */
+		struct Meshlet {
+			// A sphere around the meshlet in the mesh's local space, with the center in xyz and the radius in w
+			glm::vec4 BoundingSphere;
+			// A cone that contains the normals of every triangle, with the axis in xyz and the sine of the cone's half angle
+			// in w. If w is 1, the normals are too spread out for the cone to be useful, and the meshlet is never backface culled.
+			// Cones assume that back faces are culled, so they should be disabled this way for materials that draw back faces
+			glm::vec4 Cone;
+			// The offset of the meshlet's first index in MeshletData::Indices
+			uint32_t FirstIndex;
+			// The number of triangles in the meshlet, each is 3 indices
+			uint32_t TriangleCount;
+			// The number of unique vertices that the meshlet uses
+			uint32_t VertexCount;
+			uint32_t Reserved;
+		};
+
+		/*
+		 * The meshlets that a mesh was split into, along with a copy of the mesh's indices rearranged so that each
+		 * meshlet's triangles are contiguous
+		 */
+		struct MeshletData {
+			std::vector<Meshlet>  Meshlets;
+			// The indices of each meshlet's triangles, relative to the mesh's first vertex
+			std::vector<uint32_t> Indices;
+		};
+
+	}
+}
@@ -1,9 +1,32 @@
 #pragma once
 #include "MeshData.h"
+#include "Mesh.h"
+#include "MeshBuilder.h"
 
 namespace florp { namespace graphics {
 	class ObjLoader {
 	public:
+		/*
+		 * Loads a mesh from an OBJ file. The file is memory mapped and parsed in chunks across all hardware threads, and
+		 * faces with more than 3 vertices are triangulated as fans. The triangles and vertices are reordered for the GPU
+		 * with MeshOptimizer.
+		 *
+		 * The result is cached in a mesh file next to the OBJ (see MeshFile), which is used instead of parsing the OBJ for
+		 * as long as the OBJ's contents do not change
+		 * @param filename The path to the OBJ file to load
+		 * @param baseColor The color to give all of the vertices
+		 * @returns The loaded mesh, with duplicate vertices merged
+		 */
 		static MeshData LoadObj(const char* filename, glm::vec4 baseColor);
+		/*
+		 * Loads a mesh from an OBJ file directly onto the GPU. If the OBJ's mesh file is up to date, the mesh is uploaded
+		 * straight from the mapped file, without parsing the OBJ or copying the vertices. Use this over LoadObj when the
+		 * mesh does not need to be edited on the CPU
+		 * @param filename The path to the OBJ file to load
+		 * @param baseColor The color to give all of the vertices
+		 * @param format The layout to store the vertices with on the GPU
+		 * @returns The mesh, with tangents and bitangents already calculated
+		 */
+		static Mesh::Sptr LoadMesh(const char* filename, glm::vec4 baseColor, VertexFormat format = VertexFormat::Full);
 	};
 }}
\ No newline at end of file
@@ -14,7 +14,8 @@ namespace  florp {
 			FragmentShader = 1,
 			TessControl = 2,
 			TessEval = 3,
-			Geometry = 4
+			Geometry = 4,
+			Compute = 5
 		);
 
 		constexpr uint32_t ToGlEnum(ShaderStageType type);
@@ -132,8 +133,16 @@ namespace  florp {
 			 */
 			void Use() const;
 
+			/*
+			 * Binds this shader and launches a grid of compute work groups. This shader must have a compute stage
+			 * @param groupsX The number of work groups to launch along the X axis
+			 * @param groupsY The number of work groups to launch along the Y axis
+			 * @param groupsZ The number of work groups to launch along the Z axis
+			 */
+			void Dispatch(uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1) const;
+
 		protected:
-			uint32_t myStages[5];
+			uint32_t myStages[6];
 			bool     isLinked;
 
 			struct UniformInfo {
@@ -13,10 +13,12 @@ namespace florp
 		 *
 		 * The bitwise makeup of these values is shown below:
 		 *
-		 * HIGH             20      12    8    4    LOW
-		 * |----------------|--------|----|----|----|
-		 * |----Reserved----|--Type--|Meta|-D1-|-D2-|
+		 * HIGH      25      20      12    8    4    LOW
+		 * |---------|-------|--------|----|----|----|
+		 * |-Reserved|-VType-|--Type--|Meta|-D1-|-D2-|
 		 *
+		 * VType holds the vertex-only storage types (halfs, shorts, bytes and packed formats). These only exist in vertex
+		 * buffers, the shader will always see them as floats
 		 */
 		ENUM(ShaderDataType, uint32_t,
 			None                        = 0,
@@ -70,6 +72,24 @@ namespace florp
 			Bool3                       = 0b01000000'0000'0000'0011,
 			Bool4                       = 0b01000000'0000'0000'0100,
 
+			// Vertex storage types, these can only be used in vertex elements
+
+			Half                        = 0b00001'00000000'0000'0000'0001,
+			Half2                       = 0b00001'00000000'0000'0000'0010,
+			Half3                       = 0b00001'00000000'0000'0000'0011,
+			Half4                       = 0b00001'00000000'0000'0000'0100,
+
+			Short2                      = 0b00010'00000000'0000'0000'0010,
+			Short4                      = 0b00010'00000000'0000'0000'0100,
+
+			Ushort2                     = 0b00100'00000000'0000'0000'0010,
+			Ushort4                     = 0b00100'00000000'0000'0000'0100,
+
+			Ubyte4                      = 0b01000'00000000'0000'0000'0100,
+
+			// x, y and z in 10 bits each, and w in the top 2 bits
+			Int_2_10_10_10              = 0b10000'00000000'0000'0000'0100,
+
 			// Texture resources (not to be used in vertex elements)
 
 			// Usage of bit fields are a bit different here
@@ -135,7 +155,7 @@ namespace florp
 			BufferTextureUint           = 0b10000000'0010'10000'000
 		);
 
-		const uint32_t ShaderDataType_TypeMask = 0b11111111'0000'0000'0000;
+		const uint32_t ShaderDataType_TypeMask = 0b11111'11111111'0000'0000'0000;
 		const uint32_t ShaderDataType_Size1Mask = 0b00000000'0000'0000'1111;
 		const uint32_t ShaderDataType_Size2Mask = 0b00000000'0000'1111'0000;
 
@@ -277,7 +297,12 @@ namespace florp
 			Double  = 0b00010000'0000'0000'0000,
 			MatrixD = 0b00100000'0000'0000'0000,
 			Bool    = 0b01000000'0000'0000'0000,
-			Texture = 0b10000000'0000'0000'0000
+			Texture = 0b10000000'0000'0000'0000,
+			Half    = 0b00001'00000000'0000'0000'0000,
+			Short   = 0b00010'00000000'0000'0000'0000,
+			Ushort  = 0b00100'00000000'0000'0000'0000,
+			Ubyte   = 0b01000'00000000'0000'0000'0000,
+			Packed  = 0b10000'00000000'0000'0000'0000
 		);
 
 		/// <summary>
@@ -313,7 +338,14 @@ namespace florp
 			case ShaderDataTypecode::MatrixD:
 				return 8 * ((uint32_t)type & ShaderDataType_Size1Mask) * (((uint32_t)type & ShaderDataType_Size2Mask) >> 4);
 			case ShaderDataTypecode::Bool:
+			case ShaderDataTypecode::Ubyte:
 				return (uint32_t)type & ShaderDataType_Size1Mask;
+			case ShaderDataTypecode::Half:
+			case ShaderDataTypecode::Short:
+			case ShaderDataTypecode::Ushort:
+				return 2 * ((uint32_t)type & ShaderDataType_Size1Mask);
+			case ShaderDataTypecode::Packed:
+				return 4;
 			default:
 				LOG_ASSERT(false, "Unknown ShaderDataType!");
 				return 0;
@@ -334,6 +366,11 @@ namespace florp
 			case ShaderDataTypecode::Uint:
 			case ShaderDataTypecode::Double:
 			case ShaderDataTypecode::Bool:
+			case ShaderDataTypecode::Half:
+			case ShaderDataTypecode::Short:
+			case ShaderDataTypecode::Ushort:
+			case ShaderDataTypecode::Ubyte:
+			case ShaderDataTypecode::Packed:
 				return (uint32_t)type & ShaderDataType_Size1Mask;
 			case ShaderDataTypecode::Matrix:
 			case ShaderDataTypecode::MatrixD:
@@ -464,6 +501,16 @@ namespace florp
 				return GL_DOUBLE;
 			case ShaderDataTypecode::Bool:
 				return GL_BOOL;
+			case ShaderDataTypecode::Half:
+				return GL_HALF_FLOAT;
+			case ShaderDataTypecode::Short:
+				return GL_SHORT;
+			case ShaderDataTypecode::Ushort:
+				return GL_UNSIGNED_SHORT;
+			case ShaderDataTypecode::Ubyte:
+				return GL_UNSIGNED_BYTE;
+			case ShaderDataTypecode::Packed:
+				return GL_INT_2_10_10_10_REV;
 			default:
 				LOG_ASSERT(false, "Unknown Shader Data Typecode!"); return 0;
 			}
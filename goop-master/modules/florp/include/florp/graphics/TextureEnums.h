@@ -19,7 +19,9 @@ namespace florp
 			RGB10 = GL_RGB10,
 			RGB16 = GL_RGB16,
 			RGBA8 = GL_RGBA8,
-			RGBA16 = GL_RGBA16
+			RGBA16 = GL_RGBA16,
+			RGB16F = GL_RGB16F,
+			RGBA16F = GL_RGBA16F
 
 			// Note: There are sized internal formats but there is a LOT of them
 		);
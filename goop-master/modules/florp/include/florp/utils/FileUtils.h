@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 
 namespace florp {
 	namespace utils {
@@ -17,5 +18,37 @@ namespace florp {
 		 * @returns The binary blob loaded from the file, allocated with malloc
 		 */
 		void* ReadFileBinary(const char* filename, size_t& outSize);
+
+		/*
+		 * Maps a file into memory for reading, rather than copying it into a buffer. The OS pages the file in as it is
+		 * touched, so very large files can be read (even from several threads at once) without a separate read pass.
+		 * The file is unmapped when this is destroyed
+		 */
+		class MappedFile {
+		public:
+			/*
+			 * Maps the given file into memory
+			 * @param filename The path to the file to map
+			 */
+			explicit MappedFile(const char* filename);
+			~MappedFile();
+
+			MappedFile(const MappedFile& other) = delete;
+			MappedFile& operator =(const MappedFile& other) = delete;
+
+			// Whether the file was opened successfully (note that empty files are open, but have no data)
+			bool IsOpen() const { return isOpen; }
+			// Gets the contents of the file, which is NOT null-terminated
+			const char* GetData() const { return myData; }
+			size_t GetSize() const { return mySize; }
+
+		private:
+			const char* myData;
+			size_t      mySize;
+			bool        isOpen;
+			// The OS handles for the file and the mapping, these are only needed on Windows
+			void*       myFileHandle;
+			void*       myMappingHandle;
+		};
 	}
 }
\ No newline at end of file
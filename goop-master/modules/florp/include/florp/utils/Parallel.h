@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+namespace florp {
+	namespace utils {
+
+		/*
+		 * Runs a function for every job index in [0, count) across a number of threads. Threads grab jobs from a shared counter,
+		 * so uneven jobs are balanced automatically. The calling thread does work as well, and this returns once every job is done
+		 * @param count The number of jobs to run
+		 * @param threadCount The number of threads to use, or 0 to use one per hardware thread
+		 * @param func The function to run for each job, which will be called from multiple threads at once
+		 */
+		void ParallelFor(uint32_t count, uint32_t threadCount, const std::function<void(uint32_t)>& func);
+
+		/*
+		 * Gets the number of threads that ParallelFor will use when it is given a thread count of 0
+		 */
+		uint32_t GetDefaultThreadCount();
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace florp {
+	namespace utils {
+
+		// The number of second level lists per power of two, as a power of two
+		#define TLSF_SECOND_LEVEL_LOG2 4
+		#define TLSF_SECOND_LEVEL_COUNT (1 << TLSF_SECOND_LEVEL_LOG2)
+		// Enough first level lists to cover every 32 bit size
+		#define TLSF_FIRST_LEVEL_COUNT (32 - TLSF_SECOND_LEVEL_LOG2 + 1)
+
+		/*
+		 * A two level segregated fit allocator (Masmano et al. 2004), which hands out ranges of a larger resource such as a
+		 * GPU buffer. Only the bookkeeping lives here, so sizes and offsets are in whatever units the owner wants (vertices,
+		 * indices, bytes...).
+		 *
+		 * Free ranges are kept in lists bucketed by a power of two and then a linear subdivision of it, with a bitmap of which
+		 * lists are not empty, so both allocating and freeing are constant time. Freed ranges are merged with their free
+		 * neighbours straight away, so the resource does not fragment over time
+		 */
+		class TlsfAllocator {
+		public:
+			// Identifies an allocation, so that it can be freed
+			typedef uint32_t Handle;
+			// Returned when an allocation fails
+			static const Handle InvalidHandle = 0xFFFFFFFFu;
+
+			/*
+			 * Creates a new allocator
+			 * @param capacity The size of the range to allocate from
+			 */
+			TlsfAllocator(uint32_t capacity = 0);
+
+			/*
+			 * Allocates a range
+			 * @param size The size of the range to allocate, must be larger than 0
+			 * @param outOffset Receives the offset of the range that was allocated
+			 * @returns A handle to the allocation, or InvalidHandle if there is not a large enough free range
+			 */
+			Handle Allocate(uint32_t size, uint32_t& outOffset);
+			/*
+			 * Frees a range that was returned by Allocate
+			 * @param handle The handle of the allocation to free
+			 */
+			void Free(Handle handle);
+
+			/*
+			 * Adds more space to the end of the range that we allocate from. Existing allocations do not move
+			 * @param size The amount of space to add
+			 */
+			void Grow(uint32_t size);
+
+			// Gets the total size of the range we allocate from
+			uint32_t GetCapacity() const { return myCapacity; }
+			// Gets the total size of every allocation
+			uint32_t GetUsed() const { return myUsed; }
+
+		private:
+			// A range of the resource, which is either allocated or free. Every block is in a list of its physical
+			// neighbours, and free blocks are also in the free list for their size
+			struct Block {
+				uint32_t Offset;
+				uint32_t Size;
+				uint32_t PrevPhysical, NextPhysical;
+				uint32_t PrevFree, NextFree;
+				bool     IsFree;
+			};
+			std::vector<Block>    myBlocks;
+			// Indices into myBlocks that are not being used, and can be handed out to new blocks
+			std::vector<uint32_t> myUnusedBlocks;
+			// The block at the end of the range
+			uint32_t myLastBlock;
+			// One bit per first level list, set if any of its second level lists are not empty
+			uint32_t myFirstLevelBitmap;
+			// One bit per second level list, set if the list is not empty
+			uint32_t mySecondLevelBitmaps[TLSF_FIRST_LEVEL_COUNT];
+			// The first block in each free list
+			uint32_t myFreeLists[TLSF_FIRST_LEVEL_COUNT][TLSF_SECOND_LEVEL_COUNT];
+			uint32_t myCapacity, myUsed;
+
+			uint32_t __CreateBlock(uint32_t offset, uint32_t size);
+			void __ReleaseBlock(uint32_t block);
+			void __InsertFree(uint32_t block);
+			void __RemoveFree(uint32_t block);
+		};
+
+	}
+}
@@ -6,16 +6,22 @@ namespace florp {
 	namespace app {
 
 		void Application::OnWindowSizeChanged(Window& window, uint32_t width, uint32_t height, void* userPointer) {
+			// We can get many of these in a single frame while the window is being dragged, so we only store the size
+			// here, and let the layers know once at the start of the next frame (see Run)
 			if (width > 0 && height > 0) {
-				for (ApplicationLayer* layer : mySingleton->myLayers) {
-					layer->OnWindowResize(width, height);
-				}
-			}			
+				mySingleton->myPendingWidth = width;
+				mySingleton->myPendingHeight = height;
+				mySingleton->isResizePending = true;
+			}
 		}
 		
 		Application* Application::mySingleton = nullptr;
 		
-		Application::Application() {
+		Application::Application() :
+			myPendingWidth(0),
+			myPendingHeight(0),
+			isResizePending(false)
+		{
 			Logger::Init();
 
 			LOG_ASSERT(mySingleton == nullptr, "Another application is already running!");
@@ -53,6 +59,14 @@ namespace florp {
 				// Poll for window events
 				myWindow->Poll();
 
+				// Forward the last size the window had this frame to the layers, so they only resize their targets once
+				if (isResizePending) {
+					isResizePending = false;
+					for (ApplicationLayer* layer : myLayers) {
+						layer->OnWindowResize(myPendingWidth, myPendingHeight);
+					}
+				}
+
 				// Update the relevant timers
 				Timing::GameTime = static_cast<float>(glfwGetTime());
 				Timing::DeltaTime = Timing::GameTime - Timing::LastFrame;
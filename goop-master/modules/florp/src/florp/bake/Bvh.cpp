@@ -0,0 +1,336 @@
+#include "florp/bake/Bvh.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "Logging.h"
+
+namespace florp {
+	namespace bake {
+
+		// The number of bins to use when evaluating the SAH along each axis
+		#define BVH_SAH_BINS 12
+		// Nodes with this many triangles or fewer will always become leaves
+		#define BVH_MIN_LEAF_SIZE 4
+		// Nodes with more than this many triangles will always be split, even if the SAH says otherwise
+		#define BVH_MAX_LEAF_SIZE 16
+		// The depth of the traversal stack that lives on the call stack, deeper trees spill over onto the heap
+		#define BVH_STACK_SIZE 64
+
+		// The per-triangle information that we need while building the tree
+		struct BuildTriangle {
+			glm::vec3 Min, Max, Centroid;
+		};
+
+		// Simple helper for accumulating an axis aligned bounding box
+		struct Bounds {
+			glm::vec3 Min = glm::vec3( std::numeric_limits<float>::max());
+			glm::vec3 Max = glm::vec3(-std::numeric_limits<float>::max());
+
+			void Grow(const glm::vec3& point) { Min = glm::min(Min, point); Max = glm::max(Max, point); }
+			void Grow(const glm::vec3& min, const glm::vec3& max) { Min = glm::min(Min, min); Max = glm::max(Max, max); }
+			float HalfArea() const {
+				glm::vec3 extents = glm::max(Max - Min, glm::vec3(0.0f));
+				return extents.x * extents.y + extents.y * extents.z + extents.z * extents.x;
+			}
+		};
+
+		void Bvh::Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices) {
+			LOG_ASSERT(indices.size() % 3 == 0, "Index count must be a multiple of 3!");
+			myNodes.clear();
+			myPackets.clear();
+			myTriangleCount = indices.size() / 3;
+			if (myTriangleCount == 0)
+				return;
+
+			// Gather the bounds and centroids of every triangle
+			std::vector<BuildTriangle> triangles(myTriangleCount);
+			std::vector<uint32_t> order(myTriangleCount);
+			for (uint32_t ix = 0; ix < myTriangleCount; ix++) {
+				const glm::vec3& a = positions[indices[ix * 3 + 0]];
+				const glm::vec3& b = positions[indices[ix * 3 + 1]];
+				const glm::vec3& c = positions[indices[ix * 3 + 2]];
+				triangles[ix].Min = glm::min(a, glm::min(b, c));
+				triangles[ix].Max = glm::max(a, glm::max(b, c));
+				triangles[ix].Centroid = (a + b + c) / 3.0f;
+				order[ix] = ix;
+			}
+
+			// A binary tree never has more than 2n - 1 nodes, and every leaf has at least one packet
+			myNodes.reserve(myTriangleCount * 2);
+			myPackets.reserve(myTriangleCount / 2 + 1);
+			myNodes.push_back(Node());
+
+			// Turns a range of our ordered triangles into a leaf
+			auto makeLeaf = [&](uint32_t nodeIx, uint32_t begin, uint32_t end) {
+				Node& node = myNodes[nodeIx];
+				node.LeftOrFirst = (uint32_t)myPackets.size();
+				node.PacketCount = (end - begin + 3) / 4;
+				for (uint32_t start = begin; start < end; start += 4) {
+					TrianglePacket packet;
+					float v0[3][4], e1[3][4], e2[3][4];
+					for (int lane = 0; lane < 4; lane++) {
+						// Unused lanes get a degenerate triangle, which has a determinant of zero and will never be hit
+						glm::vec3 a(0.0f), edge1(0.0f), edge2(0.0f);
+						packet.Ids[lane] = 0xFFFFFFFFu;
+						if (start + lane < end) {
+							uint32_t tri = order[start + lane];
+							a = positions[indices[tri * 3 + 0]];
+							edge1 = positions[indices[tri * 3 + 1]] - a;
+							edge2 = positions[indices[tri * 3 + 2]] - a;
+							packet.Ids[lane] = tri;
+						}
+						for (int axis = 0; axis < 3; axis++) {
+							v0[axis][lane] = a[axis];
+							e1[axis][lane] = edge1[axis];
+							e2[axis][lane] = edge2[axis];
+						}
+					}
+					for (int axis = 0; axis < 3; axis++) {
+						packet.V0[axis]    = _mm_loadu_ps(v0[axis]);
+						packet.Edge1[axis] = _mm_loadu_ps(e1[axis]);
+						packet.Edge2[axis] = _mm_loadu_ps(e2[axis]);
+					}
+					myPackets.push_back(packet);
+				}
+			};
+
+			// We build with an explicit stack, so that degenerate meshes can't blow up the call stack
+			struct BuildTask { uint32_t Node, Begin, End; };
+			std::vector<BuildTask> tasks;
+			tasks.push_back({ 0, 0, (uint32_t)myTriangleCount });
+
+			while (!tasks.empty()) {
+				BuildTask task = tasks.back();
+				tasks.pop_back();
+
+				// Determine the bounds of the node, as well as the bounds of the centroids (which we split on)
+				Bounds bounds, centroidBounds;
+				for (uint32_t ix = task.Begin; ix < task.End; ix++) {
+					const BuildTriangle& tri = triangles[order[ix]];
+					bounds.Grow(tri.Min, tri.Max);
+					centroidBounds.Grow(tri.Centroid);
+				}
+				myNodes[task.Node].Min = bounds.Min;
+				myNodes[task.Node].Max = bounds.Max;
+
+				uint32_t count = task.End - task.Begin;
+				if (count <= BVH_MIN_LEAF_SIZE) {
+					makeLeaf(task.Node, task.Begin, task.End);
+					continue;
+				}
+
+				// Evaluate the SAH for a number of evenly spaced split planes along each axis
+				float bestCost = std::numeric_limits<float>::max();
+				int bestAxis = -1, bestSplit = 0;
+				glm::vec3 extents = centroidBounds.Max - centroidBounds.Min;
+				for (int axis = 0; axis < 3; axis++) {
+					if (extents[axis] <= 1e-6f)
+						continue;
+
+					Bounds binBounds[BVH_SAH_BINS];
+					uint32_t binCounts[BVH_SAH_BINS] = { 0 };
+					float scale = BVH_SAH_BINS / extents[axis];
+					for (uint32_t ix = task.Begin; ix < task.End; ix++) {
+						const BuildTriangle& tri = triangles[order[ix]];
+						int bin = glm::min((int)((tri.Centroid[axis] - centroidBounds.Min[axis]) * scale), BVH_SAH_BINS - 1);
+						binCounts[bin]++;
+						binBounds[bin].Grow(tri.Min, tri.Max);
+					}
+
+					// Sweep from the right to get the cost of everything on the right side of each plane
+					float rightCosts[BVH_SAH_BINS];
+					Bounds right;
+					uint32_t rightCount = 0;
+					for (int bin = BVH_SAH_BINS - 1; bin > 0; bin--) {
+						right.Grow(binBounds[bin].Min, binBounds[bin].Max);
+						rightCount += binCounts[bin];
+						rightCosts[bin] = rightCount > 0 ? right.HalfArea() * rightCount : 0.0f;
+					}
+					// Then sweep from the left, and combine the two
+					Bounds left;
+					uint32_t leftCount = 0;
+					for (int bin = 0; bin < BVH_SAH_BINS - 1; bin++) {
+						left.Grow(binBounds[bin].Min, binBounds[bin].Max);
+						leftCount += binCounts[bin];
+						if (leftCount == 0 || leftCount == count)
+							continue;
+						float cost = left.HalfArea() * leftCount + rightCosts[bin + 1];
+						if (cost < bestCost) {
+							bestCost = cost;
+							bestAxis = axis;
+							bestSplit = bin + 1;
+						}
+					}
+				}
+
+				// If splitting is no better than intersecting everything, we can make a leaf (as long as it is not too large)
+				float leafCost = bounds.HalfArea() * count;
+				if ((bestAxis == -1 || bestCost >= leafCost) && count <= BVH_MAX_LEAF_SIZE) {
+					makeLeaf(task.Node, task.Begin, task.End);
+					continue;
+				}
+
+				uint32_t mid;
+				if (bestAxis != -1) {
+					// Partition the triangles by which side of the split plane their centroid is on
+					float scale = BVH_SAH_BINS / extents[bestAxis];
+					float minC = centroidBounds.Min[bestAxis];
+					auto it = std::partition(order.begin() + task.Begin, order.begin() + task.End, [&](uint32_t tri) {
+						return glm::min((int)((triangles[tri].Centroid[bestAxis] - minC) * scale), BVH_SAH_BINS - 1) < bestSplit;
+					});
+					mid = (uint32_t)(it - order.begin());
+				} else {
+					// All the centroids are in the same place, so we just split the list in half
+					mid = task.Begin + count / 2;
+				}
+
+				uint32_t leftIx = (uint32_t)myNodes.size();
+				myNodes.push_back(Node());
+				myNodes.push_back(Node());
+				myNodes[task.Node].LeftOrFirst = leftIx;
+				myNodes[task.Node].PacketCount = 0;
+				tasks.push_back({ leftIx, task.Begin, mid });
+				tasks.push_back({ leftIx + 1, mid, task.End });
+			}
+
+			LOG_TRACE("Built BVH with {} nodes over {} triangles", myNodes.size(), myTriangleCount);
+		}
+
+		bool Bvh::Intersect(const Ray& ray, float maxDistance, RayHit& hit) const {
+			return __Traverse(ray, maxDistance, hit, false);
+		}
+
+		bool Bvh::Occluded(const Ray& ray, float maxDistance) const {
+			RayHit hit;
+			return __Traverse(ray, maxDistance, hit, true);
+		}
+
+		// Returns the distance that a ray enters a box at, or infinity if it misses
+		inline float IntersectBounds(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& invDir, float maxDistance) {
+			glm::vec3 t0 = (min - origin) * invDir;
+			glm::vec3 t1 = (max - origin) * invDir;
+			glm::vec3 tMin = glm::min(t0, t1);
+			glm::vec3 tMax = glm::max(t0, t1);
+			float enter = glm::max(glm::max(tMin.x, tMin.y), glm::max(tMin.z, 0.0f));
+			float exit  = glm::min(glm::min(tMax.x, tMax.y), glm::min(tMax.z, maxDistance));
+			return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+		}
+
+		bool Bvh::__Traverse(const Ray& ray, float maxDistance, RayHit& hit, bool anyHit) const {
+			if (myNodes.empty())
+				return false;
+
+			const glm::vec3 invDir = 1.0f / ray.Direction;
+
+			// Broadcast the ray into SSE registers once, so that we can test 4 triangles at a time in the leaves
+			const __m128 origin[3] = { _mm_set1_ps(ray.Origin.x), _mm_set1_ps(ray.Origin.y), _mm_set1_ps(ray.Origin.z) };
+			const __m128 dir[3] = { _mm_set1_ps(ray.Direction.x), _mm_set1_ps(ray.Direction.y), _mm_set1_ps(ray.Direction.z) };
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 epsilon = _mm_set1_ps(1e-9f);
+			const __m128 signMask = _mm_set1_ps(-0.0f);
+
+			float best = maxDistance;
+			bool found = false;
+
+			// The build doesn't limit the depth of the tree, so degenerate meshes can need more than our fixed stack. Anything
+			// past the end of it goes into the overflow, which only allocates if it is actually used
+			uint32_t stack[BVH_STACK_SIZE];
+			uint32_t stackSize = 0;
+			std::vector<uint32_t> overflow;
+			auto push = [&](uint32_t node) {
+				if (stackSize < BVH_STACK_SIZE)
+					stack[stackSize++] = node;
+				else
+					overflow.push_back(node);
+			};
+			auto pop = [&]() {
+				if (overflow.empty())
+					return stack[--stackSize];
+				uint32_t result = overflow.back();
+				overflow.pop_back();
+				return result;
+			};
+			push(0);
+
+			while (stackSize > 0) {
+				const Node& node = myNodes[pop()];
+				if (IntersectBounds(node.Min, node.Max, ray.Origin, invDir, best) == std::numeric_limits<float>::infinity())
+					continue;
+
+				if (node.PacketCount > 0) {
+					for (uint32_t ix = 0; ix < node.PacketCount; ix++) {
+						const TrianglePacket& packet = myPackets[node.LeftOrFirst + ix];
+
+						// Moller-Trumbore, for 4 triangles at once
+						// pvec = dir x edge2
+						__m128 px = _mm_sub_ps(_mm_mul_ps(dir[1], packet.Edge2[2]), _mm_mul_ps(dir[2], packet.Edge2[1]));
+						__m128 py = _mm_sub_ps(_mm_mul_ps(dir[2], packet.Edge2[0]), _mm_mul_ps(dir[0], packet.Edge2[2]));
+						__m128 pz = _mm_sub_ps(_mm_mul_ps(dir[0], packet.Edge2[1]), _mm_mul_ps(dir[1], packet.Edge2[0]));
+						__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.Edge1[0], px), _mm_mul_ps(packet.Edge1[1], py)), _mm_mul_ps(packet.Edge1[2], pz));
+						__m128 invDet = _mm_div_ps(one, det);
+
+						// tvec = origin - v0
+						__m128 tx = _mm_sub_ps(origin[0], packet.V0[0]);
+						__m128 ty = _mm_sub_ps(origin[1], packet.V0[1]);
+						__m128 tz = _mm_sub_ps(origin[2], packet.V0[2]);
+						__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), invDet);
+
+						// qvec = tvec x edge1
+						__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, packet.Edge1[2]), _mm_mul_ps(tz, packet.Edge1[1]));
+						__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, packet.Edge1[0]), _mm_mul_ps(tx, packet.Edge1[2]));
+						__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, packet.Edge1[1]), _mm_mul_ps(ty, packet.Edge1[0]));
+						__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dir[0], qx), _mm_mul_ps(dir[1], qy)), _mm_mul_ps(dir[2], qz)), invDet);
+						__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.Edge2[0], qx), _mm_mul_ps(packet.Edge2[1], qy)), _mm_mul_ps(packet.Edge2[2], qz)), invDet);
+
+						// Combine all of our rejection tests into a single mask
+						__m128 mask = _mm_cmpgt_ps(_mm_andnot_ps(signMask, det), epsilon);
+						mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+						mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+						mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+						mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+						mask = _mm_and_ps(mask, _mm_cmplt_ps(t, _mm_set1_ps(best)));
+
+						int hits = _mm_movemask_ps(mask);
+						if (hits == 0)
+							continue;
+						if (anyHit)
+							return true;
+
+						// Resolve the closest of the lanes that hit
+						alignas(16) float ts[4], us[4], vs[4];
+						_mm_store_ps(ts, t);
+						_mm_store_ps(us, u);
+						_mm_store_ps(vs, v);
+						for (int lane = 0; lane < 4; lane++) {
+							if ((hits & (1 << lane)) && ts[lane] < best) {
+								best = ts[lane];
+								hit.Distance = ts[lane];
+								hit.Triangle = packet.Ids[lane];
+								hit.U = us[lane];
+								hit.V = vs[lane];
+								found = true;
+							}
+						}
+					}
+				} else {
+					// Visit the nearest child first, so that we can cull more of the far child with our closest hit
+					uint32_t nearIx = node.LeftOrFirst, farIx = node.LeftOrFirst + 1;
+					float nearDist = IntersectBounds(myNodes[nearIx].Min, myNodes[nearIx].Max, ray.Origin, invDir, best);
+					float farDist  = IntersectBounds(myNodes[farIx].Min, myNodes[farIx].Max, ray.Origin, invDir, best);
+					if (farDist < nearDist) {
+						std::swap(nearIx, farIx);
+						std::swap(nearDist, farDist);
+					}
+					if (farDist != std::numeric_limits<float>::infinity())
+						push(farIx);
+					if (nearDist != std::numeric_limits<float>::infinity())
+						push(nearIx);
+				}
+			}
+
+			return found;
+		}
+
+	}
+}
@@ -0,0 +1,410 @@
+#include "florp/bake/LightBaker.h"
+#include <chrono>
+#include <fstream>
+#include <GLM/gtc/constants.hpp>
+#include "florp/bake/Bvh.h"
+#include "florp/utils/Parallel.h"
+#include "Logging.h"
+
+namespace florp {
+	namespace bake {
+
+		// Identifies our bake files, and the version of the format
+		#define BAKE_FILE_MAGIC 0x4B414246u // 'FBAK'
+		#define BAKE_FILE_VERSION 1u
+		// How far to push ray origins off of surfaces, to avoid self-intersection
+		#define BAKE_RAY_EPSILON 1e-3f
+		// How far rays will travel before we consider them to have escaped the scene
+		#define BAKE_RAY_DISTANCE 1e4f
+
+		// A small, fast PCG random number generator. Every job seeds its own, so bakes are deterministic regardless of threading
+		struct Random {
+			uint64_t State;
+
+			explicit Random(uint64_t seed) : State(seed * 6364136223846793005ull + 1442695040888963407ull) { Next(); }
+
+			uint32_t Next() {
+				uint64_t old = State;
+				State = old * 6364136223846793005ull + 1442695040888963407ull;
+				uint32_t shifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+				uint32_t rot = (uint32_t)(old >> 59u);
+				return (shifted >> rot) | (shifted << ((~rot + 1u) & 31));
+			}
+			// Returns a random float in the range [0, 1)
+			float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+		};
+
+		// Returns a cosine weighted direction in the hemisphere around a normal
+		glm::vec3 SampleCosineHemisphere(const glm::vec3& normal, Random& rng) {
+			float r1 = rng.NextFloat(), r2 = rng.NextFloat();
+			float phi = glm::two_pi<float>() * r1;
+			float r = glm::sqrt(r2);
+			// Build an orthonormal basis around the normal (Duff et al. 2017)
+			float sign = normal.z >= 0.0f ? 1.0f : -1.0f;
+			float a = -1.0f / (sign + normal.z);
+			float b = normal.x * normal.y * a;
+			glm::vec3 tangent = glm::vec3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+			glm::vec3 bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+			return glm::normalize(tangent * (r * glm::cos(phi)) + bitangent * (r * glm::sin(phi)) + normal * glm::sqrt(glm::max(0.0f, 1.0f - r2)));
+		}
+
+		// Returns a uniformly distributed direction on the unit sphere
+		glm::vec3 SampleSphere(Random& rng) {
+			float z = 1.0f - 2.0f * rng.NextFloat();
+			float r = glm::sqrt(glm::max(0.0f, 1.0f - z * z));
+			float phi = glm::two_pi<float>() * rng.NextFloat();
+			return glm::vec3(r * glm::cos(phi), r * glm::sin(phi), z);
+		}
+
+		/*
+		 * The flattened, world space version of the scene that we trace against
+		 */
+		struct BakeScene {
+			Bvh                    Tree;
+			std::vector<glm::vec3> Positions;
+			std::vector<glm::vec3> Normals;
+			std::vector<glm::vec2> LightmapUVs;
+			std::vector<uint32_t>  Indices;
+			// The instance that each triangle belongs to
+			std::vector<uint32_t>  TriangleInstances;
+			// The first triangle of each instance
+			std::vector<uint32_t>  InstanceFirstTriangle;
+			const std::vector<BakeInstance>* Instances;
+			const std::vector<BakeLight>*    Lights;
+			const BakeSettings*              Settings;
+
+			// Calculates the direct lighting arriving at a point from all the lights in the scene, in the same units as the runtime shaders
+			glm::vec3 DirectLighting(const glm::vec3& pos, const glm::vec3& normal) const {
+				glm::vec3 result = glm::vec3(0.0f);
+				glm::vec3 origin = pos + normal * BAKE_RAY_EPSILON;
+				for (const BakeLight& light : *Lights) {
+					glm::vec3 toLight;
+					float distance, attenuation;
+					if (light.Type == BakeLightType::Directional) {
+						toLight = -light.Direction;
+						distance = BAKE_RAY_DISTANCE;
+						attenuation = 1.0f;
+					} else {
+						toLight = light.Position - pos;
+						distance = glm::length(toLight);
+						toLight /= distance;
+						if (light.Type == BakeLightType::Spot) {
+							if (glm::dot(-toLight, light.Direction) < light.CosCutoff)
+								continue;
+							attenuation = 1.0f / (1.0f + light.Attenuation * distance * distance);
+						} else {
+							attenuation = 1.0f / (1.0f + light.Attenuation * distance);
+						}
+					}
+					float nDotL = glm::dot(normal, toLight);
+					if (nDotL <= 0.0f)
+						continue;
+					if (Tree.Occluded({ origin, toLight }, distance - BAKE_RAY_EPSILON * 2.0f))
+						continue;
+					result += light.Color * nDotL * attenuation;
+				}
+				return result;
+			}
+
+			/*
+			 * Traces a path into the scene, and returns the light arriving back along the ray. Every surface that is hit
+			 * adds its direct lighting, and then bounces the path in a cosine weighted direction
+			 */
+			glm::vec3 TracePath(Ray ray, Random& rng) const {
+				glm::vec3 result = glm::vec3(0.0f);
+				glm::vec3 throughput = glm::vec3(1.0f);
+				for (uint32_t bounce = 0; bounce < Settings->Bounces; bounce++) {
+					RayHit hit;
+					if (!Tree.Intersect(ray, BAKE_RAY_DISTANCE, hit)) {
+						result += throughput * Settings->SkyColor;
+						break;
+					}
+					glm::vec3 pos, normal;
+					Interpolate(hit.Triangle, 1.0f - hit.U - hit.V, hit.U, hit.V, pos, normal);
+					// We want to bounce off of the side of the surface that we hit
+					if (glm::dot(normal, ray.Direction) > 0.0f)
+						normal = -normal;
+
+					throughput *= (*Instances)[TriangleInstances[hit.Triangle]].Albedo;
+					result += throughput * DirectLighting(pos, normal);
+					ray = { pos + normal * BAKE_RAY_EPSILON, SampleCosineHemisphere(normal, rng) };
+				}
+				return result;
+			}
+
+			// Interpolates the world position and normal of a triangle from barycentric coordinates
+			void Interpolate(uint32_t triangle, float w0, float w1, float w2, glm::vec3& pos, glm::vec3& normal) const {
+				uint32_t i0 = Indices[triangle * 3 + 0], i1 = Indices[triangle * 3 + 1], i2 = Indices[triangle * 3 + 2];
+				pos = Positions[i0] * w0 + Positions[i1] * w1 + Positions[i2] * w2;
+				normal = Normals[i0] * w0 + Normals[i1] * w1 + Normals[i2] * w2;
+				float length = glm::length(normal);
+				if (length > 1e-6f)
+					normal /= length;
+				else
+					normal = glm::normalize(glm::cross(Positions[i1] - Positions[i0], Positions[i2] - Positions[i0]));
+			}
+		};
+
+		// Stores the surface point that each texel of a lightmap covers
+		struct TexelSurface {
+			glm::vec3 Position;
+			glm::vec3 Normal;
+			bool      IsValid;
+		};
+
+		// Rasterizes an instance's triangles into its lightmap, to find the surface point at every texel center
+		void RasterizeLightmap(const BakeScene& scene, uint32_t instanceIx, std::vector<TexelSurface>& surfaces) {
+			const BakeInstance& instance = (*scene.Instances)[instanceIx];
+			uint32_t size = instance.LightmapSize;
+			surfaces.assign((size_t)size * size, { glm::vec3(0.0f), glm::vec3(0.0f), false });
+
+			uint32_t firstTri = scene.InstanceFirstTriangle[instanceIx];
+			uint32_t triCount = (uint32_t)(instance.Mesh->Indices.size() / 3);
+			for (uint32_t tri = firstTri; tri < firstTri + triCount; tri++) {
+				glm::vec2 uv[3];
+				for (int corner = 0; corner < 3; corner++)
+					uv[corner] = scene.LightmapUVs[scene.Indices[tri * 3 + corner]] * (float)size;
+
+				float area = (uv[1].x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (uv[1].y - uv[0].y);
+				if (glm::abs(area) < 1e-12f)
+					continue;
+
+				glm::vec2 min = glm::min(uv[0], glm::min(uv[1], uv[2]));
+				glm::vec2 max = glm::max(uv[0], glm::max(uv[1], uv[2]));
+				int x0 = glm::max((int)glm::floor(min.x), 0), x1 = glm::min((int)glm::ceil(max.x), (int)size - 1);
+				int y0 = glm::max((int)glm::floor(min.y), 0), y1 = glm::min((int)glm::ceil(max.y), (int)size - 1);
+				for (int y = y0; y <= y1; y++) {
+					for (int x = x0; x <= x1; x++) {
+						// Determine the barycentric coordinates of the texel center
+						glm::vec2 p = glm::vec2(x + 0.5f, y + 0.5f);
+						float w0 = ((uv[1].x - p.x) * (uv[2].y - p.y) - (uv[2].x - p.x) * (uv[1].y - p.y)) / area;
+						float w1 = ((uv[2].x - p.x) * (uv[0].y - p.y) - (uv[0].x - p.x) * (uv[2].y - p.y)) / area;
+						float w2 = 1.0f - w0 - w1;
+						if (w0 < -1e-4f || w1 < -1e-4f || w2 < -1e-4f)
+							continue;
+
+						TexelSurface& surface = surfaces[(size_t)y * size + x];
+						scene.Interpolate(tri, w0, w1, w2, surface.Position, surface.Normal);
+						surface.IsValid = true;
+					}
+				}
+			}
+		}
+
+		// Grows the baked charts of a lightmap outwards by a texel, so that bilinear filtering does not pull in black texels from outside of the charts
+		void DilateLightmap(Lightmap& lightmap, std::vector<TexelSurface>& surfaces) {
+			int size = (int)lightmap.Size;
+			std::vector<glm::vec3> texels = lightmap.Texels;
+			std::vector<bool> filled(surfaces.size(), false);
+			for (int y = 0; y < size; y++) {
+				for (int x = 0; x < size; x++) {
+					if (surfaces[(size_t)y * size + x].IsValid)
+						continue;
+					glm::vec3 sum = glm::vec3(0.0f);
+					int count = 0;
+					for (int dy = -1; dy <= 1; dy++) {
+						for (int dx = -1; dx <= 1; dx++) {
+							int nx = x + dx, ny = y + dy;
+							if (nx < 0 || ny < 0 || nx >= size || ny >= size || !surfaces[(size_t)ny * size + nx].IsValid)
+								continue;
+							sum += lightmap.Texels[(size_t)ny * size + nx];
+							count++;
+						}
+					}
+					if (count > 0) {
+						texels[(size_t)y * size + x] = sum / (float)count;
+						filled[(size_t)y * size + x] = true;
+					}
+				}
+			}
+			for (size_t ix = 0; ix < surfaces.size(); ix++)
+				surfaces[ix].IsValid = surfaces[ix].IsValid || filled[ix];
+			lightmap.Texels = std::move(texels);
+		}
+
+		BakeResult LightBaker::Bake(const std::vector<BakeInstance>& instances, const std::vector<BakeLight>& lights, const BakeSettings& settings) {
+			auto start = std::chrono::high_resolution_clock::now();
+			uint32_t threadCount = settings.ThreadCount > 0 ? settings.ThreadCount : utils::GetDefaultThreadCount();
+
+			BakeScene scene;
+			scene.Instances = &instances;
+			scene.Lights = &lights;
+			scene.Settings = &settings;
+
+			// Flatten all of our instances into a single world space triangle soup
+			for (uint32_t ix = 0; ix < instances.size(); ix++) {
+				const BakeInstance& instance = instances[ix];
+				LOG_ASSERT(instance.Mesh != nullptr, "Bake instances must have a mesh!");
+				uint32_t vertexOffset = (uint32_t)scene.Positions.size();
+				scene.InstanceFirstTriangle.push_back((uint32_t)(scene.Indices.size() / 3));
+
+				glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance.Transform)));
+				for (const graphics::Vertex& vert : instance.Mesh->Vertices) {
+					scene.Positions.push_back(glm::vec3(instance.Transform * glm::vec4(vert.Position, 1.0f)));
+					scene.Normals.push_back(glm::normalize(normalMatrix * vert.Normal));
+					scene.LightmapUVs.push_back(vert.LightmapUV);
+				}
+				for (uint32_t index : instance.Mesh->Indices)
+					scene.Indices.push_back(index + vertexOffset);
+				scene.TriangleInstances.resize(scene.Indices.size() / 3, ix);
+			}
+			scene.Tree.Build(scene.Positions, scene.Indices);
+
+			LOG_INFO("Baking lighting for {} triangles and {} lights on {} threads", scene.Indices.size() / 3, lights.size(), threadCount);
+
+			BakeResult result;
+			result.Lightmaps.resize(instances.size());
+
+			// Work out where every lightmap texel lies on the surface, and make a job for every row of every lightmap
+			std::vector<std::vector<TexelSurface>> surfaces(instances.size());
+			struct RowJob { uint32_t Instance, Row; };
+			std::vector<RowJob> rowJobs;
+			for (uint32_t ix = 0; ix < instances.size(); ix++) {
+				if (instances[ix].LightmapSize == 0)
+					continue;
+				RasterizeLightmap(scene, ix, surfaces[ix]);
+				result.Lightmaps[ix].Size = instances[ix].LightmapSize;
+				result.Lightmaps[ix].Texels.resize((size_t)instances[ix].LightmapSize * instances[ix].LightmapSize, glm::vec3(0.0f));
+				for (uint32_t row = 0; row < instances[ix].LightmapSize; row++)
+					rowJobs.push_back({ ix, row });
+			}
+
+			// Bake the lightmaps, every texel gets its direct lighting plus the average of a number of indirect paths
+			utils::ParallelFor((uint32_t)rowJobs.size(), threadCount, [&](uint32_t job) {
+				const RowJob& rowJob = rowJobs[job];
+				Random rng(((uint64_t)rowJob.Instance << 32) | rowJob.Row);
+				Lightmap& lightmap = result.Lightmaps[rowJob.Instance];
+				for (uint32_t x = 0; x < lightmap.Size; x++) {
+					size_t texelIx = (size_t)rowJob.Row * lightmap.Size + x;
+					const TexelSurface& surface = surfaces[rowJob.Instance][texelIx];
+					if (!surface.IsValid)
+						continue;
+
+					glm::vec3 indirect = glm::vec3(0.0f);
+					if (settings.Bounces > 0) {
+						glm::vec3 origin = surface.Position + surface.Normal * BAKE_RAY_EPSILON;
+						for (uint32_t sample = 0; sample < settings.SamplesPerTexel; sample++)
+							indirect += scene.TracePath({ origin, SampleCosineHemisphere(surface.Normal, rng) }, rng);
+						indirect /= (float)glm::max(settings.SamplesPerTexel, 1u);
+					}
+					lightmap.Texels[texelIx] = scene.DirectLighting(surface.Position, surface.Normal) + indirect;
+				}
+			});
+
+			for (uint32_t ix = 0; ix < instances.size(); ix++) {
+				for (uint32_t pass = 0; pass < settings.DilationPasses && result.Lightmaps[ix].Size > 0; pass++)
+					DilateLightmap(result.Lightmaps[ix], surfaces[ix]);
+			}
+
+			// Bake the probe grid
+			ProbeGrid& probes = result.Probes;
+			probes.Min = settings.ProbeMin;
+			probes.Max = settings.ProbeMax;
+			probes.Count = glm::max(settings.ProbeCount, glm::ivec3(0));
+			probes.Coefficients.resize(probes.GetProbeCount() * 3, glm::vec4(0.0f));
+			utils::ParallelFor((uint32_t)probes.GetProbeCount(), threadCount, [&](uint32_t probeIx) {
+				Random rng(0xFFFFFFFF00000000ull | probeIx);
+				glm::ivec3 cell = glm::ivec3(probeIx % probes.Count.x, (probeIx / probes.Count.x) % probes.Count.y, probeIx / (probes.Count.x * probes.Count.y));
+				glm::vec3 t = glm::vec3(cell) / glm::max(glm::vec3(probes.Count - 1), glm::vec3(1.0f));
+				glm::vec3 pos = glm::mix(probes.Min, probes.Max, t);
+
+				// Project the incoming light into L1 SH, pre-convolved with the cosine lobe. For uniform sphere samples this
+				// boils down to the average radiance for the constant term, and twice the average radiance-weighted direction
+				glm::vec3 constant = glm::vec3(0.0f);
+				glm::mat3 linear = glm::mat3(0.0f); // Column per axis, row per color channel
+				for (uint32_t sample = 0; sample < settings.SamplesPerProbe; sample++) {
+					glm::vec3 dir = SampleSphere(rng);
+					glm::vec3 radiance = scene.TracePath({ pos, dir }, rng);
+					constant += radiance;
+					linear += glm::outerProduct(radiance, dir);
+				}
+				float invSamples = 1.0f / (float)glm::max(settings.SamplesPerProbe, 1u);
+				constant *= invSamples;
+				linear *= 2.0f * invSamples;
+
+				// Lights are infinitely small, so rays will never hit them. Instead we project their direct contribution analytically
+				for (const BakeLight& light : lights) {
+					glm::vec3 toLight;
+					float distance, attenuation;
+					if (light.Type == BakeLightType::Directional) {
+						toLight = -light.Direction;
+						distance = BAKE_RAY_DISTANCE;
+						attenuation = 1.0f;
+					} else {
+						toLight = light.Position - pos;
+						distance = glm::length(toLight);
+						toLight /= distance;
+						if (light.Type == BakeLightType::Spot) {
+							if (glm::dot(-toLight, light.Direction) < light.CosCutoff)
+								continue;
+							attenuation = 1.0f / (1.0f + light.Attenuation * distance * distance);
+						} else {
+							attenuation = 1.0f / (1.0f + light.Attenuation * distance);
+						}
+					}
+					if (scene.Tree.Occluded({ pos, toLight }, distance - BAKE_RAY_EPSILON))
+						continue;
+					glm::vec3 intensity = light.Color * attenuation;
+					constant += intensity * 0.25f;
+					linear += glm::outerProduct(intensity * 0.5f, toLight);
+				}
+
+				for (int channel = 0; channel < 3; channel++)
+					probes.Coefficients[(size_t)probeIx * 3 + channel] = glm::vec4(constant[channel], linear[0][channel], linear[1][channel], linear[2][channel]);
+			});
+
+			auto end = std::chrono::high_resolution_clock::now();
+			LOG_INFO("Finished baking {} lightmap rows and {} probes in {:.2f}s", rowJobs.size(), probes.GetProbeCount(),
+				std::chrono::duration<float>(end - start).count());
+			return result;
+		}
+
+		bool BakeResult::Save(const std::string& filename) const {
+			std::ofstream file(filename, std::ios::binary);
+			if (!file.is_open()) {
+				LOG_WARN("Failed to open bake file \"{}\" for writing", filename);
+				return false;
+			}
+
+			auto write = [&](const void* data, size_t size) { file.write(reinterpret_cast<const char*>(data), size); };
+			uint32_t header[3] = { BAKE_FILE_MAGIC, BAKE_FILE_VERSION, (uint32_t)Lightmaps.size() };
+			write(header, sizeof(header));
+			for (const Lightmap& lightmap : Lightmaps) {
+				write(&lightmap.Size, sizeof(uint32_t));
+				write(lightmap.Texels.data(), lightmap.Texels.size() * sizeof(glm::vec3));
+			}
+			write(&Probes.Min, sizeof(glm::vec3));
+			write(&Probes.Max, sizeof(glm::vec3));
+			write(&Probes.Count, sizeof(glm::ivec3));
+			write(Probes.Coefficients.data(), Probes.Coefficients.size() * sizeof(glm::vec4));
+			return file.good();
+		}
+
+		bool BakeResult::Load(const std::string& filename, BakeResult& result) {
+			std::ifstream file(filename, std::ios::binary);
+			if (!file.is_open())
+				return false;
+
+			auto read = [&](void* data, size_t size) { return (bool)file.read(reinterpret_cast<char*>(data), size); };
+			uint32_t header[3];
+			if (!read(header, sizeof(header)) || header[0] != BAKE_FILE_MAGIC || header[1] != BAKE_FILE_VERSION) {
+				LOG_WARN("\"{}\" is not a valid bake file, or was baked with an older version", filename);
+				return false;
+			}
+
+			result.Lightmaps.resize(header[2]);
+			for (Lightmap& lightmap : result.Lightmaps) {
+				if (!read(&lightmap.Size, sizeof(uint32_t)))
+					return false;
+				lightmap.Texels.resize((size_t)lightmap.Size * lightmap.Size);
+				if (!read(lightmap.Texels.data(), lightmap.Texels.size() * sizeof(glm::vec3)))
+					return false;
+			}
+			if (!read(&result.Probes.Min, sizeof(glm::vec3)) || !read(&result.Probes.Max, sizeof(glm::vec3)) || !read(&result.Probes.Count, sizeof(glm::ivec3)))
+				return false;
+			result.Probes.Coefficients.resize(result.Probes.GetProbeCount() * 3);
+			return read(result.Probes.Coefficients.data(), result.Probes.Coefficients.size() * sizeof(glm::vec4));
+		}
+
+	}
+}
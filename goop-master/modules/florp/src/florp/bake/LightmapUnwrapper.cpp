@@ -0,0 +1,161 @@
+#include "florp/bake/LightmapUnwrapper.h"
+#include <unordered_map>
+#include <limits>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <GLM/gtx/hash.hpp>
+#include "stb_rect_pack.h"
+#include "Logging.h"
+
+namespace florp {
+	namespace bake {
+
+		// The number of times we will shrink the charts and try again when they do not fit in the lightmap
+		#define LIGHTMAP_MAX_PACK_ATTEMPTS 16
+		// The fraction of the lightmap that we initially try to fill with charts (the rest is lost to padding and packing)
+		#define LIGHTMAP_TARGET_COVERAGE 0.6f
+
+		// Projects a position onto the plane perpendicular to the given axis
+		inline glm::vec2 ProjectToAxis(const glm::vec3& pos, int axis) {
+			return glm::vec2(pos[(axis + 1) % 3], pos[(axis + 2) % 3]);
+		}
+
+		bool LightmapUnwrapper::Unwrap(graphics::MeshData& data, uint32_t resolution, uint32_t padding) {
+			using namespace graphics;
+			LOG_ASSERT(resolution > padding * 2, "Lightmap resolution must be larger than the padding!");
+
+			size_t triCount = data.Indices.size() / 3;
+			if (triCount == 0)
+				return true;
+
+			// Weld the vertices by position, so that our charts can grow across vertices that were split for normals or UVs
+			std::unordered_map<glm::vec3, uint32_t> positionIds;
+			std::vector<uint32_t> welded(data.Vertices.size());
+			for (size_t ix = 0; ix < data.Vertices.size(); ix++) {
+				auto it = positionIds.emplace(data.Vertices[ix].Position, (uint32_t)positionIds.size()).first;
+				welded[ix] = it->second;
+			}
+			size_t weldedCount = positionIds.size();
+
+			// Determine which way each triangle is facing (which axis its normal is closest to, and in which direction)
+			std::vector<uint8_t> facing(triCount);
+			for (size_t tri = 0; tri < triCount; tri++) {
+				const glm::vec3& a = data.Vertices[data.Indices[tri * 3 + 0]].Position;
+				const glm::vec3& b = data.Vertices[data.Indices[tri * 3 + 1]].Position;
+				const glm::vec3& c = data.Vertices[data.Indices[tri * 3 + 2]].Position;
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				glm::vec3 absNormal = glm::abs(normal);
+				int axis = absNormal.x > absNormal.y ? (absNormal.x > absNormal.z ? 0 : 2) : (absNormal.y > absNormal.z ? 1 : 2);
+				facing[tri] = (uint8_t)(axis * 2 + (normal[axis] < 0.0f ? 1 : 0));
+			}
+
+			// Build a list of the triangles touching each welded vertex
+			std::vector<uint32_t> vertTriOffsets(weldedCount + 1, 0);
+			for (size_t ix = 0; ix < triCount * 3; ix++)
+				vertTriOffsets[welded[data.Indices[ix]] + 1]++;
+			for (size_t ix = 0; ix < weldedCount; ix++)
+				vertTriOffsets[ix + 1] += vertTriOffsets[ix];
+			std::vector<uint32_t> vertTris(triCount * 3);
+			std::vector<uint32_t> fill(vertTriOffsets.begin(), vertTriOffsets.end() - 1);
+			for (size_t ix = 0; ix < triCount * 3; ix++)
+				vertTris[fill[welded[data.Indices[ix]]]++] = (uint32_t)(ix / 3);
+
+			// Flood fill across connected triangles with the same facing to form our charts
+			struct Chart {
+				int       Axis;
+				glm::vec2 Min, Max;
+			};
+			std::vector<Chart> charts;
+			std::vector<uint32_t> chartOf(triCount, 0xFFFFFFFFu);
+			std::vector<uint32_t> stack;
+			for (size_t seed = 0; seed < triCount; seed++) {
+				if (chartOf[seed] != 0xFFFFFFFFu)
+					continue;
+
+				uint32_t chartIx = (uint32_t)charts.size();
+				Chart chart;
+				chart.Axis = facing[seed] / 2;
+				chart.Min = glm::vec2(std::numeric_limits<float>::max());
+				chart.Max = glm::vec2(-std::numeric_limits<float>::max());
+
+				chartOf[seed] = chartIx;
+				stack.push_back((uint32_t)seed);
+				while (!stack.empty()) {
+					uint32_t tri = stack.back();
+					stack.pop_back();
+					for (int corner = 0; corner < 3; corner++) {
+						uint32_t vert = data.Indices[tri * 3 + corner];
+						glm::vec2 projected = ProjectToAxis(data.Vertices[vert].Position, chart.Axis);
+						chart.Min = glm::min(chart.Min, projected);
+						chart.Max = glm::max(chart.Max, projected);
+
+						uint32_t weldedIx = welded[vert];
+						for (uint32_t ix = vertTriOffsets[weldedIx]; ix < vertTriOffsets[weldedIx + 1]; ix++) {
+							uint32_t other = vertTris[ix];
+							if (chartOf[other] == 0xFFFFFFFFu && facing[other] == facing[seed]) {
+								chartOf[other] = chartIx;
+								stack.push_back(other);
+							}
+						}
+					}
+				}
+				charts.push_back(chart);
+			}
+
+			// Make an initial guess at our texel density based on the area of all the charts
+			float totalArea = 0.0f;
+			for (const Chart& chart : charts) {
+				glm::vec2 extents = chart.Max - chart.Min;
+				totalArea += extents.x * extents.y;
+			}
+			float scale = glm::sqrt(resolution * resolution * LIGHTMAP_TARGET_COVERAGE / glm::max(totalArea, 1e-6f));
+
+			// Try to pack our charts into the lightmap, shrinking them each time they do not fit
+			std::vector<stbrp_rect> rects(charts.size());
+			std::vector<stbrp_node> nodes(resolution);
+			bool packed = false;
+			for (int attempt = 0; attempt < LIGHTMAP_MAX_PACK_ATTEMPTS && !packed; attempt++) {
+				for (size_t ix = 0; ix < charts.size(); ix++) {
+					glm::vec2 extents = charts[ix].Max - charts[ix].Min;
+					rects[ix].id = (int)ix;
+					rects[ix].w = (stbrp_coord)(glm::ceil(extents.x * scale) + padding * 2);
+					rects[ix].h = (stbrp_coord)(glm::ceil(extents.y * scale) + padding * 2);
+				}
+				stbrp_context context;
+				stbrp_init_target(&context, resolution, resolution, nodes.data(), (int)nodes.size());
+				packed = stbrp_pack_rects(&context, rects.data(), (int)rects.size()) != 0;
+				if (!packed)
+					scale *= 0.85f;
+			}
+			if (!packed) {
+				LOG_WARN("Failed to pack {} lightmap charts for mesh \"{}\" into a {}x{} lightmap", charts.size(), data.DebugName, resolution, resolution);
+				return false;
+			}
+
+			// Rebuild the vertex list, duplicating any vertices that are shared between charts
+			std::vector<Vertex> vertices;
+			vertices.reserve(data.Vertices.size());
+			std::unordered_map<uint64_t, uint32_t> remap;
+			for (size_t ix = 0; ix < triCount * 3; ix++) {
+				uint32_t chartIx = chartOf[ix / 3];
+				uint32_t vert = data.Indices[ix];
+				uint64_t key = ((uint64_t)chartIx << 32) | vert;
+				auto it = remap.find(key);
+				if (it == remap.end()) {
+					const Chart& chart = charts[chartIx];
+					const stbrp_rect& rect = rects[chartIx];
+					Vertex result = data.Vertices[vert];
+					glm::vec2 local = (ProjectToAxis(result.Position, chart.Axis) - chart.Min) * scale;
+					result.LightmapUV = (glm::vec2(rect.x + padding, rect.y + padding) + local) / (float)resolution;
+					it = remap.emplace(key, (uint32_t)vertices.size()).first;
+					vertices.push_back(result);
+				}
+				data.Indices[ix] = it->second;
+			}
+			data.Vertices = std::move(vertices);
+
+			LOG_TRACE("Unwrapped mesh \"{}\" into {} lightmap charts at {} texels per unit", data.DebugName, charts.size(), scale);
+			return true;
+		}
+
+	}
+}
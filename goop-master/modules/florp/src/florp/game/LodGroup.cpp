@@ -0,0 +1,63 @@
+#include "florp/game/LodGroup.h"
+#include <cmath>
+#include "florp/graphics/MeshProcessor.h"
+#include "Logging.h"
+
+namespace florp {
+	namespace game {
+
+		float LodGroup::GetScreenSize(const glm::mat4& world, const glm::vec3& cameraPosition, const glm::mat4& projection) const {
+			glm::vec3 center = glm::vec3(world * glm::vec4(BoundsCenter, 1.0f));
+			float scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+			float radius = BoundsRadius * scale;
+			// Orthographic projections don't shrink with distance
+			if (projection[3][3] != 0.0f)
+				return radius * projection[1][1];
+			// If we are inside of the bounds, we treat it as covering the whole screen
+			float distance = glm::max(glm::length(center - cameraPosition), radius);
+			return radius * projection[1][1] / distance;
+		}
+
+		void LodGroup::Update(float screenSize) {
+			CameraLevel = SelectLevel(Levels, CameraLevel, screenSize, Hysteresis);
+			ShadowLevel = SelectLevel(Levels, ShadowLevel, screenSize * ShadowScale, Hysteresis);
+		}
+
+		uint32_t LodGroup::SelectLevel(const std::vector<LodLevel>& levels, uint32_t current, float screenSize, float hysteresis) {
+			if (levels.empty())
+				return 0;
+			uint32_t level = glm::min(current, (uint32_t)levels.size() - 1);
+			// Move to coarser levels once we are clearly smaller than the current level's threshold
+			while (level + 1 < levels.size() && screenSize < levels[level].ScreenSize * (1.0f - hysteresis))
+				level++;
+			// Move to finer levels once we are clearly larger than the finer level's threshold
+			while (level > 0 && screenSize > levels[level - 1].ScreenSize * (1.0f + hysteresis))
+				level--;
+			return level;
+		}
+
+		LodGroup LodGroup::Create(const std::vector<graphics::MeshData>& levels, graphics::VertexFormat format, float screenSize) {
+			LOG_ASSERT(!levels.empty(), "A LOD group needs at least one level!");
+			LodGroup result;
+
+			// We use a sphere around the center of the most detailed level's bounds
+			const graphics::MeshBounds bounds = graphics::MeshProcessor::ComputeBounds(levels[0].Vertices);
+			result.BoundsCenter = glm::vec3(bounds.Sphere);
+			result.BoundsRadius = bounds.Sphere.w;
+
+			const float baseTriangles = glm::max((float)levels[0].Indices.size() / 3.0f, 1.0f);
+			for (size_t ix = 0; ix < levels.size(); ix++) {
+				graphics::MeshData data = levels[ix];
+				LodLevel level;
+				level.Mesh = graphics::MeshBuilder::Bake(data, format);
+				// Halving the triangles halves the area the level can cover at the same density, and the last level covers
+				// everything down to nothing
+				float triangles = (float)levels[ix].Indices.size() / 3.0f;
+				level.ScreenSize = ix + 1 < levels.size() ? screenSize * sqrtf(triangles / baseTriangles) : 0.0f;
+				result.Levels.push_back(level);
+			}
+			return result;
+		}
+
+	}
+}
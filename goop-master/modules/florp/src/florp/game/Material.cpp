@@ -63,6 +63,12 @@ namespace florp {
 			
 			return result;
 		}
+
+		Material::Sptr Material::Clone(const graphics::Shader::Sptr& shader) {
+			Sptr result = Clone();
+			result->myShader = shader;
+			return result;
+		}
 		
 	}
 }
\ No newline at end of file
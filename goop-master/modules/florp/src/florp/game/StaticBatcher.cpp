@@ -0,0 +1,105 @@
+#include "florp/game/StaticBatcher.h"
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include "florp/game/Transform.h"
+#include "florp/game/RenderableComponent.h"
+#include "florp/graphics/MeshProcessor.h"
+#include "Logging.h"
+
+namespace florp {
+	namespace game {
+
+		size_t StaticBatcher::Build(entt::registry& ecs, graphics::VertexFormat format, float cellSize) {
+			using namespace graphics;
+
+			// Group our static entities by material first, then by the grid cell that the center of their bounds is in
+			typedef std::tuple<Material*, int, int, int> BatchKey;
+			std::map<BatchKey, std::vector<entt::entity>> groups;
+			ecs.view<StaticComponent, RenderableComponent>().each([&](auto entity, const StaticComponent& source, const RenderableComponent& renderable) {
+				if (source.Source == nullptr || source.Source->Vertices.empty() || renderable.Material == nullptr)
+					return;
+				const MeshBounds bounds = MeshProcessor::ComputeBounds(source.Source->Vertices);
+				const glm::mat4& world = ecs.get_or_assign<Transform>(entity).GetWorldTransform();
+				glm::ivec3 cell = glm::ivec3(glm::floor(glm::vec3(world * glm::vec4(glm::vec3(bounds.Sphere), 1.0f)) / cellSize));
+				groups[BatchKey(renderable.Material.get(), cell.x, cell.y, cell.z)].push_back(entity);
+			});
+
+			size_t batchCount = 0, entityCount = 0;
+			// Entities that share a source but aren't batched can still share the mesh that we bake for them
+			std::unordered_map<const MeshData*, Mesh::Sptr> singles;
+			for (auto& [key, entities] : groups) {
+				// There's nothing to gain from batching an entity by itself, but it may be relying on us for its mesh
+				if (entities.size() < 2) {
+					RenderableComponent& renderable = ecs.get<RenderableComponent>(entities[0]);
+					if (renderable.Mesh == nullptr) {
+						const std::shared_ptr<MeshData>& source = ecs.get<StaticComponent>(entities[0]).Source;
+						Mesh::Sptr& mesh = singles[source.get()];
+						if (mesh == nullptr) {
+							MeshData data = *source;
+							mesh = MeshBuilder::Bake(data, format, true);
+						}
+						renderable.Mesh = mesh;
+					}
+					continue;
+				}
+
+				MeshData data = MeshBuilder::Begin("StaticBatch" + std::to_string(batchCount));
+				StaticBatchComponent batch;
+				batch.EntityCount = (uint32_t)entities.size();
+				Material::Sptr material = ecs.get<RenderableComponent>(entities[0]).Material;
+
+				for (entt::entity entity : entities) {
+					const MeshData& source = *ecs.get<StaticComponent>(entity).Source;
+					const glm::mat4& world = ecs.get<Transform>(entity).GetWorldTransform();
+					const glm::mat3 rotation = glm::mat3(world);
+					const glm::mat3 normalMatrix = glm::transpose(glm::inverse(rotation));
+					// Mirrored transforms flip the winding of the triangles, so we need to flip them back
+					const bool isMirrored = glm::determinant(rotation) < 0.0f;
+					const uint32_t baseVertex = (uint32_t)data.Vertices.size();
+
+					data.Vertices.reserve(data.Vertices.size() + source.Vertices.size());
+					for (Vertex vertex : source.Vertices) {
+						vertex.Position = glm::vec3(world * glm::vec4(vertex.Position, 1.0f));
+						vertex.Normal = glm::normalize(normalMatrix * vertex.Normal);
+						data.Vertices.push_back(vertex);
+					}
+					data.Indices.reserve(data.Indices.size() + source.Indices.size());
+					for (size_t ix = 0; ix + 2 < source.Indices.size(); ix += 3) {
+						data.Indices.push_back(baseVertex + source.Indices[ix]);
+						data.Indices.push_back(baseVertex + source.Indices[ix + (isMirrored ? 2 : 1)]);
+						data.Indices.push_back(baseVertex + source.Indices[ix + (isMirrored ? 1 : 2)]);
+					}
+
+					// The batch draws this entity from now on
+					ecs.remove<RenderableComponent>(entity);
+				}
+
+				// The batch replaces all of its entities with a single entity, that has an identity transform
+				entt::entity result = ecs.create();
+				ecs.assign<Transform>(result);
+				RenderableComponent& renderable = ecs.assign<RenderableComponent>(result);
+				renderable.Mesh = MeshBuilder::Bake(data, format, true);
+				// Batches are large, and usually only partly on screen, so they are culled a meshlet at a time. Bake has already
+				// optimized the data, so the meshlets follow its cache-friendly triangle order
+				MeshletData meshlets = MeshBuilder::BuildMeshlets(data);
+				// The normal cones only tell us that a meshlet is facing away, so they're only safe to use when the back faces
+				// are being culled anyways. Otherwise, the meshlets are only culled against the frustum
+				if (material->RasterState.CullMode != CullMode::Back) {
+					for (Meshlet& meshlet : meshlets.Meshlets)
+						meshlet.Cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+				}
+				renderable.Mesh->SetMeshlets(meshlets);
+				renderable.Material = material;
+				ecs.assign<StaticBatchComponent>(result, batch);
+
+				batchCount++;
+				entityCount += entities.size();
+			}
+
+			LOG_INFO("Merged {} static entities into {} batches", entityCount, batchCount);
+			return batchCount;
+		}
+
+	}
+}
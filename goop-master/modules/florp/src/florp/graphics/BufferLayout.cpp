@@ -9,7 +9,8 @@ namespace florp {
 				Type == other.Type &&
 				SizeInBytes == other.SizeInBytes &&
 				Offset == other.Offset &&
-				IsNormalized == other.IsNormalized;
+				IsNormalized == other.IsNormalized &&
+				Location == other.Location;
 		}
 
 		std::size_t BufferElementHash::operator()(const BufferElement& value) const {
@@ -19,6 +20,7 @@ namespace florp {
 			hash ^= (std::hash<uint32_t>()(value.Offset)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
 			hash ^= (std::hash<bool>()(value.IsNormalized)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
 			hash ^= (std::hash<uint32_t>()(value.ArraySize)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+			hash ^= (std::hash<int32_t>()(value.Location)) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
 			return  hash;
 		}
 
@@ -1,80 +1,127 @@
 #include "florp/graphics/Mesh.h"
+#include <cfloat>
+#include <cstring>
+#include <GLM/gtc/type_ptr.hpp>
 
 namespace florp {
 	namespace graphics {
 		
-		Mesh::Mesh(void* vertices, size_t numVerts, const BufferLayout& layout, uint32_t* indices, size_t numIndices) {
+		Mesh::Mesh(const void* vertices, size_t numVerts, const BufferLayout& layout, const uint32_t* indices, size_t numIndices) {
 			myIndexCount = numIndices;
 			myVertexCount = numVerts;
 
 			// Cache the layout
 			myLayout = layout;
 
-			// Create and bind our vertex array
-			glCreateVertexArrays(1, &myRendererID);
-			glBindVertexArray(myRendererID);
+			// Most meshes have less than 65536 vertices, in which case we can halve the size of the index buffer (and the
+			// bandwidth used to fetch it) by using 16 bit indices. Those meshes live in a separate arena from the larger ones
+			GLenum indexType = numVerts <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+			myArena = MeshArena::Get(layout, indexType);
+			myRange = myArena->Allocate(vertices, (uint32_t)numVerts, indices, (uint32_t)numIndices);
+			myRendererID = myArena->GetRenderID();
+			myMeshletBuffers[0] = myMeshletBuffers[1] = 0;
+			myMeshletCount = myMeshletIndexCount = 0;
 
-			// Create 2 buffers, 1 for vertices and the other for indices
-			glCreateBuffers(2, myBuffers);
-
-			// Bind and buffer our vertex data
-			glBindBuffer(GL_ARRAY_BUFFER, myBuffers[0]);
-			glBufferData(GL_ARRAY_BUFFER, numVerts * layout.GetStride(), vertices, GL_STATIC_DRAW);
-
-			// Bind and buffer our index data
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, myBuffers[1]);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(uint32_t), indices, GL_STATIC_DRAW);
-
-			// Our elements will be sequential in the shaders (so attrib 0, 1, 2 ...)
-			uint32_t index = 0;
-			// Iterate over all elements
-			for (const BufferElement& element : layout) {
-				// Enable the attribute
-				glEnableVertexAttribArray(index);
-				// Set up the vertex attribute
-				glVertexAttribPointer(index,
-					element.GetComponentCount(), // Number of components in the attribute
-					ToGLElementType(GetShaderDataTypeCode(element.Type)), // The data type of the attribute
-					element.IsNormalized, // Whether or not the element is normalized
-					layout.GetStride(),
-					(const void*)element.Offset);
-				index++;
-			}
-
-			// Unbind our VAO
-			glBindVertexArray(0);
+			// Find a bounding sphere for culling. If we can't read the positions, we use a sphere that covers everything
+			BufferElement position;
+			if (!layout.GetElementByUsage(VertexUsage::Position, position))
+				position = *layout.begin();
+			if (position.Type == ShaderDataType::Float3 && numVerts > 0) {
+				auto read = [&](size_t ix) {
+					glm::vec3 result;
+					memcpy(&result, (const uint8_t*)vertices + ix * layout.GetStride() + position.Offset, sizeof(glm::vec3));
+					return result;
+				};
+				glm::vec3 boundsMin = read(0), boundsMax = boundsMin;
+				for (size_t ix = 1; ix < numVerts; ix++) {
+					glm::vec3 pos = read(ix);
+					boundsMin = glm::min(boundsMin, pos);
+					boundsMax = glm::max(boundsMax, pos);
+				}
+				glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+				float radius = 0.0f;
+				for (size_t ix = 0; ix < numVerts; ix++)
+					radius = glm::max(radius, glm::length(read(ix) - center));
+				myBoundingSphere = glm::vec4(center, radius);
+			} else
+				myBoundingSphere = glm::vec4(0.0f, 0.0f, 0.0f, FLT_MAX);
 		}
 
 		void* Mesh::ExtractVertices(size_t& outSize) const {
 			outSize = myLayout.GetStride() * myVertexCount;
 			void* result = malloc(outSize);
-			glGetNamedBufferSubData(myBuffers[0], 0, outSize, result);
+			glGetNamedBufferSubData(myArena->GetVertexBuffer(), (size_t)myRange.BaseVertex * myLayout.GetStride(), outSize, result);
 			return result;
 		}
 
 		uint32_t* Mesh::ExtractIndices(size_t& outSize) const {
 			outSize = sizeof(uint32_t) * myIndexCount;
-			void* data = malloc(outSize);
-			glGetNamedBufferSubData(myBuffers[1], 0, outSize, data);
-			return (uint32_t*)data;
+			uint32_t* data = (uint32_t*)malloc(outSize);
+			if (myArena->GetIndexType() == GL_UNSIGNED_SHORT) {
+				// Read the short indices into the back half of the result, and widen them from front to back
+				uint16_t* shortIndices = (uint16_t*)data + myIndexCount;
+				glGetNamedBufferSubData(myArena->GetIndexBuffer(), (size_t)myRange.FirstIndex * sizeof(uint16_t), sizeof(uint16_t) * myIndexCount, shortIndices);
+				for (size_t ix = 0; ix < myIndexCount; ix++)
+					data[ix] = shortIndices[ix];
+			} else
+				glGetNamedBufferSubData(myArena->GetIndexBuffer(), (size_t)myRange.FirstIndex * sizeof(uint32_t), outSize, data);
+			return data;
+		}
+
+		void Mesh::SetConstantAttribute(uint32_t location, const glm::vec4& value) {
+			for (auto& attribute : myConstantAttributes) {
+				if (attribute.first == location) {
+					attribute.second = value;
+					return;
+				}
+			}
+			myConstantAttributes.emplace_back(location, value);
 		}
 
 		Mesh::~Mesh() {
-			LOG_INFO("Deleting mesh with ID: {}", myRendererID);
-			// Clean up our buffers
-			glDeleteBuffers(2, myBuffers);
-			// Clean up our VAO
-			glDeleteVertexArrays(1, &myRendererID);
+			// Give our space back to the arena, the arena itself is cleaned up along with the last mesh using it
+			myArena->Free(myRange);
+			glDeleteBuffers(2, myMeshletBuffers);
+		}
+
+		void Mesh::SetMeshlets(const MeshletData& meshlets) {
+			LOG_ASSERT(meshlets.Indices.size() == myIndexCount, "Meshlets for {} have {} indices, expected {}", Name, meshlets.Indices.size(), myIndexCount);
+			glDeleteBuffers(2, myMeshletBuffers);
+			myMeshletBuffers[0] = myMeshletBuffers[1] = 0;
+			myMeshletCount = (uint32_t)meshlets.Meshlets.size();
+			myMeshletIndexCount = (uint32_t)meshlets.Indices.size();
+			if (myMeshletCount == 0)
+				return;
+
+			// These never change, so they can use immutable storage
+			glCreateBuffers(2, myMeshletBuffers);
+			glNamedBufferStorage(myMeshletBuffers[0], meshlets.Meshlets.size() * sizeof(Meshlet), meshlets.Meshlets.data(), 0);
+			glNamedBufferStorage(myMeshletBuffers[1], meshlets.Indices.size() * sizeof(uint32_t), meshlets.Indices.data(), 0);
+		}
+
+		void Mesh::ApplyConstantAttributes() const {
+			for (const auto& attribute : myConstantAttributes)
+				glVertexAttrib4fv(attribute.first, glm::value_ptr(attribute.second));
+		}
+
+		void Mesh::Draw(uint32_t baseInstance) {
+			// Bind the arena, every mesh in it shares the same vertex array
+			myArena->Bind();
+			// Constant attributes are not part of the VAO's state, so they need to be set for every draw
+			ApplyConstantAttributes();
+			if (myIndexCount > 0)
+				// Draw all of our vertices as triangles
+				glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, myIndexCount, myArena->GetIndexType(), (const void*)((size_t)myRange.FirstIndex * myArena->GetIndexSize()), 1, myRange.BaseVertex, baseInstance);
+			else
+				glDrawArraysInstancedBaseInstance(GL_TRIANGLES, myRange.BaseVertex, myVertexCount, 1, baseInstance);
 		}
 
-		void Mesh::Draw() {
-			// Bind the mesh
-			glBindVertexArray(myRendererID);
+		void Mesh::DrawDepthInstanced(GLuint instanceBuffer, size_t offset, uint32_t instanceCount) {
+			myArena->BindDepth(instanceBuffer, offset);
 			if (myIndexCount > 0)
-				// Draw all of our vertices as triangles, our indexes are unsigned ints (uint32_t)
-				glDrawElements(GL_TRIANGLES, myIndexCount, GL_UNSIGNED_INT, nullptr);
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, myIndexCount, myArena->GetIndexType(), (const void*)((size_t)myRange.FirstIndex * myArena->GetIndexSize()), instanceCount, myRange.BaseVertex);
 			else
-				glDrawArrays(GL_TRIANGLES, 0, myVertexCount);
+				glDrawArraysInstanced(GL_TRIANGLES, myRange.BaseVertex, myVertexCount, instanceCount);
 		}
 	}
 }
\ No newline at end of file
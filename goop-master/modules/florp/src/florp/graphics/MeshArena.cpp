@@ -0,0 +1,184 @@
+#include "florp/graphics/MeshArena.h"
+#include <cstring>
+#include <vector>
+
+namespace florp {
+	namespace graphics {
+
+		// How many vertices and indices new arenas have room for, these are grown as needed
+		#define MESH_ARENA_VERTEX_CAPACITY (1 << 16)
+		#define MESH_ARENA_INDEX_CAPACITY (1 << 18)
+
+		/*
+		 * Replaces a buffer with a larger one, keeping its contents
+		 * @param buffer The buffer to replace, receives the new buffer
+		 * @param oldSize The size of the old buffer, in bytes
+		 * @param newSize The size of the new buffer, in bytes
+		 */
+		static void GrowBuffer(GLuint& buffer, size_t oldSize, size_t newSize) {
+			GLuint result;
+			glCreateBuffers(1, &result);
+			glNamedBufferStorage(result, newSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+			if (oldSize > 0)
+				glCopyNamedBufferSubData(buffer, result, 0, 0, oldSize);
+			glDeleteBuffers(1, &buffer);
+			buffer = result;
+		}
+
+		MeshArena::MeshArena(const BufferLayout& layout, GLenum indexType, uint32_t vertexCapacity, uint32_t indexCapacity) :
+			myLayout(layout),
+			myIndexType(indexType)
+		{
+			// Depth-only passes only need positions, so we split them into their own tightly packed stream. If the layout does
+			// not tag a position, we assume it is the first element (this matches what our shaders expect at location 0)
+			if (!layout.GetElementByUsage(VertexUsage::Position, myPosition))
+				myPosition = *layout.begin();
+
+			// The buffers start out empty, and are given storage when we first grow them
+			myBuffers[0] = myBuffers[1] = myBuffers[2] = 0;
+			glCreateVertexArrays(1, &myRendererID);
+			glCreateVertexArrays(1, &myDepthVao);
+			glCreateVertexArrays(1, &myExternalVao);
+
+			// Our elements will be sequential in the shaders (so attrib 0, 1, 2 ...), unless they give their own location. The
+			// external VAO has the same attributes, it just gets its indices from somewhere else (see BindWithIndices)
+			for (GLuint vao : { myRendererID, myExternalVao }) {
+				uint32_t index = 0;
+				for (const BufferElement& element : layout) {
+					if (element.Location >= 0)
+						index = element.Location;
+					glEnableVertexArrayAttrib(vao, index);
+					glVertexArrayAttribFormat(vao, index,
+						element.GetComponentCount(), // Number of components in the attribute
+						ToGLElementType(GetShaderDataTypeCode(element.Type)), // The data type of the attribute
+						element.IsNormalized, // Whether or not the element is normalized
+						element.Offset);
+					glVertexArrayAttribBinding(vao, index, 0);
+					index++;
+				}
+			}
+
+			// Our depth VAO reads the per-instance model matrix from a second binding, which is set by BindDepth
+			glEnableVertexArrayAttrib(myDepthVao, 0);
+			glVertexArrayAttribFormat(myDepthVao, 0, myPosition.GetComponentCount(), ToGLElementType(GetShaderDataTypeCode(myPosition.Type)), myPosition.IsNormalized, 0);
+			glVertexArrayAttribBinding(myDepthVao, 0, 0);
+			// A mat4 takes up 4 attribute slots, one per column
+			for (uint32_t col = 0; col < 4; col++) {
+				glEnableVertexArrayAttrib(myDepthVao, 1 + col);
+				glVertexArrayAttribFormat(myDepthVao, 1 + col, 4, GL_FLOAT, GL_FALSE, col * sizeof(float) * 4);
+				glVertexArrayAttribBinding(myDepthVao, 1 + col, 1);
+			}
+			glVertexArrayBindingDivisor(myDepthVao, 1, 1);
+
+			__GrowVertices(glm::max(vertexCapacity, 1u));
+			__GrowIndices(glm::max(indexCapacity, 1u));
+		}
+
+		MeshArena::~MeshArena() {
+			LOG_INFO("Deleting mesh arena with ID: {}", myRendererID);
+			glDeleteBuffers(3, myBuffers);
+			glDeleteVertexArrays(1, &myRendererID);
+			glDeleteVertexArrays(1, &myDepthVao);
+			glDeleteVertexArrays(1, &myExternalVao);
+		}
+
+		MeshArena::Range MeshArena::Allocate(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+			Range result;
+
+			if (vertexCount > 0) {
+				result.VertexHandle = myVertices.Allocate(vertexCount, result.BaseVertex);
+				// Growing adds the space to the end of the arena, so we will always have room for the mesh afterwards
+				if (result.VertexHandle == utils::TlsfAllocator::InvalidHandle) {
+					__GrowVertices(myVertices.GetCapacity() + vertexCount);
+					result.VertexHandle = myVertices.Allocate(vertexCount, result.BaseVertex);
+				}
+				const uint32_t stride = myLayout.GetStride();
+				glNamedBufferSubData(myBuffers[0], (size_t)result.BaseVertex * stride, (size_t)vertexCount * stride, vertices);
+
+				// Copy the positions out into their own stream
+				std::vector<uint8_t> positions((size_t)vertexCount * myPosition.SizeInBytes);
+				for (size_t ix = 0; ix < vertexCount; ix++)
+					memcpy(positions.data() + ix * myPosition.SizeInBytes, (const uint8_t*)vertices + ix * stride + myPosition.Offset, myPosition.SizeInBytes);
+				glNamedBufferSubData(myBuffers[2], (size_t)result.BaseVertex * myPosition.SizeInBytes, positions.size(), positions.data());
+			}
+
+			if (indices != nullptr && indexCount > 0) {
+				result.IndexHandle = myIndices.Allocate(indexCount, result.FirstIndex);
+				if (result.IndexHandle == utils::TlsfAllocator::InvalidHandle) {
+					__GrowIndices(myIndices.GetCapacity() + indexCount);
+					result.IndexHandle = myIndices.Allocate(indexCount, result.FirstIndex);
+				}
+				if (myIndexType == GL_UNSIGNED_SHORT) {
+					std::vector<uint16_t> shortIndices(indexCount);
+					for (size_t ix = 0; ix < indexCount; ix++)
+						shortIndices[ix] = (uint16_t)indices[ix];
+					glNamedBufferSubData(myBuffers[1], (size_t)result.FirstIndex * sizeof(uint16_t), indexCount * sizeof(uint16_t), shortIndices.data());
+				} else
+					glNamedBufferSubData(myBuffers[1], (size_t)result.FirstIndex * sizeof(uint32_t), indexCount * sizeof(uint32_t), indices);
+			}
+
+			return result;
+		}
+
+		void MeshArena::Free(const Range& range) {
+			if (range.VertexHandle != utils::TlsfAllocator::InvalidHandle)
+				myVertices.Free(range.VertexHandle);
+			if (range.IndexHandle != utils::TlsfAllocator::InvalidHandle)
+				myIndices.Free(range.IndexHandle);
+		}
+
+		void MeshArena::BindDepth(GLuint instanceBuffer, size_t offset) const {
+			// Point our instance binding at the requested range of matrices
+			glVertexArrayVertexBuffer(myDepthVao, 1, instanceBuffer, offset, sizeof(float) * 16);
+			glBindVertexArray(myDepthVao);
+		}
+
+		void MeshArena::BindWithIndices(GLuint indexBuffer) const {
+			glVertexArrayElementBuffer(myExternalVao, indexBuffer);
+			glBindVertexArray(myExternalVao);
+		}
+
+		void MeshArena::__GrowVertices(uint32_t minCapacity) {
+			uint32_t oldCapacity = myVertices.GetCapacity();
+			uint32_t newCapacity = glm::max(minCapacity, oldCapacity * 2);
+			if (oldCapacity > 0)
+				LOG_INFO("Growing mesh arena {} to {} vertices", myRendererID, newCapacity);
+			GrowBuffer(myBuffers[0], (size_t)oldCapacity * myLayout.GetStride(), (size_t)newCapacity * myLayout.GetStride());
+			GrowBuffer(myBuffers[2], (size_t)oldCapacity * myPosition.SizeInBytes, (size_t)newCapacity * myPosition.SizeInBytes);
+			myVertices.Grow(newCapacity - oldCapacity);
+			glVertexArrayVertexBuffer(myRendererID, 0, myBuffers[0], 0, myLayout.GetStride());
+			glVertexArrayVertexBuffer(myExternalVao, 0, myBuffers[0], 0, myLayout.GetStride());
+			glVertexArrayVertexBuffer(myDepthVao, 0, myBuffers[2], 0, myPosition.SizeInBytes);
+		}
+
+		void MeshArena::__GrowIndices(uint32_t minCapacity) {
+			uint32_t oldCapacity = myIndices.GetCapacity();
+			uint32_t newCapacity = glm::max(minCapacity, oldCapacity * 2);
+			if (oldCapacity > 0)
+				LOG_INFO("Growing mesh arena {} to {} indices", myRendererID, newCapacity);
+			GrowBuffer(myBuffers[1], (size_t)oldCapacity * GetIndexSize(), (size_t)newCapacity * GetIndexSize());
+			myIndices.Grow(newCapacity - oldCapacity);
+			glVertexArrayElementBuffer(myRendererID, myBuffers[1]);
+			glVertexArrayElementBuffer(myDepthVao, myBuffers[1]);
+		}
+
+		MeshArena::Sptr MeshArena::Get(const BufferLayout& layout, GLenum indexType) {
+			// We only hold on to arenas weakly, so that they go away along with the meshes in them
+			static std::vector<std::weak_ptr<MeshArena>> arenas;
+			for (auto it = arenas.begin(); it != arenas.end();) {
+				Sptr arena = it->lock();
+				if (arena == nullptr) {
+					it = arenas.erase(it);
+					continue;
+				}
+				if (arena->myIndexType == indexType && arena->myLayout == layout)
+					return arena;
+				++it;
+			}
+			Sptr result = std::make_shared<MeshArena>(layout, indexType, MESH_ARENA_VERTEX_CAPACITY, MESH_ARENA_INDEX_CAPACITY);
+			arenas.push_back(result);
+			return result;
+		}
+
+	}
+}
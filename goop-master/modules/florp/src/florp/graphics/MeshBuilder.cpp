@@ -1,11 +1,30 @@
 #include "florp/graphics/MeshBuilder.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <unordered_map>
+#include <GLM/gtc/packing.hpp>
+#include "florp/graphics/MeshOptimizer.h"
+#include "florp/graphics/MeshProcessor.h"
+#include "florp/utils/Parallel.h"
 #include "Logging.h"
 
 namespace florp {
 	namespace graphics {
+
+		// The number of vertices we pack per job when baking into VertexFormat::Packed
+		#define PACK_JOB_SIZE (64 * 1024)
+		// The attribute location of the color, this is where the constant color goes when it is left out of a packed layout
+		#define PACKED_COLOR_LOCATION 1
+		// The most triangles a meshlet can have, this is the work group size of the meshlet culling shader
+		#define MESHLET_TRIANGLE_LIMIT 128
+		// Marks a vertex that is not in the meshlet being built, or that there is no triangle to add next
+		#define MESHLET_NONE 0xFFFFFFFFu
+		// Meshlets whose normals spread out further than this (the cosine of the angle from the cone's axis) are never
+		// backface culled, since their cone would almost never let us cull them anyways
+		#define MESHLET_CONE_THRESHOLD 0.1f
 		
 		int AddMiddlePoint(uint32_t offset, glm::vec3 scale, glm::vec3 center, int a, int b, std::vector<Vertex>& vertices, std::unordered_map<uint64_t, uint32_t>& midpointCache)
 		{
@@ -79,35 +98,9 @@ namespace florp {
 		}
 
 		void MeshBuilder::ComputeTBN(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, size_t begin, size_t end) {
-			for (size_t i = begin; (i < indices.size()) & (i < end); i += 3) {
-				glm::vec3 pos[3];
-				pos[0] = vertices[indices[i + 0u]].Position;
-				pos[1] = vertices[indices[i + 1u]].Position;
-				pos[2] = vertices[indices[i + 2u]].Position;
-
-				glm::vec2 uvs[3];
-				uvs[0] = vertices[indices[i + 0u]].UV;
-				uvs[1] = vertices[indices[i + 1u]].UV;
-				uvs[2] = vertices[indices[i + 2u]].UV;
-
-				glm::vec3 deltaP1 = pos[1] - pos[0];
-				glm::vec3 deltaP2 = pos[2] - pos[0];
-
-				glm::vec2 deltaT1 = uvs[1] - uvs[0];
-				glm::vec2 deltaT2 = uvs[2] - uvs[0];
-
-				float r = 1.0f / (deltaT1.x * deltaT2.y - deltaT1.y * deltaT2.x);
-				glm::vec3 tangent = (deltaP1 * deltaT2.y - deltaP2 * deltaT1.y) * r;
-				glm::vec3 bitangent = (deltaP2 * deltaT1.x - deltaP1 * deltaT2.x) * r;
-
-				vertices[indices[i + 0u]].Tangent = tangent;
-				vertices[indices[i + 1u]].Tangent = tangent;
-				vertices[indices[i + 2u]].Tangent = tangent;
-
-				vertices[indices[i + 0u]].BiTangent = bitangent;
-				vertices[indices[i + 1u]].BiTangent = bitangent;
-				vertices[indices[i + 2u]].BiTangent = bitangent;
-			}
+			end = std::min(end, indices.size());
+			if (begin < end)
+				MeshProcessor::ComputeTangents(vertices, indices.data() + begin, end - begin);
 		}
 
 		void MeshBuilder::AddIcoSphere(MeshData& data, const glm::vec3& center, float radius, int tessellation) {
@@ -354,23 +347,240 @@ namespace florp {
 			return result;
 		}
 
-		Mesh::Sptr MeshBuilder::Bake(MeshData& data) {
-			static const BufferLayout layout = {
-				{ "inPosition",  ShaderDataType::Float3 },
-				{ "inColor",     ShaderDataType::Float4 },
-				{ "inNormal",    ShaderDataType::Float3 },
-				{ "inTangent",   ShaderDataType::Float3 },
-				{ "inBiTangent", ShaderDataType::Float3 },
-				{ "inUV",        ShaderDataType::Float2 }
-			};
+		/*
+		 * Packs a normal into 2 snorm16s using an octahedral mapping, the inverse of UnpackNormal in lighting.vs.glsl
+		 */
+		inline uint32_t PackOctahedral(const glm::vec3& normal) {
+			float sum = abs(normal.x) + abs(normal.y) + abs(normal.z);
+			if (!(sum > 0.0f))
+				return glm::packSnorm2x16(glm::vec2(0.0f));
+			glm::vec3 n = normal / sum;
+			glm::vec2 sign = glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+			glm::vec2 result = n.z >= 0.0f ? glm::vec2(n) : (1.0f - glm::abs(glm::vec2(n.y, n.x))) * sign;
+			return glm::packSnorm2x16(result);
+		}
+
+		/*
+		 * Packs a tangent into snorm 10-10-10-2, after making it perpendicular to the normal. The sign of the bitangent
+		 * (relative to cross(normal, tangent)) goes in w, so that the bitangent can be rebuilt in the shader
+		 */
+		inline uint32_t PackTangent(const glm::vec3& normal, const glm::vec3& tangent, const glm::vec3& bitangent) {
+			float normalLength = glm::length(normal);
+			glm::vec3 n = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f, 0.0f, 1.0f);
+			glm::vec3 t = tangent - n * glm::dot(n, tangent);
+			float tangentLength = glm::length(t);
+			// Degenerate UVs will give us a zero (or NaN) tangent, in which case any direction along the surface will do
+			if (!(tangentLength > 1e-6f) || !std::isfinite(tangentLength))
+				t = glm::normalize(glm::cross(n, abs(n.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+			else
+				t /= tangentLength;
+			float sign = glm::dot(glm::cross(n, t), bitangent) < 0.0f ? -1.0f : 1.0f;
+			return glm::packSnorm3x10_1x2(glm::vec4(t, sign));
+		}
+
+		Mesh::Sptr MeshBuilder::Bake(MeshData& data, VertexFormat format, bool optimize) {
+			if (optimize)
+				MeshOptimizer::Optimize(data);
 			ComputeTBN(data.Vertices, data.Indices);
 
-			const auto result = std::make_shared<Mesh>(
-				data.Vertices.data(), data.Vertices.size(),
-				layout,
-				data.Indices.data(), data.Indices.size());
+			const auto result = Upload(data.Vertices.data(), data.Vertices.size(), data.Indices.data(), data.Indices.size(), format);
 			result->Name = data.DebugName;
 			return result;
 		}
+
+		Mesh::Sptr MeshBuilder::Upload(const Vertex* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount, VertexFormat format) {
+			if (format == VertexFormat::Full) {
+				static const BufferLayout layout = {
+					{ "inPosition",  ShaderDataType::Float3, VertexUsage::Position },
+					{ "inColor",     ShaderDataType::Float4, VertexUsage::Color },
+					{ "inNormal",    ShaderDataType::Float3, VertexUsage::Normal },
+					{ "inTangent",   ShaderDataType::Float3, VertexUsage::Tangent },
+					{ "inBiTangent", ShaderDataType::Float3, VertexUsage::Bitangent },
+					{ "inUV",        ShaderDataType::Float2, VertexUsage::Texture },
+					{ "inLightmapUV", ShaderDataType::Float2, VertexUsage::Texture }
+				};
+				return std::make_shared<Mesh>(vertices, vertexCount, layout, indices, indexCount);
+			}
+
+			// Meshes like our OBJs give every vertex the same color, in which case there's no point storing it per vertex
+			bool constantColor = true;
+			for (size_t ix = 1; ix < vertexCount && constantColor; ix++)
+				constantColor = vertices[ix].Color == vertices[0].Color;
+
+			// The locations are explicit, so that they line up with the full layout even when the color is left out
+			std::vector<BufferElement> elements;
+			elements.emplace_back("inPosition", ShaderDataType::Float3, VertexUsage::Position, false, 1, 0);
+			if (!constantColor)
+				elements.emplace_back("inColor", ShaderDataType::Ubyte4, VertexUsage::Color, true, 1, PACKED_COLOR_LOCATION);
+			elements.emplace_back("inNormal", ShaderDataType::Short2, VertexUsage::Normal, true, 1, 2);
+			elements.emplace_back("inTangent", ShaderDataType::Int_2_10_10_10, VertexUsage::Tangent, true, 1, 3);
+			elements.emplace_back("inUV", ShaderDataType::Half2, VertexUsage::Texture, false, 1, 5);
+			elements.emplace_back("inLightmapUV", ShaderDataType::Ushort2, VertexUsage::Texture, true, 1, 6);
+			BufferLayout layout = BufferLayout(elements);
+
+			// Every element after the position is a single 32 bit word, in the same order as the words below
+			const uint32_t stride = layout.GetStride();
+			std::vector<uint8_t> packed((size_t)vertexCount * stride);
+			const uint32_t jobs = (uint32_t)((vertexCount + PACK_JOB_SIZE - 1) / PACK_JOB_SIZE);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				size_t end = std::min((size_t)(job + 1) * PACK_JOB_SIZE, vertexCount);
+				for (size_t ix = (size_t)job * PACK_JOB_SIZE; ix < end; ix++) {
+					const Vertex& vert = vertices[ix];
+					uint8_t* out = packed.data() + ix * stride;
+					uint32_t words[5] = {
+						glm::packUnorm4x8(vert.Color),
+						PackOctahedral(vert.Normal),
+						PackTangent(vert.Normal, vert.Tangent, vert.BiTangent),
+						glm::packHalf2x16(vert.UV),
+						glm::packUnorm2x16(vert.LightmapUV)
+					};
+					memcpy(out, &vert.Position, sizeof(glm::vec3));
+					memcpy(out + sizeof(glm::vec3), constantColor ? words + 1 : words, stride - sizeof(glm::vec3));
+				}
+			});
+
+			const auto result = std::make_shared<Mesh>(packed.data(), vertexCount, layout, indices, indexCount);
+			if (constantColor)
+				result->SetConstantAttribute(PACKED_COLOR_LOCATION, vertexCount > 0 ? vertices[0].Color : glm::vec4(1.0f));
+			return result;
+		}
+	
+		/*
+		 * Computes the bounding sphere and normal cone of a meshlet
+		 * @param data The mesh that the meshlet is from
+		 * @param meshlet The meshlet to update
+		 * @param indices The indices of the meshlet's triangles
+		 * @param vertices The unique vertices used by the meshlet
+		 */
+		static void ComputeMeshletBounds(const MeshData& data, Meshlet& meshlet, const uint32_t* indices, const std::vector<uint32_t>& vertices) {
+			glm::vec3 boundsMin = data.Vertices[vertices[0]].Position, boundsMax = boundsMin;
+			for (uint32_t vertex : vertices) {
+				boundsMin = glm::min(boundsMin, data.Vertices[vertex].Position);
+				boundsMax = glm::max(boundsMax, data.Vertices[vertex].Position);
+			}
+			glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+			float radius = 0.0f;
+			for (uint32_t vertex : vertices)
+				radius = glm::max(radius, glm::length(data.Vertices[vertex].Position - center));
+			meshlet.BoundingSphere = glm::vec4(center, radius);
+
+			// The cone's axis is the average of the face normals, and its angle is the one to the normal furthest from it.
+			// We use the face normals rather than the vertex normals, since backface culling is done per face
+			std::vector<glm::vec3> normals;
+			normals.reserve(meshlet.TriangleCount);
+			glm::vec3 axis = glm::vec3(0.0f);
+			for (uint32_t tri = 0; tri < meshlet.TriangleCount; tri++) {
+				const glm::vec3& a = data.Vertices[indices[tri * 3 + 0]].Position;
+				const glm::vec3& b = data.Vertices[indices[tri * 3 + 1]].Position;
+				const glm::vec3& c = data.Vertices[indices[tri * 3 + 2]].Position;
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				float length = glm::length(normal);
+				// Degenerate triangles are never drawn, so they don't need to be in the cone
+				if (length <= 1e-12f)
+					continue;
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+
+			float minDot = 1.0f;
+			if (normals.empty() || glm::length(axis) <= 1e-6f)
+				minDot = -1.0f;
+			else {
+				axis = glm::normalize(axis);
+				for (const glm::vec3& normal : normals)
+					minDot = glm::min(minDot, glm::dot(axis, normal));
+			}
+			// A back facing cone is the normal cone widened by 90 degrees and flipped, so we store sin(angle) = cos(angle + 90)
+			meshlet.Cone = minDot <= MESHLET_CONE_THRESHOLD ?
+				glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) :
+				glm::vec4(axis, sqrtf(1.0f - minDot * minDot));
+		}
+
+		MeshletData MeshBuilder::BuildMeshlets(const MeshData& data, uint32_t maxVertices, uint32_t maxTriangles) {
+			LOG_ASSERT(maxTriangles > 0 && maxTriangles <= MESHLET_TRIANGLE_LIMIT, "Meshlets can have at most {} triangles", MESHLET_TRIANGLE_LIMIT);
+			LOG_ASSERT(maxVertices >= 3, "Meshlets need room for at least 3 vertices");
+
+			MeshletData result;
+			const size_t triangleCount = data.Indices.size() / 3;
+			const size_t vertexCount = data.Vertices.size();
+			if (triangleCount == 0)
+				return result;
+
+			// Build a list of the triangles that use each vertex, so we can find the neighbours of a meshlet
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t ix = 0; ix < triangleCount * 3; ix++)
+				adjacencyOffsets[data.Indices[ix] + 1]++;
+			for (size_t ix = 0; ix < vertexCount; ix++)
+				adjacencyOffsets[ix + 1] += adjacencyOffsets[ix];
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t ix = 0; ix < triangleCount * 3; ix++)
+				adjacency[fill[data.Indices[ix]]++] = (uint32_t)(ix / 3);
+
+			std::vector<bool> isEmitted(triangleCount, false);
+			// Whether each vertex is in the meshlet that we are building
+			std::vector<bool> isInMeshlet(vertexCount, false);
+			std::vector<uint32_t> vertices;
+			vertices.reserve(maxVertices);
+			size_t emittedCount = 0;
+			size_t seed = 0;
+
+			while (emittedCount < triangleCount) {
+				// Each meshlet starts from the first triangle that is left, so we follow the order the mesh was optimized in
+				while (isEmitted[seed])
+					seed++;
+
+				Meshlet meshlet = {};
+				meshlet.FirstIndex = (uint32_t)result.Indices.size();
+				vertices.clear();
+
+				uint32_t next = (uint32_t)seed;
+				while (next != MESHLET_NONE) {
+					isEmitted[next] = true;
+					emittedCount++;
+					meshlet.TriangleCount++;
+					for (int corner = 0; corner < 3; corner++) {
+						uint32_t vertex = data.Indices[next * 3 + corner];
+						result.Indices.push_back(vertex);
+						if (!isInMeshlet[vertex]) {
+							isInMeshlet[vertex] = true;
+							vertices.push_back(vertex);
+						}
+					}
+					if (meshlet.TriangleCount == maxTriangles)
+						break;
+
+					// Out of the triangles touching the meshlet, pick the one that adds the fewest new vertices. If none of them
+					// fit, we end the meshlet, rather than adding a triangle from somewhere else in the mesh and loosening its bounds
+					next = MESHLET_NONE;
+					uint32_t bestNew = 4;
+					for (size_t vx = 0; vx < vertices.size() && bestNew > 0; vx++) {
+						for (uint32_t ax = adjacencyOffsets[vertices[vx]]; ax < adjacencyOffsets[vertices[vx] + 1]; ax++) {
+							uint32_t triangle = adjacency[ax];
+							if (isEmitted[triangle])
+								continue;
+							uint32_t newCount = 0;
+							for (int corner = 0; corner < 3; corner++)
+								newCount += isInMeshlet[data.Indices[triangle * 3 + corner]] ? 0 : 1;
+							if (vertices.size() + newCount > maxVertices)
+								continue;
+							if (newCount < bestNew || (newCount == bestNew && triangle < next)) {
+								bestNew = newCount;
+								next = triangle;
+							}
+						}
+					}
+				}
+
+				meshlet.VertexCount = (uint32_t)vertices.size();
+				ComputeMeshletBounds(data, meshlet, result.Indices.data() + meshlet.FirstIndex, vertices);
+				result.Meshlets.push_back(meshlet);
+				for (uint32_t vertex : vertices)
+					isInMeshlet[vertex] = false;
+			}
+
+			LOG_INFO("Split {} into {} meshlets ({:.1f} triangles each)", data.DebugName, result.Meshlets.size(), (float)triangleCount / result.Meshlets.size());
+			return result;
+		}
 	}
 }
@@ -0,0 +1,204 @@
+#include "florp/graphics/MeshFile.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "Logging.h"
+
+namespace florp {
+	namespace graphics {
+
+		// Identifies our mesh files, and the version of the format
+		#define FMESH_FILE_MAGIC 0x48534D46u // 'FMSH'
+		#define FMESH_FILE_VERSION 2u
+		// Every section starts on a multiple of this, so the vertex data is aligned for any attribute type (and cache lines)
+		#define FMESH_ALIGNMENT 64
+		// The longest attribute name we will store, including the null terminator
+		#define FMESH_MAX_NAME_LENGTH 48
+
+		struct MeshFile::Header {
+			uint32_t  Magic;
+			uint32_t  Version;
+			uint64_t  SourceHash;
+			uint32_t  VertexCount;
+			uint32_t  IndexCount;
+			uint32_t  Stride;
+			uint32_t  ElementCount;
+			glm::vec3 BoundsMin;
+			glm::vec3 BoundsMax;
+			uint64_t  LayoutOffset;
+			uint64_t  VertexOffset;
+			uint64_t  IndexOffset;
+			uint64_t  FileSize;
+		};
+
+		// Describes a single BufferElement in the file
+		struct FMeshElement {
+			char     Name[FMESH_MAX_NAME_LENGTH];
+			uint32_t Type;
+			uint32_t Usage;
+			uint32_t ArraySize;
+			uint32_t Offset;
+			uint32_t IsNormalized;
+			int32_t  Location;
+		};
+
+		static inline uint64_t Align(uint64_t value) {
+			return (value + FMESH_ALIGNMENT - 1) / FMESH_ALIGNMENT * FMESH_ALIGNMENT;
+		}
+
+		MeshFile::MeshFile(const std::string& filename) :
+			myFile(filename.c_str()),
+			myHeader(nullptr)
+		{
+			if (!myFile.IsOpen() || myFile.GetSize() < sizeof(Header))
+				return;
+
+			// Make sure the header is for a mesh file we understand, and that the file has not been truncated
+			const Header* header = reinterpret_cast<const Header*>(myFile.GetData());
+			if (header->Magic != FMESH_FILE_MAGIC || header->Version != FMESH_FILE_VERSION || header->FileSize != myFile.GetSize()) {
+				LOG_TRACE("Ignoring mesh file \"{}\", it is from a different version or is incomplete", filename);
+				return;
+			}
+			if (header->LayoutOffset + header->ElementCount * sizeof(FMeshElement) > header->FileSize ||
+				header->VertexOffset + (uint64_t)header->VertexCount * header->Stride > header->FileSize ||
+				header->IndexOffset + (uint64_t)header->IndexCount * sizeof(uint32_t) > header->FileSize) {
+				LOG_WARN("Mesh file \"{}\" is corrupt", filename);
+				return;
+			}
+
+			// Rebuild the layout from the element descriptors
+			const FMeshElement* elements = reinterpret_cast<const FMeshElement*>(myFile.GetData() + header->LayoutOffset);
+			std::vector<BufferElement> layout;
+			layout.reserve(header->ElementCount);
+			for (uint32_t ix = 0; ix < header->ElementCount; ix++) {
+				const FMeshElement& element = elements[ix];
+				std::string name(element.Name, strnlen(element.Name, FMESH_MAX_NAME_LENGTH));
+				layout.emplace_back(name, (ShaderDataType)element.Type, (VertexUsage)element.Usage, element.IsNormalized != 0, element.ArraySize, element.Location);
+			}
+			myLayout = BufferLayout(layout);
+			if (myLayout.GetStride() != header->Stride) {
+				LOG_WARN("Mesh file \"{}\" has a layout that does not match its stride", filename);
+				return;
+			}
+
+			myHeader = header;
+		}
+
+		uint64_t MeshFile::GetSourceHash() const {
+			return myHeader != nullptr ? myHeader->SourceHash : 0;
+		}
+
+		uint32_t MeshFile::GetVertexCount() const {
+			return myHeader != nullptr ? myHeader->VertexCount : 0;
+		}
+
+		uint32_t MeshFile::GetIndexCount() const {
+			return myHeader != nullptr ? myHeader->IndexCount : 0;
+		}
+
+		glm::vec3 MeshFile::GetBoundsMin() const {
+			return myHeader != nullptr ? myHeader->BoundsMin : glm::vec3(0.0f);
+		}
+
+		glm::vec3 MeshFile::GetBoundsMax() const {
+			return myHeader != nullptr ? myHeader->BoundsMax : glm::vec3(0.0f);
+		}
+
+		const void* MeshFile::GetVertexData() const {
+			return myHeader != nullptr ? myFile.GetData() + myHeader->VertexOffset : nullptr;
+		}
+
+		const uint32_t* MeshFile::GetIndexData() const {
+			return myHeader != nullptr ? reinterpret_cast<const uint32_t*>(myFile.GetData() + myHeader->IndexOffset) : nullptr;
+		}
+
+		MeshData MeshFile::ToMeshData(const std::string& debugName) const {
+			LOG_ASSERT(IsValid(), "Cannot read an invalid mesh file!");
+			LOG_ASSERT(myLayout.GetStride() == sizeof(Vertex), "Mesh file does not use the default vertex layout!");
+
+			MeshData result = MeshData();
+			result.DebugName = debugName;
+			const Vertex* vertices = reinterpret_cast<const Vertex*>(GetVertexData());
+			result.Vertices.assign(vertices, vertices + myHeader->VertexCount);
+			result.Indices.assign(GetIndexData(), GetIndexData() + myHeader->IndexCount);
+			return result;
+		}
+
+		Mesh::Sptr MeshFile::Upload() const {
+			LOG_ASSERT(IsValid(), "Cannot upload an invalid mesh file!");
+			return std::make_shared<Mesh>(GetVertexData(), myHeader->VertexCount, myLayout, GetIndexData(), myHeader->IndexCount);
+		}
+
+		bool MeshFile::Save(const std::string& filename, const BufferLayout& layout, const void* vertices, uint32_t vertexCount,
+			const uint32_t* indices, uint32_t indexCount, uint64_t sourceHash) {
+			// Find the bounds of the positions, if the layout does not tag one we assume it's the first element (like Mesh does)
+			BufferElement position;
+			if (!layout.GetElementByUsage(VertexUsage::Position, position))
+				position = *layout.begin();
+			glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+			if (position.Type == ShaderDataType::Float3) {
+				for (uint32_t ix = 0; ix < vertexCount; ix++) {
+					glm::vec3 pos;
+					memcpy(&pos, reinterpret_cast<const uint8_t*>(vertices) + (size_t)ix * layout.GetStride() + position.Offset, sizeof(glm::vec3));
+					boundsMin = ix == 0 ? pos : glm::min(boundsMin, pos);
+					boundsMax = ix == 0 ? pos : glm::max(boundsMax, pos);
+				}
+			}
+
+			Header header = Header();
+			header.Magic = FMESH_FILE_MAGIC;
+			header.Version = FMESH_FILE_VERSION;
+			header.SourceHash = sourceHash;
+			header.VertexCount = vertexCount;
+			header.IndexCount = indexCount;
+			header.Stride = layout.GetStride();
+			header.ElementCount = layout.ElementCount();
+			header.BoundsMin = boundsMin;
+			header.BoundsMax = boundsMax;
+			header.LayoutOffset = Align(sizeof(Header));
+			header.VertexOffset = Align(header.LayoutOffset + header.ElementCount * sizeof(FMeshElement));
+			header.IndexOffset = Align(header.VertexOffset + (uint64_t)vertexCount * header.Stride);
+			header.FileSize = header.IndexOffset + (uint64_t)indexCount * sizeof(uint32_t);
+
+			std::vector<FMeshElement> elements;
+			for (const BufferElement& element : layout) {
+				LOG_ASSERT(element.Name.size() < FMESH_MAX_NAME_LENGTH, "Attribute name \"{}\" is too long for a mesh file!", element.Name);
+				FMeshElement desc = FMeshElement();
+				strncpy(desc.Name, element.Name.c_str(), FMESH_MAX_NAME_LENGTH - 1);
+				desc.Type = (uint32_t)element.Type;
+				desc.Usage = (uint32_t)element.Usage;
+				desc.ArraySize = element.ArraySize;
+				desc.Offset = element.Offset;
+				desc.IsNormalized = element.IsNormalized ? 1 : 0;
+				elements.push_back(desc);
+			}
+
+			// We write to a temporary file and then swap it in, so a crash part way through never leaves a truncated mesh behind
+			std::string tempName = filename + ".tmp";
+			{
+				std::ofstream file(tempName, std::ios::binary);
+				if (!file)
+					return false;
+
+				const char padding[FMESH_ALIGNMENT] = { 0 };
+				auto write = [&](const void* data, size_t size) { file.write(reinterpret_cast<const char*>(data), size); };
+				auto pad = [&](uint64_t offset) { write(padding, offset - (uint64_t)file.tellp()); };
+				write(&header, sizeof(Header));
+				pad(header.LayoutOffset);
+				write(elements.data(), elements.size() * sizeof(FMeshElement));
+				pad(header.VertexOffset);
+				write(vertices, (size_t)vertexCount * header.Stride);
+				pad(header.IndexOffset);
+				write(indices, (size_t)indexCount * sizeof(uint32_t));
+				if (!file)
+					return false;
+			}
+			std::remove(filename.c_str());
+			return std::rename(tempName.c_str(), filename.c_str()) == 0;
+		}
+
+		bool MeshFile::Save(const std::string& filename, const MeshData& data, uint64_t sourceHash) {
+			return Save(filename, VertexLayout, data.Vertices.data(), (uint32_t)data.Vertices.size(), data.Indices.data(), (uint32_t)data.Indices.size(), sourceHash);
+		}
+	}
+}
@@ -0,0 +1,254 @@
+#include "florp/graphics/MeshOptimizer.h"
+#include <algorithm>
+#include <numeric>
+#include "Logging.h"
+
+namespace florp {
+	namespace graphics {
+
+		// Marks a vertex that has not been given a new index yet
+		#define OPTIMIZER_NO_VERTEX 0xFFFFFFFFu
+
+		/*
+		 * Simulates a FIFO post-transform cache. A vertex is in the cache if fewer than cacheSize vertices have been
+		 * transformed since it was, which we track with a timestamp per vertex
+		 */
+		struct CacheSimulator {
+			std::vector<uint32_t> TimeStamps;
+			uint32_t              Time;
+			uint32_t              Size;
+
+			CacheSimulator(size_t vertexCount, uint32_t cacheSize) :
+				TimeStamps(vertexCount, 0), Time(cacheSize + 1), Size(cacheSize) { }
+
+			// Empties the cache
+			void Flush() { Time += Size + 1; }
+
+			// Processes a triangle, and returns how many of its vertices had to be transformed
+			uint32_t Process(const uint32_t* triangle) {
+				uint32_t misses = 0;
+				for (int ix = 0; ix < 3; ix++) {
+					if (Time - TimeStamps[triangle[ix]] > Size) {
+						TimeStamps[triangle[ix]] = Time++;
+						misses++;
+					}
+				}
+				return misses;
+			}
+		};
+
+		float MeshOptimizer::ComputeACMR(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize) {
+			if (indexCount < 3)
+				return 0.0f;
+			CacheSimulator cache(vertexCount, cacheSize);
+			size_t misses = 0;
+			for (size_t ix = 0; ix + 2 < indexCount; ix += 3)
+				misses += cache.Process(indices + ix);
+			return (float)misses / (float)(indexCount / 3);
+		}
+
+		void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>* clusters, uint32_t cacheSize) {
+			const size_t triangleCount = indices.size() / 3;
+			if (clusters != nullptr)
+				clusters->clear();
+			if (triangleCount == 0)
+				return;
+
+			// Build the list of triangles that use each vertex, and how many of those are yet to be emitted
+			std::vector<uint32_t> liveCount(vertexCount, 0);
+			for (size_t ix = 0; ix < triangleCount * 3; ix++)
+				liveCount[indices[ix]]++;
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			for (size_t ix = 0; ix < vertexCount; ix++)
+				adjacencyOffsets[ix + 1] = adjacencyOffsets[ix] + liveCount[ix];
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			{
+				std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t ix = 0; ix < triangleCount * 3; ix++)
+					adjacency[cursors[indices[ix]]++] = (uint32_t)(ix / 3);
+			}
+
+			std::vector<uint32_t> timeStamps(vertexCount, 0);
+			std::vector<bool>     emitted(triangleCount, false);
+			std::vector<uint32_t> deadEnds;
+			std::vector<uint32_t> candidates;
+			std::vector<uint32_t> result;
+			result.reserve(triangleCount * 3);
+			uint32_t time = cacheSize + 1;
+			uint32_t cursor = 0;
+
+			// When a fan runs out of good candidates, we go back to recently used vertices that still have triangles left,
+			// and then to the first vertex in the input with triangles left. Either way, the cache is mostly cold again
+			auto skipDeadEnd = [&]() -> uint32_t {
+				while (!deadEnds.empty()) {
+					uint32_t vertex = deadEnds.back();
+					deadEnds.pop_back();
+					if (liveCount[vertex] > 0)
+						return vertex;
+				}
+				for (; cursor < vertexCount; cursor++) {
+					if (liveCount[cursor] > 0)
+						return cursor;
+				}
+				return OPTIMIZER_NO_VERTEX;
+			};
+
+			uint32_t fanning = skipDeadEnd();
+			while (fanning != OPTIMIZER_NO_VERTEX) {
+				// Emit every remaining triangle around our fanning vertex
+				candidates.clear();
+				for (uint32_t ix = adjacencyOffsets[fanning]; ix < adjacencyOffsets[fanning + 1]; ix++) {
+					uint32_t triangle = adjacency[ix];
+					if (emitted[triangle])
+						continue;
+					for (int corner = 0; corner < 3; corner++) {
+						uint32_t vertex = indices[triangle * 3 + corner];
+						result.push_back(vertex);
+						deadEnds.push_back(vertex);
+						candidates.push_back(vertex);
+						liveCount[vertex]--;
+						if (time - timeStamps[vertex] > cacheSize)
+							timeStamps[vertex] = time++;
+					}
+					emitted[triangle] = true;
+				}
+
+				// Pick the next fanning vertex from the ones we just used. We prefer the oldest vertex that will still be in
+				// the cache once all of its remaining triangles are emitted, so that it leaves the cache with nothing left to do
+				uint32_t next = OPTIMIZER_NO_VERTEX;
+				int32_t bestPriority = -1;
+				for (uint32_t vertex : candidates) {
+					if (liveCount[vertex] == 0)
+						continue;
+					int32_t priority = 0;
+					if (time - timeStamps[vertex] + 2 * liveCount[vertex] <= cacheSize)
+						priority = (int32_t)(time - timeStamps[vertex]);
+					if (priority > bestPriority) {
+						bestPriority = priority;
+						next = vertex;
+					}
+				}
+				if (next == OPTIMIZER_NO_VERTEX) {
+					next = skipDeadEnd();
+					// This is a hard boundary, the triangles after this don't share anything with the cache
+					if (clusters != nullptr && next != OPTIMIZER_NO_VERTEX)
+						clusters->push_back((uint32_t)(result.size() / 3));
+				}
+				fanning = next;
+			}
+
+			// Every cluster list starts with the first triangle
+			if (clusters != nullptr)
+				clusters->insert(clusters->begin(), 0);
+			indices.swap(result);
+		}
+
+		void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters, float threshold, uint32_t cacheSize) {
+			const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+			if (triangleCount == 0 || clusters.empty())
+				return;
+
+			// Hard clusters can be quite large (often the whole mesh), so we split them wherever the running ACMR is already
+			// within the threshold of the cluster's ACMR. Cutting the cache there only costs us a little cache efficiency
+			std::vector<uint32_t> softClusters;
+			CacheSimulator cache(vertices.size(), cacheSize);
+			for (size_t ix = 0; ix < clusters.size(); ix++) {
+				uint32_t start = clusters[ix];
+				uint32_t end = ix + 1 < clusters.size() ? clusters[ix + 1] : triangleCount;
+				if (start >= end)
+					continue;
+
+				cache.Flush();
+				uint32_t clusterMisses = 0;
+				for (uint32_t triangle = start; triangle < end; triangle++)
+					clusterMisses += cache.Process(&indices[triangle * 3]);
+				float clusterThreshold = threshold * (float)clusterMisses / (float)(end - start);
+
+				cache.Flush();
+				softClusters.push_back(start);
+				uint32_t runningMisses = 0, runningTriangles = 0;
+				for (uint32_t triangle = start; triangle < end; triangle++) {
+					runningMisses += cache.Process(&indices[triangle * 3]);
+					runningTriangles++;
+					if (triangle + 1 < end && (float)runningMisses / (float)runningTriangles <= clusterThreshold) {
+						softClusters.push_back(triangle + 1);
+						cache.Flush();
+						runningMisses = runningTriangles = 0;
+					}
+				}
+			}
+
+			// Find the area weighted centroid of the mesh and of each cluster, and the average normal of each cluster
+			const size_t clusterCount = softClusters.size();
+			std::vector<float> sortKeys(clusterCount);
+			std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f)), normals(clusterCount, glm::vec3(0.0f));
+			glm::vec3 meshCentroid = glm::vec3(0.0f);
+			float meshArea = 0.0f;
+			for (size_t ix = 0; ix < clusterCount; ix++) {
+				uint32_t start = softClusters[ix];
+				uint32_t end = ix + 1 < clusterCount ? softClusters[ix + 1] : triangleCount;
+				float clusterArea = 0.0f;
+				for (uint32_t triangle = start; triangle < end; triangle++) {
+					const glm::vec3& a = vertices[indices[triangle * 3 + 0]].Position;
+					const glm::vec3& b = vertices[indices[triangle * 3 + 1]].Position;
+					const glm::vec3& c = vertices[indices[triangle * 3 + 2]].Position;
+					glm::vec3 normal = glm::cross(b - a, c - a);
+					float area = glm::length(normal);
+					centroids[ix] += (a + b + c) * (area / 3.0f);
+					normals[ix] += normal;
+					clusterArea += area;
+				}
+				meshCentroid += centroids[ix];
+				meshArea += clusterArea;
+				centroids[ix] = clusterArea > 0.0f ? centroids[ix] / clusterArea : vertices[indices[start * 3]].Position;
+			}
+			meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+			// Clusters that face away from the center of the mesh are the most likely to occlude the rest, so they go first
+			for (size_t ix = 0; ix < clusterCount; ix++) {
+				float length = glm::length(normals[ix]);
+				sortKeys[ix] = length > 0.0f ? glm::dot(centroids[ix] - meshCentroid, normals[ix] / length) : 0.0f;
+			}
+			std::vector<uint32_t> order(clusterCount);
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+			std::vector<uint32_t> result;
+			result.reserve(indices.size());
+			for (uint32_t cluster : order) {
+				uint32_t start = softClusters[cluster];
+				uint32_t end = cluster + 1 < clusterCount ? softClusters[cluster + 1] : triangleCount;
+				result.insert(result.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+			}
+			indices.swap(result);
+		}
+
+		void MeshOptimizer::OptimizeVertexFetch(MeshData& data) {
+			std::vector<uint32_t> remap(data.Vertices.size(), OPTIMIZER_NO_VERTEX);
+			std::vector<Vertex> vertices;
+			vertices.reserve(data.Vertices.size());
+			for (uint32_t& index : data.Indices) {
+				if (remap[index] == OPTIMIZER_NO_VERTEX) {
+					remap[index] = (uint32_t)vertices.size();
+					vertices.push_back(data.Vertices[index]);
+				}
+				index = remap[index];
+			}
+			data.Vertices.swap(vertices);
+		}
+
+		void MeshOptimizer::Optimize(MeshData& data, float overdrawThreshold) {
+			if (data.Indices.size() < 3)
+				return;
+			float before = ComputeACMR(data.Indices.data(), data.Indices.size(), data.Vertices.size());
+
+			std::vector<uint32_t> clusters;
+			OptimizeVertexCache(data.Indices, data.Vertices.size(), &clusters);
+			OptimizeOverdraw(data.Indices, data.Vertices, clusters, overdrawThreshold);
+			OptimizeVertexFetch(data);
+
+			float after = ComputeACMR(data.Indices.data(), data.Indices.size(), data.Vertices.size());
+			LOG_INFO("Optimized mesh '{}' ({} triangles), ACMR {:.3f} -> {:.3f}", data.DebugName, data.Indices.size() / 3, before, after);
+		}
+	}
+}
@@ -0,0 +1,599 @@
+#include "florp/graphics/MeshProcessor.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <xmmintrin.h>
+#include "florp/utils/Parallel.h"
+#include "Logging.h"
+
+namespace florp {
+	namespace graphics {
+
+		// The number of triangles or vertices that each job handles, this must be a multiple of 4
+		#define MESH_PROCESS_JOB_SIZE (16 * 1024)
+		// Marks an empty slot in the table used to find matching positions
+		#define MESH_WELD_EMPTY_SLOT 0xFFFFFFFFu
+		// How close the attributes other than the position need to be for WeldVertices to merge two vertices
+		#define MESH_WELD_ATTRIBUTE_EPSILON 1e-5f
+		// Vectors shorter than this (squared) are treated as zero, so we don't normalize them into garbage
+		#define MESH_PROCESS_MIN_LENGTH_SQ 1e-24f
+
+		/*
+		 * The X, Y and Z components of a vector for 4 triangles or vertices at once
+		 */
+		struct Vec3x4 {
+			__m128 X, Y, Z;
+		};
+
+		inline Vec3x4 Sub(const Vec3x4& a, const Vec3x4& b) {
+			return { _mm_sub_ps(a.X, b.X), _mm_sub_ps(a.Y, b.Y), _mm_sub_ps(a.Z, b.Z) };
+		}
+		inline Vec3x4 Scale(const Vec3x4& a, __m128 s) {
+			return { _mm_mul_ps(a.X, s), _mm_mul_ps(a.Y, s), _mm_mul_ps(a.Z, s) };
+		}
+		inline __m128 Dot(const Vec3x4& a, const Vec3x4& b) {
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.X, b.X), _mm_mul_ps(a.Y, b.Y)), _mm_mul_ps(a.Z, b.Z));
+		}
+		inline Vec3x4 Cross(const Vec3x4& a, const Vec3x4& b) {
+			return {
+				_mm_sub_ps(_mm_mul_ps(a.Y, b.Z), _mm_mul_ps(a.Z, b.Y)),
+				_mm_sub_ps(_mm_mul_ps(a.Z, b.X), _mm_mul_ps(a.X, b.Z)),
+				_mm_sub_ps(_mm_mul_ps(a.X, b.Y), _mm_mul_ps(a.Y, b.X))
+			};
+		}
+		// Normalizes each vector, vectors that are too short to normalize come out as zero
+		inline Vec3x4 Normalize(const Vec3x4& a) {
+			const __m128 lengthSq = Dot(a, a);
+			const __m128 isValid = _mm_cmpgt_ps(lengthSq, _mm_set1_ps(MESH_PROCESS_MIN_LENGTH_SQ));
+			const __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(lengthSq, _mm_set1_ps(MESH_PROCESS_MIN_LENGTH_SQ))));
+			return Scale(a, _mm_and_ps(isValid, inverse));
+		}
+		// Picks a where the mask is set, and b everywhere else
+		inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		}
+		// The arc cosine of 4 values, from Abramowitz and Stegun 4.4.45. The error is under 1e-4 radians, which is plenty for weights
+		inline __m128 Acos(__m128 x) {
+			x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+			const __m128 ax = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+			__m128 poly = _mm_set1_ps(-0.0187293f);
+			poly = _mm_add_ps(_mm_mul_ps(poly, ax), _mm_set1_ps(0.0742610f));
+			poly = _mm_add_ps(_mm_mul_ps(poly, ax), _mm_set1_ps(-0.2121144f));
+			poly = _mm_add_ps(_mm_mul_ps(poly, ax), _mm_set1_ps(1.5707288f));
+			poly = _mm_mul_ps(poly, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), ax)));
+			// acos(-x) = pi - acos(x)
+			return Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(3.14159265f), poly), poly);
+		}
+		// The angle between each pair of vectors, which do not need to be normalized
+		inline __m128 Angle(const Vec3x4& a, const Vec3x4& b) {
+			return Acos(Dot(Normalize(a), Normalize(b)));
+		}
+		// Stores up to 4 lanes of a register into memory
+		inline void StorePartial(float* out, __m128 value, uint32_t count) {
+			if (count == 4)
+				_mm_storeu_ps(out, value);
+			else {
+				alignas(16) float lanes[4];
+				_mm_store_ps(lanes, value);
+				for (uint32_t ix = 0; ix < count; ix++)
+					out[ix] = lanes[ix];
+			}
+		}
+
+		/*
+		 * A single attribute of every vertex, split into one stream per component
+		 */
+		struct Streams {
+			std::vector<float> X, Y, Z;
+
+			// Loads 4 values from the streams, one from each of the given vertices
+			Vec3x4 Gather(const uint32_t* ix) const {
+				return {
+					_mm_set_ps(X[ix[3]], X[ix[2]], X[ix[1]], X[ix[0]]),
+					_mm_set_ps(Y[ix[3]], Y[ix[2]], Y[ix[1]], Y[ix[0]]),
+					_mm_set_ps(Z[ix[3]], Z[ix[2]], Z[ix[1]], Z[ix[0]])
+				};
+			}
+			// Loads 4 values from the streams, starting at the given vertex
+			Vec3x4 Load(size_t ix) const {
+				return { _mm_loadu_ps(X.data() + ix), _mm_loadu_ps(Y.data() + ix), _mm_loadu_ps(Z.data() + ix) };
+			}
+		};
+
+		/*
+		 * Copies a vec3 attribute of each vertex out into streams, which are padded up to a multiple of 4 by repeating the
+		 * last vertex, so that there is always a full register to load
+		 * @param vertices The vertices to copy from
+		 * @param member The attribute to copy
+		 * @param out The streams to copy into
+		 */
+		template <typename T>
+		void SplitStreams(const std::vector<Vertex>& vertices, T Vertex::* member, Streams& out) {
+			const size_t count = vertices.size();
+			const size_t padded = (count + 3) & ~(size_t)3;
+			out.X.resize(padded);
+			out.Y.resize(padded);
+			out.Z.resize(padded, 0.0f);
+			const uint32_t jobs = (uint32_t)((padded + MESH_PROCESS_JOB_SIZE - 1) / MESH_PROCESS_JOB_SIZE);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t end = std::min((size_t)(job + 1) * MESH_PROCESS_JOB_SIZE, padded);
+				for (size_t ix = (size_t)job * MESH_PROCESS_JOB_SIZE; ix < end; ix++) {
+					const T& value = vertices[std::min(ix, count - 1)].*member;
+					out.X[ix] = value[0];
+					out.Y[ix] = value[1];
+					if constexpr (T::length() > 2)
+						out.Z[ix] = value[2];
+				}
+			});
+		}
+
+		/*
+		 * Builds a list of the corners that use each key, so that per-corner results can be summed up per vertex without
+		 * any two threads writing to the same vertex. Corners are numbered corner * triangleCount + triangle, which is the
+		 * layout that the per-corner streams are stored in
+		 * @param indices The indices of the triangles
+		 * @param triangleCount The number of triangles
+		 * @param keys Maps each vertex to the key that its corners are listed under
+		 * @param keyCount The number of keys
+		 * @param outOffsets Receives where each key's corners start in outCorners, with one extra entry at the end
+		 * @param outCorners Receives the corners of each key
+		 */
+		void BuildCornerLists(const uint32_t* indices, size_t triangleCount, const uint32_t* keys, size_t keyCount, std::vector<uint32_t>& outOffsets, std::vector<uint32_t>& outCorners) {
+			outOffsets.assign(keyCount + 1, 0);
+			for (size_t ix = 0; ix < triangleCount * 3; ix++)
+				outOffsets[(keys ? keys[indices[ix]] : indices[ix]) + 1]++;
+			for (size_t ix = 0; ix < keyCount; ix++)
+				outOffsets[ix + 1] += outOffsets[ix];
+			outCorners.resize(triangleCount * 3);
+			std::vector<uint32_t> fill(outOffsets.begin(), outOffsets.end() - 1);
+			for (size_t tri = 0; tri < triangleCount; tri++) {
+				for (size_t corner = 0; corner < 3; corner++) {
+					uint32_t vertex = indices[tri * 3 + corner];
+					outCorners[fill[keys ? keys[vertex] : vertex]++] = (uint32_t)(corner * triangleCount + tri);
+				}
+			}
+		}
+
+		/*
+		 * Runs a function over blocks of up to 4 triangles, spread across our threads
+		 * @param triangleCount The number of triangles
+		 * @param indices The indices of the triangles
+		 * @param func Called with the first triangle of the block, the number of triangles in it, and the indices of each
+		 *             corner for the 4 triangles. Blocks that are not full repeat their last triangle
+		 */
+		template <typename Func>
+		void ForEachTriangleBlock(size_t triangleCount, const uint32_t* indices, const Func& func) {
+			const uint32_t jobs = (uint32_t)((triangleCount + MESH_PROCESS_JOB_SIZE - 1) / MESH_PROCESS_JOB_SIZE);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t end = std::min((size_t)(job + 1) * MESH_PROCESS_JOB_SIZE, triangleCount);
+				for (size_t tri = (size_t)job * MESH_PROCESS_JOB_SIZE; tri < end; tri += 4) {
+					const uint32_t count = (uint32_t)std::min<size_t>(4, end - tri);
+					uint32_t corners[3][4];
+					for (uint32_t lane = 0; lane < 4; lane++) {
+						const size_t source = tri + std::min(lane, count - 1);
+						corners[0][lane] = indices[source * 3 + 0];
+						corners[1][lane] = indices[source * 3 + 1];
+						corners[2][lane] = indices[source * 3 + 2];
+					}
+					func(tri, count, corners);
+				}
+			});
+		}
+
+		/*
+		 * Computes the angle of each corner of 4 triangles
+		 * @param p The positions of the triangles' corners
+		 * @param outAngles Receives the angle at each corner
+		 */
+		inline void CornerAngles(const Vec3x4 p[3], __m128 outAngles[3]) {
+			const Vec3x4 e01 = Sub(p[1], p[0]), e02 = Sub(p[2], p[0]), e12 = Sub(p[2], p[1]);
+			const Vec3x4 zero = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+			outAngles[0] = Angle(e01, e02);
+			outAngles[1] = Angle(Sub(zero, e01), e12);
+			outAngles[2] = Angle(Sub(zero, e02), Sub(zero, e12));
+		}
+
+		/*
+		 * Builds a table from each vertex to the first vertex before it that matches, using a hash table over a grid of cells.
+		 * With an epsilon of 0, the cells are the exact bits of the position
+		 * @param vertices The vertices to examine
+		 * @param epsilon How close positions need to be to match
+		 * @param isMatch Called with two vertices whose positions match, returns true if they should be merged
+		 * @param outRemap Receives the index of the matching vertex for each vertex, or its own index if there is none
+		 * @returns The number of vertices that did not match an earlier vertex
+		 */
+		template <typename Match>
+		uint32_t BuildRemap(const std::vector<Vertex>& vertices, float epsilon, const Match& isMatch, std::vector<uint32_t>& outRemap) {
+			const size_t count = vertices.size();
+			outRemap.resize(count);
+			if (count == 0)
+				return 0;
+
+			// Cells twice the size of epsilon mean that everything within epsilon of a vertex is in at most 2 cells per axis
+			const float cellSize = epsilon * 2.0f;
+			auto cellOf = [&](const glm::vec3& position) {
+				if (epsilon <= 0.0f) {
+					glm::ivec3 bits;
+					// Add 0 so that -0 and 0 land in the same cell
+					const glm::vec3 value = position + glm::vec3(0.0f);
+					memcpy(&bits, &value, sizeof(glm::ivec3));
+					return bits;
+				}
+				return glm::ivec3(glm::floor(position / cellSize));
+			};
+			auto hashOf = [](const glm::ivec3& cell) {
+				uint32_t hash = (uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u ^ (uint32_t)cell.z * 83492791u;
+				hash ^= hash >> 16;
+				hash *= 0x7FEB352Du;
+				return hash ^ (hash >> 15);
+			};
+
+			// Finding each vertex's cell and its hash is independent of the other vertices, so that part is done in parallel
+			std::vector<glm::ivec3> cells(count);
+			std::vector<uint32_t> hashes(count);
+			const uint32_t jobs = (uint32_t)((count + MESH_PROCESS_JOB_SIZE - 1) / MESH_PROCESS_JOB_SIZE);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t end = std::min((size_t)(job + 1) * MESH_PROCESS_JOB_SIZE, count);
+				for (size_t ix = (size_t)job * MESH_PROCESS_JOB_SIZE; ix < end; ix++) {
+					cells[ix] = cellOf(vertices[ix].Position);
+					hashes[ix] = hashOf(cells[ix]);
+				}
+			});
+
+			// The same open addressing scheme that ObjLoader uses, kept at most half full so that probe chains stay short.
+			// Only the first vertex at each position goes in the table, and every vertex after it is matched against it
+			size_t capacity = 16;
+			while (capacity < count * 2)
+				capacity <<= 1;
+			const size_t mask = capacity - 1;
+			std::vector<uint32_t> table(capacity, MESH_WELD_EMPTY_SLOT);
+
+			const float epsilonSq = epsilon * epsilon;
+			uint32_t uniqueCount = 0;
+			for (size_t ix = 0; ix < count; ix++) {
+				const glm::vec3& position = vertices[ix].Position;
+				glm::ivec3 lo = cells[ix], hi = cells[ix];
+				if (epsilon > 0.0f) {
+					lo = cellOf(position - glm::vec3(epsilon));
+					hi = cellOf(position + glm::vec3(epsilon));
+				}
+
+				uint32_t match = MESH_WELD_EMPTY_SLOT;
+				for (int z = lo.z; z <= hi.z && match == MESH_WELD_EMPTY_SLOT; z++)
+				for (int y = lo.y; y <= hi.y && match == MESH_WELD_EMPTY_SLOT; y++)
+				for (int x = lo.x; x <= hi.x && match == MESH_WELD_EMPTY_SLOT; x++) {
+					const glm::ivec3 cell = glm::ivec3(x, y, z);
+					for (size_t slot = (cell == cells[ix] ? hashes[ix] : hashOf(cell)) & mask; table[slot] != MESH_WELD_EMPTY_SLOT; slot = (slot + 1) & mask) {
+						const uint32_t other = table[slot];
+						if (cells[other] != cell)
+							continue;
+						const glm::vec3 delta = vertices[other].Position - position;
+						if ((epsilon > 0.0f ? glm::dot(delta, delta) <= epsilonSq : true) && isMatch(vertices[other], vertices[ix])) {
+							match = other;
+							break;
+						}
+					}
+				}
+
+				if (match == MESH_WELD_EMPTY_SLOT) {
+					size_t slot = hashes[ix] & mask;
+					while (table[slot] != MESH_WELD_EMPTY_SLOT)
+						slot = (slot + 1) & mask;
+					table[slot] = (uint32_t)ix;
+					match = (uint32_t)ix;
+					uniqueCount++;
+				}
+				outRemap[ix] = match;
+			}
+			return uniqueCount;
+		}
+
+		void MeshProcessor::ComputeNormals(std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount, float weldEpsilon) {
+			const size_t triangleCount = indexCount / 3;
+			if (triangleCount == 0 || vertices.empty())
+				return;
+
+			// Vertices that share a position sum their normals together, under the first vertex at that position
+			std::vector<uint32_t> remap;
+			GeneratePositionRemap(vertices, weldEpsilon, remap);
+
+			Streams positions;
+			SplitStreams(vertices, &Vertex::Position, positions);
+
+			// Find each face's normal, weighted by the angle at each of its corners. Each corner's result goes in its own
+			// stream, so that 4 triangles can be stored at once
+			Streams weighted;
+			weighted.X.resize(triangleCount * 3);
+			weighted.Y.resize(triangleCount * 3);
+			weighted.Z.resize(triangleCount * 3);
+			ForEachTriangleBlock(triangleCount, indices, [&](size_t tri, uint32_t count, const uint32_t corners[3][4]) {
+				const Vec3x4 p[3] = { positions.Gather(corners[0]), positions.Gather(corners[1]), positions.Gather(corners[2]) };
+				const Vec3x4 normal = Normalize(Cross(Sub(p[1], p[0]), Sub(p[2], p[0])));
+				__m128 angles[3];
+				CornerAngles(p, angles);
+				for (size_t corner = 0; corner < 3; corner++) {
+					const Vec3x4 value = Scale(normal, angles[corner]);
+					const size_t offset = corner * triangleCount + tri;
+					StorePartial(weighted.X.data() + offset, value.X, count);
+					StorePartial(weighted.Y.data() + offset, value.Y, count);
+					StorePartial(weighted.Z.data() + offset, value.Z, count);
+				}
+			});
+
+			std::vector<uint32_t> offsets, cornerList;
+			BuildCornerLists(indices, triangleCount, remap.data(), vertices.size(), offsets, cornerList);
+
+			// Sum up the corners at each position. Positions that no triangle uses, or whose faces are all degenerate, keep
+			// the normals they had
+			std::vector<glm::vec3> sums(vertices.size());
+			const uint32_t jobs = (uint32_t)((vertices.size() + MESH_PROCESS_JOB_SIZE - 1) / MESH_PROCESS_JOB_SIZE);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t end = std::min((size_t)(job + 1) * MESH_PROCESS_JOB_SIZE, vertices.size());
+				for (size_t ix = (size_t)job * MESH_PROCESS_JOB_SIZE; ix < end; ix++) {
+					glm::vec3 sum = glm::vec3(0.0f);
+					for (uint32_t cx = offsets[ix]; cx < offsets[ix + 1]; cx++)
+						sum += glm::vec3(weighted.X[cornerList[cx]], weighted.Y[cornerList[cx]], weighted.Z[cornerList[cx]]);
+					sums[ix] = sum;
+				}
+			});
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t end = std::min((size_t)(job + 1) * MESH_PROCESS_JOB_SIZE, vertices.size());
+				for (size_t ix = (size_t)job * MESH_PROCESS_JOB_SIZE; ix < end; ix++) {
+					const glm::vec3& sum = sums[remap[ix]];
+					if (glm::dot(sum, sum) > MESH_PROCESS_MIN_LENGTH_SQ)
+						vertices[ix].Normal = glm::normalize(sum);
+				}
+			});
+		}
+
+		void MeshProcessor::ComputeTangents(std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount) {
+			const size_t triangleCount = indexCount / 3;
+			const size_t vertexCount = vertices.size();
+			if (triangleCount == 0 || vertexCount == 0)
+				return;
+
+			Streams positions, uvs;
+			SplitStreams(vertices, &Vertex::Position, positions);
+			SplitStreams(vertices, &Vertex::UV, uvs);
+
+			// Find each face's tangent and bitangent from its UVs, weighted by the angle at each of its corners. These are
+			// normalized first, so that faces with more texels don't get more of a say than faces with fewer
+			Streams tangents, bitangents;
+			for (Streams* streams : { &tangents, &bitangents }) {
+				streams->X.resize(triangleCount * 3);
+				streams->Y.resize(triangleCount * 3);
+				streams->Z.resize(triangleCount * 3);
+			}
+			ForEachTriangleBlock(triangleCount, indices, [&](size_t tri, uint32_t count, const uint32_t corners[3][4]) {
+				const Vec3x4 p[3] = { positions.Gather(corners[0]), positions.Gather(corners[1]), positions.Gather(corners[2]) };
+				const Vec3x4 uv[3] = { uvs.Gather(corners[0]), uvs.Gather(corners[1]), uvs.Gather(corners[2]) };
+				const Vec3x4 deltaP1 = Sub(p[1], p[0]), deltaP2 = Sub(p[2], p[0]);
+				const Vec3x4 deltaT1 = Sub(uv[1], uv[0]), deltaT2 = Sub(uv[2], uv[0]);
+
+				// Faces with no area in UV space don't have a tangent, so they don't contribute anything
+				const __m128 det = _mm_sub_ps(_mm_mul_ps(deltaT1.X, deltaT2.Y), _mm_mul_ps(deltaT1.Y, deltaT2.X));
+				const __m128 isValid = _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det), _mm_set1_ps(FLT_MIN));
+				const __m128 r = _mm_and_ps(isValid, _mm_div_ps(_mm_set1_ps(1.0f), Select(isValid, det, _mm_set1_ps(1.0f))));
+				const Vec3x4 tangent = Normalize(Scale(Sub(Scale(deltaP1, deltaT2.Y), Scale(deltaP2, deltaT1.Y)), r));
+				const Vec3x4 bitangent = Normalize(Scale(Sub(Scale(deltaP2, deltaT1.X), Scale(deltaP1, deltaT2.X)), r));
+
+				__m128 angles[3];
+				CornerAngles(p, angles);
+				for (size_t corner = 0; corner < 3; corner++) {
+					const size_t offset = corner * triangleCount + tri;
+					const Vec3x4 t = Scale(tangent, angles[corner]), b = Scale(bitangent, angles[corner]);
+					StorePartial(tangents.X.data() + offset, t.X, count);
+					StorePartial(tangents.Y.data() + offset, t.Y, count);
+					StorePartial(tangents.Z.data() + offset, t.Z, count);
+					StorePartial(bitangents.X.data() + offset, b.X, count);
+					StorePartial(bitangents.Y.data() + offset, b.Y, count);
+					StorePartial(bitangents.Z.data() + offset, b.Z, count);
+				}
+			});
+
+			// Tangents depend on the UVs, so unlike the normals these are only shared between corners of the same vertex
+			std::vector<uint32_t> offsets, cornerList;
+			BuildCornerLists(indices, triangleCount, nullptr, vertexCount, offsets, cornerList);
+
+			// Sum up the corners of each vertex into streams, so we can orthonormalize 4 vertices at a time
+			Streams normals, tangentSums, bitangentSums;
+			SplitStreams(vertices, &Vertex::Normal, normals);
+			const size_t padded = normals.X.size();
+			for (Streams* streams : { &tangentSums, &bitangentSums }) {
+				streams->X.assign(padded, 0.0f);
+				streams->Y.assign(padded, 0.0f);
+				streams->Z.assign(padded, 0.0f);
+			}
+			const uint32_t jobs = (uint32_t)((padded + MESH_PROCESS_JOB_SIZE - 1) / MESH_PROCESS_JOB_SIZE);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t begin = (size_t)job * MESH_PROCESS_JOB_SIZE;
+				const size_t end = std::min(begin + MESH_PROCESS_JOB_SIZE, padded);
+				for (size_t ix = begin; ix < std::min(end, vertexCount); ix++) {
+					for (uint32_t cx = offsets[ix]; cx < offsets[ix + 1]; cx++) {
+						const uint32_t corner = cornerList[cx];
+						tangentSums.X[ix] += tangents.X[corner];
+						tangentSums.Y[ix] += tangents.Y[corner];
+						tangentSums.Z[ix] += tangents.Z[corner];
+						bitangentSums.X[ix] += bitangents.X[corner];
+						bitangentSums.Y[ix] += bitangents.Y[corner];
+						bitangentSums.Z[ix] += bitangents.Z[corner];
+					}
+				}
+
+				// Gram-Schmidt the tangent against the normal, and rebuild the bitangent from the two of them so the frame is
+				// orthonormal. The bitangent keeps the handedness of the sum, which flips on mirrored UVs
+				for (size_t ix = begin; ix < end; ix += 4) {
+					const Vec3x4 n = normals.Load(ix);
+					const Vec3x4 b = bitangentSums.Load(ix);
+					Vec3x4 t = tangentSums.Load(ix);
+					t = Normalize(Sub(t, Scale(n, Dot(n, t))));
+					const Vec3x4 cross = Cross(n, t);
+					const __m128 sign = Select(_mm_cmplt_ps(Dot(cross, b), _mm_setzero_ps()), _mm_set1_ps(-1.0f), _mm_set1_ps(1.0f));
+					const Vec3x4 outB = Scale(cross, sign);
+
+					alignas(16) float lanes[6][4];
+					_mm_store_ps(lanes[0], t.X);
+					_mm_store_ps(lanes[1], t.Y);
+					_mm_store_ps(lanes[2], t.Z);
+					_mm_store_ps(lanes[3], outB.X);
+					_mm_store_ps(lanes[4], outB.Y);
+					_mm_store_ps(lanes[5], outB.Z);
+					for (size_t lane = 0; lane < 4 && ix + lane < vertexCount; lane++) {
+						const size_t vertex = ix + lane;
+						if (offsets[vertex] == offsets[vertex + 1])
+							continue;
+						Vertex& out = vertices[vertex];
+						out.Tangent = glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+						out.BiTangent = glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]);
+						// If none of the faces had a usable tangent (or it lines up with the normal), we still want a valid
+						// frame, so we pick any direction perpendicular to the normal
+						if (glm::dot(out.Tangent, out.Tangent) <= MESH_PROCESS_MIN_LENGTH_SQ) {
+							const glm::vec3 axis = fabsf(out.Normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+							out.Tangent = glm::normalize(glm::cross(axis, out.Normal));
+							out.BiTangent = glm::cross(out.Normal, out.Tangent);
+						}
+					}
+				}
+			});
+		}
+
+		MeshBounds MeshProcessor::ComputeBounds(const std::vector<Vertex>& vertices) {
+			MeshBounds result;
+			if (vertices.empty())
+				return result;
+
+			// The streams are padded with copies of the last vertex, so those don't change the bounds
+			Streams positions;
+			SplitStreams(vertices, &Vertex::Position, positions);
+			const size_t padded = positions.X.size();
+			const uint32_t jobs = (uint32_t)((padded + MESH_PROCESS_JOB_SIZE - 1) / MESH_PROCESS_JOB_SIZE);
+
+			// Each job finds the bounds of its own range, and we combine them afterwards
+			std::vector<glm::vec3> mins(jobs), maxes(jobs);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t begin = (size_t)job * MESH_PROCESS_JOB_SIZE;
+				const size_t end = std::min(begin + MESH_PROCESS_JOB_SIZE, padded);
+				Vec3x4 lo = positions.Load(begin), hi = lo;
+				for (size_t ix = begin + 4; ix < end; ix += 4) {
+					const Vec3x4 p = positions.Load(ix);
+					lo = { _mm_min_ps(lo.X, p.X), _mm_min_ps(lo.Y, p.Y), _mm_min_ps(lo.Z, p.Z) };
+					hi = { _mm_max_ps(hi.X, p.X), _mm_max_ps(hi.Y, p.Y), _mm_max_ps(hi.Z, p.Z) };
+				}
+				alignas(16) float lanes[6][4];
+				_mm_store_ps(lanes[0], lo.X);
+				_mm_store_ps(lanes[1], lo.Y);
+				_mm_store_ps(lanes[2], lo.Z);
+				_mm_store_ps(lanes[3], hi.X);
+				_mm_store_ps(lanes[4], hi.Y);
+				_mm_store_ps(lanes[5], hi.Z);
+				mins[job] = glm::vec3(lanes[0][0], lanes[1][0], lanes[2][0]);
+				maxes[job] = glm::vec3(lanes[3][0], lanes[4][0], lanes[5][0]);
+				for (int lane = 1; lane < 4; lane++) {
+					mins[job] = glm::min(mins[job], glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]));
+					maxes[job] = glm::max(maxes[job], glm::vec3(lanes[3][lane], lanes[4][lane], lanes[5][lane]));
+				}
+			});
+			result.Min = mins[0];
+			result.Max = maxes[0];
+			for (uint32_t job = 1; job < jobs; job++) {
+				result.Min = glm::min(result.Min, mins[job]);
+				result.Max = glm::max(result.Max, maxes[job]);
+			}
+
+			// The radius is the distance to the furthest vertex from the center of the box
+			const glm::vec3 center = (result.Min + result.Max) * 0.5f;
+			const Vec3x4 center4 = { _mm_set1_ps(center.x), _mm_set1_ps(center.y), _mm_set1_ps(center.z) };
+			std::vector<float> radii(jobs);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t begin = (size_t)job * MESH_PROCESS_JOB_SIZE;
+				const size_t end = std::min(begin + MESH_PROCESS_JOB_SIZE, padded);
+				__m128 furthest = _mm_setzero_ps();
+				for (size_t ix = begin; ix < end; ix += 4) {
+					const Vec3x4 delta = Sub(positions.Load(ix), center4);
+					furthest = _mm_max_ps(furthest, Dot(delta, delta));
+				}
+				alignas(16) float lanes[4];
+				_mm_store_ps(lanes, furthest);
+				radii[job] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+			});
+			result.Sphere = glm::vec4(center, sqrtf(*std::max_element(radii.begin(), radii.end())));
+			return result;
+		}
+
+		uint32_t MeshProcessor::GeneratePositionRemap(const std::vector<Vertex>& vertices, float epsilon, std::vector<uint32_t>& outRemap) {
+			return BuildRemap(vertices, epsilon, [](const Vertex&, const Vertex&) { return true; }, outRemap);
+		}
+
+		size_t MeshProcessor::WeldVertices(MeshData& data, float epsilon) {
+			const size_t vertexCount = data.Vertices.size();
+			if (vertexCount == 0)
+				return 0;
+
+			auto isNear = [](const auto& a, const auto& b) {
+				return glm::all(glm::lessThanEqual(glm::abs(a - b), decltype(a - b)(MESH_WELD_ATTRIBUTE_EPSILON)));
+			};
+			std::vector<uint32_t> remap;
+			const uint32_t uniqueCount = BuildRemap(data.Vertices, epsilon, [&](const Vertex& a, const Vertex& b) {
+				return isNear(a.Normal, b.Normal) && isNear(a.UV, b.UV) && isNear(a.LightmapUV, b.LightmapUV) &&
+					isNear(a.Color, b.Color) && isNear(a.Tangent, b.Tangent) && isNear(a.BiTangent, b.BiTangent);
+			}, remap);
+			if (uniqueCount == vertexCount)
+				return 0;
+
+			// Give each vertex that we're keeping its new index, they stay in the same order
+			std::vector<uint32_t> newIndex(vertexCount);
+			uint32_t next = 0;
+			for (size_t ix = 0; ix < vertexCount; ix++)
+				newIndex[ix] = remap[ix] == ix ? next++ : MESH_WELD_EMPTY_SLOT;
+			for (size_t ix = 0; ix < vertexCount; ix++)
+				newIndex[ix] = newIndex[remap[ix]];
+
+			std::vector<Vertex> vertices(uniqueCount);
+			const uint32_t jobs = (uint32_t)((vertexCount + MESH_PROCESS_JOB_SIZE - 1) / MESH_PROCESS_JOB_SIZE);
+			utils::ParallelFor(jobs, 0, [&](uint32_t job) {
+				const size_t end = std::min((size_t)(job + 1) * MESH_PROCESS_JOB_SIZE, vertexCount);
+				for (size_t ix = (size_t)job * MESH_PROCESS_JOB_SIZE; ix < end; ix++) {
+					if (remap[ix] == ix)
+						vertices[newIndex[ix]] = data.Vertices[ix];
+				}
+			});
+
+			// Triangles that had two of their corners merged no longer have any area, so we drop them
+			size_t indexCount = 0;
+			for (size_t ix = 0; ix + 2 < data.Indices.size(); ix += 3) {
+				const uint32_t a = newIndex[data.Indices[ix]], b = newIndex[data.Indices[ix + 1]], c = newIndex[data.Indices[ix + 2]];
+				if (a == b || b == c || a == c)
+					continue;
+				data.Indices[indexCount++] = a;
+				data.Indices[indexCount++] = b;
+				data.Indices[indexCount++] = c;
+			}
+			const size_t droppedTriangles = (data.Indices.size() - indexCount) / 3;
+			data.Indices.resize(indexCount);
+
+			// Some vertices may have only been used by the triangles we dropped, so we compact out any that are unused now.
+			// Vertices only ever move towards the front, so this can be done in place
+			std::vector<uint32_t> compacted(uniqueCount, MESH_WELD_EMPTY_SLOT);
+			for (uint32_t index : data.Indices)
+				compacted[index] = 0;
+			uint32_t usedCount = 0;
+			for (uint32_t ix = 0; ix < uniqueCount; ix++) {
+				if (compacted[ix] != MESH_WELD_EMPTY_SLOT) {
+					compacted[ix] = usedCount;
+					vertices[usedCount++] = vertices[ix];
+				}
+			}
+			if (usedCount < uniqueCount) {
+				vertices.resize(usedCount);
+				for (uint32_t& index : data.Indices)
+					index = compacted[index];
+			}
+			data.Vertices = std::move(vertices);
+
+			LOG_TRACE("Welded {} vertices of {} and removed {} unused, dropping {} triangles", vertexCount - uniqueCount, data.DebugName, uniqueCount - usedCount, droppedTriangles);
+			return vertexCount - usedCount;
+		}
+
+	}
+}
@@ -0,0 +1,298 @@
+#include "florp/graphics/MeshSimplifier.h"
+#include <algorithm>
+#include <numeric>
+#include "florp/graphics/MeshOptimizer.h"
+#include "Logging.h"
+
+namespace florp {
+	namespace graphics {
+
+		// How much a collapse is penalized for moving a vertex onto one with a different normal, relative to the squared size
+		// of the mesh. This keeps creases and the curvature of smooth shading from being flattened out
+		#define SIMPLIFY_NORMAL_WEIGHT 0.01f
+		// A collapse is rejected if it would rotate any triangle's normal by more than acos of this
+		#define SIMPLIFY_MIN_NORMAL_DOT 0.25f
+		// A level of detail is only kept if it removes at least this fraction of the previous level's triangles
+		#define SIMPLIFY_MIN_LOD_REDUCTION 0.1f
+
+		/*
+		 * The weighted sum of squared distances to a set of planes, stored as the symmetric matrix A, vector b and constant c
+		 * so that the sum at p is p'Ap + 2b'p + c. W is the total weight, so that we can get the average squared distance
+		 */
+		struct Quadric {
+			double A00, A01, A02, A11, A12, A22;
+			double B0, B1, B2;
+			double C;
+			double W;
+
+			Quadric() : A00(0), A01(0), A02(0), A11(0), A12(0), A22(0), B0(0), B1(0), B2(0), C(0), W(0) { }
+
+			// Creates the quadric for the plane with the given unit normal and distance, weighted by weight
+			static Quadric FromPlane(const glm::dvec3& n, double d, double weight) {
+				Quadric result;
+				result.A00 = n.x * n.x * weight; result.A01 = n.x * n.y * weight; result.A02 = n.x * n.z * weight;
+				result.A11 = n.y * n.y * weight; result.A12 = n.y * n.z * weight; result.A22 = n.z * n.z * weight;
+				result.B0 = n.x * d * weight; result.B1 = n.y * d * weight; result.B2 = n.z * d * weight;
+				result.C = d * d * weight;
+				result.W = weight;
+				return result;
+			}
+
+			Quadric& operator +=(const Quadric& other) {
+				A00 += other.A00; A01 += other.A01; A02 += other.A02;
+				A11 += other.A11; A12 += other.A12; A22 += other.A22;
+				B0 += other.B0; B1 += other.B1; B2 += other.B2;
+				C += other.C;
+				W += other.W;
+				return *this;
+			}
+
+			// Gets the average squared distance from p to our planes
+			double Evaluate(const glm::vec3& p) const {
+				double x = p.x, y = p.y, z = p.z;
+				double result =
+					A00 * x * x + A11 * y * y + A22 * z * z +
+					2.0 * (A01 * x * y + A02 * x * z + A12 * y * z) +
+					2.0 * (B0 * x + B1 * y + B2 * z) + C;
+				return W > 0.0 ? glm::max(result, 0.0) / W : 0.0;
+			}
+		};
+
+		/*
+		 * A candidate for collapsing the From vertex onto the To vertex
+		 */
+		struct Collapse {
+			uint32_t From;
+			uint32_t To;
+			float    Error;
+		};
+
+		/*
+		 * Finds the vertices that may not be moved: those that share their position with another vertex (UV and normal
+		 * seams), and those on open or non-manifold edges
+		 */
+		static std::vector<bool> FindLockedVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+			const size_t vertexCount = vertices.size();
+			std::vector<bool> locked(vertexCount, false);
+
+			// Sort the vertices by position so we can find the ones that share a position
+			std::vector<uint32_t> order(vertexCount);
+			std::iota(order.begin(), order.end(), 0);
+			auto lessPosition = [&](uint32_t a, uint32_t b) {
+				const glm::vec3& pa = vertices[a].Position;
+				const glm::vec3& pb = vertices[b].Position;
+				return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+			};
+			std::sort(order.begin(), order.end(), lessPosition);
+
+			// Weld vertices with the same position, seams are any position with more than one vertex
+			std::vector<uint32_t> welded(vertexCount);
+			for (size_t ix = 0; ix < vertexCount; ) {
+				size_t end = ix + 1;
+				while (end < vertexCount && vertices[order[end]].Position == vertices[order[ix]].Position)
+					end++;
+				for (size_t jx = ix; jx < end; jx++) {
+					welded[order[jx]] = order[ix];
+					locked[order[jx]] = end - ix > 1;
+				}
+				ix = end;
+			}
+
+			// Count how many triangles use each welded edge, a manifold interior edge is used by exactly 2
+			std::vector<uint64_t> edges;
+			edges.reserve(indices.size());
+			for (size_t ix = 0; ix + 2 < indices.size(); ix += 3) {
+				for (int corner = 0; corner < 3; corner++) {
+					uint64_t a = welded[indices[ix + corner]];
+					uint64_t b = welded[indices[ix + (corner + 1) % 3]];
+					edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			std::vector<bool> lockedWelded(vertexCount, false);
+			for (size_t ix = 0; ix < edges.size(); ) {
+				size_t end = ix + 1;
+				while (end < edges.size() && edges[end] == edges[ix])
+					end++;
+				if (end - ix != 2) {
+					lockedWelded[(uint32_t)(edges[ix] >> 32)] = true;
+					lockedWelded[(uint32_t)(edges[ix] & 0xFFFFFFFFu)] = true;
+				}
+				ix = end;
+			}
+			for (size_t ix = 0; ix < vertexCount; ix++)
+				locked[ix] = locked[ix] || lockedWelded[welded[ix]];
+			return locked;
+		}
+
+		MeshData MeshSimplifier::Simplify(const MeshData& source, size_t targetTriangles, float maxError, float* outError) {
+			MeshData result = source;
+			std::vector<Vertex>& vertices = result.Vertices;
+			std::vector<uint32_t>& indices = result.Indices;
+			const size_t vertexCount = vertices.size();
+			if (outError != nullptr)
+				*outError = 0.0f;
+			if (indices.size() / 3 <= targetTriangles || vertexCount == 0)
+				return result;
+
+			// Errors are measured relative to the largest side of the mesh's bounds
+			glm::vec3 boundsMin = vertices[0].Position, boundsMax = vertices[0].Position;
+			for (const Vertex& vertex : vertices) {
+				boundsMin = glm::min(boundsMin, vertex.Position);
+				boundsMax = glm::max(boundsMax, vertex.Position);
+			}
+			glm::vec3 size = boundsMax - boundsMin;
+			float extent = glm::max(size.x, glm::max(size.y, size.z));
+			if (extent <= 0.0f)
+				return result;
+			const float normalPenalty = SIMPLIFY_NORMAL_WEIGHT * extent * extent;
+			const float errorLimit = (maxError * extent) * (maxError * extent);
+
+			std::vector<bool> locked = FindLockedVertices(vertices, indices);
+
+			// Every vertex starts with the planes of the triangles around it, weighted by area
+			std::vector<Quadric> quadrics(vertexCount);
+			for (size_t ix = 0; ix + 2 < indices.size(); ix += 3) {
+				glm::dvec3 p0 = vertices[indices[ix + 0]].Position;
+				glm::dvec3 p1 = vertices[indices[ix + 1]].Position;
+				glm::dvec3 p2 = vertices[indices[ix + 2]].Position;
+				glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+				double area = glm::length(normal);
+				if (area <= 0.0)
+					continue;
+				normal /= area;
+				Quadric plane = Quadric::FromPlane(normal, -glm::dot(normal, p0), area * 0.5);
+				for (int corner = 0; corner < 3; corner++)
+					quadrics[indices[ix + corner]] += plane;
+			}
+
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+			std::vector<uint32_t> adjacency;
+			std::vector<Collapse> collapses;
+			std::vector<uint32_t> remap(vertexCount);
+			std::vector<bool> touched(vertexCount);
+			float largestError = 0.0f;
+
+			// We work in passes, each of which makes as many of the cheapest collapses as it can without any two collapses
+			// touching the same triangles. That way every collapse in a pass can be checked against the mesh as it was at
+			// the start of the pass, and we only have to rebuild our adjacency once per pass
+			while (indices.size() / 3 > targetTriangles) {
+				const size_t triangleCount = indices.size() / 3;
+
+				// Build the list of triangles around each vertex
+				std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+				for (uint32_t index : indices)
+					adjacencyOffsets[index + 1]++;
+				for (size_t ix = 0; ix < vertexCount; ix++)
+					adjacencyOffsets[ix + 1] += adjacencyOffsets[ix];
+				adjacency.resize(indices.size());
+				{
+					std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+					for (size_t ix = 0; ix < indices.size(); ix++)
+						adjacency[cursors[indices[ix]]++] = (uint32_t)(ix / 3);
+				}
+
+				// Find the cost of collapsing every edge in either direction
+				collapses.clear();
+				for (size_t ix = 0; ix < indices.size(); ix++) {
+					uint32_t from = indices[ix];
+					uint32_t to = indices[ix / 3 * 3 + (ix + 1) % 3];
+					for (int direction = 0; direction < 2; direction++) {
+						if (!locked[from]) {
+							Quadric quadric = quadrics[from];
+							quadric += quadrics[to];
+							float normalDot = glm::dot(vertices[from].Normal, vertices[to].Normal);
+							float lengths = glm::length(vertices[from].Normal) * glm::length(vertices[to].Normal);
+							float error = (float)quadric.Evaluate(vertices[to].Position) +
+								normalPenalty * (1.0f - (lengths > 0.0f ? normalDot / lengths : 1.0f));
+							collapses.push_back({ from, to, error });
+						}
+						std::swap(from, to);
+					}
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Error < b.Error; });
+
+				std::iota(remap.begin(), remap.end(), 0);
+				std::fill(touched.begin(), touched.end(), false);
+				size_t removed = 0, made = 0;
+				const size_t toRemove = triangleCount - targetTriangles;
+				for (const Collapse& collapse : collapses) {
+					if (collapse.Error > errorLimit || removed >= toRemove)
+						break;
+					if (touched[collapse.From] || touched[collapse.To])
+						continue;
+
+					// Make sure that no triangle around the vertex we are moving would flip over (or get close to it)
+					bool flips = false;
+					size_t degenerate = 0;
+					for (uint32_t ix = adjacencyOffsets[collapse.From]; ix < adjacencyOffsets[collapse.From + 1] && !flips; ix++) {
+						const uint32_t* triangle = &indices[adjacency[ix] * 3];
+						if (triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To) {
+							degenerate++;
+							continue;
+						}
+						glm::vec3 before[3], after[3];
+						for (int corner = 0; corner < 3; corner++) {
+							before[corner] = vertices[triangle[corner]].Position;
+							after[corner] = triangle[corner] == collapse.From ? vertices[collapse.To].Position : before[corner];
+						}
+						glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+						glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+						flips = glm::dot(normalBefore, normalAfter) < SIMPLIFY_MIN_NORMAL_DOT * glm::length(normalBefore) * glm::length(normalAfter);
+					}
+					if (flips)
+						continue;
+
+					// Lock everything around the vertex for the rest of this pass, since its triangles are about to change
+					for (uint32_t ix = adjacencyOffsets[collapse.From]; ix < adjacencyOffsets[collapse.From + 1]; ix++) {
+						const uint32_t* triangle = &indices[adjacency[ix] * 3];
+						touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+					}
+					remap[collapse.From] = collapse.To;
+					quadrics[collapse.To] += quadrics[collapse.From];
+					largestError = glm::max(largestError, collapse.Error);
+					removed += degenerate;
+					made++;
+				}
+				if (made == 0)
+					break;
+
+				// Apply the collapses, and drop the triangles that have collapsed down to a line
+				size_t write = 0;
+				for (size_t ix = 0; ix < indices.size(); ix += 3) {
+					uint32_t a = remap[indices[ix]], b = remap[indices[ix + 1]], c = remap[indices[ix + 2]];
+					if (a == b || b == c || a == c)
+						continue;
+					indices[write++] = a;
+					indices[write++] = b;
+					indices[write++] = c;
+				}
+				indices.resize(write);
+			}
+
+			// Tidy up the vertices we no longer use, and re-order everything for the GPU
+			MeshOptimizer::Optimize(result);
+			if (outError != nullptr)
+				*outError = sqrtf(largestError) / extent;
+			return result;
+		}
+
+		std::vector<MeshData> MeshSimplifier::GenerateLods(const MeshData& source, uint32_t levelCount, float reduction, float maxError) {
+			std::vector<MeshData> result;
+			result.push_back(source);
+			for (uint32_t level = 1; level < levelCount; level++) {
+				const MeshData& previous = result.back();
+				size_t previousTriangles = previous.Indices.size() / 3;
+				// Each level is simplified from the source rather than the previous level, so errors do not stack up
+				float error;
+				MeshData lod = Simplify(source, (size_t)(previousTriangles * reduction), maxError, &error);
+				size_t triangles = lod.Indices.size() / 3;
+				if (triangles == 0 || (float)triangles > (float)previousTriangles * (1.0f - SIMPLIFY_MIN_LOD_REDUCTION))
+					break;
+				LOG_TRACE("Generated LOD {} for '{}', {} -> {} triangles (error {:.4f})", level, source.DebugName, source.Indices.size() / 3, triangles, error);
+				result.push_back(std::move(lod));
+			}
+			return result;
+		}
+	}
+}
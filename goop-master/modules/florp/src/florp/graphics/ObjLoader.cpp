@@ -1,212 +1,347 @@
 #include "florp/graphics/ObjLoader.h"
 #include "florp/graphics/MeshBuilder.h"
-#include <fstream>
-#include <iostream>
+#include "florp/graphics/MeshFile.h"
+#include "florp/graphics/MeshOptimizer.h"
+#include "florp/graphics/MeshProcessor.h"
+#include "florp/utils/FileUtils.h"
+#include "florp/utils/Parallel.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
 #include <string>
 #include <vector>
-#include <sstream>
-#include <filesystem>
-#include <regex>
 
 #include "Logging.h"
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/normal.hpp>
-#include <unordered_map>
 
 namespace florp {
 	namespace graphics {
 
+		// We try to give each thread a few chunks so that uneven chunks balance out, but don't bother splitting below this size
+		#define OBJ_MIN_CHUNK_SIZE (1024 * 1024)
+		#define OBJ_CHUNKS_PER_THREAD 4
+		// The number of vertices we build per job once the vertices have been de-duplicated
+		#define OBJ_VERTEX_JOB_SIZE (64 * 1024)
+		// Marks an attribute that a face vertex did not specify
+		#define OBJ_MISSING 0xFFFFFFFFu
+		// Marks an empty slot in the de-duplication table
+		#define OBJ_EMPTY_SLOT 0xFFFFFFFFu
+		// Marks a face vertex attribute that was not given as a relative index
+		#define OBJ_NOT_RELATIVE 0xFF
+		// Mesh files are written next to the OBJ, with this appended to the OBJ's file name
+		#define OBJ_CACHE_EXTENSION ".fmesh"
+		// Bump this whenever the parser changes the meshes it produces, so that existing mesh files are regenerated
+		#define OBJ_CACHE_VERSION 3
+		// The size of the blocks we hash the source in, each block is hashed by a single thread
+		#define OBJ_HASH_BLOCK_SIZE (4 * 1024 * 1024)
+
+		/*
+		 * The position, texture and normal indices of a single face vertex, 0-based
+		 */
 		struct VIndex {
 			uint32_t Pos, Tex, Norm;
+
+			bool operator ==(const VIndex& other) const {
+				return Pos == other.Pos && Tex == other.Tex && Norm == other.Norm;
+			}
+		};
+
+		/*
+		 * Negative indices in an OBJ are relative to the attributes defined so far. A chunk doesn't know how many attributes
+		 * came before it until all the chunks are parsed, so we record these and resolve them once the chunks are merged
+		 */
+		struct RelativeIndex {
+			size_t  Corner;  // The corner (in the chunk's list) that uses this index
+			uint8_t Attrib;  // 0 for the position, 1 for the texture, and 2 for the normal
+			int64_t Index;   // The index relative to the start of the chunk, which may be negative
 		};
 
-		// Borrowed from https://stackoverflow.com/questions/216823/whats-the-best-way-to-trim-stdstring
-		#pragma region String Trimming
+		/*
+		 * A vertex of the face that is currently being parsed, along with any of its indices that are relative
+		 */
+		struct FaceVertex {
+			VIndex        Index;
+			RelativeIndex Relative[3]; // Attrib is OBJ_NOT_RELATIVE if the index was not relative
+		};
+
+		/*
+		 * Everything parsed out of a single chunk of the file
+		 */
+		struct ObjChunk {
+			const char* Begin;
+			const char* End;
+			std::vector<glm::vec3>     Positions;
+			std::vector<glm::vec2>     TexUvs;
+			std::vector<glm::vec3>     Normals;
+			// Every 3 corners make up a triangle, faces with more than 3 vertices have already been triangulated
+			std::vector<VIndex>        Corners;
+			std::vector<RelativeIndex> RelativeIndices;
+		};
+
+		// Returns true if the character is whitespace that can appear inside of a line
+		static inline bool IsSpace(char c) {
+			return c == ' ' || c == '\t' || c == '\r';
+		}
 
-		// trim from start (in place)
-		static inline void ltrim(std::string& s) {
-			s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int ch) {
-				return !std::isspace(ch);
-				}));
+		static inline const char* SkipSpace(const char* p, const char* end) {
+			while (p < end && IsSpace(*p))
+				p++;
+			return p;
 		}
 
-		// trim from end (in place)
-		static inline void rtrim(std::string& s) {
-			s.erase(std::find_if(s.rbegin(), s.rend(), [](int ch) {
-				return !std::isspace(ch);
-				}).base(), s.end());
+		// Parses a float, leaving the output unchanged if there isn't one
+		static inline const char* ParseFloat(const char* p, const char* end, float& out) {
+			p = SkipSpace(p, end);
+			// from_chars doesn't accept an explicit plus sign
+			if (p < end && *p == '+')
+				p++;
+			return std::from_chars(p, end, out).ptr;
 		}
 
-		// trim from both ends (in place)
-		static inline void trim(std::string& s) {
-			ltrim(s);
-			rtrim(s);
+		// Parses a vector of floats, any components missing from the line are left as 0
+		template <int N>
+		static inline glm::vec<N, float> ParseVector(const char* p, const char* end) {
+			glm::vec<N, float> result = glm::vec<N, float>(0.0f);
+			for (int ix = 0; ix < N; ix++)
+				p = ParseFloat(p, end, result[ix]);
+			return result;
 		}
 
-		#pragma endregion 
+		/*
+		 * Parses the vertices of a face, triangulating it as a fan if it has more than 3 vertices
+		 * @param p The start of the face's vertex list (just after the 'f')
+		 * @param end The end of the line
+		 * @param chunk The chunk to add the triangles to
+		 * @param scratch Temporary storage for the face's vertices, re-used between faces to avoid allocations
+		 */
+		static void ParseFace(const char* p, const char* end, ObjChunk& chunk, std::vector<FaceVertex>& scratch) {
+			const size_t counts[3] = { chunk.Positions.size(), chunk.TexUvs.size(), chunk.Normals.size() };
+			size_t vertexCount = 0;
 
-		MeshData ObjLoader::LoadObj(const char* filename, glm::vec4 baseColor) {
-			// Open our file in binary mode
-			std::ifstream file;
-			file.open(filename, std::ios::binary);
+			while ((p = SkipSpace(p, end)) < end) {
+				if (scratch.size() <= vertexCount)
+					scratch.resize(vertexCount + 1);
+				FaceVertex& vertex = scratch[vertexCount];
+				uint32_t* attribs = &vertex.Index.Pos;
+				vertex.Index = { OBJ_MISSING, OBJ_MISSING, OBJ_MISSING };
+				for (RelativeIndex& relative : vertex.Relative)
+					relative.Attrib = OBJ_NOT_RELATIVE;
 
-			// If our file fails to open, we will throw an error
-			if (!file) {
-				throw new std::runtime_error("Failed to open file");
+				// Each vertex is pos[/tex][/norm], where either of the last two may be empty (ex: 1//3)
+				for (uint8_t attribIx = 0; attribIx < 3; attribIx++) {
+					int64_t index = 0;
+					auto parsed = std::from_chars(p, end, index);
+					if (parsed.ec == std::errc()) {
+						p = parsed.ptr;
+						if (index > 0) {
+							attribs[attribIx] = (uint32_t)(index - 1);
+						} else if (index < 0) {
+							vertex.Relative[attribIx].Attrib = attribIx;
+							vertex.Relative[attribIx].Index = (int64_t)counts[attribIx] + index;
+						}
+					}
+					if (p >= end || *p != '/')
+						break;
+					p++;
+				}
+				// Skip anything we didn't understand in this vertex
+				while (p < end && !IsSpace(*p))
+					p++;
+				vertexCount++;
 			}
 
-			LOG_TRACE("Loading mesh from '{}'", filename);
+			if (vertexCount < 3) {
+				LOG_WARN("Skipping OBJ face with only {} vertices", vertexCount);
+				return;
+			}
 
-			// Declare vectors for our positions, normals, and face indices
-			std::vector<glm::vec3>   positions;
-			std::vector<glm::vec2>   texUvs;
-			std::vector<glm::vec3>   normals;
-			std::vector<glm::mat<3, 3, uint32_t>>  faces;
-			// Stores our w value if it is provided
-			float garb;
-			// Stores the line that we are operating on
-			std::string line;
-
-			// A cache for mapping face vertex indices to a mesh vertex index
-			std::unordered_map<uint64_t, int> vectorCache;
-
-			// Iterate as long as there is content to read
-			while (std::getline(file, line)) {
-				// v is our position
-				if (line.substr(0, 2) == "v ") {
-					// Read in the position and append it to our positions list
-					std::istringstream ss = std::istringstream(line.substr(2));
-					glm::vec3 pos; ss >> pos.x; ss >> pos.y; ss >> pos.z; ss >> garb;
-					positions.push_back(pos);
+			// Fan out from the first vertex, which is correct for the convex polygons that exporters write
+			for (size_t ix = 1; ix + 1 < vertexCount; ix++) {
+				for (size_t vertexIx : { (size_t)0, ix, ix + 1 }) {
+					const FaceVertex& vertex = scratch[vertexIx];
+					for (const RelativeIndex& relative : vertex.Relative) {
+						if (relative.Attrib != OBJ_NOT_RELATIVE)
+							chunk.RelativeIndices.push_back({ chunk.Corners.size(), relative.Attrib, relative.Index });
+					}
+					chunk.Corners.push_back(vertex.Index);
 				}
-				// vn is our normals
-				else if (line.substr(0, 3) == "vn ") {
-					// Read in all the normals and append to list
-					std::istringstream ss = std::istringstream(line.substr(3));
-					glm::vec3 norm; ss >> norm.x; ss >> norm.y; ss >> norm.z;
-					normals.push_back(norm);
+			}
+		}
+
+		// Parses every line in a chunk of the file
+		static void ParseChunk(ObjChunk& chunk) {
+			std::vector<FaceVertex> scratch;
+			const char* p = chunk.Begin;
+			while (p < chunk.End) {
+				const char* lineEnd = reinterpret_cast<const char*>(memchr(p, '\n', chunk.End - p));
+				if (lineEnd == nullptr)
+					lineEnd = chunk.End;
+				p = SkipSpace(p, lineEnd);
+
+				// We only care about v, vt, vn and f, everything else (comments, groups, materials) is skipped
+				if (lineEnd - p >= 2) {
+					if (p[0] == 'v') {
+						if (IsSpace(p[1]))
+							chunk.Positions.push_back(ParseVector<3>(p + 2, lineEnd));
+						else if (p[1] == 'n' && lineEnd - p >= 3 && IsSpace(p[2]))
+							chunk.Normals.push_back(ParseVector<3>(p + 3, lineEnd));
+						else if (p[1] == 't' && lineEnd - p >= 3 && IsSpace(p[2]))
+							chunk.TexUvs.push_back(ParseVector<2>(p + 3, lineEnd));
+					}
+					else if (p[0] == 'f' && IsSpace(p[1])) {
+						ParseFace(p + 2, lineEnd, chunk, scratch);
+					}
 				}
-				// vt is our UV's 
-				else if (line.substr(0, 3) == "vt ") {
-					// Read in the coordinates and append to list
-					std::istringstream ss = std::istringstream(line.substr(3));
-					glm::vec2 uv; ss >> uv.x; ss >> uv.y;
-					texUvs.push_back(uv);
+				p = lineEnd + 1;
+			}
+		}
+
+		// Scrambles the bits of a hash, so that every input bit affects every output bit (the finalizer from SplitMix64)
+		static inline uint64_t MixHash(uint64_t hash) {
+			hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+			hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+			return hash ^ (hash >> 31);
+		}
+
+		// Mixes the 3 indices of a vertex into a 64 bit hash
+		static inline uint64_t HashVertex(const VIndex& vertex) {
+			return MixHash(((uint64_t)vertex.Pos << 32 | vertex.Tex) ^ ((uint64_t)vertex.Norm * 0x9E3779B97F4A7C15ull));
+		}
+
+		// Parses an OBJ file that has been mapped into memory, the file is parsed straight out of the OS's page cache
+		static MeshData ParseObj(const utils::MappedFile& file, const char* filename, glm::vec4 baseColor) {
+			LOG_TRACE("Loading mesh from '{}'", filename);
+
+			// Split the file into chunks at line boundaries, so that they can be parsed in parallel
+			const char* data = file.GetData();
+			const char* dataEnd = data + file.GetSize();
+			uint32_t threadCount = utils::GetDefaultThreadCount();
+			size_t chunkCount = std::max<size_t>(1, std::min<size_t>(file.GetSize() / OBJ_MIN_CHUNK_SIZE, threadCount * OBJ_CHUNKS_PER_THREAD));
+			std::vector<ObjChunk> chunks(chunkCount);
+			const char* chunkBegin = data;
+			for (size_t ix = 0; ix < chunkCount; ix++) {
+				const char* chunkEnd = dataEnd;
+				if (ix + 1 < chunkCount) {
+					chunkEnd = std::max(chunkBegin, data + file.GetSize() / chunkCount * (ix + 1));
+					const char* newline = reinterpret_cast<const char*>(memchr(chunkEnd, '\n', dataEnd - chunkEnd));
+					chunkEnd = newline != nullptr ? newline + 1 : dataEnd;
 				}
-				// f is our faces
-				else if (line.substr(0, 2) == "f ") {
-					// We will start parsing with a string stream
-					std::istringstream ss = std::istringstream(line.substr(2));
-
-					// Our face starts as all zeros
-					glm::mat<3, 3, uint32_t> face = glm::mat<3, 3, uint32_t>(0.0f);
-
-					// Remove the first 2 characters (the 'f ')
-					line = line.substr(2);
-					// Trim any leftover whitespace characters
-					rtrim(line);
-
-					// Track whether we are on a whitespace char, and get the length of the line
-					bool ws = false;
-					size_t len = line.length();
-
-					// Set all the attributes to -1 by default
-					face[0][0] = -1; face[0][1] = -1; face[0][2] = -1;
-					face[1][0] = -1; face[1][1] = -1; face[1][2] = -1;
-					face[2][0] = -1; face[2][1] = -1; face[2][2] = -1;
-
-					// Iterate over line, track where we the beginning of our integer is
-					for (size_t ix = 0, start = 0, attribIx = 0, vertexIx = 0; ix < len; ix++) {
-						// If we have a digit, set our whitespace tracker to false
-						if (std::isdigit(line[ix])) {
-							ws = false;
-						}
-						// If we are at a divisor character, or at the end of the string, we need to extract
-						if ((line[ix] == '/' || line[ix] == '\\') | (ix == (len - 1))) {
-							// Extract the number
-							int index = atoi(line.c_str() + start);
-							// Update our start offset for the next number
-							start = ix + 1;
-							// Ensure that we are not past the end of our vertex
-							LOG_ASSERT(attribIx < 3, "Too many attribute indices in OBJ vertex!");
-							// Store the index (and adjust index to be 0-based)
-							face[vertexIx][attribIx] = index - 1;
-							// Advance to the next attribute
-							attribIx++;
-							ws = false;
-						}
-						// Handle whitespace characters, these indicate the start of a new face
-						else if (line[ix] == ' ' || line[ix] == '\t') {
-							// If the last character was not whitespace, we extract the last attribute
-							if (!ws) {
-								int index = atoi(line.c_str() + start);
-								face[vertexIx][attribIx] = index - 1;
-								// Advance to the next vertex, and reset the attrib index
-								LOG_ASSERT(vertexIx < 3, "Too many vertices OBJ face!");
-								vertexIx++;
-								attribIx = 0;
-							}
-							// Update the start index for attributes
-							start = ix + 1;
-							ws = true;
-						}
-					}
+				chunks[ix].Begin = chunkBegin;
+				chunks[ix].End = chunkEnd;
+				chunkBegin = chunkEnd;
+			}
 
-					// Once we have face index data, add it to our list to be processed
-					faces.push_back(face);
+			utils::ParallelFor((uint32_t)chunkCount, threadCount, [&](uint32_t chunkIx) {
+				ParseChunk(chunks[chunkIx]);
+			});
+
+			LOG_TRACE("\tLoaded data from {} chunks, merging", chunkCount);
+
+			// Figure out where each chunk's data goes in the combined lists
+			struct ChunkOffsets {
+				size_t Positions, TexUvs, Normals, Corners;
+			};
+			std::vector<ChunkOffsets> offsets(chunkCount);
+			ChunkOffsets total = ChunkOffsets();
+			for (size_t ix = 0; ix < chunkCount; ix++) {
+				offsets[ix] = total;
+				total.Positions += chunks[ix].Positions.size();
+				total.TexUvs    += chunks[ix].TexUvs.size();
+				total.Normals   += chunks[ix].Normals.size();
+				total.Corners   += chunks[ix].Corners.size();
+			}
+
+			LOG_ASSERT(total.Positions < OBJ_MISSING && total.TexUvs < OBJ_MISSING && total.Normals < OBJ_MISSING, "Too many attributes in OBJ file!");
+			LOG_ASSERT(total.Corners < OBJ_MISSING, "Too many faces in OBJ file!");
+
+			std::vector<glm::vec3> positions(total.Positions);
+			std::vector<glm::vec2> texUvs(total.TexUvs);
+			std::vector<glm::vec3> normals(total.Normals);
+			std::vector<VIndex>    corners(total.Corners);
+
+			utils::ParallelFor((uint32_t)chunkCount, threadCount, [&](uint32_t chunkIx) {
+				ObjChunk& chunk = chunks[chunkIx];
+				const ChunkOffsets& offset = offsets[chunkIx];
+				std::copy(chunk.Positions.begin(), chunk.Positions.end(), positions.begin() + offset.Positions);
+				std::copy(chunk.TexUvs.begin(), chunk.TexUvs.end(), texUvs.begin() + offset.TexUvs);
+				std::copy(chunk.Normals.begin(), chunk.Normals.end(), normals.begin() + offset.Normals);
+				std::copy(chunk.Corners.begin(), chunk.Corners.end(), corners.begin() + offset.Corners);
+
+				// Now that we know how many attributes came before this chunk, we can resolve its relative indices
+				const size_t attribOffsets[3] = { offset.Positions, offset.TexUvs, offset.Normals };
+				for (const RelativeIndex& relative : chunk.RelativeIndices) {
+					int64_t index = (int64_t)attribOffsets[relative.Attrib] + relative.Index;
+					(&corners[offset.Corners + relative.Corner].Pos)[relative.Attrib] = index >= 0 ? (uint32_t)index : OBJ_MISSING;
+				}
+
+				// Free up the chunk's memory as we go, large scans can have a lot of it
+				chunk = ObjChunk();
+			});
+
+			LOG_TRACE("\tMerged {} triangles, de-duplicating vertices", corners.size() / 3);
+
+			// De-duplicate our vertices with an open addressing hash table of vertex indices. Keeping the table at most half
+			// full keeps the probe chains short, and storing the vertex index rather than the key keeps the table small
+			size_t capacity = 16;
+			while (capacity < corners.size() * 2)
+				capacity <<= 1;
+			const size_t mask = capacity - 1;
+			std::vector<uint32_t> table(capacity, OBJ_EMPTY_SLOT);
+
+			std::vector<VIndex>   uniqueVertices;
+			// The first corner to use each vertex, so that vertices without normals can use that face's normal
+			std::vector<uint32_t> firstCorners;
+			std::vector<uint32_t> indices(corners.size());
+			uniqueVertices.reserve(std::min(corners.size(), total.Positions * 2));
+			firstCorners.reserve(uniqueVertices.capacity());
+
+			for (size_t cornerIx = 0; cornerIx < corners.size(); cornerIx++) {
+				const VIndex& corner = corners[cornerIx];
+				size_t slot = HashVertex(corner) & mask;
+				while (table[slot] != OBJ_EMPTY_SLOT && !(uniqueVertices[table[slot]] == corner))
+					slot = (slot + 1) & mask;
+
+				// If we did not find the vertex, we need to create a new one
+				if (table[slot] == OBJ_EMPTY_SLOT) {
+					table[slot] = (uint32_t)uniqueVertices.size();
+					uniqueVertices.push_back(corner);
+					firstCorners.push_back((uint32_t)cornerIx);
 				}
+				indices[cornerIx] = table[slot];
 			}
+			table = std::vector<uint32_t>();
 
-			LOG_TRACE("\tLoaded data, starting post-processing");
-
-			// Allocate a new array for our vertices
-			std::vector<Vertex> vertices;
-			std::vector<uint32_t> indices;
-
-			// Iterate over all the positions we've read
-			for (auto& face : faces) {
-				for (int jx = 0; jx < 3; jx++) {
-					auto& aSet = face[jx];
-					// We will use our mask to only select the lowest 21 bits of each index
-					uint64_t mask = 0b0'000000000000000000000'000000000000000000000'111111111111111111111;
-					uint64_t key = 0;
-
-					// We generate a key using our vertex's position, texture, and normal indices
-					key = ((aSet[0] & mask) << 42) | ((aSet[1] & mask) << 21) | (aSet[2] & mask);
-
-					// Search the cache for the key
-					auto it = vectorCache.find(key);
-
-					// If it exists, we push the index to our indices
-					if (it != vectorCache.end())
-						indices.push_back(it->second);
-					// Otherwise, we need to create a new vertex
-					else
-					{
-						// Load the vertex from the attributes
-						Vertex vertex;
-						vertex.Position =
-							aSet[0] != (uint32_t)-1 ?
-							positions[aSet[0]] :
-							glm::vec3(0);
-						vertex.Color = baseColor;
-						vertex.UV =
-							aSet[1] != (uint32_t)-1 ?
-							texUvs[aSet[1]] :
-							glm::vec2(0.0f);
-						vertex.Normal =
-							aSet[2] != (uint32_t)-1 ?
-							normals[aSet[2]] :
-							glm::triangleNormal(positions[face[0][0]], positions[face[1][0]], positions[face[2][0]]);
-						// Add the index of the new vertex to the cache
-						vectorCache[key] = vertices.size();
-						// Add the index of the new vertex to our indices
-						indices.push_back(vertices.size());
-						// Add the vertex to the buffer
-						vertices.push_back(vertex);
+			// Build the actual vertices from their attributes, any indices past the end of the lists are treated as missing
+			std::vector<Vertex> vertices(uniqueVertices.size());
+			uint32_t vertexJobs = (uint32_t)((vertices.size() + OBJ_VERTEX_JOB_SIZE - 1) / OBJ_VERTEX_JOB_SIZE);
+			utils::ParallelFor(vertexJobs, threadCount, [&](uint32_t job) {
+				size_t end = std::min(vertices.size(), (size_t)(job + 1) * OBJ_VERTEX_JOB_SIZE);
+				for (size_t ix = (size_t)job * OBJ_VERTEX_JOB_SIZE; ix < end; ix++) {
+					const VIndex& aSet = uniqueVertices[ix];
+					auto facePosition = [&](size_t corner) {
+						uint32_t pos = corners[corner].Pos;
+						return pos < positions.size() ? positions[pos] : glm::vec3(0.0f);
+					};
 
+					Vertex& vertex = vertices[ix];
+					vertex.Position = aSet.Pos < positions.size() ? positions[aSet.Pos] : glm::vec3(0.0f);
+					vertex.Color = baseColor;
+					vertex.UV = aSet.Tex < texUvs.size() ? texUvs[aSet.Tex] : glm::vec2(0.0f);
+					if (aSet.Norm < normals.size()) {
+						vertex.Normal = normals[aSet.Norm];
+					} else {
+						size_t triangle = firstCorners[ix] / 3 * 3;
+						vertex.Normal = glm::triangleNormal(facePosition(triangle), facePosition(triangle + 1), facePosition(triangle + 2));
 					}
 				}
+			});
+
+			// If the file has no normals at all, we give it smooth ones rather than faceting it
+			if (normals.empty()) {
+				LOG_TRACE("\tComputing smooth normals...");
+				MeshProcessor::ComputeNormals(vertices, indices.data(), indices.size());
 			}
 
 			// Compute our TBN matrices for normal mapping
@@ -215,9 +350,114 @@ namespace florp {
 
 			// Create and return a result as a meshBuilder mesh data object
 			auto result = MeshBuilder::Begin();
-			result.Vertices = vertices;
-			result.Indices = indices;
+			result.Vertices = std::move(vertices);
+			result.Indices = std::move(indices);
 			result.DebugName = filename;
+
+			// OBJs come out in the order they were modelled in, which is rarely good for the GPU. This is the slowest part
+			// of loading an OBJ, but it only happens when the mesh file is out of date
+			LOG_TRACE("\tOptimizing triangle and vertex order...");
+			MeshOptimizer::Optimize(result);
+			return result;
+		}
+
+		// Hashes the contents of an OBJ, along with everything else that affects the mesh we generate from it
+		static uint64_t HashSource(const utils::MappedFile& file, const glm::vec4& baseColor) {
+			// Each block is hashed on its own so that we can spread the work across threads, then we combine them in order
+			size_t blockCount = (file.GetSize() + OBJ_HASH_BLOCK_SIZE - 1) / OBJ_HASH_BLOCK_SIZE;
+			std::vector<uint64_t> blockHashes(blockCount);
+			utils::ParallelFor((uint32_t)blockCount, 0, [&](uint32_t block) {
+				const char* begin = file.GetData() + (size_t)block * OBJ_HASH_BLOCK_SIZE;
+				size_t size = std::min<size_t>(OBJ_HASH_BLOCK_SIZE, file.GetSize() - (size_t)block * OBJ_HASH_BLOCK_SIZE);
+				uint64_t hash = 0xCBF29CE484222325ull ^ size;
+				size_t ix = 0;
+				for (; ix + sizeof(uint64_t) <= size; ix += sizeof(uint64_t)) {
+					uint64_t word;
+					memcpy(&word, begin + ix, sizeof(uint64_t));
+					hash = (hash ^ word) * 0x100000001B3ull;
+					hash ^= hash >> 29;
+				}
+				for (; ix < size; ix++)
+					hash = (hash ^ (uint8_t)begin[ix]) * 0x100000001B3ull;
+				blockHashes[block] = hash;
+			});
+
+			uint64_t result = OBJ_CACHE_VERSION;
+			auto combine = [&](uint64_t value) {
+				result = MixHash(result ^ (value + 0x9E3779B97F4A7C15ull + (result << 6) + (result >> 2)));
+			};
+			for (uint64_t hash : blockHashes)
+				combine(hash);
+			for (int ix = 0; ix < 4; ix++) {
+				uint32_t bits;
+				memcpy(&bits, &baseColor[ix], sizeof(uint32_t));
+				combine(bits);
+			}
+			combine(file.GetSize());
+			return result;
+		}
+
+		/*
+		 * Makes sure that the mesh file next to an OBJ is up to date, re-parsing the OBJ and re-writing the mesh file if it's not
+		 * @param filename The path to the OBJ file
+		 * @param baseColor The color to give all of the vertices
+		 * @param parsed Receives the parsed mesh, if we had to parse the OBJ
+		 * @param wasParsed Set to true if we had to parse the OBJ
+		 * @returns The up to date mesh file, or nullptr if we could not write one
+		 */
+		static MeshFile::Sptr OpenCache(const char* filename, glm::vec4 baseColor, MeshData& parsed, bool& wasParsed) {
+			utils::MappedFile source(filename);
+
+			// If our file fails to open, we will throw an error
+			if (!source.IsOpen()) {
+				throw std::runtime_error("Failed to open file");
+			}
+
+			uint64_t hash = HashSource(source, baseColor);
+			std::string cachePath = std::string(filename) + OBJ_CACHE_EXTENSION;
+			{
+				MeshFile::Sptr cache = std::make_shared<MeshFile>(cachePath);
+				if (cache->IsValid() && cache->GetSourceHash() == hash) {
+					LOG_TRACE("Loading mesh from '{}'", cachePath);
+					wasParsed = false;
+					return cache;
+				}
+				// The out of date file is unmapped when we leave this scope, so that we can replace it
+			}
+
+			parsed = ParseObj(source, filename, baseColor);
+			wasParsed = true;
+			if (!MeshFile::Save(cachePath, parsed, hash)) {
+				LOG_WARN("Failed to write mesh file '{}', the OBJ will be parsed again next time", cachePath);
+				return nullptr;
+			}
+			MeshFile::Sptr result = std::make_shared<MeshFile>(cachePath);
+			return result->IsValid() ? result : nullptr;
+		}
+
+		MeshData ObjLoader::LoadObj(const char* filename, glm::vec4 baseColor) {
+			MeshData parsed;
+			bool wasParsed;
+			MeshFile::Sptr cache = OpenCache(filename, baseColor, parsed, wasParsed);
+			return wasParsed ? parsed : cache->ToMeshData(filename);
+		}
+
+		Mesh::Sptr ObjLoader::LoadMesh(const char* filename, glm::vec4 baseColor, VertexFormat format) {
+			MeshData parsed;
+			bool wasParsed;
+			MeshFile::Sptr cache = OpenCache(filename, baseColor, parsed, wasParsed);
+
+			// The mesh file already has our TBNs, so we can skip MeshBuilder::Bake and upload straight from the mapped file.
+			// The file keeps the full vertices (so that LoadObj can use it too), so packed formats are packed as we upload
+			Mesh::Sptr result;
+			if (cache == nullptr)
+				result = MeshBuilder::Upload(parsed.Vertices.data(), parsed.Vertices.size(), parsed.Indices.data(), parsed.Indices.size(), format);
+			else if (format == VertexFormat::Full)
+				result = cache->Upload();
+			else
+				result = MeshBuilder::Upload(reinterpret_cast<const Vertex*>(cache->GetVertexData()), cache->GetVertexCount(),
+					cache->GetIndexData(), cache->GetIndexCount(), format);
+			result->Name = filename;
 			return result;
 		}
 
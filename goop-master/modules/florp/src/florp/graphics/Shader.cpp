@@ -16,6 +16,7 @@ namespace florp
 				case ShaderStageType::TessControl: return GL_TESS_CONTROL_SHADER;
 				case ShaderStageType::TessEval: return GL_TESS_EVALUATION_SHADER;
 				case ShaderStageType::Geometry: return GL_GEOMETRY_SHADER;
+				case ShaderStageType::Compute: return GL_COMPUTE_SHADER;
 				default: LOG_ASSERT(false, "Invalid shader type"); return GL_NONE;
 			}
 		}
@@ -23,7 +24,7 @@ namespace florp
 
 		Shader::Shader() {
 			myRendererID = glCreateProgram();
-			for(int ix = 0; ix < 5; ix++) myStages[ix] = 0;
+			for(int ix = 0; ix < 6; ix++) myStages[ix] = 0;
 			isLinked = false;
 		}
 
@@ -92,7 +93,7 @@ namespace florp
 			glLinkProgram(myRendererID);
 
 			// Remove shader parts to save space
-			for(int ix = 0; ix < 5; ix++) {
+			for(int ix = 0; ix < 6; ix++) {
 				if (myStages[ix] != 0) {
 					glDetachShader(myRendererID, myStages[ix]);
 					glDeleteShader(myStages[ix]);
@@ -228,6 +229,11 @@ namespace florp
 			glUseProgram(myRendererID);
 		}
 
+		void Shader::Dispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) const {
+			Use();
+			glDispatchCompute(groupsX, groupsY, groupsZ);
+		}
+
 		bool Shader::__CheckCompileStatus(uint32_t shaderHandle) {
 			// Check our compile status
 			GLint compileStatus = 0;
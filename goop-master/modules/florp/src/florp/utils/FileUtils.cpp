@@ -2,6 +2,18 @@
 #include <fstream>
 #include "Logging.h"
 
+#ifdef WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace florp {
 	namespace utils {
 
@@ -72,6 +84,69 @@ namespace florp {
 				return nullptr;
 			}
 		}
+
+		MappedFile::MappedFile(const char* filename) :
+			myData(nullptr),
+			mySize(0),
+			isOpen(false),
+			myFileHandle(nullptr),
+			myMappingHandle(nullptr)
+		{
+			#ifdef WINDOWS
+			HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+				return;
+			myFileHandle = file;
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size))
+				return;
+			mySize = (size_t)size.QuadPart;
+			isOpen = true;
+			// Windows can't map an empty file, but there's nothing to read anyways
+			if (mySize == 0)
+				return;
+
+			myMappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (myMappingHandle != nullptr)
+				myData = reinterpret_cast<const char*>(MapViewOfFile(myMappingHandle, FILE_MAP_READ, 0, 0, 0));
+			#else
+			int file = open(filename, O_RDONLY);
+			if (file < 0)
+				return;
+
+			struct stat info;
+			if (fstat(file, &info) == 0) {
+				mySize = (size_t)info.st_size;
+				isOpen = true;
+				if (mySize > 0) {
+					void* data = mmap(nullptr, mySize, PROT_READ, MAP_PRIVATE, file, 0);
+					myData = data != MAP_FAILED ? reinterpret_cast<const char*>(data) : nullptr;
+				}
+			}
+			// The mapping keeps its own reference to the file
+			close(file);
+			#endif
+
+			if (mySize > 0 && myData == nullptr) {
+				LOG_WARN("Failed to map file \"{}\" into memory", filename);
+				isOpen = false;
+			}
+		}
+
+		MappedFile::~MappedFile() {
+			#ifdef WINDOWS
+			if (myData != nullptr)
+				UnmapViewOfFile(myData);
+			if (myMappingHandle != nullptr)
+				CloseHandle(myMappingHandle);
+			if (myFileHandle != nullptr)
+				CloseHandle(myFileHandle);
+			#else
+			if (myData != nullptr)
+				munmap(const_cast<char*>(myData), mySize);
+			#endif
+		}
 		
 	}
 }
@@ -0,0 +1,34 @@
+#include "florp/utils/Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace florp {
+	namespace utils {
+
+		void ParallelFor(uint32_t count, uint32_t threadCount, const std::function<void(uint32_t)>& func) {
+			if (threadCount == 0)
+				threadCount = GetDefaultThreadCount();
+			// There's no point spinning up more threads than we have jobs
+			threadCount = std::min(threadCount, count);
+
+			std::atomic<uint32_t> next(0);
+			auto worker = [&]() {
+				for (uint32_t job = next++; job < count; job = next++)
+					func(job);
+			};
+			std::vector<std::thread> threads;
+			for (uint32_t ix = 1; ix < threadCount; ix++)
+				threads.emplace_back(worker);
+			// The calling thread does work as well
+			worker();
+			for (auto& thread : threads)
+				thread.join();
+		}
+
+		uint32_t GetDefaultThreadCount() {
+			return std::max(std::thread::hardware_concurrency(), 1u);
+		}
+	}
+}
@@ -0,0 +1,230 @@
+#include "florp/utils/TlsfAllocator.h"
+#include "Logging.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace florp {
+	namespace utils {
+
+		// Marks the end of a list of blocks
+		#define TLSF_NO_BLOCK TlsfAllocator::InvalidHandle
+
+		// Gets the index of the highest set bit in a non-zero value
+		inline uint32_t HighestBit(uint32_t value) {
+			#ifdef _MSC_VER
+			unsigned long result;
+			_BitScanReverse(&result, value);
+			return result;
+			#else
+			return 31 - __builtin_clz(value);
+			#endif
+		}
+
+		// Gets the index of the lowest set bit in a non-zero value
+		inline uint32_t LowestBit(uint32_t value) {
+			#ifdef _MSC_VER
+			unsigned long result;
+			_BitScanForward(&result, value);
+			return result;
+			#else
+			return __builtin_ctz(value);
+			#endif
+		}
+
+		/*
+		 * Finds the free list that a block of the given size belongs in. Sizes below the second level count get a list each,
+		 * larger sizes are split by their highest bit, and then by the next TLSF_SECOND_LEVEL_LOG2 bits
+		 */
+		inline void MapSize(uint32_t size, uint32_t& firstLevel, uint32_t& secondLevel) {
+			if (size < TLSF_SECOND_LEVEL_COUNT) {
+				firstLevel = 0;
+				secondLevel = size;
+			} else {
+				uint32_t highBit = HighestBit(size);
+				firstLevel = highBit - TLSF_SECOND_LEVEL_LOG2 + 1;
+				secondLevel = (size >> (highBit - TLSF_SECOND_LEVEL_LOG2)) & (TLSF_SECOND_LEVEL_COUNT - 1);
+			}
+		}
+
+		TlsfAllocator::TlsfAllocator(uint32_t capacity) :
+			myLastBlock(TLSF_NO_BLOCK),
+			myFirstLevelBitmap(0),
+			myCapacity(0),
+			myUsed(0)
+		{
+			for (uint32_t fl = 0; fl < TLSF_FIRST_LEVEL_COUNT; fl++) {
+				mySecondLevelBitmaps[fl] = 0;
+				for (uint32_t sl = 0; sl < TLSF_SECOND_LEVEL_COUNT; sl++)
+					myFreeLists[fl][sl] = TLSF_NO_BLOCK;
+			}
+			if (capacity > 0)
+				Grow(capacity);
+		}
+
+		TlsfAllocator::Handle TlsfAllocator::Allocate(uint32_t size, uint32_t& outOffset) {
+			LOG_ASSERT(size > 0, "Cannot allocate an empty range!");
+
+			// Round the size up to the next list boundary, so that any block in the list we find is large enough
+			uint32_t searchSize = size;
+			if (size >= TLSF_SECOND_LEVEL_COUNT) {
+				uint32_t round = (1u << (HighestBit(size) - TLSF_SECOND_LEVEL_LOG2)) - 1;
+				if (size > 0xFFFFFFFFu - round)
+					return InvalidHandle;
+				searchSize += round;
+			}
+			uint32_t firstLevel, secondLevel;
+			MapSize(searchSize, firstLevel, secondLevel);
+
+			// Find the first non-empty list at or above that one
+			uint32_t block = TLSF_NO_BLOCK;
+			uint32_t secondLevelMap = mySecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+			uint32_t firstLevelMap = firstLevel + 1 < 32 ? myFirstLevelBitmap & (~0u << (firstLevel + 1)) : 0;
+			if (secondLevelMap != 0)
+				block = myFreeLists[firstLevel][LowestBit(secondLevelMap)];
+			else if (firstLevelMap != 0) {
+				firstLevel = LowestBit(firstLevelMap);
+				block = myFreeLists[firstLevel][LowestBit(mySecondLevelBitmaps[firstLevel])];
+			} else {
+				// Nothing is guaranteed to fit, but the list that our exact size falls in may still have a large enough block
+				// (this matters when we are almost out of space, such as allocating the whole range at once)
+				MapSize(size, firstLevel, secondLevel);
+				for (block = myFreeLists[firstLevel][secondLevel]; block != TLSF_NO_BLOCK; block = myBlocks[block].NextFree) {
+					if (myBlocks[block].Size >= size)
+						break;
+				}
+				if (block == TLSF_NO_BLOCK)
+					return InvalidHandle;
+			}
+
+			__RemoveFree(block);
+
+			// Give whatever we don't need back to the free lists
+			if (myBlocks[block].Size > size) {
+				uint32_t remainder = __CreateBlock(myBlocks[block].Offset + size, myBlocks[block].Size - size);
+				myBlocks[block].Size = size;
+				myBlocks[remainder].PrevPhysical = block;
+				myBlocks[remainder].NextPhysical = myBlocks[block].NextPhysical;
+				if (myBlocks[block].NextPhysical != TLSF_NO_BLOCK)
+					myBlocks[myBlocks[block].NextPhysical].PrevPhysical = remainder;
+				else
+					myLastBlock = remainder;
+				myBlocks[block].NextPhysical = remainder;
+				__InsertFree(remainder);
+			}
+
+			myBlocks[block].IsFree = false;
+			myUsed += size;
+			outOffset = myBlocks[block].Offset;
+			return block;
+		}
+
+		void TlsfAllocator::Free(Handle handle) {
+			LOG_ASSERT(handle < myBlocks.size() && !myBlocks[handle].IsFree, "Freeing a range that is not allocated!");
+			uint32_t block = handle;
+			myUsed -= myBlocks[block].Size;
+
+			// Merge with the block before us if it is free
+			uint32_t prev = myBlocks[block].PrevPhysical;
+			if (prev != TLSF_NO_BLOCK && myBlocks[prev].IsFree) {
+				__RemoveFree(prev);
+				myBlocks[prev].Size += myBlocks[block].Size;
+				myBlocks[prev].NextPhysical = myBlocks[block].NextPhysical;
+				if (myBlocks[block].NextPhysical != TLSF_NO_BLOCK)
+					myBlocks[myBlocks[block].NextPhysical].PrevPhysical = prev;
+				else
+					myLastBlock = prev;
+				__ReleaseBlock(block);
+				block = prev;
+			}
+
+			// And with the block after us
+			uint32_t next = myBlocks[block].NextPhysical;
+			if (next != TLSF_NO_BLOCK && myBlocks[next].IsFree) {
+				__RemoveFree(next);
+				myBlocks[block].Size += myBlocks[next].Size;
+				myBlocks[block].NextPhysical = myBlocks[next].NextPhysical;
+				if (myBlocks[next].NextPhysical != TLSF_NO_BLOCK)
+					myBlocks[myBlocks[next].NextPhysical].PrevPhysical = block;
+				else
+					myLastBlock = block;
+				__ReleaseBlock(next);
+			}
+
+			__InsertFree(block);
+		}
+
+		void TlsfAllocator::Grow(uint32_t size) {
+			if (size == 0)
+				return;
+			// If the end of the range is free we can just make it larger, otherwise we need a new block for it
+			if (myLastBlock != TLSF_NO_BLOCK && myBlocks[myLastBlock].IsFree) {
+				__RemoveFree(myLastBlock);
+				myBlocks[myLastBlock].Size += size;
+				__InsertFree(myLastBlock);
+			} else {
+				uint32_t block = __CreateBlock(myCapacity, size);
+				myBlocks[block].PrevPhysical = myLastBlock;
+				if (myLastBlock != TLSF_NO_BLOCK)
+					myBlocks[myLastBlock].NextPhysical = block;
+				myLastBlock = block;
+				__InsertFree(block);
+			}
+			myCapacity += size;
+		}
+
+		uint32_t TlsfAllocator::__CreateBlock(uint32_t offset, uint32_t size) {
+			uint32_t result;
+			if (!myUnusedBlocks.empty()) {
+				result = myUnusedBlocks.back();
+				myUnusedBlocks.pop_back();
+			} else {
+				result = (uint32_t)myBlocks.size();
+				myBlocks.emplace_back();
+			}
+			myBlocks[result] = { offset, size, TLSF_NO_BLOCK, TLSF_NO_BLOCK, TLSF_NO_BLOCK, TLSF_NO_BLOCK, false };
+			return result;
+		}
+
+		void TlsfAllocator::__ReleaseBlock(uint32_t block) {
+			myBlocks[block].IsFree = false;
+			myUnusedBlocks.push_back(block);
+		}
+
+		void TlsfAllocator::__InsertFree(uint32_t block) {
+			uint32_t firstLevel, secondLevel;
+			MapSize(myBlocks[block].Size, firstLevel, secondLevel);
+			uint32_t head = myFreeLists[firstLevel][secondLevel];
+			myBlocks[block].IsFree = true;
+			myBlocks[block].PrevFree = TLSF_NO_BLOCK;
+			myBlocks[block].NextFree = head;
+			if (head != TLSF_NO_BLOCK)
+				myBlocks[head].PrevFree = block;
+			myFreeLists[firstLevel][secondLevel] = block;
+			myFirstLevelBitmap |= 1u << firstLevel;
+			mySecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+		}
+
+		void TlsfAllocator::__RemoveFree(uint32_t block) {
+			uint32_t firstLevel, secondLevel;
+			MapSize(myBlocks[block].Size, firstLevel, secondLevel);
+			uint32_t prev = myBlocks[block].PrevFree;
+			uint32_t next = myBlocks[block].NextFree;
+			if (prev != TLSF_NO_BLOCK)
+				myBlocks[prev].NextFree = next;
+			else
+				myFreeLists[firstLevel][secondLevel] = next;
+			if (next != TLSF_NO_BLOCK)
+				myBlocks[next].PrevFree = prev;
+			myBlocks[block].IsFree = false;
+
+			// Clear the bitmaps if that was the last block in the list
+			if (myFreeLists[firstLevel][secondLevel] == TLSF_NO_BLOCK) {
+				mySecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+				if (mySecondLevelBitmaps[firstLevel] == 0)
+					myFirstLevelBitmap &= ~(1u << firstLevel);
+			}
+		}
+
+	}
+}
@@ -7,7 +7,8 @@ layout(location = 2) in vec3 inWorldPos;
 layout(location = 3) in vec2 inUV;
 
 layout(location = 0) out vec4 outColor;
-layout(location = 1) out vec3 outNormal;
+layout(location = 1) out vec2 outNormal;
+layout(location = 3) out vec2 outMaterial;
 
 uniform sampler2D s_Albedo;
 
@@ -15,7 +16,18 @@ uniform vec3  a_CameraPos;
 
 uniform vec3  a_AmbientColor;
 uniform float a_AmbientPower;
-uniform float a_MatShininess;
+uniform float a_MatShininess = 1.0;
+uniform float a_MatSpecular = 1.0;
+
+// Shininess is stored in the G-Buffer as log2, so that 8 bits can cover 1 to 2048
+const float MAX_SHININESS_LOG = 11.0;
+
+// Packs a unit normal into the [0,1] range using an octahedral mapping, so it only needs 2 channels
+vec2 PackNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 result = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return result * 0.5 + 0.5;
+}
 
 const int MAX_LIGHTS = 16;
 struct Light{
@@ -80,5 +92,6 @@ void main() {
 
 	// Write the output
 	outColor = vec4(result, inColor.a);
-	outNormal = (norm / 2) + vec3(0.5);
+	outNormal = PackNormal(norm);
+	outMaterial = vec2(log2(max(a_MatShininess, 1.0)) / MAX_SHININESS_LOG, a_MatSpecular);
 }
\ No newline at end of file
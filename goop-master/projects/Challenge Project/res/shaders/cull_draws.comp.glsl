@@ -0,0 +1,71 @@
+#version 460
+// Culls every opaque draw in the scene against the camera's frustum, and writes an indirect draw command for each one
+// that survives. Draws are split into groups that share a material and mesh arena, and each group has its own range of
+// commands and a count that glMultiDrawElementsIndirectCount reads, so the culled draws are packed together
+
+layout (local_size_x = 64) in;
+
+// These match the structs in IndirectRenderer.h
+struct ObjectData {
+	mat4 Model;
+	mat4 NormalMatrix;
+};
+struct DrawData {
+	vec4 BoundingSphere; // In the mesh's local space
+	uint IndexCount;
+	uint FirstIndex;
+	int  BaseVertex;
+	uint Group;
+};
+// This is the layout of DrawElementsIndirectCommand
+struct DrawCommand {
+	uint Count;
+	uint InstanceCount;
+	uint FirstIndex;
+	int  BaseVertex;
+	uint BaseInstance;
+};
+
+layout (std430, binding = 2) readonly buffer b_Objects {
+	ObjectData Objects[];
+};
+layout (std430, binding = 3) readonly buffer b_Draws {
+	DrawData Draws[];
+};
+// The first command for each group
+layout (std430, binding = 4) readonly buffer b_GroupOffsets {
+	uint GroupOffsets[];
+};
+// The number of commands written for each group, this must be zeroed before we run
+layout (std430, binding = 5) buffer b_GroupCounts {
+	uint GroupCounts[];
+};
+layout (std430, binding = 6) writeonly buffer b_Commands {
+	DrawCommand Commands[];
+};
+
+uniform int  a_DrawCount;
+// The planes of the camera's frustum in world space, with the normals pointing inwards
+uniform vec4 a_FrustumPlanes[6];
+
+void main() {
+	uint ix = gl_GlobalInvocationID.x;
+	if (ix >= uint(a_DrawCount))
+		return;
+
+	// Move the bounding sphere into world space, scaling it by the largest scale of the model matrix
+	DrawData draw = Draws[ix];
+	mat4 model = Objects[ix].Model;
+	vec3 center = (model * vec4(draw.BoundingSphere.xyz, 1.0)).xyz;
+	float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+	float radius = draw.BoundingSphere.w * scale;
+
+	for (int plane = 0; plane < 6; plane++) {
+		if (dot(a_FrustumPlanes[plane].xyz, center) + a_FrustumPlanes[plane].w < -radius)
+			return;
+	}
+
+	// The object's index goes in the base instance, so the vertex shader can find its matrices
+	uint slot = GroupOffsets[draw.Group] + atomicAdd(GroupCounts[draw.Group], 1);
+	Commands[slot] = DrawCommand(draw.IndexCount, 1u, draw.FirstIndex, draw.BaseVertex, ix);
+}
@@ -0,0 +1,99 @@
+#version 460
+// Culls the meshlets of a single object against the camera's frustum, and against the camera's position with their normal
+// cones so that clusters that only have back facing triangles are skipped. The triangles of the meshlets that survive are
+// copied into an index buffer, and counted up in the object's indirect draw command. Each work group handles one meshlet,
+// with one invocation per triangle
+
+// This must be at least the largest number of triangles in a meshlet, see MESHLET_TRIANGLE_LIMIT in MeshBuilder.cpp
+layout (local_size_x = 128) in;
+
+// These match the structs in IndirectRenderer.h and florp/graphics/Meshlet.h
+struct ObjectData {
+	mat4 Model;
+	mat4 NormalMatrix;
+};
+struct Meshlet {
+	vec4 BoundingSphere; // In the mesh's local space
+	vec4 Cone;           // The axis in xyz, and the sine of the angle in w
+	uint FirstIndex;
+	uint TriangleCount;
+	uint VertexCount;
+	uint Reserved;
+};
+// This is the layout of DrawElementsIndirectCommand
+struct DrawCommand {
+	uint Count;
+	uint InstanceCount;
+	uint FirstIndex;
+	int  BaseVertex;
+	uint BaseInstance;
+};
+
+layout (std430, binding = 2) readonly buffer b_Objects {
+	ObjectData Objects[];
+};
+layout (std430, binding = 7) readonly buffer b_Meshlets {
+	Meshlet Meshlets[];
+};
+layout (std430, binding = 8) readonly buffer b_MeshletIndices {
+	uint MeshletIndices[];
+};
+layout (std430, binding = 9) writeonly buffer b_OutputIndices {
+	uint OutputIndices[];
+};
+// The Count of each command must be zeroed before we run
+layout (std430, binding = 10) buffer b_MeshletCommands {
+	DrawCommand Commands[];
+};
+
+// The object that we are culling the meshlets of, and the command that draws it
+uniform int  a_Object;
+uniform int  a_Command;
+// Where the object's range of the output index buffer starts
+uniform int  a_OutputOffset;
+// The planes of the camera's frustum in world space, with the normals pointing inwards
+uniform vec4 a_FrustumPlanes[6];
+uniform vec3 a_CameraPosition;
+
+shared bool isVisible;
+shared uint outputIndex;
+
+void main() {
+	Meshlet meshlet = Meshlets[gl_WorkGroupID.x];
+
+	// The first invocation decides if the meshlet is visible, and reserves room for its triangles
+	if (gl_LocalInvocationIndex == 0) {
+		mat4 model = Objects[a_Object].Model;
+		vec3 center = (model * vec4(meshlet.BoundingSphere.xyz, 1.0)).xyz;
+		float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+		float radius = meshlet.BoundingSphere.w * scale;
+
+		bool visible = true;
+		for (int plane = 0; plane < 6; plane++)
+			visible = visible && dot(a_FrustumPlanes[plane].xyz, center) + a_FrustumPlanes[plane].w >= -radius;
+
+		// If the camera is behind every triangle's plane, the whole meshlet is back facing. This is conservative, since
+		// we test from the sphere rather than from the cone's apex. Meshes that draw their back faces have their cones
+		// disabled (w = 1) on the CPU, see StaticBatcher::Build
+		if (visible && meshlet.Cone.w < 1.0) {
+			vec3 axis = normalize(mat3(Objects[a_Object].NormalMatrix) * meshlet.Cone.xyz);
+			vec3 toCenter = center - a_CameraPosition;
+			visible = dot(toCenter, axis) < meshlet.Cone.w * length(toCenter) + radius;
+		}
+
+		isVisible = visible;
+		if (visible)
+			outputIndex = uint(a_OutputOffset) + atomicAdd(Commands[a_Command].Count, meshlet.TriangleCount * 3u);
+	}
+	barrier();
+
+	uint triangle = gl_LocalInvocationIndex;
+	if (!isVisible || triangle >= meshlet.TriangleCount)
+		return;
+
+	uint source = meshlet.FirstIndex + triangle * 3u;
+	uint target = outputIndex + triangle * 3u;
+	OutputIndices[target + 0] = MeshletIndices[source + 0];
+	OutputIndices[target + 1] = MeshletIndices[source + 1];
+	OutputIndices[target + 2] = MeshletIndices[source + 2];
+}
@@ -0,0 +1,18 @@
+#version 440
+// Resolves a multisampled depth buffer by taking the closest or furthest of each pixel's samples
+
+uniform sampler2DMS s_Depth;
+
+// Matches DepthResolveMode, 1 is the minimum and 2 is the maximum
+uniform int a_Mode;
+uniform int a_NumSamples;
+
+void main() {
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float result = texelFetch(s_Depth, texel, 0).r;
+	for (int ix = 1; ix < a_NumSamples; ix++) {
+		float value = texelFetch(s_Depth, texel, ix).r;
+		result = a_Mode == 1 ? min(result, value) : max(result, value);
+	}
+	gl_FragDepth = result;
+}
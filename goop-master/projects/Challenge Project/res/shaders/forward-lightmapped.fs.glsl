@@ -0,0 +1,42 @@
+#version 410
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec3 inNormal;
+layout(location = 3) in vec2 inUV;
+layout(location = 4) in vec2 inLightmapUV;
+
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec2 outNormal;
+layout(location = 2) out vec3 outEmissive;
+layout(location = 3) out vec2 outMaterial;
+
+uniform sampler2D s_Albedo;
+// The baked irradiance for this surface, in the same units as the light accumulation buffer
+uniform sampler2D s_Lightmap;
+
+// The material properties, these are written to the G-Buffer for the lighting passes
+uniform float a_MatShininess = 1.0;
+uniform float a_MatSpecular = 1.0;
+
+// Shininess is stored in the G-Buffer as log2, so that 8 bits can cover 1 to 2048
+const float MAX_SHININESS_LOG = 11.0;
+
+// Packs a unit normal into the [0,1] range using an octahedral mapping, so it only needs 2 channels
+vec2 PackNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 result = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return result * 0.5 + 0.5;
+}
+
+void main() {
+	// Write the output
+	outAlbedo = vec4(texture(s_Albedo, inUV).rgb * inColor.rgb, inColor.a);
+
+	// Our baked lighting goes into the emissive buffer, which the composite adds to the light accumulation
+	outEmissive = texture(s_Lightmap, inLightmapUV).rgb;
+
+	// Re-normalize our input, so that it is always length 1
+	vec3 norm = normalize(inNormal);
+	outNormal = PackNormal(norm);
+	outMaterial = vec2(log2(max(a_MatShininess, 1.0)) / MAX_SHININESS_LOG, a_MatSpecular);
+}
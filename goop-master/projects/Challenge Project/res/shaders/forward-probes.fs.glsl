@@ -0,0 +1,82 @@
+#version 430
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inWorldPos;
+layout(location = 3) in vec2 inUV;
+layout(location = 5) in vec3 inWorldNormal;
+
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec2 outNormal;
+layout(location = 2) out vec3 outEmissive;
+layout(location = 3) out vec2 outMaterial;
+
+uniform sampler2D s_Albedo;
+uniform sampler2D s_Emissive;
+
+uniform float a_EmissiveStrength;
+
+// The material properties, these are written to the G-Buffer for the lighting passes
+uniform float a_MatShininess = 1.0;
+uniform float a_MatSpecular = 1.0;
+
+// Shininess is stored in the G-Buffer as log2, so that 8 bits can cover 1 to 2048
+const float MAX_SHININESS_LOG = 11.0;
+
+// Packs a unit normal into the [0,1] range using an octahedral mapping, so it only needs 2 channels
+vec2 PackNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 result = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return result * 0.5 + 0.5;
+}
+
+// The baked light probe grid, bound by the LightingLayer. Every probe has 3 coefficients (one per color channel),
+// storing cosine-convolved L1 spherical harmonics as (constant, linear.xyz)
+layout(std430, binding = 0) readonly buffer b_LightProbes {
+	vec4  ProbeMin;
+	vec4  ProbeMax;
+	ivec4 ProbeCount;
+	vec4  ProbeCoefficients[];
+};
+
+// Evaluates the irradiance of a single probe for the given world space normal
+vec3 EvaluateProbe(ivec3 cell, vec3 normal) {
+	int ix = (cell.z * ProbeCount.y + cell.y) * ProbeCount.x + cell.x;
+	vec4 n = vec4(1.0, normal);
+	return max(vec3(
+		dot(ProbeCoefficients[ix * 3 + 0], n),
+		dot(ProbeCoefficients[ix * 3 + 1], n),
+		dot(ProbeCoefficients[ix * 3 + 2], n)), vec3(0.0));
+}
+
+// Trilinearly blends the 8 probes surrounding a world position
+vec3 SampleProbes(vec3 worldPos, vec3 normal) {
+	if (ProbeCount.x * ProbeCount.y * ProbeCount.z == 0)
+		return vec3(0.0);
+
+	vec3 cellPos = clamp((worldPos - ProbeMin.xyz) / max(ProbeMax.xyz - ProbeMin.xyz, vec3(0.0001)), 0.0, 1.0) * vec3(max(ProbeCount.xyz - 1, 0));
+	ivec3 base = min(ivec3(cellPos), max(ProbeCount.xyz - 2, 0));
+	vec3 t = clamp(cellPos - vec3(base), 0.0, 1.0);
+
+	vec3 result = vec3(0.0);
+	for (int corner = 0; corner < 8; corner++) {
+		ivec3 offset = ivec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+		vec3 weights = mix(1.0 - t, t, vec3(offset));
+		ivec3 cell = min(base + offset, ProbeCount.xyz - 1);
+		result += EvaluateProbe(cell, normal) * weights.x * weights.y * weights.z;
+	}
+	return result;
+}
+
+void main() {
+	// Write the output
+	outAlbedo = vec4(texture(s_Albedo, inUV).rgb * inColor.rgb, inColor.a);
+
+	// Our baked lighting goes into the emissive buffer along with the material's emissive light, since the composite adds it to the light accumulation
+	outEmissive = texture(s_Emissive, inUV).rgb * a_EmissiveStrength + SampleProbes(inWorldPos, normalize(inWorldNormal));
+
+	// Re-normalize our input, so that it is always length 1
+	vec3 norm = normalize(inNormal);
+	outNormal = PackNormal(norm);
+	outMaterial = vec2(log2(max(a_MatShininess, 1.0)) / MAX_SHININESS_LOG, a_MatSpecular);
+}
@@ -0,0 +1,8 @@
+#version 440
+// Generates a single triangle that covers the whole screen from the vertex index, so that it can be drawn without
+// any vertex buffers (see FrameBuffer::Resolve)
+
+void main() {
+	vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
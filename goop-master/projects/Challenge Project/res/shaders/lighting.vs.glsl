@@ -1,27 +1,54 @@
-#version 410
+#version 460
 
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec4 inColor;
-layout (location = 2) in vec3 inNormal;
+layout (location = 2) in vec2 inNormal; // Octahedral encoded, see VertexFormat::Packed
 layout (location = 5) in vec2 inUV;
+layout (location = 6) in vec2 inLightmapUV;
 
 layout (location = 0) out vec4 outColor;
 layout (location = 1) out vec3 outNormal;
 layout (location = 2) out vec3 outWorldPos;
 layout (location = 3) out vec2 outUV;
+layout (location = 4) out vec2 outLightmapUV;
+layout (location = 5) out vec3 outWorldNormal;
 
-uniform mat4 a_ModelViewProjection;
-uniform mat4 a_Model;
+// Per-object data, which we look up with the draw's base instance (see IndirectRenderer)
+struct ObjectData {
+	mat4 Model;
+	// The inverse transpose of the model matrix
+	mat4 NormalMatrix;
+};
+layout (std430, binding = 2) readonly buffer b_Objects {
+	ObjectData Objects[];
+};
+
+uniform mat4 a_ViewProjection;
 uniform mat4 a_View;
-uniform mat3 a_NormalMatrix;
+
+// Unpacks an octahedral encoded normal from the [-1,1] range back into a unit vector
+vec3 UnpackNormal(vec2 f) {
+	vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
 
 void main() {
+	ObjectData object = Objects[gl_BaseInstance];
+	// The normal matrix is the inverse transpose of the model matrix, so normals stay correct under non-uniform scale
+	vec3 worldNormal = mat3(object.NormalMatrix) * UnpackNormal(inNormal);
 	outColor = inColor;
-	outNormal = a_NormalMatrix * inNormal;
+	// Our view matrix has no scaling, so its inverse transpose is just its rotation
+	outNormal = mat3(a_View) * worldNormal;
 	outColor = inColor;
-	outWorldPos =  (a_Model * vec4(inPosition, 1)).xyz;
-	gl_Position = a_ModelViewProjection * vec4(inPosition, 1);
+	outWorldPos =  (object.Model * vec4(inPosition, 1)).xyz;
+	gl_Position = a_ViewProjection * vec4(outWorldPos, 1);
 
 	// New in tutorial 06
 	outUV = inUV;
+
+	// Used by the baked lighting shaders
+	outLightmapUV = inLightmapUV;
+	outWorldNormal = worldNormal;
 }
\ No newline at end of file
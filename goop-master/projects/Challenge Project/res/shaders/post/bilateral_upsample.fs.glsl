@@ -0,0 +1,64 @@
+#version 440
+// Upsamples the result of a pass that was run at a reduced resolution back to full resolution. Each pixel blends the
+// 4 nearest low resolution texels, but texels whose depth does not match the pixel's depth are weighted down, so the
+// effect does not bleed across silhouettes like it would with a plain bilinear upsample.
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec2 inScreenCoords ;
+
+layout (location = 0) out vec4 outColor;
+
+// The full resolution image from before the effect, this is only used when no low resolution texel is a good match
+uniform sampler2D xImage;
+// The result of the reduced resolution pass
+layout (binding = 1) uniform sampler2D s_LowRes;
+// The full resolution depth buffer (non-linearized)
+layout (binding = 2) uniform sampler2D s_Depth;
+
+uniform float a_NearPlane;
+uniform float a_FarPlane;
+
+// The fraction of the buffers that was rendered to this frame (see DynamicResolution), inUV is already scaled by this
+uniform vec2 a_UvScale = vec2(1.0);
+
+// How sharply the weights fall off as the depths diverge, relative to the depth of the pixel
+const float c_DepthSharpness = 50.0;
+// If the total weight falls below this, none of the texels are from our surface and we are on an edge that the low resolution pass missed
+const float c_MinWeight = 0.05;
+
+float LinearizeDepth(float rawValue) {
+	float z = rawValue * 2.0 - 1.0;
+	return (2.0 * a_NearPlane * a_FarPlane) / (a_FarPlane + a_NearPlane - z * (a_FarPlane - a_NearPlane));
+}
+
+void main() {
+	vec2 lowSize = vec2(textureSize(s_LowRes, 0));
+	vec2 highSize = vec2(textureSize(s_Depth, 0));
+	float depth = LinearizeDepth(texelFetch(s_Depth, ivec2(gl_FragCoord.xy), 0).r);
+
+	// Find the 4 low resolution texels around this pixel, and our bilinear weights between them
+	vec2 lowPos = inUV * lowSize - 0.5;
+	ivec2 base = ivec2(floor(lowPos));
+	vec2 f = fract(lowPos);
+	ivec2 maxTexel = ivec2(ceil(a_UvScale * lowSize)) - 1;
+
+	vec3 result = vec3(0.0);
+	float total = 0.0;
+	for (int ix = 0; ix < 4; ix++) {
+		ivec2 offset = ivec2(ix & 1, ix >> 1);
+		ivec2 texel = clamp(base + offset, ivec2(0), maxTexel);
+
+		// The low resolution texel covers several of our pixels, we compare against the depth at its center
+		ivec2 highTexel = ivec2((vec2(texel) + 0.5) / lowSize * highSize);
+		float texelDepth = LinearizeDepth(texelFetch(s_Depth, highTexel, 0).r);
+
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		float weight = bilinear.x * bilinear.y / (1.0 + c_DepthSharpness * abs(texelDepth - depth) / depth);
+
+		result += texelFetch(s_LowRes, texel, 0).rgb * weight;
+		total += weight;
+	}
+
+	// Fall back to the unprocessed pixel rather than amplifying a texel from the wrong surface
+	outColor = vec4(total > c_MinWeight ? result / total : texture(xImage, inUV).rgb, 1.0);
+}
@@ -6,7 +6,9 @@ layout(location = 1) in vec2 inScreenCoords;
 layout(location = 0) out vec4 outColor;
 
 layout(binding = 1) uniform sampler2D s_CameraDepth; // Camera's depth buffer
-layout(binding = 2) uniform sampler2D s_GNormal;     // The normal buffer
+layout(binding = 2) uniform sampler2D s_GNormal;     // The normal buffer (octahedral encoded)
+layout(binding = 3) uniform samplerCubeArray s_ShadowCubes; // The shared shadow cubes for all shadowed point lights
+layout(binding = 4) uniform sampler2D s_GMaterial;   // The material buffer (log2 shininess, specular strength)
 
 // The inverse of the camera's view-project matrix (clip->world)
 uniform mat4 a_ViewProjectionInv;
@@ -19,22 +21,39 @@ uniform vec3  a_LightPos;
 uniform vec3  a_LightColor;
 // The attenuation factor for the light (1/dist)
 uniform float a_LightAttenuation;
-// This should really be a GBuffer parameter
-uniform float a_MatShininess;
-
-const vec3 HALF = vec3(0.5);
-const vec3 DOUBLE = vec3(2.0);
-// Unpacks a normal from the [0,1] range to the [-1, 1] range
-vec3 UnpackNormal(vec3 rawNormal) {
-	return (rawNormal - HALF) * DOUBLE;
+// The material of the pixel we are lighting, these are read from the G-Buffer at the start of main
+float matShininess;
+float matSpecular;
+
+// The inverse of the camera's view matrix (view->world)
+uniform mat4  a_ViewInv;
+// The index of this light's cube in the shadow cube array, or -1 if the light does not cast shadows
+uniform int   a_ShadowIndex = -1;
+// The distance that the light casts shadows out to
+uniform float a_ShadowRange;
+// The shadow biasing to use, as a fraction of the shadow range
+uniform float a_ShadowBias;
+
+// Shininess is stored in the G-Buffer as log2, so that 8 bits can cover 1 to 2048
+const float MAX_SHININESS_LOG = 11.0;
+// Unpacks an octahedral encoded normal from the [0,1] range back into a unit vector
+vec3 UnpackNormal(vec2 rawNormal) {
+	vec2 f = rawNormal * 2.0 - 1.0;
+	vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
 }
 
+// The fraction of the buffers that was rendered to this frame (see DynamicResolution), inUV is already scaled by this
+uniform vec2 a_UvScale = vec2(1.0);
+
 // Calculates a world position from the main camera's depth buffer
 vec4 GetWorldPos(vec2 uv) {
 	// Get the depth buffer value at this pixel.    
 	float zOverW = texture(s_CameraDepth, uv).r * 2 - 1; 
 	// H is the viewport position at this pixel in the range -1 to 1.    
-	vec4 currentPos = vec4(uv.xy * 2 - 1, zOverW, 1); 
+	vec4 currentPos = vec4((uv.xy / a_UvScale) * 2 - 1, zOverW, 1); 
 	// Transform by the view-projection inverse.    
 	vec4 D = a_ViewProjectionInv * currentPos; 
 	// Divide by w to get the world position.    
@@ -46,7 +65,7 @@ vec4 GetViewPos(vec2 uv) {
 	// Get the depth buffer value at this pixel.    
 	float zOverW = texture(s_CameraDepth, uv).r * 2 - 1;
 	// H is the viewport position at this pixel in the range -1 to 1.    
-	vec4 currentPos = vec4(uv.xy * 2 - 1, zOverW, 1);
+	vec4 currentPos = vec4((uv.xy / a_UvScale) * 2 - 1, zOverW, 1);
 	// Transform by the view-projection inverse.    
 	vec4 D = a_ProjectionInv * currentPos;
 	// Divide by w to get the world position.    
@@ -72,10 +91,10 @@ vec3 BlinnPhong(vec3 fragPos, vec3 fragNorm, vec3 lightPosition, vec3 lightColor
 
 	// Our specular power is the angle between the the normal and the half vector, raised
 	// to the power of the light's shininess
-	float specPower = pow(max(dot(fragNorm, halfDir), 0.0), a_MatShininess);
+	float specPower = pow(max(dot(fragNorm, halfDir), 0.0), matShininess);
 
 	// Finally, we can calculate the actual specular factor
-	vec3 specOut = specPower * lightColor;
+	vec3 specOut = specPower * matSpecular * lightColor;
 
 	// Calculate our diffuse factor, this is essentially the angle between
 	// the surface and the light
@@ -90,14 +109,48 @@ vec3 BlinnPhong(vec3 fragPos, vec3 fragNorm, vec3 lightPosition, vec3 lightColor
 	return attenuation * (diffuseOut + specOut);
 }
 
+// The offsets to use when sampling the shadow cube, these are the corners of a cube around the sample direction
+const vec3 SHADOW_OFFSETS[8] = vec3[](
+	vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1),
+	vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1)
+);
+
+// Determines how shadowed a fragment is by this light, by comparing its distance to the light with the shadow cube
+// @param fragPos The position of the fragment, in view space
+// @param lightPos The position of the light, in view space
+float CubeShadow(vec3 fragPos, vec3 lightPos) {
+	// Our cubes are stored in world space, so we need to rotate our sample direction out of view space
+	vec3 toFrag = mat3(a_ViewInv) * (fragPos - lightPos);
+	float depth = length(toFrag) / a_ShadowRange;
+	// Anything outside of the shadow range is never shadowed
+	if (depth >= 1.0)
+		return 0.0;
+
+	// We'll sample in a small area around our direction to soften the edges of the shadows
+	float result = 0.0;
+	float radius = 0.01 * length(toFrag);
+	for (int ix = 0; ix < 8; ix++) {
+		float closest = texture(s_ShadowCubes, vec4(toFrag + SHADOW_OFFSETS[ix] * radius, a_ShadowIndex)).r;
+		result += depth - a_ShadowBias > closest ? 1.0 : 0.0;
+	}
+	return result / 8.0;
+}
+
 void main() {
 	// Extract the world position from the depth buffer
 	vec4 viewPos = GetViewPos(inUV);  
 	// Extract our normal from the G Buffer
-	vec3 viewNormal = UnpackNormal(texture(s_GNormal, inUV).rgb);
+	vec3 viewNormal = UnpackNormal(texture(s_GNormal, inUV).rg);
+	vec2 material = texture(s_GMaterial, inUV).rg;
+	matShininess = exp2(material.r * MAX_SHININESS_LOG);
+	matSpecular = material.g;
 
 	// Calculate our lighting for this point light
 	vec3 result = BlinnPhong(viewPos.xyz, viewNormal, a_LightPos, a_LightColor, a_LightAttenuation);
+	// Apply the light's shadows, if it has any
+	if (a_ShadowIndex >= 0) {
+		result *= 1.0 - CubeShadow(viewPos.xyz, a_LightPos);
+	}
 
 	// Output the result
 	outColor = vec4(result, 1.0);
@@ -0,0 +1,18 @@
+#version 440
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec2 inScreenCoords ;
+
+layout (location = 0) out vec4 outColor;
+
+uniform sampler2D xImage;
+
+// The top of the bloom chain, after all the levels have been upsampled into it
+layout (binding = 1) uniform sampler2D s_Bloom;
+
+uniform float a_BloomStrength;
+
+void main() {
+	vec3 bloom = textureLod(s_Bloom, inUV, 0).rgb;
+	outColor = vec4(texture(xImage, inUV).rgb + bloom * a_BloomStrength, 1.0);
+}
@@ -0,0 +1,58 @@
+#version 440
+// Downsamples one level of the bloom chain using the dual filter (Kawase) kernel, which is 4 bilinear taps on the
+// corners around the texel plus the center tap weighted by 4. Rather than every invocation fetching its own 16 texel
+// footprint, each work group loads the source texels it covers into shared memory once.
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// A group of 8x8 outputs covers 16x16 source texels, plus a 1 texel border for the corner taps
+#define TILE_SIZE 18
+
+layout (binding = 0) uniform sampler2D xImage;  // The scene, only read when prefiltering
+layout (binding = 1) uniform sampler2D s_Bloom; // The bloom chain, we read from a_SourceLevel
+layout (binding = 0, rgba16f) uniform writeonly image2D s_Output;
+
+uniform int   a_SourceLevel;
+uniform float a_BloomThreshold;
+// When true, we are reading from the scene and applying the highlight threshold, rather than reading the chain
+uniform bool  b_Prefilter;
+
+shared vec3 tile[TILE_SIZE][TILE_SIZE];
+
+vec3 FetchSource(ivec2 coord) {
+	if (b_Prefilter) {
+		ivec2 size = textureSize(xImage, 0);
+		vec3 color = texelFetch(xImage, clamp(coord, ivec2(0), size - 1), 0).rgb;
+		// Determine our luminance, based on percieved brightness of colors, and only keep what's above the threshold
+		float luminance = dot(color, vec3(0.299, 0.587, 0.114));
+		return color * (max(luminance - a_BloomThreshold, 0.0) / max(luminance, 0.0001));
+	} else {
+		ivec2 size = textureSize(s_Bloom, a_SourceLevel);
+		return texelFetch(s_Bloom, clamp(coord, ivec2(0), size - 1), a_SourceLevel).rgb;
+	}
+}
+
+// Averages the 2x2 block of tile texels starting at p, which is the same as a bilinear tap on the corner between them
+vec3 Box(ivec2 p) {
+	return 0.25 * (tile[p.y][p.x] + tile[p.y][p.x + 1] + tile[p.y + 1][p.x] + tile[p.y + 1][p.x + 1]);
+}
+
+void main() {
+	// Cooperatively load the tile, the 64 invocations will each load about 5 texels
+	ivec2 origin = ivec2(gl_WorkGroupID.xy) * 16 - 1;
+	for (uint ix = gl_LocalInvocationIndex; ix < TILE_SIZE * TILE_SIZE; ix += 64) {
+		ivec2 local = ivec2(ix % TILE_SIZE, ix / TILE_SIZE);
+		tile[local.y][local.x] = FetchSource(origin + local);
+	}
+	barrier();
+
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(coord, imageSize(s_Output))))
+		return;
+
+	// Our footprint in the source covers texels 2p-1 to 2p+2, which starts at 2 * our local ID in the tile
+	ivec2 base = ivec2(gl_LocalInvocationID.xy) * 2;
+	vec3 result = Box(base + 1) * 4.0 +
+		Box(base) + Box(base + ivec2(2, 0)) + Box(base + ivec2(0, 2)) + Box(base + 2);
+	imageStore(s_Output, coord, vec4(result / 8.0, 1.0));
+}
@@ -0,0 +1,59 @@
+#version 440
+// Upsamples one level of the bloom chain with a 3x3 tent filter, and adds it to the next level up. Running this from
+// the smallest level to the largest gives a wide, smooth blur for the cost of a handful of small dispatches. Each work
+// group loads the source texels it covers into shared memory and does the bilinear filtering itself.
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// A group of 8x8 outputs covers at most 4x4 source texels, plus a 2 texel border for the tent and bilinear taps
+#define TILE_SIZE 10
+
+layout (binding = 1) uniform sampler2D s_Bloom; // The bloom chain, we read from a_SourceLevel
+// The level above a_SourceLevel, we add our result to what is already there
+layout (binding = 0, rgba16f) uniform image2D s_Output;
+
+uniform int   a_SourceLevel;
+// The distance between the tent taps, in source texels (clamped to [0, 1] so that we stay inside the tile)
+uniform float a_Radius;
+
+shared vec3 tile[TILE_SIZE][TILE_SIZE];
+
+// Performs a bilinear tap into the tile, pos is in texels relative to the tile's origin
+vec3 Bilinear(vec2 pos) {
+	vec2 p = pos - 0.5;
+	ivec2 i = ivec2(floor(p));
+	vec2 f = p - vec2(i);
+	return mix(
+		mix(tile[i.y][i.x],     tile[i.y][i.x + 1],     f.x),
+		mix(tile[i.y + 1][i.x], tile[i.y + 1][i.x + 1], f.x),
+		f.y);
+}
+
+void main() {
+	ivec2 sourceSize = textureSize(s_Bloom, a_SourceLevel);
+	ivec2 outputSize = imageSize(s_Output);
+	vec2  ratio = vec2(sourceSize) / vec2(outputSize);
+
+	// Cooperatively load the tile covering this group's outputs
+	ivec2 origin = ivec2(floor(vec2(gl_WorkGroupID.xy * 8) * ratio)) - 2;
+	for (uint ix = gl_LocalInvocationIndex; ix < TILE_SIZE * TILE_SIZE; ix += 64) {
+		ivec2 local = ivec2(ix % TILE_SIZE, ix / TILE_SIZE);
+		tile[local.y][local.x] = texelFetch(s_Bloom, clamp(origin + local, ivec2(0), sourceSize - 1), a_SourceLevel).rgb;
+	}
+	barrier();
+
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(coord, outputSize)))
+		return;
+
+	// 3x3 tent, weighted 1 2 1 / 2 4 2 / 1 2 1
+	vec2 center = (vec2(coord) + 0.5) * ratio - vec2(origin);
+	float radius = clamp(a_Radius, 0.0, 1.0);
+	vec3 result = Bilinear(center) * 4.0;
+	result += (Bilinear(center + vec2(-radius, 0.0)) + Bilinear(center + vec2(radius, 0.0)) +
+	           Bilinear(center + vec2(0.0, -radius)) + Bilinear(center + vec2(0.0, radius))) * 2.0;
+	result +=  Bilinear(center + vec2(-radius, -radius)) + Bilinear(center + vec2(radius, -radius)) +
+	           Bilinear(center + vec2(-radius,  radius)) + Bilinear(center + vec2(radius,  radius));
+
+	imageStore(s_Output, coord, imageLoad(s_Output, coord) + vec4(result / 16.0, 0.0));
+}
@@ -0,0 +1,29 @@
+#version 440
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec2 inScreenCoords;
+
+layout (location = 0) out vec4 outMoments;
+
+layout (binding = 0) uniform sampler2D s_Moments;
+
+// True if we are blurring along the x axis, false for the y axis
+uniform bool isHorizontal;
+
+const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+
+// Unlike the regular gaussian blur, we need to keep all 4 channels, since EVSM stores moments in all of them
+void main() {
+	vec2 off = 1.0 / textureSize(s_Moments, 0);
+	if (isHorizontal) {
+		off = off * vec2(1, 0);
+	} else {
+		off = off * vec2(0, 1);
+	}
+	vec4 result = textureLod(s_Moments, inUV, 0) * weights[0];
+	for(int i = 1; i < 5; i++) {
+		result += textureLod(s_Moments, inUV + off * i, 0) * weights[i];
+		result += textureLod(s_Moments, inUV - off * i, 0) * weights[i];
+	}
+	outMoments = result;
+}
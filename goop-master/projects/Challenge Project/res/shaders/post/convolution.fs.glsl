@@ -1,25 +1,37 @@
 #version 440
+// Applies a full 2D convolution kernel, this is used for kernels that are too far from separable to be split into
+// horizontal and vertical passes (see SeparableKernel)
 
 layout (location = 0) in vec2 inUV;
 layout (location = 1) in vec2 inScreenCoords ;
 
 layout (location = 0) out vec4 outColor;
 
+// Should match CONVOLUTION_MAX_SIZE
+const int c_MaxSize = 15;
+
 uniform sampler2D xImage;
 uniform ivec2 xScreenRes;
-uniform mat3 a_Filter;
 
-vec4 applyFilter(vec2 uv, vec2 res) {
-	vec2 offset = vec2(1.33f) / res;
+// The weights of the kernel, row by row starting from the top, packed 4 to an element
+uniform vec4 a_Kernel[(c_MaxSize * c_MaxSize + 3) / 4];
+uniform int  a_KernelSize;
+
+vec4 applyFilter(vec2 uv) {
+	ivec2 size = textureSize(xImage, 0);
+	ivec2 center = ivec2(uv * vec2(size));
+	int radius = a_KernelSize / 2;
 	vec4 result = vec4(0);
-	for(int ix = -1; ix <= 1; ix++) {
-		for (int iy = -1; iy <= 1; iy++) {
-			result += texture(xImage, uv + (offset * vec2(ix, iy))) * a_Filter[iy + 1][ix + 1];
+	for (int row = 0; row < a_KernelSize; row++) {
+		for (int col = 0; col < a_KernelSize; col++) {
+			int ix = row * a_KernelSize + col;
+			ivec2 texel = clamp(center + ivec2(col - radius, radius - row), ivec2(0), size - 1);
+			result += texelFetch(xImage, texel, 0) * a_Kernel[ix / 4][ix % 4];
 		}
 	}
 	return result;
 }
 
 void main() {
-	outColor = applyFilter(inUV, xScreenRes);
-}
\ No newline at end of file
+	outColor = vec4(applyFilter(inUV).rgb, 1.0);
+}
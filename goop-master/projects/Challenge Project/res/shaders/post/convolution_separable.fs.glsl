@@ -0,0 +1,34 @@
+#version 440
+// Applies one half of a separable term of a convolution kernel (see SeparableKernel). The horizontal pass reads the
+// source image, while the vertical pass reads the horizontal pass's result and adds it to the terms before it
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec2 inScreenCoords ;
+
+layout (location = 0) out vec4 outColor;
+
+// Should match CONVOLUTION_MAX_SIZE
+const int c_MaxTaps = 15;
+
+// The image to convolve, this is slot 0 for horizontal passes and slot 1 for vertical passes
+uniform sampler2D s_Input;
+// The sum of the terms before this one
+layout (binding = 2) uniform sampler2D s_Accumulated;
+uniform bool b_Accumulate = false;
+
+// The axis to sample along, either (1, 0) or (0, 1)
+uniform vec2 a_Direction;
+// The offset (in texels) of each tap in x, and its weight in y. Fractional offsets let the filter blend two texels
+uniform vec2 a_Taps[c_MaxTaps];
+uniform int  a_TapCount;
+
+void main() {
+	vec2 texelSize = a_Direction / vec2(textureSize(s_Input, 0));
+	vec3 result = vec3(0.0);
+	for (int ix = 0; ix < a_TapCount; ix++) {
+		result += textureLod(s_Input, inUV + texelSize * a_Taps[ix].x, 0).rgb * a_Taps[ix].y;
+	}
+	if (b_Accumulate)
+		result += texture(s_Accumulated, inUV).rgb;
+	outColor = vec4(result, 1.0);
+}
@@ -22,6 +22,8 @@ uniform float a_Aperture;
 
 // The inverse of the camera's projection matrix
 uniform mat4 a_ProjectionInv;
+// The fraction of the buffers that was rendered to this frame (see DynamicResolution), inUV is already scaled by this
+uniform vec2 a_UvScale = vec2(1.0);
 
 const float GOLDEN_ANGLE = 2.39996323;
 const float MAX_BLUR_RADIUS = 20; // We impose a hard limit on blurring to avoid killing the GPU
@@ -32,7 +34,7 @@ const float RAD_SCALE = 0.5;
 // @param rawValue The raw, non-linear depth value to convert
 // @returns A distance to the camera in world units
 float DepthToDist(vec2 screen, float rawValue) {
-	vec4 screenPos = vec4(screen.x, screen.y, rawValue, 1.0) * 2.0 - 1.0;
+	vec4 screenPos = vec4(screen / a_UvScale, rawValue, 1.0) * 2.0 - 1.0;
 	vec4 viewPosition = a_ProjectionInv * screenPos;
 
 	return -(viewPosition.z / viewPosition.w);
@@ -0,0 +1,132 @@
+#version 440
+// Must match MAX_SHADOW_CASCADES in DirectionalLight.h
+#define MAX_CASCADES 4
+
+layout(location = 0) in vec2 inUV;
+layout(location = 1) in vec2 inScreenCoords;
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 1) uniform sampler2D s_CameraDepth;           // Camera's depth buffer
+layout(binding = 2) uniform sampler2DArray s_ShadowCascades;   // The light's cascades, one per layer
+layout(binding = 3) uniform sampler2D s_GNormal;               // The normal buffer (octahedral encoded)
+layout(binding = 4) uniform sampler2D s_GMaterial;             // The material buffer (log2 shininess, specular strength)
+
+// The inverse of the camera's project matrix (clip->view)
+uniform mat4 a_ProjectionInv;
+
+// The view->light clip space matrix for each cascade
+uniform mat4  a_CascadeViewProjection[MAX_CASCADES];
+// The far plane of each cascade, as a distance from the camera
+uniform float a_CascadeSplits[MAX_CASCADES];
+// The number of cascades the light is using
+uniform int   a_NumCascades;
+
+// The direction that the light is shining, in view space
+uniform vec3  a_LightDir;
+// The light's color
+uniform vec3  a_LightColor;
+// The shadow biasing to use
+uniform float a_Bias = 0.0005;
+// The material of the pixel we are lighting, these are read from the G-Buffer at the start of main
+float matShininess;
+float matSpecular;
+
+// Shininess is stored in the G-Buffer as log2, so that 8 bits can cover 1 to 2048
+const float MAX_SHININESS_LOG = 11.0;
+// Unpacks an octahedral encoded normal from the [0,1] range back into a unit vector
+vec3 UnpackNormal(vec2 rawNormal) {
+	vec2 f = rawNormal * 2.0 - 1.0;
+	vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+// The fraction of the buffers that was rendered to this frame (see DynamicResolution), inUV is already scaled by this
+uniform vec2 a_UvScale = vec2(1.0);
+
+vec4 GetViewPos(vec2 uv) {
+	// Get the depth buffer value at this pixel.    
+	float zOverW = texture(s_CameraDepth, uv).r * 2 - 1;
+	// H is the viewport position at this pixel in the range -1 to 1.    
+	vec4 currentPos = vec4((uv.xy / a_UvScale) * 2 - 1, zOverW, 1);
+	// Transform by the view-projection inverse.    
+	vec4 D = a_ProjectionInv * currentPos;
+	// Divide by w to get the world position.    
+	vec4 viewPos = D / D.w;
+	return viewPos;
+}
+
+// Caluclate the blinn-phong factor for a light with no position
+vec3 BlinnPhongDirectional(vec3 fragPos, vec3 fragNorm, vec3 lightDir, vec3 lightColor, float shadowFactor) {
+	// The direction to the light is the same for every fragment
+	vec3 toLight = -lightDir;
+
+	// Determine the direction between the camera and the pixel (camera is now at 0,0,0)
+	vec3 viewDir = normalize(-fragPos);
+
+	// Calculate the halfway vector between the direction to the light and the direction to the eye
+	vec3 halfDir = normalize(toLight + viewDir);
+
+	// Our specular power is the angle between the the normal and the half vector, raised
+	// to the power of the light's shininess
+	float specPower = pow(max(dot(fragNorm, halfDir), 0.0), matShininess);
+	vec3 specOut = specPower * matSpecular * lightColor;
+
+	// Calculate our diffuse factor, this is essentially the angle between the surface and the light
+	float diffuseFactor = max(dot(fragNorm, toLight), 0);
+	vec3  diffuseOut = diffuseFactor * lightColor;
+
+	// Directional lights are infinitely far away, so there is no attenuation
+	return (1.0 - shadowFactor) * (diffuseOut + specOut);
+}
+
+// Performs 3x3 PCF on a single cascade
+// @param fragPos The position in the cascade's normalized clip space to sample
+// @param cascade The index of the cascade to sample from
+// @param bias The shadow bias factor to use
+float PCF(vec3 fragPos, int cascade, float bias) {
+	float result = 0.0;
+	vec2 texelSize = 1.0 / textureSize(s_ShadowCascades, 0).xy; // Determine the texel size of a single layer
+
+	// Iterate over a 3x3 area of texels around our sample location
+	for(int x = -1; x <= 1; ++x) { 
+		for(int y = -1; y <= 1; ++y) {
+			float pcfDepth = texture(s_ShadowCascades, vec3(fragPos.xy + vec2(x, y) * texelSize, cascade)).r;
+			result += fragPos.z - bias > pcfDepth ? 1.0 : 0.0;
+		}    
+	}
+	result /= 9.0; // Average our sum
+	return result;
+}
+
+void main() {
+	vec4 viewPos = GetViewPos(inUV);         // Extract the view position from the depth buffer
+	float viewDepth = -viewPos.z;            // The camera looks down -Z
+
+	// Extract our normal from the G Buffer
+	vec3 viewNormal = UnpackNormal(texture(s_GNormal, inUV).rg);
+	vec2 material = texture(s_GMaterial, inUV).rg;
+	matShininess = exp2(material.r * MAX_SHININESS_LOG);
+	matSpecular = material.g;
+
+	// Select the first cascade that contains this fragment, anything beyond the last cascade is unshadowed
+	float shadow = 0.0;
+	int cascade = 0;
+	while (cascade < a_NumCascades && viewDepth > a_CascadeSplits[cascade]) {
+		cascade++;
+	}
+	if (cascade < a_NumCascades) {
+		vec4 shadowPos = a_CascadeViewProjection[cascade] * viewPos; // Orthographic, so no perspective divide needed
+		shadowPos.xyz = shadowPos.xyz * 0.5 + 0.5;                   // Normalize from clip space to [0,1]
+
+		// Determine our biasing factor, we have a higher bias the closer the surface is to being parallel with the light.
+		// Farther cascades cover more world space per texel, so they need proportionally more bias
+		float bias = max((a_Bias * 10) * (1.0 - dot(viewNormal, -a_LightDir)), a_Bias) * (cascade + 1);
+		shadow = PCF(shadowPos.xyz, cascade, bias);
+	}
+
+	vec3 result = BlinnPhongDirectional(viewPos.xyz, viewNormal, a_LightDir, a_LightColor, shadow);
+	outColor = vec4(result, 1.0);
+}
@@ -0,0 +1,56 @@
+#version 440
+// Reduces the luminance histogram from luminance_histogram.comp.glsl down to the average log luminance of the frame,
+// and eases the exposure towards the value that maps that average to our key value. This runs as a single work group
+// with one invocation per bin, and clears the histogram for the next frame as it goes.
+
+layout (local_size_x = 256) in;
+
+#define HISTOGRAM_BINS 256
+
+// This matches ExposureData in AutoExposure.cpp
+layout (std430, binding = 1) buffer b_Exposure {
+	float Exposure;
+	float AverageLuminance;
+	uint  Bins[HISTOGRAM_BINS];
+};
+
+// The number of pixels that were binned this frame
+uniform float a_PixelCount;
+// These should match what the histogram was built with
+uniform float a_MinLogLuminance;
+uniform float a_LogLuminanceRange;
+// The average luminance we want to end up at after exposure
+uniform float a_KeyValue;
+// The minimum and maximum exposure we will allow
+uniform vec2  a_ExposureLimits;
+// How far to move towards the target exposure this frame (0 to 1)
+uniform float a_AdaptRate;
+
+shared float weighted[HISTOGRAM_BINS];
+
+void main() {
+	uint bin = gl_LocalInvocationIndex;
+	uint count = Bins[bin];
+	Bins[bin] = 0;
+	weighted[bin] = float(count) * float(bin);
+	barrier();
+
+	// Sum up the weighted bins in shared memory
+	for (uint stride = HISTOGRAM_BINS / 2; stride > 0; stride >>= 1) {
+		if (bin < stride)
+			weighted[bin] += weighted[bin + stride];
+		barrier();
+	}
+
+	if (bin == 0) {
+		// Bin 0 holds the pixels that were too dark to meter (the sky, for instance), so they are left out of the average
+		float metered = max(a_PixelCount - float(count), 1.0);
+		float averageBin = weighted[0] / metered;
+		float averageLog = (averageBin - 1.0) / float(HISTOGRAM_BINS - 2) * a_LogLuminanceRange + a_MinLogLuminance;
+		AverageLuminance = exp2(averageLog);
+
+		// We adapt in log space, so that brightening and darkening by the same number of stops take the same time
+		float target = clamp(a_KeyValue / AverageLuminance, a_ExposureLimits.x, a_ExposureLimits.y);
+		Exposure = exp2(mix(log2(max(Exposure, 0.0001)), log2(target), a_AdaptRate));
+	}
+}
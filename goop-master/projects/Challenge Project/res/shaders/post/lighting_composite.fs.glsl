@@ -11,7 +11,12 @@ layout(binding = 1) uniform sampler2D a_GColor;
 layout(binding = 2) uniform sampler2D a_HdrLightAccum;
 layout(binding = 3) uniform sampler2D a_GEmissive; // NEW
 
-uniform float a_Exposure;
+// The exposure that AutoExposure has adapted to the scene's lighting, this never leaves the GPU
+layout(std430, binding = 1) readonly buffer b_Exposure {
+	float Exposure;
+};
+// A manual exposure compensation, applied on top of the adapted exposure
+uniform float a_Exposure = 1.0;
 
 vec3 ToneMap(vec3 color, float exposure) {
 	const float gamma = 2.2;
@@ -22,5 +27,5 @@ vec3 ToneMap(vec3 color, float exposure) {
 
 void main() {
 	vec4 color = texture(a_GColor, inUV) * (texture(a_HdrLightAccum, inUV) + texture(a_GEmissive, inUV)); // Updated
-	outColor = vec4(ToneMap(color.rgb, a_Exposure), 1.0);
+	outColor = vec4(ToneMap(color.rgb, Exposure * a_Exposure), 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#version 440
+// Builds a histogram of the log2 luminance of the scene's lighting, which exposure_adapt.comp.glsl reduces down to
+// an exposure. Each work group bins its pixels into shared memory first, so that the global buffer only sees one
+// atomic add per bin per group, rather than one per pixel.
+
+layout (local_size_x = 16, local_size_y = 16) in;
+
+#define HISTOGRAM_BINS 256
+
+layout (binding = 0) uniform sampler2D s_LightAccum; // The light accumulation buffer
+layout (binding = 1) uniform sampler2D s_GEmissive;  // The emissive buffer, which is added to the lighting in the composite
+
+// This matches ExposureData in AutoExposure.cpp
+layout (std430, binding = 1) buffer b_Exposure {
+	float Exposure;
+	float AverageLuminance;
+	uint  Bins[HISTOGRAM_BINS];
+};
+
+// The region of the buffers that was rendered to this frame
+uniform ivec2 a_Viewport;
+// The log2 luminance that maps to bin 1, and the inverse of the range covered by bins 1 to 255
+uniform float a_MinLogLuminance;
+uniform float a_InvLogLuminanceRange;
+
+// Anything darker than this goes into bin 0, which is left out of the average
+const float c_MinLuminance = 0.0001;
+
+shared uint localBins[HISTOGRAM_BINS];
+
+uint GetBin(float luminance) {
+	if (luminance < c_MinLuminance)
+		return 0;
+	float t = clamp((log2(luminance) - a_MinLogLuminance) * a_InvLogLuminanceRange, 0.0, 1.0);
+	return uint(t * float(HISTOGRAM_BINS - 2) + 1.0);
+}
+
+void main() {
+	// Our group has exactly one invocation per bin, so each clears and then flushes its own bin
+	localBins[gl_LocalInvocationIndex] = 0;
+	barrier();
+
+	ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+	if (all(lessThan(coord, a_Viewport))) {
+		vec3 light = texelFetch(s_LightAccum, coord, 0).rgb + texelFetch(s_GEmissive, coord, 0).rgb;
+		float luminance = dot(light, vec3(0.2126, 0.7152, 0.0722));
+		atomicAdd(localBins[GetBin(luminance)], 1);
+	}
+	barrier();
+
+	uint count = localBins[gl_LocalInvocationIndex];
+	if (count > 0)
+		atomicAdd(Bins[gl_LocalInvocationIndex], count);
+}
@@ -14,12 +14,16 @@ const int c_NumSamples = 5;
 
 layout (binding = 1) uniform sampler2D a_CurrentDepth;
 
+// The fraction of the buffers that was rendered to this frame (see DynamicResolution), inUV is already scaled by this
+uniform vec2 a_UvScale = vec2(1.0);
+
 // https://developer.nvidia.com/gpugems/gpugems3/part-iv-image-effects/chapter-27-motion-blur-post-processing-effect
 vec2 CalculateMotion(sampler2D depth, mat4 invViewProj, mat4 prevViewProj) {
 	// Get the depth buffer value at this pixel.    
 	float zOverW = texture(depth, inUV).r; 
 	// H is the viewport position at this pixel in the range -1 to 1.    
-	vec4 currentPos = vec4(inUV.x * 2 - 1, (1 - inUV.y) * 2 - 1, zOverW, 1); 
+	vec2 screen = inUV / a_UvScale;
+	vec4 currentPos = vec4(screen.x * 2 - 1, (1 - screen.y) * 2 - 1, zOverW, 1); 
 	// Transform by the view-projection inverse.    
 	vec4 D = currentPos * invViewProj; 
 	// Divide by w to get the world position.    
@@ -49,5 +53,5 @@ vec4 CalculateBlur(sampler2D sampler, vec2 motion, vec2 texCoord) {
 
 void main() {
 	vec2 motion = CalculateMotion(a_CurrentDepth, a_ViewProjectionInv, a_PrevViewProjection);
-	outColor = CalculateBlur(xImage, motion, inUV);
+	outColor = CalculateBlur(xImage, motion * a_UvScale, inUV);
 }
\ No newline at end of file
@@ -0,0 +1,9 @@
+// Overlays a checkerboard pattern on the image
+uniform int  a_CheckerSize = 8;
+uniform vec3 a_CheckerColor = vec3(0.0);
+
+vec4 Apply(vec4 color) {
+	float multiplier =
+		mod(round(inScreenCoords.x / a_CheckerSize) + round((inScreenCoords.y / a_CheckerSize)), 2);
+	return vec4((color.rgb * multiplier) + (a_CheckerColor * (1 - multiplier)), color.a);
+}
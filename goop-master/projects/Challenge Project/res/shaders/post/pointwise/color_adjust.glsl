@@ -0,0 +1,13 @@
+// Basic color grading, adjusting the brightness, contrast and saturation of the image
+uniform float a_Brightness = 0.0;
+uniform float a_Contrast   = 1.0;
+uniform float a_Saturation = 1.0;
+
+const vec3 c_LuminanceWeights = vec3(0.299, 0.587, 0.114);
+
+vec4 Apply(vec4 color) {
+	vec3 result = (color.rgb - 0.5) * a_Contrast + 0.5 + a_Brightness;
+	float luminance = dot(result, c_LuminanceWeights);
+	result = mix(vec3(luminance), result, a_Saturation);
+	return vec4(clamp(result, 0.0, 1.0), color.a);
+}
@@ -0,0 +1,4 @@
+// Inverts the color of the image
+vec4 Apply(vec4 color) {
+	return vec4(1.0 - color.rgb, color.a);
+}
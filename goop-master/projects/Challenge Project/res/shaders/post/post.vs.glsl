@@ -6,10 +6,12 @@ layout (location = 0) out vec2 outUV;
 layout (location = 1) out vec2 outScreenCoords;
 
 uniform ivec2 xScreenRes;
+// The fraction of the input buffers that holds the image, when rendering at a reduced resolution (see DynamicResolution)
+uniform vec2 a_UvScale = vec2(1.0);
 
 void main() {
 	gl_Position = vec4(inPosition, 0, 1);
 	outScreenCoords = ((inPosition + vec2(1, 1)) / 2.0f) * xScreenRes;
 
-	outUV = inUV;
+	outUV = inUV * a_UvScale;
 }
\ No newline at end of file
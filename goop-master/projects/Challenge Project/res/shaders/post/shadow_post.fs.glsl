@@ -7,8 +7,10 @@ layout(location = 0) out vec4 outColor;
 
 layout(binding = 1) uniform sampler2D s_CameraDepth; // Camera's depth buffer
 layout(binding = 2) uniform sampler2D s_ShadowDepth; // The light's shadow sampler
-layout(binding = 3) uniform sampler2D s_GNormal;     // The normal buffer
+layout(binding = 3) uniform sampler2D s_GNormal;     // The normal buffer (octahedral encoded)
 layout(binding = 4) uniform sampler2D s_Projection;  // The projection to use
+layout(binding = 5) uniform sampler2D s_ShadowMoments; // The light's pre-filtered moments, if it is using VSM or EVSM
+layout(binding = 6) uniform sampler2D s_GMaterial;    // The material buffer (log2 shininess, specular strength)
 
 // The inverse of the camera's view matrix (view->world)
 uniform mat4 a_ViewInv;
@@ -33,28 +35,42 @@ uniform vec3  a_LightColor;
 uniform float a_LightAttenuation;
 // The shadow biasing to use
 uniform float a_Bias = 0.01;
-// This should really be a GBuffer parameter
-uniform float a_MatShininess;
+// The material of the pixel we are lighting, these are read from the G-Buffer at the start of main
+float matShininess;
+float matSpecular;
 
 // Allows us to toggle between shadows and projectors
 uniform bool  b_IsProjector;
 // The intensity of the projector image
 uniform float a_ProjectorIntensity;
 
-const vec3 HALF = vec3(0.5);
-const vec3 DOUBLE = vec3(2.0);
-
-// Unpacks a normal from the [0,1] range to the [-1, 1] range
-vec3 UnpackNormal(vec3 rawNormal) {
-	return (rawNormal - HALF) * DOUBLE;
+// How the light's shadows are filtered, must match ShadowFilterMode (0 = PCF, 1 = VSM, 2 = EVSM)
+uniform int   a_FilterMode = 0;
+// The amount of light bleeding to cut off for moment based filtering
+uniform float a_LightBleedReduction = 0.2;
+// The positive and negative exponents that were used to warp the depth for EVSM
+uniform vec2  a_EvsmExponents;
+
+// Shininess is stored in the G-Buffer as log2, so that 8 bits can cover 1 to 2048
+const float MAX_SHININESS_LOG = 11.0;
+// Unpacks an octahedral encoded normal from the [0,1] range back into a unit vector
+vec3 UnpackNormal(vec2 rawNormal) {
+	vec2 f = rawNormal * 2.0 - 1.0;
+	vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
 }
 
+// The fraction of the buffers that was rendered to this frame (see DynamicResolution), inUV is already scaled by this
+uniform vec2 a_UvScale = vec2(1.0);
+
 // Calculates a world position from the main camera's depth buffer
 vec4 GetWorldPos(vec2 uv) {
 	// Get the depth buffer value at this pixel.    
 	float zOverW = texture(s_CameraDepth, uv).r * 2 - 1; 
 	// H is the viewport position at this pixel in the range -1 to 1.    
-	vec4 currentPos = vec4(uv.xy * 2 - 1, zOverW, 1); 
+	vec4 currentPos = vec4((uv.xy / a_UvScale) * 2 - 1, zOverW, 1); 
 	// Transform by the view-projection inverse.    
 	vec4 D = a_ViewProjectionInv * currentPos; 
 	// Divide by w to get the world position.    
@@ -66,7 +82,7 @@ vec4 GetViewPos(vec2 uv) {
 	// Get the depth buffer value at this pixel.    
 	float zOverW = texture(s_CameraDepth, uv).r * 2 - 1;
 	// H is the viewport position at this pixel in the range -1 to 1.    
-	vec4 currentPos = vec4(uv.xy * 2 - 1, zOverW, 1);
+	vec4 currentPos = vec4((uv.xy / a_UvScale) * 2 - 1, zOverW, 1);
 	// Transform by the view-projection inverse.    
 	vec4 D = a_ProjectionInv * currentPos;
 	// Divide by w to get the world position.    
@@ -92,10 +108,10 @@ vec3 BlinnPhong(vec3 fragPos, vec3 fragNorm, vec3 lightPosition, vec3 lightColor
 
 	// Our specular power is the angle between the the normal and the half vector, raised
 	// to the power of the light's shininess
-	float specPower = pow(max(dot(fragNorm, halfDir), 0.0), a_MatShininess);
+	float specPower = pow(max(dot(fragNorm, halfDir), 0.0), matShininess);
 
 	// Finally, we can calculate the actual specular factor
-	vec3 specOut = specPower * lightColor;
+	vec3 specOut = specPower * matSpecular * lightColor;
 
 	// Calculate our diffuse factor, this is essentially the angle between
 	// the surface and the light
@@ -129,6 +145,40 @@ float PCF(vec3 fragPos, float bias) {
 	return result;
 }
 
+// Determines how lit a fragment is from a set of moments, using Chebyshev's inequality
+// @param moments The mean and mean squared depth around the sample
+// @param depth The depth of the fragment being tested
+// @param minVariance The smallest variance to allow, which works as our bias
+float ChebyshevUpperBound(vec2 moments, float depth, float minVariance) {
+	// If we are in front of the mean, we are fully lit
+	float p = depth <= moments.x ? 1.0 : 0.0;
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float d = depth - moments.x;
+	float pMax = variance / (variance + d * d);
+	// Cut off the tail of the distribution to reduce light bleeding where shadows overlap
+	pMax = clamp((pMax - a_LightBleedReduction) / (1.0 - a_LightBleedReduction), 0.0, 1.0);
+	return max(p, pMax);
+}
+
+// Determines the shadow factor from the light's moment map, since the map is pre-blurred and mip-mapped, this is a single fetch
+// @param fragPos The position in the shadow's normalized clip space to sample
+// @param bias The shadow bias factor to use
+float MomentShadow(vec3 fragPos, float bias) {
+	vec4 moments = texture(s_ShadowMoments, fragPos.xy);
+	float depth = fragPos.z - bias;
+	if (a_FilterMode == 2) {
+		// Warp our depth the same way the moments were generated, and take the most conservative of the two bounds
+		float warped = depth * 2.0 - 1.0;
+		float pos = exp(a_EvsmExponents.x * warped);
+		float neg = -exp(-a_EvsmExponents.y * warped);
+		float posLit = ChebyshevUpperBound(moments.xy, pos, 0.0001 * a_EvsmExponents.x * pos * pos);
+		float negLit = ChebyshevUpperBound(moments.zw, neg, 0.0001 * a_EvsmExponents.y * neg * neg);
+		return 1.0 - min(posLit, negLit);
+	} else {
+		return 1.0 - ChebyshevUpperBound(moments.xy, depth, 0.00002);
+	}
+}
+
 void main() {
 	vec4 viewPos = GetViewPos(inUV);         // Extract the world position from the depth buffer
 	vec4 shadowPos = a_LightView * viewPos;  // Determine the position in light clip space
@@ -136,12 +186,15 @@ void main() {
 	shadowPos = shadowPos * 0.5 + 0.5;       // Normalize from clip space to [0,1]
 
 	// Extract our normal from the G Buffer
-	vec3 viewNormal = UnpackNormal(texture(s_GNormal, inUV).rgb);
+	vec3 viewNormal = UnpackNormal(texture(s_GNormal, inUV).rg);
+	vec2 material = texture(s_GMaterial, inUV).rg;
+	matShininess = exp2(material.r * MAX_SHININESS_LOG);
+	matSpecular = material.g;
 
 	// Determine our biasing factor, we have a higher bias the closer the surface is to being parallell
 	float bias = max((a_Bias * 10) * (1.0 - dot(viewNormal, a_LightDir)), a_Bias);
-	// Determine our shadow factor using PCF
-	float shadow = PCF(shadowPos.xyz, bias);
+	// Determine our shadow factor using PCF, or our moments if the light has been pre-filtered
+	float shadow = a_FilterMode == 0 ? PCF(shadowPos.xyz, bias) : MomentShadow(shadowPos.xyz, bias);
 	// If we are outside of the range of our shadow texture, we set shadow to zero
 	if (shadowPos.x < 0 || shadowPos.x > 1 ||
 		shadowPos.y < 0 || shadowPos.y > 1 ||
@@ -0,0 +1,58 @@
+#version 440
+// Upscales the rendered region of the image to the whole screen. This uses a Catmull-Rom filter (in 9 bilinear taps)
+// to keep edges sharp, and then clamps the result to the 4 texels around the sample so that the filter can't ring
+// and leave halos along high contrast edges.
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec2 inScreenCoords ;
+
+layout (location = 0) out vec4 outColor;
+
+uniform sampler2D xImage;
+
+// The fraction of the image that holds the rendered region, inUV is already scaled by this
+uniform vec2 a_UvScale = vec2(1.0);
+
+void main() {
+	vec2 texSize = vec2(textureSize(xImage, 0));
+	// Keep all of our taps inside of the region that was rendered to this frame
+	vec2 minUV = 0.5 / texSize;
+	vec2 maxUV = (a_UvScale * texSize - 0.5) / texSize;
+
+	// Determine the Catmull-Rom weights for the 4x4 texels around our sample
+	vec2 samplePos = inUV * texSize;
+	vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+	vec2 f = samplePos - texPos1;
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+	// The middle two texels on each axis can be combined into a single bilinear tap
+	vec2 w12 = w1 + w2;
+	vec2 tc0  = clamp((texPos1 - 1.0) / texSize, minUV, maxUV);
+	vec2 tc3  = clamp((texPos1 + 2.0) / texSize, minUV, maxUV);
+	vec2 tc12 = clamp((texPos1 + w2 / w12) / texSize, minUV, maxUV);
+
+	vec3 result =
+		textureLod(xImage, vec2(tc0.x,  tc0.y),  0).rgb * w0.x  * w0.y +
+		textureLod(xImage, vec2(tc12.x, tc0.y),  0).rgb * w12.x * w0.y +
+		textureLod(xImage, vec2(tc3.x,  tc0.y),  0).rgb * w3.x  * w0.y +
+		textureLod(xImage, vec2(tc0.x,  tc12.y), 0).rgb * w0.x  * w12.y +
+		textureLod(xImage, vec2(tc12.x, tc12.y), 0).rgb * w12.x * w12.y +
+		textureLod(xImage, vec2(tc3.x,  tc12.y), 0).rgb * w3.x  * w12.y +
+		textureLod(xImage, vec2(tc0.x,  tc3.y),  0).rgb * w0.x  * w3.y +
+		textureLod(xImage, vec2(tc12.x, tc3.y),  0).rgb * w12.x * w3.y +
+		textureLod(xImage, vec2(tc3.x,  tc3.y),  0).rgb * w3.x  * w3.y;
+
+	// Clamp to the nearest 2x2 texels, which removes the ringing that the negative lobes cause at edges
+	ivec2 base = ivec2(texPos1 - 0.5);
+	ivec2 maxTexel = ivec2(a_UvScale * texSize) - 1;
+	vec3 a = texelFetch(xImage, clamp(base,               ivec2(0), maxTexel), 0).rgb;
+	vec3 b = texelFetch(xImage, clamp(base + ivec2(1, 0), ivec2(0), maxTexel), 0).rgb;
+	vec3 c = texelFetch(xImage, clamp(base + ivec2(0, 1), ivec2(0), maxTexel), 0).rgb;
+	vec3 d = texelFetch(xImage, clamp(base + ivec2(1, 1), ivec2(0), maxTexel), 0).rgb;
+	result = clamp(result, min(min(a, b), min(c, d)), max(max(a, b), max(c, d)));
+
+	outColor = vec4(result, 1.0);
+}
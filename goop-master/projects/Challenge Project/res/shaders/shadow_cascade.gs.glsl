@@ -0,0 +1,39 @@
+#version 450
+// Must match MAX_SHADOW_CASCADES in DirectionalLight.h
+#define MAX_CASCADES 4
+
+// We run one instance of the geometry shader per cascade, so a single draw call covers every cascade
+layout(triangles, invocations = MAX_CASCADES) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+// The world->light clip space matrix for each cascade
+uniform mat4 a_LightViewProjection[MAX_CASCADES];
+// The number of cascades that the light is actually using
+uniform int  a_NumLayers;
+
+void main() {
+	if (gl_InvocationID >= a_NumLayers)
+		return;
+
+	// Project the triangle into this cascade
+	vec4 clip[3];
+	for (int ix = 0; ix < 3; ix++) {
+		clip[ix] = a_LightViewProjection[gl_InvocationID] * gl_in[ix].gl_Position;
+	}
+
+	// Cull the triangle if it is entirely outside of the cascade's bounds. Note that we don't cull against the near plane,
+	// since depth clamping will flatten any casters in front of the cascade onto it
+	for (int axis = 0; axis < 2; axis++) {
+		if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w) return;
+		if (clip[0][axis] >  clip[0].w && clip[1][axis] >  clip[1].w && clip[2][axis] >  clip[2].w) return;
+	}
+	if (clip[0].z > clip[0].w && clip[1].z > clip[1].w && clip[2].z > clip[2].w) return;
+
+	// Emit the triangle into the cascade's layer of the texture array
+	for (int ix = 0; ix < 3; ix++) {
+		gl_Position = clip[ix];
+		gl_Layer = gl_InvocationID;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) in vec3 inWorldPos;
+
+// The position of the light, in world space
+uniform vec3  a_LightPos;
+// The distance that the light casts shadows out to
+uniform float a_ShadowRange;
+
+out float gl_FragDepth;
+
+void main() {
+	// We store the linear distance to the light, so the lookup does not need to know which face it landed on
+	gl_FragDepth = length(inWorldPos - a_LightPos) / a_ShadowRange;
+}
@@ -0,0 +1,35 @@
+#version 450
+
+// We run one instance of the geometry shader per cube face, so a single draw call covers the entire cube
+layout(triangles, invocations = 6) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+layout(location = 0) out vec3 outWorldPos;
+
+// The world->face clip space matrix for each face of the cube, in the order +X, -X, +Y, -Y, +Z, -Z
+uniform mat4 a_FaceViewProjection[6];
+// The index of the light's cube within the cube map array
+uniform int  a_CubeIndex;
+
+void main() {
+	// Project the triangle onto this face
+	vec4 clip[3];
+	for (int ix = 0; ix < 3; ix++) {
+		clip[ix] = a_FaceViewProjection[gl_InvocationID] * gl_in[ix].gl_Position;
+	}
+
+	// Cull the triangle if it is entirely outside of this face's frustum, most triangles will only touch one or two faces
+	for (int axis = 0; axis < 3; axis++) {
+		if (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w) return;
+		if (clip[0][axis] >  clip[0].w && clip[1][axis] >  clip[1].w && clip[2][axis] >  clip[2].w) return;
+	}
+
+	// Emit the triangle into this face of the light's cube, each cube takes up 6 consecutive layers
+	for (int ix = 0; ix < 3; ix++) {
+		gl_Position = clip[ix];
+		gl_Layer = a_CubeIndex * 6 + gl_InvocationID;
+		outWorldPos = gl_in[ix].gl_Position.xyz;
+		EmitVertex();
+	}
+	EndPrimitive();
+}
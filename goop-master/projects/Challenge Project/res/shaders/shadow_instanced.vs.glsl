@@ -0,0 +1,10 @@
+#version 450
+// Depth passes draw from the mesh's position-only stream, with the model matrix supplied per instance
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in mat4 inModel;
+
+uniform mat4 a_ViewProjection;
+
+void main() {
+	gl_Position = a_ViewProjection * inModel * vec4(inPosition, 1);
+}
@@ -0,0 +1,9 @@
+#version 450
+// Depth passes draw from the mesh's position-only stream, with the model matrix supplied per instance
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in mat4 inModel;
+
+// We only go to world space here, the geometry shader handles the per-layer projection
+void main() {
+	gl_Position = inModel * vec4(inPosition, 1);
+}
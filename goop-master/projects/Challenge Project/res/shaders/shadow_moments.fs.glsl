@@ -0,0 +1,33 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D a_Mask;
+uniform vec2 a_OutputResolution;
+// True if we should use the mask to ignore sections of the light's view
+uniform bool b_UseMask;
+
+// True if we are storing exponential moments (EVSM), false for regular variance moments (VSM)
+uniform bool b_Exponential;
+// The positive and negative exponents to warp our depth with when using EVSM
+uniform vec2 a_EvsmExponents;
+
+layout (location = 0) out vec4 outMoments;
+
+void main() {
+	float depth = gl_FragCoord.z;
+	// Masked areas act as if there is an occluder right in front of the light
+	if (b_UseMask && texture(a_Mask, gl_FragCoord.xy / a_OutputResolution).r < 0.5f)
+		depth = 0.0f;
+
+	if (b_Exponential) {
+		// Warp our depth into the [-1, 1] range, and store the positive and negative exponential moments
+		depth = depth * 2.0 - 1.0;
+		float pos = exp(a_EvsmExponents.x * depth);
+		float neg = -exp(-a_EvsmExponents.y * depth);
+		outMoments = vec4(pos, pos * pos, neg, neg * neg);
+	} else {
+		// We bias our second moment using the depth derivatives, which helps reduce acne on sloped surfaces
+		float dx = dFdx(depth);
+		float dy = dFdy(depth);
+		outMoments = vec4(depth, depth * depth + 0.25 * (dx * dx + dy * dy), 0.0, 0.0);
+	}
+}
@@ -0,0 +1,67 @@
+#include "AutoExposure.h"
+#include <cmath>
+
+// The size of the work groups in the histogram shader, along each axis
+#define EXPOSURE_GROUP_SIZE 16
+
+// This matches the layout of the b_Exposure blocks in the shaders
+struct ExposureData {
+	float    Exposure;
+	float    AverageLuminance;
+	uint32_t Bins[EXPOSURE_HISTOGRAM_BINS];
+};
+
+AutoExposure::AutoExposure() :
+	myBuffer(0),
+	myKeyValue(0.5f),
+	myAdaptationSpeed(1.5f),
+	myMinLogLuminance(-10.0f),
+	myMaxLogLuminance(4.0f),
+	myExposureLimits(glm::vec2(0.1f, 10.0f))
+{
+	using namespace florp::graphics;
+	myHistogram = std::make_shared<Shader>();
+	myHistogram->LoadPart(ShaderStageType::Compute, "shaders/post/luminance_histogram.comp.glsl");
+	myHistogram->Link();
+
+	myAdapt = std::make_shared<Shader>();
+	myAdapt->LoadPart(ShaderStageType::Compute, "shaders/post/exposure_adapt.comp.glsl");
+	myAdapt->Link();
+
+	// We start from a neutral exposure, after this the buffer is only ever touched by the GPU
+	ExposureData initial = ExposureData();
+	initial.Exposure = 1.0f;
+	glCreateBuffers(1, &myBuffer);
+	glNamedBufferStorage(myBuffer, sizeof(ExposureData), &initial, 0);
+}
+
+AutoExposure::~AutoExposure() {
+	glDeleteBuffers(1, &myBuffer);
+}
+
+void AutoExposure::Apply(const glm::uvec2& viewport, float deltaTime) {
+	Bind();
+	float range = myMaxLogLuminance - myMinLogLuminance;
+
+	// Bin every pixel's luminance, each work group builds its histogram in shared memory before adding it to the buffer
+	myHistogram->SetUniform("a_Viewport", glm::ivec2(viewport));
+	myHistogram->SetUniform("a_MinLogLuminance", myMinLogLuminance);
+	myHistogram->SetUniform("a_InvLogLuminanceRange", 1.0f / range);
+	myHistogram->Dispatch((viewport.x + EXPOSURE_GROUP_SIZE - 1) / EXPOSURE_GROUP_SIZE, (viewport.y + EXPOSURE_GROUP_SIZE - 1) / EXPOSURE_GROUP_SIZE);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// A single group of one invocation per bin finds the average, adapts the exposure, and clears the bins for next frame.
+	// The adaptation is frame rate independent, we move the same fraction of the way per second regardless of frame time
+	myAdapt->SetUniform("a_PixelCount", (float)(viewport.x * viewport.y));
+	myAdapt->SetUniform("a_MinLogLuminance", myMinLogLuminance);
+	myAdapt->SetUniform("a_LogLuminanceRange", range);
+	myAdapt->SetUniform("a_KeyValue", myKeyValue);
+	myAdapt->SetUniform("a_ExposureLimits", myExposureLimits);
+	myAdapt->SetUniform("a_AdaptRate", 1.0f - std::exp(-deltaTime * myAdaptationSpeed));
+	myAdapt->Dispatch(1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void AutoExposure::Bind() const {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EXPOSURE_BUFFER_BINDING, myBuffer);
+}
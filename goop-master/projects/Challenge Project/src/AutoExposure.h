@@ -0,0 +1,59 @@
+#pragma once
+#include <memory>
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+#include "florp/graphics/Shader.h"
+
+// The number of bins in the luminance histogram, bin 0 is reserved for pixels that are too dark to meter
+#define EXPOSURE_HISTOGRAM_BINS 256
+// The shader storage binding that the exposure buffer is bound to, this must match the b_Exposure blocks in the shaders
+#define EXPOSURE_BUFFER_BINDING 1
+
+/*
+ * Adapts the exposure of the scene to its lighting, entirely on the GPU. A compute shader builds a histogram of the
+ * log luminance of the lighting, and a single work group reduces it down to an average and eases the exposure towards
+ * the value that maps that average to our key value. The result stays in a storage buffer that the composite reads
+ * directly, so the CPU never has to wait on a readback.
+ */
+class AutoExposure {
+public:
+	typedef std::shared_ptr<AutoExposure> Sptr;
+
+	AutoExposure();
+	~AutoExposure();
+
+	AutoExposure(const AutoExposure& other) = delete;
+	AutoExposure& operator =(const AutoExposure& other) = delete;
+
+	// The average lighting level that we want the exposure to map to
+	void SetKeyValue(float value) { myKeyValue = value; }
+	float GetKeyValue() const { return myKeyValue; }
+	// How quickly the exposure adapts to changes in lighting, larger values adapt faster
+	void SetAdaptationSpeed(float value) { myAdaptationSpeed = value; }
+	float GetAdaptationSpeed() const { return myAdaptationSpeed; }
+	// The range of luminance covered by the histogram, in log2 units. Anything outside of this range is clamped
+	void SetLuminanceRange(float minLog, float maxLog) { myMinLogLuminance = minLog; myMaxLogLuminance = maxLog; }
+	// The range that the exposure is allowed to adapt within
+	void SetExposureLimits(float min, float max) { myExposureLimits = glm::vec2(min, max); }
+
+	/*
+	 * Meters the lighting that is bound to texture slots 0 (the light accumulation) and 1 (the emissive buffer), and
+	 * adapts the exposure towards it. Once this returns, the exposure buffer is bound to EXPOSURE_BUFFER_BINDING
+	 * @param viewport The region of the textures that holds this frame's lighting, in pixels
+	 * @param deltaTime The time since the last frame, in seconds
+	 */
+	void Apply(const glm::uvec2& viewport, float deltaTime);
+
+	// Binds the exposure buffer to EXPOSURE_BUFFER_BINDING
+	void Bind() const;
+
+private:
+	florp::graphics::Shader::Sptr myHistogram;
+	florp::graphics::Shader::Sptr myAdapt;
+	GLuint    myBuffer;
+	float     myKeyValue;
+	float     myAdaptationSpeed;
+	float     myMinLogLuminance;
+	float     myMaxLogLuminance;
+	glm::vec2 myExposureLimits;
+};
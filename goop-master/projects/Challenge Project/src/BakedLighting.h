@@ -0,0 +1,13 @@
+#pragma once
+#include "florp/bake/LightBaker.h"
+
+// The file that the light baker writes to, and that the scene will load baked lighting from if it exists
+#define BAKED_LIGHTING_FILE "lighting.fbake"
+
+/*
+ * Stored in the registry's context when the scene is using baked lighting. The lightmaps have already been handed off
+ * to the materials of the static geometry, so this only needs to hold onto the probes for the LightingLayer to upload
+ */
+struct BakedLighting {
+	florp::bake::ProbeGrid Probes;
+};
@@ -0,0 +1,80 @@
+#include "BloomChain.h"
+#include "Logging.h"
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+
+// The size of the work groups in our compute shaders, along each axis
+#define BLOOM_GROUP_SIZE 8
+
+BloomChain::BloomChain() :
+	myLevelCount(0),
+	myThreshold(0.8f),
+	myRadius(1.0f)
+{
+	using namespace florp::graphics;
+	myDownsample = std::make_shared<Shader>();
+	myDownsample->LoadPart(ShaderStageType::Compute, "shaders/post/bloom_downsample.comp.glsl");
+	myDownsample->Link();
+
+	myUpsample = std::make_shared<Shader>();
+	myUpsample->LoadPart(ShaderStageType::Compute, "shaders/post/bloom_upsample.comp.glsl");
+	myUpsample->Link();
+}
+
+void BloomChain::Apply(uint32_t width, uint32_t height) {
+	__Resize(width, height);
+	GLuint chain = myChain->GetRenderID();
+
+	// The chain is sampled at binding 1 for reading the previous level, and written through image unit 0
+	myChain->Bind(1);
+
+	// Threshold the scene and downsample it into the top of the chain, then keep halving until we hit the bottom
+	myDownsample->SetUniform("a_BloomThreshold", myThreshold);
+	for (uint32_t level = 0; level < myLevelCount; level++) {
+		glm::uvec2 size = glm::max(glm::uvec2(myChain->GetWidth(), myChain->GetHeight()) >> level, glm::uvec2(1));
+		myDownsample->SetUniform("b_Prefilter", level == 0 ? 1 : 0);
+		myDownsample->SetUniform("a_SourceLevel", level == 0 ? 0 : (int)level - 1);
+		glBindImageTexture(0, chain, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		myDownsample->Dispatch((size.x + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE, (size.y + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE);
+		// The next level will fetch from the one we just wrote, and the upsampling will load it as an image
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	// Walk back up the chain, adding each level into the one above it
+	myUpsample->SetUniform("a_Radius", myRadius);
+	for (int level = (int)myLevelCount - 1; level > 0; level--) {
+		glm::uvec2 size = glm::max(glm::uvec2(myChain->GetWidth(), myChain->GetHeight()) >> (uint32_t)(level - 1), glm::uvec2(1));
+		myUpsample->SetUniform("a_SourceLevel", level);
+		glBindImageTexture(0, chain, level - 1, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+		myUpsample->Dispatch((size.x + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE, (size.y + BLOOM_GROUP_SIZE - 1) / BLOOM_GROUP_SIZE);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+}
+
+void BloomChain::__Resize(uint32_t width, uint32_t height) {
+	// The top of the chain is half the resolution of the source
+	uint32_t chainWidth = glm::max(width / 2, 1u);
+	uint32_t chainHeight = glm::max(height / 2, 1u);
+	if (myChain != nullptr && myChain->GetWidth() == chainWidth && myChain->GetHeight() == chainHeight)
+		return;
+
+	// Figure out how many levels we can fit before the chain gets too small to be useful
+	myLevelCount = 1;
+	while (myLevelCount < BLOOM_MAX_LEVELS && (glm::min(chainWidth, chainHeight) >> myLevelCount) >= BLOOM_MIN_LEVEL_SIZE)
+		myLevelCount++;
+
+	florp::graphics::Texture2dDescription desc = florp::graphics::Texture2dDescription();
+	desc.Width = chainWidth;
+	desc.Height = chainHeight;
+	desc.MipmapLevels = myLevelCount;
+	desc.Format = florp::graphics::InternalFormat::RGBA16F;
+	desc.WrapS = desc.WrapT = florp::graphics::WrapMode::ClampToEdge;
+	desc.MinFilter = florp::graphics::MinFilter::LinearMipNearest;
+	desc.MagFilter = florp::graphics::MagFilter::Linear;
+	myChain = std::make_shared<florp::graphics::Texture2D>(desc);
+	myChain->SetDebugName("Bloom Chain");
+
+	LOG_TRACE("Created bloom chain at {}x{} with {} levels", chainWidth, chainHeight, myLevelCount);
+}
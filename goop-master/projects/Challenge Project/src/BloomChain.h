@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include "florp/graphics/Shader.h"
+#include "florp/graphics/Texture2D.h"
+
+// The maximum number of levels in the bloom mip chain, each level halves the resolution of the last
+#define BLOOM_MAX_LEVELS 6
+// We stop adding levels once the smallest side of the chain would drop below this many texels
+#define BLOOM_MIN_LEVEL_SIZE 8
+
+/*
+ * Generates bloom with a dual filter (Kawase style) mip chain. The highlights of the source image are thresholded and
+ * downsampled into a half resolution chain of mips, which is then upsampled back up with a tent filter, adding each
+ * level into the one above it. This gives a very wide blur with only a couple of small dispatches per level, instead
+ * of many full resolution blur passes.
+ *
+ * Both directions run as compute shaders, with each work group loading the texels it needs into shared memory
+ */
+class BloomChain {
+public:
+	typedef std::shared_ptr<BloomChain> Sptr;
+
+	BloomChain();
+	~BloomChain() = default;
+
+	// The luminance that a color needs to be above before it starts to bloom
+	void SetThreshold(float value) { myThreshold = value; }
+	float GetThreshold() const { return myThreshold; }
+	// The distance between the upsampling taps, in texels of the lower level (0 to 1)
+	void SetRadius(float value) { myRadius = value; }
+	float GetRadius() const { return myRadius; }
+
+	/*
+	 * Runs the bloom chain for the image that is currently bound to texture slot 0. Once this returns, the top level
+	 * of the chain (which holds the final bloom) is bound to texture slot 1
+	 * @param width The width of the source image
+	 * @param height The height of the source image
+	 */
+	void Apply(uint32_t width, uint32_t height);
+
+	// Gets the texture holding the chain, level 0 holds the final result
+	const florp::graphics::Texture2D::Sptr& GetResult() const { return myChain; }
+
+private:
+	florp::graphics::Shader::Sptr    myDownsample;
+	florp::graphics::Shader::Sptr    myUpsample;
+	florp::graphics::Texture2D::Sptr myChain;
+	uint32_t myLevelCount;
+	float    myThreshold;
+	float    myRadius;
+
+	// Re-creates the chain if the source size has changed
+	void __Resize(uint32_t width, uint32_t height);
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <GLM/glm.hpp>
+#include "LayeredDepthBuffer.h"
+
+// The maximum number of cascades that a directional light can use (must match the cascade shaders)
+#define MAX_SHADOW_CASCADES 4
+
+/*
+ * Stores the information for a directional (sun) light. The light shines along the -Z axis of the transform it is attached to,
+ * so only the rotation of the transform matters.
+ *
+ * The camera's view frustum is split into a number of cascades along the view direction, and each cascade gets its own
+ * orthographic shadow map fitted around that slice. All cascades live in a single depth texture array, and are rendered
+ * in a single layered pass
+ */
+struct DirectionalLight {
+	// The depth texture array that stores all of our cascades
+	LayeredDepthBuffer::Sptr ShadowBuffer;
+
+	// The number of cascades to use (between 1 and MAX_SHADOW_CASCADES, and no more than the number of layers in the shadow buffer)
+	int       NumCascades = MAX_SHADOW_CASCADES;
+	// The distance from the camera that shadows will be rendered out to
+	float     ShadowDistance = 100.0f;
+	// Blends between uniform (0) and logarithmic (1) splitting of the view frustum
+	float     SplitLambda = 0.75f;
+	// Extra distance behind each cascade to capture casters that are outside the view frustum
+	float     CasterPadding = 25.0f;
+	// The depth bias to apply when comparing against the shadow map
+	float     Bias = 0.0005f;
+
+	glm::vec3 Color = glm::vec3(1.0f);
+
+	// These are calculated by the LightingLayer every frame
+	// The world->light clip space matrices for each cascade
+	glm::mat4 CascadeViewProjections[MAX_SHADOW_CASCADES];
+	// The far plane of each cascade, as a distance from the camera
+	float     CascadeSplits[MAX_SHADOW_CASCADES];
+};
@@ -0,0 +1,93 @@
+#include "DynamicResolution.h"
+#include "florp/game/SceneManager.h"
+#include "Logging.h"
+#include <GLM/glm.hpp>
+
+// How quickly the smoothed frame time follows the measured times (0 to 1, higher is faster)
+#define DYNAMIC_RES_SMOOTHING 0.1f
+// We don't bother changing the scale if it would change by less than this, to avoid shimmering from tiny adjustments
+#define DYNAMIC_RES_HYSTERESIS 0.02f
+// The largest change we will make to the scale in a single frame
+#define DYNAMIC_RES_MAX_STEP 0.05f
+
+DynamicResolution::DynamicResolution() :
+	myFrameIndex(0),
+	myTargetFrameTime(15.0f), // Leave a little bit of headroom under 60Hz for the CPU and presentation
+	myMinScale(0.5f),
+	myMaxScale(1.0f),
+	myScale(1.0f),
+	myGpuFrameTime(0.0f),
+	isEnabled(true)
+{
+	glGenQueries(DYNAMIC_RES_QUERY_FRAMES * 2, &myQueries[0][0]);
+	for (int ix = 0; ix < DYNAMIC_RES_QUERY_FRAMES; ix++)
+		isPending[ix] = false;
+}
+
+DynamicResolution::~DynamicResolution() {
+	glDeleteQueries(DYNAMIC_RES_QUERY_FRAMES * 2, &myQueries[0][0]);
+}
+
+void DynamicResolution::SetScaleRange(float min, float max) {
+	LOG_ASSERT(min > 0.0f && min <= max, "Invalid render scale range!");
+	// We only ever render into a region of the buffers, so we can't go above their full size
+	myMaxScale = glm::min(max, 1.0f);
+	myMinScale = glm::min(min, myMaxScale);
+	myScale = glm::clamp(myScale, myMinScale, myMaxScale);
+}
+
+void DynamicResolution::BeginFrame() {
+	// If the queries for this slot still haven't come back, we'll have to wait for them rather than overwrite them
+	if (isPending[myFrameIndex]) {
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(myQueries[myFrameIndex][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(myQueries[myFrameIndex][1], GL_QUERY_RESULT, &end);
+		isPending[myFrameIndex] = false;
+		__Update((float)(end - begin) / 1000000.0f);
+	}
+	glQueryCounter(myQueries[myFrameIndex][0], GL_TIMESTAMP);
+}
+
+void DynamicResolution::EndFrame() {
+	glQueryCounter(myQueries[myFrameIndex][1], GL_TIMESTAMP);
+	isPending[myFrameIndex] = true;
+	myFrameIndex = (myFrameIndex + 1) % DYNAMIC_RES_QUERY_FRAMES;
+
+	// Collect any older frames that the GPU has finished with, without waiting for the ones that are still running. We
+	// start from the oldest (which is the slot that the next frame will use), and stop at the first one that isn't ready
+	// so the timings are fed in the order the frames were drawn
+	for (int ix = 0; ix < DYNAMIC_RES_QUERY_FRAMES; ix++) {
+		uint32_t slot = (myFrameIndex + ix) % DYNAMIC_RES_QUERY_FRAMES;
+		if (!isPending[slot])
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(myQueries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(myQueries[slot][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(myQueries[slot][1], GL_QUERY_RESULT, &end);
+		isPending[slot] = false;
+		__Update((float)(end - begin) / 1000000.0f);
+	}
+}
+
+const DynamicResolution::Sptr& DynamicResolution::Get() {
+	Sptr& result = CurrentRegistry().ctx_or_set<Sptr>();
+	if (result == nullptr)
+		result = std::make_shared<DynamicResolution>();
+	return result;
+}
+
+void DynamicResolution::__Update(float frameTime) {
+	myGpuFrameTime = myGpuFrameTime == 0.0f ? frameTime : glm::mix(myGpuFrameTime, frameTime, DYNAMIC_RES_SMOOTHING);
+	if (!isEnabled || myGpuFrameTime <= 0.0f)
+		return;
+
+	// Our cost is roughly proportional to the pixel count, which goes with the square of the scale
+	float desired = myScale * glm::sqrt(myTargetFrameTime / myGpuFrameTime);
+	desired = glm::clamp(desired, myMinScale, myMaxScale);
+	if (glm::abs(desired - myScale) < DYNAMIC_RES_HYSTERESIS && desired != myMinScale && desired != myMaxScale)
+		return;
+	myScale += glm::clamp(desired - myScale, -DYNAMIC_RES_MAX_STEP, DYNAMIC_RES_MAX_STEP);
+}
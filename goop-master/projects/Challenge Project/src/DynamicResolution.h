@@ -0,0 +1,71 @@
+#pragma once
+#include <memory>
+#include <glad/glad.h>
+
+// The number of frames of GPU timer queries we keep in flight, so that we never stall waiting on a result
+#define DYNAMIC_RES_QUERY_FRAMES 4
+
+/*
+ * Adjusts the resolution that the main camera renders at to hold a target GPU frame time. The GPU time of every frame
+ * is measured with timestamp queries (read back a few frames later, once they are ready), and the render scale is
+ * nudged up or down to match the target. Since the cost of most of our passes scales with the number of pixels, the
+ * scale moves with the square root of the ratio between the target and measured times.
+ *
+ * The buffers are never re-allocated, the camera just renders into the bottom-left corner of its buffers (the origin
+ * of the viewport and of UVs), and everything after that works on the same region until the final upscale to the
+ * screen (see a_UvScale in the post shaders). Every region is rounded up to whole pixels, so we never sample texels
+ * that were not written. The controller is shared between the layers through the registry context, see DynamicResolution::Get
+ */
+class DynamicResolution {
+public:
+	typedef std::shared_ptr<DynamicResolution> Sptr;
+
+	DynamicResolution();
+	~DynamicResolution();
+
+	// The GPU time that we are trying to hold each frame at, in milliseconds
+	void SetTargetFrameTime(float ms) { myTargetFrameTime = ms; }
+	float GetTargetFrameTime() const { return myTargetFrameTime; }
+
+	// The limits on the render scale (1 is the full size of the buffers)
+	void SetScaleRange(float min, float max);
+	float GetMinScale() const { return myMinScale; }
+	float GetMaxScale() const { return myMaxScale; }
+
+	// Turns the controller on or off, when disabled the scale will be locked at the maximum
+	void SetEnabled(bool enabled) { isEnabled = enabled; }
+	bool IsEnabled() const { return isEnabled; }
+
+	// Gets the render scale to use for this frame
+	float GetScale() const { return isEnabled ? myScale : myMaxScale; }
+	// Gets the smoothed GPU frame time, in milliseconds
+	float GetGpuFrameTime() const { return myGpuFrameTime; }
+
+	/*
+	 * Marks the start of the GPU work for a frame, this should be called before any rendering
+	 */
+	void BeginFrame();
+	/*
+	 * Marks the end of the GPU work for a frame, and updates the render scale from any frames that have finished
+	 */
+	void EndFrame();
+
+	/*
+	 * Gets the controller shared by all the layers in the current scene, creating it if it does not exist yet
+	 */
+	static const Sptr& Get();
+
+private:
+	// A begin and end timestamp for every frame in flight
+	GLuint   myQueries[DYNAMIC_RES_QUERY_FRAMES][2];
+	bool     isPending[DYNAMIC_RES_QUERY_FRAMES];
+	uint32_t myFrameIndex;
+
+	float    myTargetFrameTime;
+	float    myMinScale, myMaxScale;
+	float    myScale;
+	float    myGpuFrameTime;
+	bool     isEnabled;
+
+	void __Update(float frameTime);
+};
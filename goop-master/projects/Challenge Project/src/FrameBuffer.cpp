@@ -2,11 +2,19 @@
 #include "Logging.h"
 #include <GLM/glm.hpp>
 
+// The texture slot we bind the multisampled depth to while resolving. GL 4.5 guarantees at least 80 slots, we use the
+// last of those so that we don't disturb anything that the caller has already bound
+#define DEPTH_RESOLVE_SLOT 79
+
+florp::graphics::Shader::Sptr FrameBuffer::myDepthResolveShader = nullptr;
+GLuint FrameBuffer::myEmptyVao = 0;
+
 FrameBuffer::RenderBuffer::RenderBuffer() :
 	RendererID(0),
 	Resource(florp::graphics::IGraphicsResource::Sptr()),
 	IsRenderBuffer(false),
-	Description(RenderBufferDesc()) { }
+	Description(RenderBufferDesc()),
+	NeedsResolve(false) { }
 
 FrameBuffer::FrameBuffer(uint32_t width, uint32_t height, uint8_t numSamples) {
 	myWidth = width;
@@ -16,6 +24,7 @@ FrameBuffer::FrameBuffer(uint32_t width, uint32_t height, uint8_t numSamples) {
 	int maxSamples = 0;
 	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
 	myNumSamples = glm::clamp((int)numSamples, 1, maxSamples);
+	myDepthResolveMode = DepthResolveMode::Sample0;
 	isValid = false;
 
 	glCreateFramebuffers(1, &myRendererID);
@@ -33,6 +42,7 @@ FrameBuffer::~FrameBuffer()
 
 florp::graphics::Texture2D::Sptr FrameBuffer::GetAttachment(RenderTargetAttachment attachment) {
 	if (myNumSamples > 1) {
+		Resolve(attachment);
 		return myUnsampledFrameBuffer->GetAttachment(attachment);
 	} else {
 		if (myLayers.find(attachment) != myLayers.end()) {
@@ -84,6 +94,7 @@ void FrameBuffer::AddAttachment(const RenderBufferDesc& desc)
 	RenderBuffer& buffer = myLayers[desc.Attachment];
 	buffer.Description = desc;
 	buffer.IsRenderBuffer = !desc.ShaderReadable;
+	buffer.NeedsResolve = false;
 
 	// Handling for when we can use renderbuffers instead of textures
 	if (buffer.IsRenderBuffer) {
@@ -105,10 +116,10 @@ void FrameBuffer::AddAttachment(const RenderBufferDesc& desc)
 		imageDesc.Width = myWidth;
 		imageDesc.Height = myHeight;
 		imageDesc.WrapS = imageDesc.WrapT = florp::graphics::WrapMode::ClampToEdge;
-		imageDesc.MinFilter = florp::graphics::MinFilter::Linear;
+		imageDesc.MinFilter = desc.MipmapLevels > 1 ? florp::graphics::MinFilter::LinearMipLinear : florp::graphics::MinFilter::Linear;
 		imageDesc.Format = (florp::graphics::InternalFormat)desc.Format;
 		imageDesc.NumSamples = myNumSamples;
-		imageDesc.MipmapLevels = 1; // NEW
+		imageDesc.MipmapLevels = glm::max(desc.MipmapLevels, 1u); // NEW
 
 		// Create the image, and store it's info in our buffer tag
 		florp::graphics::Texture2D::Sptr image = std::make_shared<florp::graphics::Texture2D>(imageDesc);
@@ -160,6 +171,13 @@ bool FrameBuffer::Validate()
 	}
 }
 
+void FrameBuffer::GenerateMipmaps(RenderTargetAttachment attachment) {
+	florp::graphics::Texture2D::Sptr texture = GetAttachment(attachment);
+	if (texture != nullptr && texture->GetMipLevels() > 1) {
+		glGenerateTextureMipmap(texture->GetRenderID());
+	}
+}
+
 void FrameBuffer::Bind(uint32_t slot) {
 	GetAttachment(RenderTargetAttachment::Color0)->Bind(slot);
 }
@@ -170,30 +188,110 @@ void FrameBuffer::Bind(uint32_t slot, RenderTargetAttachment attachment) {
 
 void FrameBuffer::Bind(RenderTargetBinding bindMode) const {
 	myBinding = bindMode;
+	if (bindMode == RenderTargetBinding::Draw || bindMode == RenderTargetBinding::Both)
+		__MarkDirty();
 	glBindFramebuffer((GLenum)bindMode, myRendererID);
 }
 
 void FrameBuffer::UnBind() const {
 	if (myBinding != RenderTargetBinding::None) {
-		if (myNumSamples > 1) {
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, myRendererID);
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, myUnsampledFrameBuffer->myRendererID);
-			Blit({ 0, 0, myWidth, myHeight }, { 0, 0, myWidth, myHeight }, BufferFlags::All, florp::graphics::MagFilter::Nearest);
-			for (auto& kvp : myLayers) {
-				if (IsColorAttachment(kvp.first)) {
-					glReadBuffer(*kvp.first);
-					glDrawBuffer(*kvp.first);
-					Blit({ 0, 0, myWidth, myHeight }, { 0, 0, myWidth, myHeight }, BufferFlags::Color, florp::graphics::MagFilter::Linear);
-				}
-			}
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-		}
+		// We don't resolve here, since nothing may ever read from us. Instead we just note that the resolved copies are
+		// out of date, and resolve each attachment when it is next bound as a texture
+		if (myBinding == RenderTargetBinding::Draw || myBinding == RenderTargetBinding::Both)
+			__MarkDirty();
 		glBindFramebuffer((GLenum)myBinding, 0);
 		myBinding = RenderTargetBinding::None;
 	}
 }
 
+void FrameBuffer::Resolve(RenderTargetAttachment attachment) {
+	if (myNumSamples <= 1)
+		return;
+	// Render buffers can't be read from as textures, so they never have a resolved copy
+	auto it = myLayers.find(attachment);
+	if (it == myLayers.end() || it->second.IsRenderBuffer || !it->second.NeedsResolve)
+		return;
+	it->second.NeedsResolve = false;
+
+	GLuint target = myUnsampledFrameBuffer->myRendererID;
+	if (IsColorAttachment(attachment)) {
+		// Only copy the one attachment, rather than everything we have
+		glNamedFramebufferReadBuffer(myRendererID, *attachment);
+		glNamedFramebufferDrawBuffer(target, *attachment);
+		glBlitNamedFramebuffer(myRendererID, target, 0, 0, myWidth, myHeight, 0, 0, myWidth, myHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		// Restore the draw buffers on the resolved buffer, in case anything renders into it directly
+		const std::vector<RenderTargetAttachment>& drawBuffers = myUnsampledFrameBuffer->myDrawBuffers;
+		glNamedFramebufferDrawBuffers(target, (GLsizei)drawBuffers.size(), reinterpret_cast<const GLenum*>(drawBuffers.data()));
+		glNamedFramebufferReadBuffer(myRendererID, GL_COLOR_ATTACHMENT0);
+	}
+	else {
+		GLbitfield mask = attachment == RenderTargetAttachment::Stencil ? GL_STENCIL_BUFFER_BIT :
+			attachment == RenderTargetAttachment::DepthStencil ? GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT : GL_DEPTH_BUFFER_BIT;
+		if (attachment != RenderTargetAttachment::Stencil && myDepthResolveMode != DepthResolveMode::Sample0) {
+			__ResolveDepth(it->second);
+			mask &= ~GL_DEPTH_BUFFER_BIT;
+		}
+		if (mask != 0)
+			glBlitNamedFramebuffer(myRendererID, target, 0, 0, myWidth, myHeight, 0, 0, myWidth, myHeight, mask, GL_NEAREST);
+	}
+}
+
+void FrameBuffer::__MarkDirty() const {
+	if (myNumSamples > 1) {
+		for (auto& kvp : myLayers)
+			kvp.second.NeedsResolve = true;
+	}
+}
+
+void FrameBuffer::__ResolveDepth(const RenderBuffer& buffer) {
+	if (myDepthResolveShader == nullptr) {
+		myDepthResolveShader = std::make_shared<florp::graphics::Shader>();
+		myDepthResolveShader->LoadPart(florp::graphics::ShaderStageType::VertexShader, "shaders/fullscreen.vs.glsl");
+		myDepthResolveShader->LoadPart(florp::graphics::ShaderStageType::FragmentShader, "shaders/depth_resolve.fs.glsl");
+		myDepthResolveShader->Link();
+		myDepthResolveShader->SetDebugName("Depth Resolve");
+		glCreateVertexArrays(1, &myEmptyVao);
+	}
+
+	// This can happen in the middle of another pass, so we need to put back everything we touch
+	GLint drawBuffer, program, vao, depthFunc, viewport[4];
+	GLboolean depthTest, depthMask, colorMask[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawBuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetBooleanv(GL_DEPTH_TEST, &depthTest);
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+
+	// The shader writes gl_FragDepth, which is only stored when depth testing is on
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, myUnsampledFrameBuffer->myRendererID);
+	glViewport(0, 0, myWidth, myHeight);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	glBindTextureUnit(DEPTH_RESOLVE_SLOT, buffer.RendererID);
+	myDepthResolveShader->Use();
+	myDepthResolveShader->SetUniform("s_Depth", DEPTH_RESOLVE_SLOT);
+	myDepthResolveShader->SetUniform("a_Mode", (int)myDepthResolveMode);
+	myDepthResolveShader->SetUniform("a_NumSamples", (int)myNumSamples);
+	glBindVertexArray(myEmptyVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glBindVertexArray(vao);
+	glUseProgram(program);
+	glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+	glDepthMask(depthMask);
+	glDepthFunc(depthFunc);
+	if (!depthTest)
+		glDisable(GL_DEPTH_TEST);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawBuffer);
+}
+
 void FrameBuffer::Blit(const glm::ivec4& srcBounds, const glm::ivec4& dstBounds, BufferFlags flags, florp::graphics::MagFilter filterMode) {
 	glBlitFramebuffer(
 		srcBounds.x, srcBounds.y, srcBounds.z, srcBounds.w,
@@ -203,6 +301,7 @@ void FrameBuffer::Blit(const glm::ivec4& srcBounds, const glm::ivec4& dstBounds,
 
 FrameBuffer::Sptr FrameBuffer::Clone() const {
 	auto result = std::make_shared<FrameBuffer>(myWidth, myHeight, myNumSamples);
+	result->myDepthResolveMode = myDepthResolveMode;
 
 	for (auto& kvp : myLayers) {
 		result->AddAttachment(kvp.second.Description);
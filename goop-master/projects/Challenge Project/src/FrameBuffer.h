@@ -7,6 +7,7 @@
 #include "EnumToString.h"
 #include <unordered_map>
 #include "florp/graphics/Texture2D.h"
+#include "florp/graphics/Shader.h"
 
 ENUM(RenderTargetAttachment, uint32_t,
      Color0       = GL_COLOR_ATTACHMENT0,
@@ -31,9 +32,13 @@ ENUM(RenderTargetType, uint32_t,
 	ColorRgb10   = GL_RGB10,
 	ColorRgb8    = GL_RGB8,
 	ColorRG8     = GL_RG8,
+	ColorRg16    = GL_RG16,
 	ColorRed8    = GL_R8,
 	ColorRgb16F  = GL_RGB16F, // NEW
 	ColorRgba16F = GL_RGBA16F,
+	ColorR11G11B10F = GL_R11F_G11F_B10F,
+	ColorRg32F   = GL_RG32F,
+	ColorRgba32F = GL_RGBA32F,
 	DepthStencil = GL_DEPTH24_STENCIL8,
 	Depth16      = GL_DEPTH_COMPONENT16,
 	Depth24      = GL_DEPTH_COMPONENT24,
@@ -60,6 +65,15 @@ ENUM_FLAGS(BufferFlags, GLenum,
 	All     = Color | Depth | Stencil
 );
 
+/*
+ * How the samples of a multisampled depth attachment are combined when it is resolved
+ */
+ENUM(DepthResolveMode, uint32_t,
+	Sample0 = 0, // Resolved with a blit, which takes the first sample on most drivers
+	Min     = 1, // The closest sample to the camera
+	Max     = 2  // The furthest sample from the camera
+);
+
 struct RenderBufferDesc {
 	/*
 	 * If this is set to true, we will generate an OpenGL texture instead of a render buffer
@@ -73,6 +87,11 @@ struct RenderBufferDesc {
 	 * Where the buffer will be attached to
 	 */
 	RenderTargetAttachment Attachment;
+	/*
+	 * The number of mip levels to allocate if this is a texture (only level 0 is rendered to, see FrameBuffer::GenerateMipmaps)
+	 * Default is 1
+	 */
+	uint32_t MipmapLevels = 1;
 };
 
 /*
@@ -102,10 +121,26 @@ public:
 	glm::ivec2 GetSize() const { return { myWidth, myHeight }; }
 
 	/*
-	 * Gets the given attachment as a Texture, or nullptr if the attachment point cannot be retrieved as a texture
+	 * Gets the given attachment as a Texture, or nullptr if the attachment point cannot be retrieved as a texture. If
+	 * this frame buffer is multisampled, this will resolve the attachment first if it has been drawn to
 	 */
 	florp::graphics::Texture2D::Sptr GetAttachment(RenderTargetAttachment attachment);
 
+	/*
+	 * Resolves a multisampled attachment into its single sampled texture, if it has been drawn to since it was last
+	 * resolved. Attachments are resolved automatically when they are bound as textures, so this only needs to be
+	 * called if the texture is used some other way. Does nothing if this frame buffer is not multisampled
+	 * @param attachment The attachment to resolve
+	 */
+	void Resolve(RenderTargetAttachment attachment);
+
+	/*
+	 * Sets how the depth attachment is resolved if this frame buffer is multisampled. Min and Max are resolved with a
+	 * shader, while Sample0 uses a blit
+	 */
+	void SetDepthResolveMode(DepthResolveMode mode) { myDepthResolveMode = mode; }
+	DepthResolveMode GetDepthResolveMode() const { return myDepthResolveMode; }
+
 	/*
 	 * Resizes this frame buffer to the new dimensions. Note that this will destroy any data currently stored within it,
 	 * and invalidate any texture handles that have been retrieved from this frame buffer
@@ -127,11 +162,19 @@ public:
 	 */
 	bool Validate();
 
+	/*
+	 * Regenerates the mip chain for the given attachment from it's first level. Does nothing if the attachment is
+	 * not a texture, or only has a single mip level
+	 * @param attachment The attachment to generate the mip chain for (default is Color0)
+	 */
+	void GenerateMipmaps(RenderTargetAttachment attachment = RenderTargetAttachment::Color0);
+
 	virtual void Bind(uint32_t slot) override;
 	virtual void Bind(uint32_t slot, RenderTargetAttachment attachment);
 	
 	/*
-	 * Binds this frame buffer for usage as either a reading buffer, writing buffer, or both
+	 * Binds this frame buffer for usage as either a reading buffer, writing buffer, or both. Binding for drawing marks
+	 * all of our attachments as needing to be resolved (if we are multisampled)
 	 * @param bindMode The slot to bind to (default is Draw/Write)
 	 */
 	void Bind(RenderTargetBinding bindMode = RenderTargetBinding::Draw) const;
@@ -174,6 +217,7 @@ protected:
 
 	// We will store a pointer to another FBO if this one is multisampled
 	Sptr                        myUnsampledFrameBuffer;
+	DepthResolveMode            myDepthResolveMode;
 
 	// Stores our attachment information for a given render buffer attachment point
 	struct RenderBuffer {
@@ -181,11 +225,23 @@ protected:
 		florp::graphics::IGraphicsResource::Sptr Resource;
 		bool             IsRenderBuffer;
 		RenderBufferDesc Description;
+		// Whether the multisampled buffer has been drawn to since it was last resolved
+		mutable bool     NeedsResolve;
 
 		RenderBuffer();
 	};
 	// Stores our buffers per attachment point
 	std::unordered_map<RenderTargetAttachment, RenderBuffer> myLayers;
 	std::vector<RenderTargetAttachment> myDrawBuffers;  // NEW
+
+	// Shared by all frame buffers for resolving depth with the min or max of the samples
+	static florp::graphics::Shader::Sptr myDepthResolveShader;
+	// Core profile needs a VAO bound to draw, even though the resolve generates its vertices
+	static GLuint myEmptyVao;
+
+	// Marks all of our attachments as having been drawn to
+	void __MarkDirty() const;
+	// Resolves the depth attachment with the given mode, using a shader
+	void __ResolveDepth(const RenderBuffer& buffer);
 };
 
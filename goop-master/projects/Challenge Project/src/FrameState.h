@@ -5,6 +5,8 @@
 // Represents the state for the previous or current frame
 struct FrameState {
 	FrameBuffer::Sptr Output;	
+	// The region of Output that was rendered to, starting from (0, 0). This is smaller than the buffer when rendering at a reduced resolution
+	glm::uvec2        Viewport;
 	glm::mat4         View;
 	glm::mat4         Projection;
 	glm::mat4         ViewProjection;
@@ -15,4 +17,9 @@ struct AppFrameState
 {
 	FrameState Current;
 	FrameState Last;
+
+	// Gets the fraction of the output buffer that was rendered to this frame, for scaling UVs
+	glm::vec2 GetUvScale() const {
+		return glm::vec2(Current.Viewport) / glm::vec2(Current.Output->GetWidth(), Current.Output->GetHeight());
+	}
 };
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include "GBufferLayout.h"
+#include "florp/game/SceneManager.h"
+
+FrameBuffer::Sptr GBufferLayout::CreateBuffer(uint32_t width, uint32_t height) const {
+	// Every attachment will be read by the lighting passes, so they all need to be textures
+	auto attachment = [](RenderTargetAttachment point, RenderTargetType format) {
+		RenderBufferDesc result = RenderBufferDesc();
+		result.ShaderReadable = true;
+		result.Attachment = point;
+		result.Format = format;
+		return result;
+	};
+
+	FrameBuffer::Sptr result = std::make_shared<FrameBuffer>(width, height, NumSamples);
+	result->AddAttachment(attachment(RenderTargetAttachment::Color0, Albedo));
+	result->AddAttachment(attachment(RenderTargetAttachment::Color1, Normal));
+	result->AddAttachment(attachment(RenderTargetAttachment::Color2, Emissive));
+	result->AddAttachment(attachment(RenderTargetAttachment::Color3, Material));
+	result->AddAttachment(attachment(RenderTargetAttachment::Depth, Depth));
+	result->Validate();
+	return result;
+}
+
+GBufferLayout& GBufferLayout::Get() {
+	return CurrentRegistry().ctx_or_set<GBufferLayout>();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "FrameBuffer.h"
+
+/*
+ * Describes the formats of the attachments in the deferred G-Buffer, and of the lighting accumulation buffer. The
+ * layout is stored in the registry context (see GBufferLayout::Get), so the scene can change it before the camera is
+ * created, and the lighting layer will pick up the matching accumulation format.
+ *
+ * The shaders expect the following in each attachment:
+ *    Color0 - Albedo (rgb)
+ *    Color1 - Normal (view space, octahedral encoded into rg, see PackNormal in the forward shaders)
+ *    Color2 - Emissive and baked light (rgb, in the same units as the light accumulation)
+ *    Color3 - Material (r is the log2 encoded shininess, g is the specular strength)
+ */
+struct GBufferLayout {
+	RenderTargetType Albedo       = RenderTargetType::ColorRgb8;
+	// Octahedral normals only need 2 channels, 16 bits each is plenty for smooth highlights
+	RenderTargetType Normal       = RenderTargetType::ColorRg16;
+	// Packed floats, since emissive strengths and baked lighting can go above 1
+	RenderTargetType Emissive     = RenderTargetType::ColorR11G11B10F;
+	RenderTargetType Material     = RenderTargetType::ColorRG8;
+	RenderTargetType Depth        = RenderTargetType::Depth32;
+	// The lighting accumulation buffer, this only needs to be HDR, not signed or very precise
+	RenderTargetType Accumulation = RenderTargetType::ColorR11G11B10F;
+	uint8_t          NumSamples   = 4;
+
+	/*
+	 * Creates a new G-Buffer with this layout
+	 * @param width The width of the buffer, in pixels
+	 * @param height The height of the buffer, in pixels
+	 */
+	FrameBuffer::Sptr CreateBuffer(uint32_t width, uint32_t height) const;
+
+	/*
+	 * Gets the layout used by the current scene, creating the default layout if it has not been set
+	 */
+	static GBufferLayout& Get();
+};
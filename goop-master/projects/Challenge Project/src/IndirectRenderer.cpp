@@ -0,0 +1,247 @@
+#include "IndirectRenderer.h"
+#include <florp\game\RenderableComponent.h>
+#include <florp\game\Transform.h>
+#include <florp\app\Timing.h>
+#include "Logging.h"
+
+// The size of the work groups in the culling shader
+#define INDIRECT_CULL_GROUP_SIZE 64
+
+IndirectRenderer::IndirectRenderer() {
+	using namespace florp::graphics;
+	// glMultiDrawElementsIndirectCount and gl_BaseInstance are only core as of 4.6, and our shaders are #version 460
+	LOG_ASSERT(GLAD_GL_VERSION_4_6, "The indirect renderer needs OpenGL 4.6, but the context is only {}.{}", GLVersion.major, GLVersion.minor);
+	myCullShader = std::make_shared<Shader>();
+	myCullShader->LoadPart(ShaderStageType::Compute, "shaders/cull_draws.comp.glsl");
+	myCullShader->Link();
+	myMeshletCullShader = std::make_shared<Shader>();
+	myMeshletCullShader->LoadPart(ShaderStageType::Compute, "shaders/cull_meshlets.comp.glsl");
+	myMeshletCullShader->Link();
+
+	glCreateBuffers(BufferCount, myBuffers);
+	for (int ix = 0; ix < BufferCount; ix++)
+		myCapacities[ix] = 0;
+}
+
+IndirectRenderer::~IndirectRenderer() {
+	glDeleteBuffers(BufferCount, myBuffers);
+}
+
+void IndirectRenderer::Gather(entt::registry& ecs) {
+	using namespace florp::game;
+	myObjects.clear();
+	myDraws.clear();
+	myGroupOffsets.clear();
+	myGroups.clear();
+	myDirectDraws.clear();
+	myMeshletDraws.clear();
+	myMeshletGroups.clear();
+	myMeshletCommands.clear();
+
+	// The culling shader uses the draw's index to find its object, so the objects for our other draws go after all of
+	// the culled ones, and we hold on to them until the end
+	std::vector<ObjectData> meshletObjects;
+	std::vector<ObjectData> directObjects;
+	uint32_t meshletIndexCount = 0;
+
+	// Every draw in a group needs the same material, vertex array, and constant attributes, since we can't change
+	// any of those in the middle of a multi-draw
+	auto needsNewGroup = [](const std::vector<DrawGroup>& groups, const RenderableComponent& renderer) {
+		return groups.empty() ||
+			groups.back().Material != renderer.Material ||
+			groups.back().Mesh->GetArena() != renderer.Mesh->GetArena() ||
+			groups.back().Mesh->GetConstantAttributes() != renderer.Mesh->GetConstantAttributes();
+	};
+
+	auto view = ecs.view<RenderableComponent>();
+	for (const auto& entity : view) {
+		const RenderableComponent& renderer = ecs.get<RenderableComponent>(entity);
+		if (renderer.Mesh == nullptr || renderer.Material == nullptr)
+			continue;
+
+		const Transform& transform = ecs.get_or_assign<Transform>(entity);
+		ObjectData object;
+		object.Model = transform.GetWorldTransform();
+		object.NormalMatrix = glm::transpose(glm::inverse(object.Model));
+
+		if (renderer.Material->RasterState.Blending.BlendEnabled || renderer.Mesh->GetIndexCount() == 0) {
+			myDirectDraws.push_back({ renderer.Material, renderer.Mesh, 0 });
+			directObjects.push_back(object);
+			continue;
+		}
+
+		if (renderer.Mesh->HasMeshlets()) {
+			if (needsNewGroup(myMeshletGroups, renderer))
+				myMeshletGroups.push_back({ renderer.Material, renderer.Mesh, (uint32_t)myMeshletDraws.size(), 0 });
+			myMeshletGroups.back().CommandCount++;
+			// The object index is filled in once we know how many culled draws there are. The worst case is that every
+			// meshlet is visible, so that's how much room each object gets in the meshlet index buffer
+			myMeshletDraws.push_back({ renderer.Mesh, 0, meshletIndexCount });
+			meshletObjects.push_back(object);
+			meshletIndexCount += renderer.Mesh->GetMeshletIndexCount();
+			continue;
+		}
+
+		if (needsNewGroup(myGroups, renderer)) {
+			myGroupOffsets.push_back((uint32_t)myDraws.size());
+			myGroups.push_back({ renderer.Material, renderer.Mesh, (uint32_t)myDraws.size(), 0 });
+		}
+		myGroups.back().CommandCount++;
+
+		DrawData draw;
+		draw.BoundingSphere = renderer.Mesh->GetBoundingSphere();
+		draw.IndexCount = (uint32_t)renderer.Mesh->GetIndexCount();
+		draw.FirstIndex = renderer.Mesh->GetFirstIndex();
+		draw.BaseVertex = (int32_t)renderer.Mesh->GetBaseVertex();
+		draw.Group = (uint32_t)myGroups.size() - 1;
+		myDraws.push_back(draw);
+		myObjects.push_back(object);
+	}
+
+	for (size_t ix = 0; ix < myMeshletDraws.size(); ix++) {
+		MeshletDraw& draw = myMeshletDraws[ix];
+		draw.Object = (uint32_t)myObjects.size();
+		myObjects.push_back(meshletObjects[ix]);
+		// The count is filled in by the meshlet culling shader
+		myMeshletCommands.push_back({ 0, 1, draw.OutputOffset, (int32_t)draw.Mesh->GetBaseVertex(), draw.Object });
+	}
+	for (size_t ix = 0; ix < myDirectDraws.size(); ix++) {
+		myDirectDraws[ix].Object = (uint32_t)myObjects.size();
+		myObjects.push_back(directObjects[ix]);
+	}
+
+	__Upload(ObjectBuffer, myObjects.data(), myObjects.size() * sizeof(ObjectData));
+	__Upload(DrawBuffer, myDraws.data(), myDraws.size() * sizeof(DrawData));
+	__Upload(GroupOffsetBuffer, myGroupOffsets.data(), myGroupOffsets.size() * sizeof(uint32_t));
+	// These are filled in by the culling shader
+	__Upload(GroupCountBuffer, nullptr, myGroups.size() * sizeof(uint32_t));
+	__Upload(CommandBuffer, nullptr, myDraws.size() * sizeof(DrawCommand));
+	// The meshlet commands are reset from myMeshletCommands for each camera
+	__Upload(MeshletCommandBuffer, nullptr, myMeshletCommands.size() * sizeof(DrawCommand));
+	__Upload(MeshletIndexBuffer, nullptr, (size_t)meshletIndexCount * sizeof(uint32_t));
+}
+
+void IndirectRenderer::Render(const glm::mat4& view, const glm::mat4& viewProjection) {
+	using namespace florp::game;
+	using namespace florp::graphics;
+	if (myObjects.empty())
+		return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_OBJECT_BINDING, myBuffers[ObjectBuffer]);
+
+	// Pull the frustum planes out of the view projection (Gribb and Hartmann), each row of the matrix is a column of
+	// its transpose. We normalize them so that the distance to the plane can be compared against the sphere's radius
+	glm::mat4 rows = glm::transpose(viewProjection);
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2]
+	};
+	for (glm::vec4& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	if (!myDraws.empty()) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_DRAW_BINDING, myBuffers[DrawBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_GROUP_OFFSET_BINDING, myBuffers[GroupOffsetBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_GROUP_COUNT_BINDING, myBuffers[GroupCountBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_COMMAND_BINDING, myBuffers[CommandBuffer]);
+
+		// Every group starts out empty, the culling shader counts up the draws that survive
+		uint32_t zero = 0;
+		glClearNamedBufferSubData(myBuffers[GroupCountBuffer], GL_R32UI, 0, myGroups.size() * sizeof(uint32_t), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+		myCullShader->SetUniform("a_DrawCount", (int)myDraws.size());
+		myCullShader->SetUniforms("a_FrustumPlanes", 6, planes);
+		myCullShader->Dispatch(((uint32_t)myDraws.size() + INDIRECT_CULL_GROUP_SIZE - 1) / INDIRECT_CULL_GROUP_SIZE);
+	}
+
+	if (!myMeshletDraws.empty()) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_MESHLET_OUTPUT_BINDING, myBuffers[MeshletIndexBuffer]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_MESHLET_COMMAND_BINDING, myBuffers[MeshletCommandBuffer]);
+		// Every command starts out with no indices, the culling shader adds the triangles of each visible meshlet
+		glNamedBufferSubData(myBuffers[MeshletCommandBuffer], 0, myMeshletCommands.size() * sizeof(DrawCommand), myMeshletCommands.data());
+
+		myMeshletCullShader->SetUniforms("a_FrustumPlanes", 6, planes);
+		myMeshletCullShader->SetUniform("a_CameraPosition", glm::vec3(glm::inverse(view)[3]));
+		// Each mesh has its own meshlet buffers, so we need a dispatch per object. Meshlets are meant for a handful of
+		// large meshes, so this is still far less work than drawing them whole
+		for (size_t ix = 0; ix < myMeshletDraws.size(); ix++) {
+			const MeshletDraw& draw = myMeshletDraws[ix];
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_MESHLET_BINDING, draw.Mesh->GetMeshletBuffer());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_MESHLET_INDEX_BINDING, draw.Mesh->GetMeshletIndexBuffer());
+			myMeshletCullShader->SetUniform("a_Object", (int)draw.Object);
+			myMeshletCullShader->SetUniform("a_Command", (int)ix);
+			myMeshletCullShader->SetUniform("a_OutputOffset", (int)draw.OutputOffset);
+			myMeshletCullShader->Dispatch(draw.Mesh->GetMeshletCount());
+		}
+	}
+
+	// The commands are read by the draws, the compacted indices are read as an index buffer, and the object data is still
+	// read by the vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	Shader::Sptr boundShader = nullptr;
+	Material::Sptr boundMaterial = nullptr;
+	auto bindMaterial = [&](const Material::Sptr& material) {
+		// If our shader has changed, we need to bind it and update our frame-level uniforms
+		if (material->GetShader() != boundShader) {
+			boundShader = material->GetShader();
+			boundShader->Use();
+			boundShader->SetUniform("a_ViewProjection", viewProjection);
+			boundShader->SetUniform("a_View", view);
+			boundShader->SetUniform("a_Time", florp::app::Timing::GameTime);
+		}
+		// If our material has changed, we need to apply it to the shader
+		if (material != boundMaterial) {
+			boundMaterial = material;
+			boundMaterial->Apply();
+		}
+	};
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, myBuffers[CommandBuffer]);
+	glBindBuffer(GL_PARAMETER_BUFFER, myBuffers[GroupCountBuffer]);
+	for (size_t ix = 0; ix < myGroups.size(); ix++) {
+		const DrawGroup& group = myGroups[ix];
+		bindMaterial(group.Material);
+		group.Mesh->GetArena()->Bind();
+		group.Mesh->ApplyConstantAttributes();
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, group.Mesh->GetIndexType(),
+			(const void*)(group.FirstCommand * sizeof(DrawCommand)),
+			(GLintptr)(ix * sizeof(uint32_t)),
+			group.CommandCount, sizeof(DrawCommand));
+	}
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+
+	// Every meshlet draw has a command, so these don't need a count. Objects whose meshlets were all culled just draw nothing
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, myBuffers[MeshletCommandBuffer]);
+	for (const DrawGroup& group : myMeshletGroups) {
+		bindMaterial(group.Material);
+		group.Mesh->GetArena()->BindWithIndices(myBuffers[MeshletIndexBuffer]);
+		group.Mesh->ApplyConstantAttributes();
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+			(const void*)(group.FirstCommand * sizeof(DrawCommand)),
+			group.CommandCount, sizeof(DrawCommand));
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	// These are not culled, but they're usually a small part of the scene
+	for (const DirectDraw& draw : myDirectDraws) {
+		bindMaterial(draw.Material);
+		draw.Mesh->Draw(draw.Object);
+	}
+}
+
+void IndirectRenderer::__Upload(Buffers buffer, const void* data, size_t size) {
+	if (size == 0)
+		return;
+	if (data != nullptr) {
+		// We re-specify the buffer each frame so the driver can orphan last frame's data
+		myCapacities[buffer] = glm::max(myCapacities[buffer], size);
+		glNamedBufferData(myBuffers[buffer], myCapacities[buffer], nullptr, GL_STREAM_DRAW);
+		glNamedBufferSubData(myBuffers[buffer], 0, size, data);
+	} else if (size > myCapacities[buffer]) {
+		// Buffers that are only written by the GPU just need to be large enough
+		myCapacities[buffer] = size;
+		glNamedBufferData(myBuffers[buffer], size, nullptr, GL_DYNAMIC_COPY);
+	}
+}
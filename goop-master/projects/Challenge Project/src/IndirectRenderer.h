@@ -0,0 +1,146 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <entt.hpp>
+#include <glad/glad.h>
+#include <GLM/glm.hpp>
+#include "florp/graphics/Shader.h"
+#include "florp/graphics/Mesh.h"
+#include "florp/game/Material.h"
+
+// The shader storage bindings used for drawing, these must match lighting.vs.glsl, cull_draws.comp.glsl and
+// cull_meshlets.comp.glsl
+#define INDIRECT_OBJECT_BINDING          2
+#define INDIRECT_DRAW_BINDING            3
+#define INDIRECT_GROUP_OFFSET_BINDING    4
+#define INDIRECT_GROUP_COUNT_BINDING     5
+#define INDIRECT_COMMAND_BINDING         6
+#define INDIRECT_MESHLET_BINDING         7
+#define INDIRECT_MESHLET_INDEX_BINDING   8
+#define INDIRECT_MESHLET_OUTPUT_BINDING  9
+#define INDIRECT_MESHLET_COMMAND_BINDING 10
+
+/*
+ * Draws the scene's renderables with as few CPU-side draw calls as possible. Every renderable's matrices are uploaded
+ * into a single storage buffer, and the opaque renderables are split into groups that share a material and a mesh
+ * arena. A compute shader culls each renderable against the camera's frustum and writes an indirect draw command for
+ * the ones that survive, and then each group is drawn with a single glMultiDrawElementsIndirectCount. The vertex shader
+ * finds each draw's matrices with gl_BaseInstance.
+ *
+ * The number of draw calls only depends on the number of materials, so adding more objects to the scene only costs us
+ * the time to copy their matrices. Blended renderables (which need to be drawn in order) and renderables without
+ * indices are drawn one at a time after the groups, still using the same per-object data.
+ *
+ * Meshes that have meshlets (see Mesh::SetMeshlets) are culled a cluster at a time instead of as a whole. Each of their
+ * meshlets is tested against the frustum and its normal cone, and the triangles of the visible ones are compacted into an
+ * index buffer that is drawn with a single indirect command per object. This lets us skip the back facing and off-screen
+ * parts of large meshes, without needing mesh shaders
+ *
+ * This needs an OpenGL 4.6 context, for glMultiDrawElementsIndirectCount and gl_BaseInstance
+ */
+class IndirectRenderer {
+public:
+	typedef std::shared_ptr<IndirectRenderer> Sptr;
+
+	IndirectRenderer();
+	~IndirectRenderer();
+
+	IndirectRenderer(const IndirectRenderer& other) = delete;
+	IndirectRenderer& operator =(const IndirectRenderer& other) = delete;
+
+	/*
+	 * Collects all the renderables in the registry into our groups, and uploads their per-object data. The renderables
+	 * should already be sorted by material and mesh arena, otherwise we will end up with more groups than we need
+	 * @param ecs The registry to collect the renderables from
+	 */
+	void Gather(entt::registry& ecs);
+
+	/*
+	 * Culls and draws everything that was collected by the last call to Gather
+	 * @param view The camera's view matrix
+	 * @param viewProjection The camera's view projection matrix, used for culling
+	 */
+	void Render(const glm::mat4& view, const glm::mat4& viewProjection);
+
+	// Gets the number of renderables that were collected by the last call to Gather
+	size_t GetObjectCount() const { return myObjects.size(); }
+	// Gets the number of multi-draw calls that Render makes
+	size_t GetGroupCount() const { return myGroups.size(); }
+	// Gets the number of renderables that are culled by their meshlets
+	size_t GetMeshletDrawCount() const { return myMeshletDraws.size(); }
+	// Gets the number of renderables that are drawn one at a time
+	size_t GetDirectDrawCount() const { return myDirectDraws.size(); }
+
+private:
+	// These match the structs in lighting.vs.glsl and cull_draws.comp.glsl
+	struct ObjectData {
+		glm::mat4 Model;
+		glm::mat4 NormalMatrix;
+	};
+	struct DrawData {
+		glm::vec4 BoundingSphere;
+		uint32_t  IndexCount;
+		uint32_t  FirstIndex;
+		int32_t   BaseVertex;
+		uint32_t  Group;
+	};
+	// The layout of DrawElementsIndirectCommand
+	struct DrawCommand {
+		uint32_t Count;
+		uint32_t InstanceCount;
+		uint32_t FirstIndex;
+		int32_t  BaseVertex;
+		uint32_t BaseInstance;
+	};
+
+	// A run of draws that can be submitted with a single multi-draw
+	struct DrawGroup {
+		florp::game::Material::Sptr Material;
+		// The first mesh in the group, every mesh in a group shares its arena and constant attributes
+		florp::graphics::Mesh::Sptr Mesh;
+		uint32_t FirstCommand;
+		uint32_t CommandCount;
+	};
+	// A renderable whose meshlets are culled before it is drawn
+	struct MeshletDraw {
+		florp::graphics::Mesh::Sptr Mesh;
+		uint32_t Object;
+		// The offset of the object's range in the meshlet index buffer, in indices
+		uint32_t OutputOffset;
+	};
+	// A renderable that is drawn by itself
+	struct DirectDraw {
+		florp::game::Material::Sptr Material;
+		florp::graphics::Mesh::Sptr Mesh;
+		uint32_t Object;
+	};
+
+	enum Buffers {
+		ObjectBuffer, DrawBuffer, GroupOffsetBuffer, GroupCountBuffer, CommandBuffer,
+		MeshletCommandBuffer, MeshletIndexBuffer, BufferCount
+	};
+
+	florp::graphics::Shader::Sptr myCullShader;
+	florp::graphics::Shader::Sptr myMeshletCullShader;
+	GLuint myBuffers[BufferCount];
+	// The size of each buffer, in bytes
+	size_t myCapacities[BufferCount];
+
+	std::vector<ObjectData>  myObjects;
+	std::vector<DrawData>    myDraws;
+	std::vector<uint32_t>    myGroupOffsets;
+	std::vector<DrawGroup>   myGroups;
+	std::vector<DirectDraw>  myDirectDraws;
+	std::vector<MeshletDraw> myMeshletDraws;
+	// The meshlet draws are grouped just like the culled draws, but every draw has a command, which starts out empty
+	std::vector<DrawGroup>   myMeshletGroups;
+	std::vector<DrawCommand> myMeshletCommands;
+
+	/*
+	 * Uploads data to one of our buffers, growing it if it is too small
+	 * @param buffer The buffer to upload to
+	 * @param data The data to upload, or nullptr to only make sure the buffer is large enough
+	 * @param size The size of the data, in bytes
+	 */
+	void __Upload(Buffers buffer, const void* data, size_t size);
+};
@@ -0,0 +1,57 @@
+#include "LayeredDepthBuffer.h"
+#include "Logging.h"
+
+LayeredDepthBuffer::LayeredDepthBuffer(uint32_t size, uint32_t layers, LayeredTargetType type, RenderTargetType format) {
+	LOG_ASSERT(size > 0, "Size must be greater than zero!");
+	LOG_ASSERT(layers > 0, "Must have at least one layer!");
+	mySize = size;
+	myLayerCount = layers;
+	myType = type;
+	myInternalFormat = (florp::graphics::InternalFormat)format;
+
+	// Cube arrays store each cube as 6 layer-faces
+	uint32_t depth = myType == LayeredTargetType::CubeArray ? myLayerCount * 6 : myLayerCount;
+
+	// Create the backing texture, we will be doing our own filtering in the shader, so we stick to linear with no mips
+	glCreateTextures(*myType, 1, &myRendererID);
+	glTextureStorage3D(myRendererID, 1, *format, mySize, mySize, depth);
+	glTextureParameteri(myRendererID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(myRendererID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(myRendererID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(myRendererID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Attaching the entire texture (instead of a single layer) makes the frame buffer layered
+	glCreateFramebuffers(1, &myFrameBufferID);
+	glNamedFramebufferTexture(myFrameBufferID, GL_DEPTH_ATTACHMENT, myRendererID, 0);
+	glNamedFramebufferDrawBuffer(myFrameBufferID, GL_NONE);
+	glNamedFramebufferReadBuffer(myFrameBufferID, GL_NONE);
+
+	GLenum result = glCheckNamedFramebufferStatus(myFrameBufferID, GL_FRAMEBUFFER);
+	if (result != GL_FRAMEBUFFER_COMPLETE) {
+		LOG_ERROR("Layered depth buffer failed to validate! Status: {:#x}", result);
+	}
+}
+
+LayeredDepthBuffer::~LayeredDepthBuffer() {
+	LOG_INFO("Deleting layered depth buffer with ID: {}", myFrameBufferID);
+	glDeleteFramebuffers(1, &myFrameBufferID);
+	glDeleteTextures(1, &myRendererID);
+}
+
+void LayeredDepthBuffer::Bind() const {
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, myFrameBufferID);
+}
+
+void LayeredDepthBuffer::UnBind() const {
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void LayeredDepthBuffer::SetDebugName(const std::string& value) {
+	glObjectLabel(GL_FRAMEBUFFER, myFrameBufferID, -1, value.c_str());
+	// Pass the name down the call chain
+	florp::graphics::IGraphicsResource::SetDebugName(value);
+
+	char name[128];
+	sprintf_s(name, 128, "%s_Depth", value.c_str());
+	glObjectLabel(GL_TEXTURE, myRendererID, -1, name);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <glad/glad.h>
+#include "florp/graphics/ITexture.h"
+#include "EnumToString.h"
+#include "FrameBuffer.h"
+
+/*
+ * The type of texture backing a layered depth buffer
+ */
+ENUM(LayeredTargetType, GLenum,
+	TextureArray = GL_TEXTURE_2D_ARRAY,      // Each layer is a single 2D image
+	CubeArray    = GL_TEXTURE_CUBE_MAP_ARRAY // Each layer is a cube map, made up of 6 consecutive layer-faces
+);
+
+/*
+ * Represents a depth-only render target that is backed by an array texture, with every layer attached at once. This lets
+ * us render into all the layers in a single pass, by selecting the layer with gl_Layer in a geometry shader
+ *
+ * This is used for things like cascaded shadow maps and omnidirectional shadows, where we would otherwise need one pass per layer
+ */
+class LayeredDepthBuffer : public florp::graphics::ITexture {
+public:
+	GraphicsClass(LayeredDepthBuffer);
+
+	/*
+	 * Creates a new layered depth buffer
+	 * @param size The width and height of every layer, in texels (must be larger than 0)
+	 * @param layers The number of layers to create (for cube arrays, this is the number of cubes)
+	 * @param type The type of texture that will back this buffer (default is a 2D texture array)
+	 * @param format The depth format to use for the buffer (default is Depth32)
+	 */
+	LayeredDepthBuffer(uint32_t size, uint32_t layers, LayeredTargetType type = LayeredTargetType::TextureArray, RenderTargetType format = RenderTargetType::Depth32);
+	virtual ~LayeredDepthBuffer();
+
+	// Gets the width and height of a single layer, in texels
+	uint32_t GetSize() const { return mySize; }
+	// Gets the number of layers in this buffer (for cube arrays, this is the number of cubes)
+	uint32_t GetLayerCount() const { return myLayerCount; }
+	// Gets the type of texture backing this buffer
+	LayeredTargetType GetType() const { return myType; }
+
+	// We still want to be able to bind the depth texture to a texture slot
+	using ITexture::Bind;
+	/*
+	 * Binds this buffer as the draw target, with all of its layers attached
+	 */
+	void Bind() const;
+	/*
+	 * Unbinds this buffer from the draw target
+	 */
+	void UnBind() const;
+
+	/*
+	 * Overrides SetDebug name, so that we can send the name into OpenGL
+	 * @param value The new debug name for this object
+	 */
+	virtual void SetDebugName(const std::string& value) override;
+
+protected:
+	// The size of a single layer, and the number of layers
+	uint32_t          mySize, myLayerCount;
+	// The type of texture that is backing us
+	LayeredTargetType myType;
+	// The frame buffer that our depth texture is attached to
+	GLuint            myFrameBufferID;
+};
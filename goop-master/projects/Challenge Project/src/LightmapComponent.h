@@ -0,0 +1,19 @@
+#pragma once
+#include <memory>
+#include <GLM/glm.hpp>
+#include "florp/graphics/MeshData.h"
+
+/*
+ * Marks an entity as static geometry that receives a baked lightmap. The entity's mesh must have been unwrapped
+ * with the LightmapUnwrapper before it was baked, and must not move once the lighting has been baked
+ */
+struct LightmapComponent {
+	// The CPU-side copy of the entity's mesh (with lightmap UVs), which the light baker traces against
+	std::shared_ptr<florp::graphics::MeshData> Source;
+	// The width and height of this entity's lightmap, in texels
+	uint32_t  Size = 256;
+	// The average diffuse color of the surface, used when bouncing light off of it
+	glm::vec3 Albedo = glm::vec3(0.5f);
+	// The index of this entity's lightmap in the bake file, assigned when the component is attached
+	uint32_t  Index = 0;
+};
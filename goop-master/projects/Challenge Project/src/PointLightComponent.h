@@ -4,4 +4,14 @@
 struct PointLightComponent {
 	glm::vec3 Color;
 	float     Attenuation;
+
+	// If true, this light will render an omnidirectional shadow map into the LightingLayer's shared cube map array
+	bool      CastShadows = false;
+	// The distance from the light that shadows will be cast out to
+	float     ShadowRange = 25.0f;
+	// The depth bias to apply when comparing against the shadow map, as a fraction of the shadow range
+	float     ShadowBias  = 0.005f;
+
+	// The index of this light's cube in the shadow cube map array, assigned by the LightingLayer (-1 if not shadowed)
+	int       ShadowIndex = -1;
 };
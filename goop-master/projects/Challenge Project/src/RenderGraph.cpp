@@ -0,0 +1,177 @@
+#include "RenderGraph.h"
+#include "Logging.h"
+#include <GLM/glm.hpp>
+
+RenderGraph::RenderGraph(const RenderTargetPool::Sptr& pool) :
+	myPool(pool),
+	myFinalOutput(InvalidHandle),
+	myViewport(1),
+	myViewportSize(1),
+	isDirty(true) {
+	LOG_ASSERT(pool != nullptr, "A render graph needs a pool to allocate its targets from!");
+}
+
+RenderGraph::ResourceHandle RenderGraph::Import(const std::string& name) {
+	Resource resource;
+	resource.Name = name;
+	resource.Producer = InvalidHandle;
+	myResources.push_back(resource);
+	return (ResourceHandle)(myResources.size() - 1);
+}
+
+void RenderGraph::SetImported(ResourceHandle resource, const FrameBuffer::Sptr& buffer) {
+	LOG_ASSERT(resource < myResources.size() && myResources[resource].Producer == InvalidHandle, "Resource is not an imported resource!");
+	myResources[resource].Buffer = buffer;
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(const std::string& name, const std::vector<Input>& inputs, const TransientTargetDesc& output, const ExecuteFunc& execute) {
+	for (const Input& input : inputs) {
+		LOG_ASSERT(input.Resource < myResources.size(), "Pass \"{}\" reads from a resource that does not exist!", name);
+	}
+
+	PassHandle handle = (PassHandle)myPasses.size();
+
+	Resource resource;
+	resource.Name = name;
+	resource.Producer = handle;
+	resource.Desc = output;
+	myResources.push_back(resource);
+
+	Pass pass;
+	pass.Name = name;
+	pass.Inputs = inputs;
+	pass.Output = (ResourceHandle)(myResources.size() - 1);
+	pass.Execute = execute;
+	pass.Enabled = true;
+	myPasses.push_back(pass);
+
+	isDirty = true;
+	return handle;
+}
+
+RenderGraph::ResourceHandle RenderGraph::GetOutput(PassHandle pass) const {
+	return myPasses[pass].Output;
+}
+
+void RenderGraph::SetEnabled(PassHandle pass, bool enabled) {
+	if (myPasses[pass].Enabled != enabled) {
+		myPasses[pass].Enabled = enabled;
+		isDirty = true;
+	}
+}
+
+bool RenderGraph::IsEnabled(PassHandle pass) const {
+	return myPasses[pass].Enabled;
+}
+
+void RenderGraph::SetFinalOutput(ResourceHandle resource) {
+	myFinalOutput = resource;
+	isDirty = true;
+}
+
+FrameBuffer::Sptr RenderGraph::Execute() {
+	if (isDirty)
+		__Compile();
+
+	for (size_t step = 0; step < myOrder.size(); step++) {
+		Pass& pass = myPasses[myOrder[step]];
+		Resource& output = myResources[pass.Output];
+
+		// Grab a target for the output, this may be memory that an earlier pass has already finished with
+		output.Buffer = myPool->Acquire(output.Desc);
+		output.Buffer->Bind(RenderTargetBinding::Draw);
+		glClear(GL_COLOR_BUFFER_BIT);
+		// Round up in integers, so that full size targets get exactly the camera's viewport and smaller ones cover all the
+		// texels that a_UvScale can reach
+		glm::uvec2 size = glm::uvec2(output.Buffer->GetWidth(), output.Buffer->GetHeight());
+		glm::uvec2 viewport = glm::max((size * myViewport + myViewportSize - 1u) / myViewportSize, glm::uvec2(1));
+		glViewport(0, 0, viewport.x, viewport.y);
+
+		// Bind the inputs in the order they were declared, reading through any disabled passes
+		for (size_t ix = 0; ix < pass.Inputs.size(); ix++) {
+			const Resource& source = myResources[__Resolve(pass.Inputs[ix].Resource)];
+			source.Buffer->Bind((uint32_t)ix, pass.Inputs[ix].Attachment);
+		}
+
+		pass.Execute(output.Buffer);
+		output.Buffer->UnBind();
+
+		// Hand back any targets that no later pass will read from
+		for (ResourceHandle released : myReleases[step]) {
+			myPool->Release(myResources[released].Buffer);
+			myResources[released].Buffer = nullptr;
+		}
+	}
+
+	ResourceHandle result = __Resolve(myFinalOutput);
+	return result == InvalidHandle ? nullptr : myResources[result].Buffer;
+}
+
+void RenderGraph::EndFrame() {
+	for (Resource& resource : myResources) {
+		if (resource.Producer != InvalidHandle && resource.Buffer != nullptr) {
+			myPool->Release(resource.Buffer);
+			resource.Buffer = nullptr;
+		}
+	}
+}
+
+size_t RenderGraph::GetLivePassCount() {
+	if (isDirty)
+		__Compile();
+	return myOrder.size();
+}
+
+RenderGraph::ResourceHandle RenderGraph::__Resolve(ResourceHandle resource) const {
+	while (resource != InvalidHandle) {
+		PassHandle producer = myResources[resource].Producer;
+		if (producer == InvalidHandle || myPasses[producer].Enabled)
+			break;
+		// A disabled pass passes its first input straight through
+		const Pass& pass = myPasses[producer];
+		resource = pass.Inputs.empty() ? InvalidHandle : pass.Inputs[0].Resource;
+	}
+	return resource;
+}
+
+void RenderGraph::__Compile() {
+	myOrder.clear();
+
+	// Walk backwards from the final output, anything we never reach does not contribute to the frame
+	ResourceHandle result = __Resolve(myFinalOutput);
+	std::vector<bool> visited(myPasses.size(), false);
+	if (result != InvalidHandle && myResources[result].Producer != InvalidHandle)
+		__Visit(myResources[result].Producer, visited);
+
+	// Find the last step that reads from each transient resource, that is when we can give its target back to the pool
+	std::vector<int> lastUse(myResources.size(), -1);
+	for (size_t step = 0; step < myOrder.size(); step++) {
+		for (const Input& input : myPasses[myOrder[step]].Inputs) {
+			ResourceHandle resource = __Resolve(input.Resource);
+			if (myResources[resource].Producer != InvalidHandle)
+				lastUse[resource] = (int)step;
+		}
+	}
+	myReleases.assign(myOrder.size(), std::vector<ResourceHandle>());
+	for (size_t ix = 0; ix < myResources.size(); ix++) {
+		// The final output is held until EndFrame, since the caller still needs to read from it
+		if (lastUse[ix] >= 0 && ix != result)
+			myReleases[lastUse[ix]].push_back((ResourceHandle)ix);
+	}
+
+	LOG_TRACE("Compiled render graph, {} of {} passes are live", myOrder.size(), myPasses.size());
+	isDirty = false;
+}
+
+void RenderGraph::__Visit(PassHandle pass, std::vector<bool>& visited) {
+	visited[pass] = true;
+	for (const Input& input : myPasses[pass].Inputs) {
+		ResourceHandle resource = __Resolve(input.Resource);
+		LOG_ASSERT(resource != InvalidHandle, "Pass \"{}\" reads from a disabled pass with no inputs!", myPasses[pass].Name);
+		PassHandle producer = myResources[resource].Producer;
+		if (producer != InvalidHandle && !visited[producer])
+			__Visit(producer, visited);
+	}
+	// Post-order, so all of a pass's dependencies will run before it
+	myOrder.push_back(pass);
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "FrameBuffer.h"
+#include "RenderTargetPool.h"
+
+/*
+ * A small frame graph for full screen passes. Rather than owning their output buffers and wiring them together by
+ * hand, passes declare which resources they read and the format of the target they write. Every time the graph is
+ * changed it will:
+ *    - Resolve disabled passes, so that anything reading from them reads from the pass's first input instead
+ *    - Cull any passes that do not contribute to the final output
+ *    - Order the remaining passes so that every pass runs after the passes it reads from
+ *    - Work out the lifetime of every transient target, so that they can be returned to the pool as soon as their
+ *      last reader has run, and re-used by later passes
+ *
+ * Resources that are produced outside of the graph (like the scene's G-Buffer) are imported, and must be provided
+ * every frame before the graph is executed
+ */
+class RenderGraph {
+public:
+	typedef std::shared_ptr<RenderGraph> Sptr;
+	typedef uint32_t ResourceHandle;
+	typedef uint32_t PassHandle;
+	static constexpr uint32_t InvalidHandle = 0xFFFFFFFFu;
+
+	/*
+	 * Describes a resource that is read by a pass, the input at index 0 will be bound to texture slot 0 and so on
+	 */
+	struct Input {
+		ResourceHandle         Resource;
+		RenderTargetAttachment Attachment = RenderTargetAttachment::Color0;
+	};
+
+	/*
+	 * The callback for executing a pass. The inputs are already bound, and the output is bound and cleared with the
+	 * viewport covering it, so the callback only needs to set up its shader and draw
+	 */
+	typedef std::function<void(const FrameBuffer::Sptr& output)> ExecuteFunc;
+
+	RenderGraph(const RenderTargetPool::Sptr& pool);
+	~RenderGraph() = default;
+
+	/*
+	 * Declares a resource that is produced outside of the graph
+	 * @param name The name of the resource, for debugging
+	 * @returns A handle to the resource, which can be used as an input to passes
+	 */
+	ResourceHandle Import(const std::string& name);
+	/*
+	 * Sets the frame buffer to use for an imported resource this frame
+	 * @param resource The handle returned from Import
+	 * @param buffer The buffer to read from
+	 */
+	void SetImported(ResourceHandle resource, const FrameBuffer::Sptr& buffer);
+
+	/*
+	 * Adds a new pass to the graph. Inputs must already exist, so passes can never form a cycle
+	 * @param name The name of the pass, for debugging
+	 * @param inputs The resources that this pass reads from. When the pass is disabled, readers of its output will read from inputs[0] instead
+	 * @param output The format and scale of the target that this pass writes to
+	 * @param execute The callback for drawing the pass
+	 * @returns A handle to the new pass
+	 */
+	PassHandle AddPass(const std::string& name, const std::vector<Input>& inputs, const TransientTargetDesc& output, const ExecuteFunc& execute);
+	/*
+	 * Gets the resource that a pass writes to, so that it can be used as an input to later passes
+	 */
+	ResourceHandle GetOutput(PassHandle pass) const;
+
+	void SetEnabled(PassHandle pass, bool enabled);
+	bool IsEnabled(PassHandle pass) const;
+
+	/*
+	 * Sets which resource is the result of the graph. Only passes that contribute to this resource will be executed
+	 */
+	void SetFinalOutput(ResourceHandle resource);
+
+	/*
+	 * Sets the region of every target that passes will render into, starting from the bottom-left corner. This is
+	 * used for dynamic resolution, where we only fill a region of our targets rather than re-allocating them. Each
+	 * target fills the same fraction of itself, rounded up, so it always covers the UVs scaled by viewport / size
+	 * @param viewport The region of the full size targets to render into
+	 * @param size The size of the full size targets
+	 */
+	void SetViewport(const glm::uvec2& viewport, const glm::uvec2& size) { myViewport = viewport; myViewportSize = size; }
+
+	/*
+	 * Executes all the live passes in the graph, recompiling it first if it has changed
+	 * @returns The frame buffer holding the final output, which stays valid until EndFrame is called
+	 */
+	FrameBuffer::Sptr Execute();
+	/*
+	 * Returns the final output and any other targets still held by the graph to the pool. This should be called
+	 * once the caller is done with the result of Execute
+	 */
+	void EndFrame();
+
+	// Gets the number of passes that will run when the graph is executed
+	size_t GetLivePassCount();
+
+private:
+	struct Resource {
+		std::string         Name;
+		PassHandle          Producer; // InvalidHandle for imported resources
+		TransientTargetDesc Desc;
+		FrameBuffer::Sptr   Buffer;
+	};
+	struct Pass {
+		std::string         Name;
+		std::vector<Input>  Inputs;
+		ResourceHandle      Output;
+		ExecuteFunc         Execute;
+		bool                Enabled;
+	};
+
+	RenderTargetPool::Sptr           myPool;
+	std::vector<Resource>            myResources;
+	std::vector<Pass>                myPasses;
+	ResourceHandle                   myFinalOutput;
+	// The region of the full size targets that we render into, see SetViewport
+	glm::uvec2                       myViewport, myViewportSize;
+
+	// The compiled state of the graph, which is rebuilt whenever the passes or their enabled states change
+	bool                             isDirty;
+	std::vector<PassHandle>          myOrder;     // The live passes, in the order they will be executed
+	std::vector<std::vector<ResourceHandle>> myReleases; // The transient resources to release after each step in myOrder
+
+	/*
+	 * Follows a resource through any disabled passes to find the resource that will actually hold its contents
+	 */
+	ResourceHandle __Resolve(ResourceHandle resource) const;
+	void __Compile();
+	void __Visit(PassHandle pass, std::vector<bool>& visited);
+};
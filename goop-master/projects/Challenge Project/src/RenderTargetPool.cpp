@@ -0,0 +1,96 @@
+#include "RenderTargetPool.h"
+#include "florp/app/Application.h"
+#include "florp/game/SceneManager.h"
+#include "Logging.h"
+#include <GLM/glm.hpp>
+
+// When the targets need to grow, we give them this much extra space (as a fraction of the window size)
+#define POOL_GROWTH_HEADROOM 0.125f
+// Allocated sizes are rounded up to a multiple of this, so that small changes in size land on the same allocation
+#define POOL_SIZE_ALIGNMENT 64
+
+RenderTargetPool::RenderTargetPool(uint32_t width, uint32_t height) :
+	myWidth(width),
+	myHeight(height) { }
+
+FrameBuffer::Sptr RenderTargetPool::Acquire(const TransientTargetDesc& desc) {
+	// Re-use a free target that matches the description if we have one. The formats need to be identical, since a wider
+	// format would lose the clamping and quantization that 8 bit passes rely on
+	for (PooledTarget& target : myTargets) {
+		if (!target.InUse && target.Desc == desc) {
+			target.InUse = true;
+			return target.Buffer;
+		}
+	}
+
+	RenderBufferDesc color = RenderBufferDesc();
+	color.ShaderReadable = true;
+	color.Attachment = RenderTargetAttachment::Color0;
+	color.Format = desc.Format;
+
+	glm::uvec2 size = __GetSize(desc);
+	FrameBuffer::Sptr buffer = std::make_shared<FrameBuffer>(size.x, size.y);
+	buffer->AddAttachment(color);
+	buffer->Validate();
+	buffer->SetDebugName("Transient_" + std::string(~desc.Format) + "_" + std::to_string(myTargets.size()));
+
+	LOG_TRACE("Allocated transient target #{} ({}x{} {})", myTargets.size(), size.x, size.y, ~desc.Format);
+	myTargets.push_back({ desc, buffer, true });
+	return buffer;
+}
+
+void RenderTargetPool::Release(const FrameBuffer::Sptr& target) {
+	for (PooledTarget& pooled : myTargets) {
+		if (pooled.Buffer == target) {
+			LOG_ASSERT(pooled.InUse, "Transient target was released twice!");
+			pooled.InUse = false;
+			return;
+		}
+	}
+	LOG_ASSERT(false, "Released a target that does not belong to this pool!");
+}
+
+void RenderTargetPool::Resize(uint32_t width, uint32_t height) {
+	// If the window still fits in our targets, everything will just render into a smaller region of them. We do
+	// shrink once the window is under a quarter of our area though, so that we don't hang on to too much memory
+	bool fits = width <= myWidth && height <= myHeight;
+	bool wasteful = (uint64_t)width * height * 4 < (uint64_t)myWidth * myHeight;
+	if (fits && !wasteful)
+		return;
+
+	auto grow = [](uint32_t size) {
+		uint32_t result = size + (uint32_t)(size * POOL_GROWTH_HEADROOM);
+		return (result + POOL_SIZE_ALIGNMENT - 1) / POOL_SIZE_ALIGNMENT * POOL_SIZE_ALIGNMENT;
+	};
+	myWidth = grow(width);
+	myHeight = grow(height);
+	LOG_INFO("Re-allocating {} render targets at {}x{} for a {}x{} window", myTargets.size(), myWidth, myHeight, width, height);
+	for (PooledTarget& target : myTargets) {
+		glm::uvec2 size = __GetSize(target.Desc);
+		target.Buffer->Resize(size.x, size.y);
+	}
+}
+
+size_t RenderTargetPool::GetActiveCount() const {
+	size_t result = 0;
+	for (const PooledTarget& target : myTargets)
+		result += target.InUse ? 1 : 0;
+	return result;
+}
+
+const RenderTargetPool::Sptr& RenderTargetPool::Get() {
+	Sptr& result = CurrentRegistry().ctx_or_set<Sptr>();
+	if (result == nullptr) {
+		florp::app::Window::Sptr window = florp::app::Application::Get()->GetWindow();
+		result = std::make_shared<RenderTargetPool>(window->GetWidth(), window->GetHeight());
+	}
+	return result;
+}
+
+glm::uvec2 RenderTargetPool::__GetSize(const TransientTargetDesc& desc) const {
+	// Never let a scaled target collapse to nothing, since frame buffers need to be at least 1x1
+	return glm::max(glm::uvec2(
+		(uint32_t)(myWidth * desc.ResolutionMultiplier),
+		(uint32_t)(myHeight * desc.ResolutionMultiplier)
+	), glm::uvec2(1));
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <GLM/vec2.hpp>
+#include "FrameBuffer.h"
+
+/*
+ * Describes a transient render target, relative to the size of the window
+ */
+struct TransientTargetDesc {
+	RenderTargetType Format = RenderTargetType::ColorRgb8;
+	float            ResolutionMultiplier = 1.0f;
+
+	bool operator ==(const TransientTargetDesc& other) const {
+		return Format == other.Format && ResolutionMultiplier == other.ResolutionMultiplier;
+	}
+};
+
+/*
+ * A pool of single color attachment frame buffers that are only needed for part of a frame. Layers acquire a target
+ * when they start writing to it and release it once the last reader is done, so that targets with non-overlapping
+ * lifetimes can share the same memory. Targets are only shared between identical descriptions, since handing a pass a
+ * different format than it asked for would change its results.
+ *
+ * The pool is shared between all the layers through the registry context, see RenderTargetPool::Get
+ */
+class RenderTargetPool {
+public:
+	typedef std::shared_ptr<RenderTargetPool> Sptr;
+
+	RenderTargetPool(uint32_t width, uint32_t height);
+	~RenderTargetPool() = default;
+
+	/*
+	 * Gets a free target matching the given description, creating one if none are available
+	 * @param desc The format and scale of the target to get
+	 * @returns A frame buffer that the caller owns until it is released
+	 */
+	FrameBuffer::Sptr Acquire(const TransientTargetDesc& desc);
+	/*
+	 * Returns a target to the pool so that it can be re-used by another pass
+	 * @param target The target to release, must have been acquired from this pool
+	 */
+	void Release(const FrameBuffer::Sptr& target);
+
+	/*
+	 * Makes sure that the targets in the pool are large enough for the new window size. Targets are allocated with
+	 * some headroom, and are only re-allocated when the window outgrows them (or shrinks to a small fraction of them),
+	 * otherwise we just render into a smaller region of them. Multiple layers can forward their resize events to the
+	 * pool, only the first call for a given size will do any work
+	 * @param width The new width of the window
+	 * @param height The new height of the window
+	 */
+	void Resize(uint32_t width, uint32_t height);
+	/*
+	 * Gets the size that full resolution targets are allocated at, which may be larger than the window. Any other
+	 * window sized buffers (like the camera's G-Buffer) should use this size, so that the same fraction of every
+	 * buffer is rendered to
+	 */
+	glm::uvec2 GetSize() const { return glm::uvec2(myWidth, myHeight); }
+
+	// Gets the total number of targets that the pool has allocated
+	size_t GetTargetCount() const { return myTargets.size(); }
+	// Gets the number of targets that are currently acquired
+	size_t GetActiveCount() const;
+
+	/*
+	 * Gets the pool shared by all the layers in the current scene, creating it if it does not exist yet
+	 */
+	static const Sptr& Get();
+
+private:
+	struct PooledTarget {
+		TransientTargetDesc Desc;
+		FrameBuffer::Sptr   Buffer;
+		bool                InUse;
+	};
+	std::vector<PooledTarget> myTargets;
+	// The allocated size of full resolution targets
+	uint32_t myWidth, myHeight;
+
+	glm::uvec2 __GetSize(const TransientTargetDesc& desc) const;
+};
@@ -0,0 +1,136 @@
+#include "SeparableKernel.h"
+#include "Logging.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// We stop rotating once every pair of columns is this close to orthogonal
+#define SVD_EPSILON 1e-12
+#define SVD_MAX_SWEEPS 64
+
+SeparableKernel SeparableKernel::Decompose(const float* weights, uint32_t size, float tolerance) {
+	LOG_ASSERT(size % 2 == 1, "Convolution kernels must have an odd size!");
+	LOG_ASSERT(size <= CONVOLUTION_MAX_SIZE, "Convolution kernel is too large! ({} > {})", size, CONVOLUTION_MAX_SIZE);
+
+	// One sided Jacobi SVD. We keep rotating pairs of columns of U (which starts as the kernel) until they are all
+	// orthogonal, applying the same rotations to V. Once done, the column norms of U are the singular values
+	std::vector<double> u(size * size), v(size * size, 0.0);
+	for (uint32_t ix = 0; ix < size * size; ix++)
+		u[ix] = weights[ix];
+	for (uint32_t ix = 0; ix < size; ix++)
+		v[ix * size + ix] = 1.0;
+
+	for (int sweep = 0; sweep < SVD_MAX_SWEEPS; sweep++) {
+		bool rotated = false;
+		for (uint32_t p = 0; p < size - 1; p++) {
+			for (uint32_t q = p + 1; q < size; q++) {
+				double alpha = 0.0, beta = 0.0, gamma = 0.0;
+				for (uint32_t row = 0; row < size; row++) {
+					alpha += u[row * size + p] * u[row * size + p];
+					beta  += u[row * size + q] * u[row * size + q];
+					gamma += u[row * size + p] * u[row * size + q];
+				}
+				if (std::abs(gamma) <= SVD_EPSILON * std::sqrt(alpha * beta) || gamma == 0.0)
+					continue;
+				rotated = true;
+
+				double zeta = (beta - alpha) / (2.0 * gamma);
+				double t = (zeta >= 0.0 ? 1.0 : -1.0) / (std::abs(zeta) + std::sqrt(1.0 + zeta * zeta));
+				double c = 1.0 / std::sqrt(1.0 + t * t);
+				double s = c * t;
+				for (uint32_t row = 0; row < size; row++) {
+					double up = u[row * size + p], uq = u[row * size + q];
+					u[row * size + p] = c * up - s * uq;
+					u[row * size + q] = s * up + c * uq;
+					double vp = v[row * size + p], vq = v[row * size + q];
+					v[row * size + p] = c * vp - s * vq;
+					v[row * size + q] = s * vp + c * vq;
+				}
+			}
+		}
+		if (!rotated)
+			break;
+	}
+
+	// Sort the terms from the largest singular value to the smallest
+	std::vector<double> sigma(size, 0.0);
+	for (uint32_t col = 0; col < size; col++) {
+		for (uint32_t row = 0; row < size; row++)
+			sigma[col] += u[row * size + col] * u[row * size + col];
+		sigma[col] = std::sqrt(sigma[col]);
+	}
+	std::vector<uint32_t> order(size);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sigma[a] > sigma[b]; });
+
+	// Keep the smallest number of terms that gets us within our tolerance, the error is whatever energy we drop
+	double energy = 0.0;
+	for (double value : sigma)
+		energy += value * value;
+	SeparableKernel result;
+	if (energy == 0.0)
+		return result;
+
+	uint32_t rank = 0;
+	double remaining = energy;
+	while (rank < size && std::sqrt(remaining / energy) > tolerance) {
+		remaining -= sigma[order[rank]] * sigma[order[rank]];
+		rank++;
+	}
+	result.myError = (float)std::sqrt(std::max(remaining, 0.0) / energy);
+
+	// Each term is sigma * u * v^T, we split sigma evenly between the vertical (u) and horizontal (v) passes
+	float half = (float)(size / 2);
+	for (uint32_t term = 0; term < rank && term < SEPARABLE_MAX_TERMS; term++) {
+		uint32_t col = order[term];
+		double scale = std::sqrt(sigma[col]);
+		std::vector<double> vertical(size), horizontal(size);
+		for (uint32_t ix = 0; ix < size; ix++) {
+			vertical[ix] = u[ix * size + col] / sigma[col] * scale;
+			horizontal[ix] = v[ix * size + col] * scale;
+		}
+		result.myTerms.push_back({ __MergeTaps(horizontal, -half, 1.0f), __MergeTaps(vertical, half, -1.0f) });
+	}
+
+	// If we need too many terms, or they end up costing more than just sampling the whole kernel, use the 2D kernel
+	if (rank > SEPARABLE_MAX_TERMS || result.GetTapCount() >= size * size) {
+		LOG_TRACE("Kernel {}x{} needs {} separable terms, using the full 2D kernel", size, size, rank);
+		result.myTerms.clear();
+		result.myError = 0.0f;
+	}
+	return result;
+}
+
+uint32_t SeparableKernel::GetTapCount() const {
+	uint32_t result = 0;
+	for (const Term& term : myTerms)
+		result += (uint32_t)(term.Horizontal.size() + term.Vertical.size());
+	return result;
+}
+
+std::vector<KernelTap> SeparableKernel::__MergeTaps(const std::vector<double>& weights, float firstOffset, float step) {
+	// Weights that are tiny relative to the rest of the kernel aren't worth a sample
+	double largest = 0.0;
+	for (double weight : weights)
+		largest = std::max(largest, std::abs(weight));
+	double threshold = largest * 1e-5;
+
+	std::vector<KernelTap> result;
+	for (size_t ix = 0; ix < weights.size(); ix++) {
+		double a = weights[ix];
+		if (std::abs(a) <= threshold)
+			continue;
+		float offset = firstOffset + step * ix;
+
+		// Two neighbouring weights with the same sign can be sampled together, by placing a bilinear tap between them
+		// so that the filter hardware weights them for us
+		if (ix + 1 < weights.size() && a * weights[ix + 1] > 0.0 && std::abs(weights[ix + 1]) > threshold) {
+			double b = weights[ix + 1];
+			result.push_back({ offset + step * (float)(b / (a + b)), (float)(a + b) });
+			ix++;
+		} else {
+			result.push_back({ offset, (float)a });
+		}
+	}
+	return result;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+// The largest kernel (along each axis) that the convolution shaders can apply
+#define CONVOLUTION_MAX_SIZE 15
+// The most separable terms we will use before falling back to the full 2D kernel, since each term costs two passes
+#define SEPARABLE_MAX_TERMS 4
+
+/*
+ * A single sample taken by a 1D convolution pass
+ */
+struct KernelTap {
+	float Offset; // The offset from the pixel along the pass's axis, in texels. Fractional offsets use bilinear filtering
+	float Weight;
+};
+
+/*
+ * Breaks a 2D convolution kernel down into a sum of separable terms, each of which can be applied as a horizontal
+ * pass followed by a vertical pass. The kernel is decomposed with a singular value decomposition, and we keep as few
+ * of the largest singular values as we need to stay within a given error. Blurs (and anything else that is an outer
+ * product) only need a single term, so an NxN kernel goes from N^2 taps to 2N.
+ *
+ * Adjacent taps with weights of the same sign are merged into a single bilinear tap, which roughly halves the taps
+ * again for smooth kernels
+ */
+class SeparableKernel {
+public:
+	struct Term {
+		std::vector<KernelTap> Horizontal;
+		std::vector<KernelTap> Vertical;   // Positive offsets are up the screen, matching the top row of the kernel
+	};
+
+	SeparableKernel() = default;
+	~SeparableKernel() = default;
+
+	/*
+	 * Decomposes a square kernel
+	 * @param weights The weights of the kernel, row by row, starting from the top row
+	 * @param size The width and height of the kernel, must be odd and at most CONVOLUTION_MAX_SIZE
+	 * @param tolerance The largest error we will accept, relative to the magnitude of the kernel
+	 * @returns The decomposed kernel, which will have no terms if applying the full 2D kernel would be cheaper
+	 */
+	static SeparableKernel Decompose(const float* weights, uint32_t size, float tolerance = 0.01f);
+
+	// Whether the kernel can be applied as separable passes, otherwise the full 2D kernel should be used
+	bool IsSeparable() const { return !myTerms.empty(); }
+	const std::vector<Term>& GetTerms() const { return myTerms; }
+	// Gets the error of the approximation, relative to the magnitude of the kernel
+	float GetError() const { return myError; }
+	// Gets the total number of texture samples each pixel will take across all the passes
+	uint32_t GetTapCount() const;
+
+private:
+	std::vector<Term> myTerms;
+	float             myError = 0.0f;
+
+	/*
+	 * Converts a column of weights into taps, merging neighbours where we can
+	 * @param weights The weights, starting from the lowest offset
+	 * @param firstOffset The offset of the first weight
+	 * @param step The change in offset between weights (1 for horizontal, -1 for vertical since rows go down)
+	 */
+	static std::vector<KernelTap> __MergeTaps(const std::vector<double>& weights, float firstOffset, float step);
+};
@@ -1,6 +1,16 @@
 #pragma once
 #include <GLM/glm.hpp>
 #include "FrameBuffer.h"
+#include "EnumToString.h"
+
+/*
+ * Determines how a shadow light's shadow map is stored and filtered
+ */
+ENUM(ShadowFilterMode, uint32_t,
+	Pcf  = 0, // The raw depth map is stored, and filtered with PCF when compositing
+	Vsm  = 1, // Variance shadow mapping, stores depth and depth squared in an RG32F map
+	Evsm = 2  // Exponential variance shadow mapping, stores positive and negative exponential moments in an RGBA32F map
+);
 
 /*
  * Stores the information required to render with a camera. Since this is a component of a gameobject,
@@ -22,4 +32,12 @@ struct ShadowLight {
 
 	glm::vec3 Color;
 	float     Attenuation;
+
+	// How this light's shadows are filtered, the moment based modes are pre-blurred and mip-mapped so they only need a single fetch
+	ShadowFilterMode  Filter = ShadowFilterMode::Pcf;
+	// The amount of light bleeding to cut off when using moment based filtering, higher values give darker, harder shadows
+	float             LightBleedReduction = 0.2f;
+	// The moment map for the light (and a scratch buffer for blurring), created by the LightingLayer when the filter mode needs them
+	FrameBuffer::Sptr MomentBuffer;
+	FrameBuffer::Sptr MomentScratch;
 };
\ No newline at end of file
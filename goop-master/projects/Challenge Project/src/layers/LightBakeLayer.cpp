@@ -0,0 +1,66 @@
+#include "LightBakeLayer.h"
+#include <florp\game\SceneManager.h>
+#include <florp\game\Transform.h>
+#include "florp/app/Application.h"
+#include "LightmapComponent.h"
+#include "BakedLighting.h"
+#include "ShadowLight.h"
+#include "PointLightComponent.h"
+#include "DirectionalLight.h"
+
+LightBakeLayer::LightBakeLayer() {
+	// Our probes cover the area around the center of the scene where our dynamic objects move around
+	mySettings.ProbeMin = glm::vec3(-25.0f, -0.5f, -25.0f);
+	mySettings.ProbeMax = glm::vec3( 25.0f,  6.0f,  25.0f);
+	mySettings.ProbeCount = glm::ivec3(11, 3, 11);
+}
+
+void LightBakeLayer::Initialize() {
+	using namespace florp::bake;
+	using namespace florp::game;
+	auto& ecs = CurrentRegistry();
+
+	// Gather all of our lightmapped geometry, ordered by lightmap index so that the bake lines up with the scene
+	std::vector<BakeInstance> instances(ecs.size<LightmapComponent>());
+	ecs.view<LightmapComponent>().each([&](auto entity, const LightmapComponent& lightmap) {
+		BakeInstance& instance = instances[lightmap.Index];
+		instance.Mesh = lightmap.Source.get();
+		instance.Transform = ecs.get<Transform>(entity).GetWorldTransform();
+		instance.Albedo = lightmap.Albedo;
+		instance.LightmapSize = lightmap.Size;
+	});
+
+	// Gather all of our lights, matching the attenuation models of the lighting shaders
+	std::vector<BakeLight> lights;
+	ecs.view<ShadowLight>().each([&](auto entity, const ShadowLight& light) {
+		const glm::mat4& world = ecs.get<Transform>(entity).GetWorldTransform();
+		BakeLight& result = lights.emplace_back();
+		result.Type = BakeLightType::Spot;
+		result.Position = glm::vec3(world[3]);
+		result.Direction = -glm::normalize(glm::vec3(world[2]));
+		result.Color = light.Color;
+		result.Attenuation = light.Attenuation;
+		// Shadow lights have a square frustum, we'll use the cone that fits inside of it
+		result.CosCutoff = glm::cos(glm::atan(1.0f / light.Projection[1][1]));
+	});
+	ecs.view<PointLightComponent>().each([&](auto entity, const PointLightComponent& light) {
+		BakeLight& result = lights.emplace_back();
+		result.Type = BakeLightType::Point;
+		result.Position = glm::vec3(ecs.get<Transform>(entity).GetWorldTransform()[3]);
+		result.Color = light.Color;
+		result.Attenuation = light.Attenuation;
+	});
+	ecs.view<DirectionalLight>().each([&](auto entity, const DirectionalLight& light) {
+		BakeLight& result = lights.emplace_back();
+		result.Type = BakeLightType::Directional;
+		result.Direction = -glm::normalize(glm::vec3(ecs.get<Transform>(entity).GetWorldTransform()[2]));
+		result.Color = light.Color;
+	});
+
+	BakeResult result = LightBaker::Bake(instances, lights, mySettings);
+	if (result.Save(BAKED_LIGHTING_FILE))
+		LOG_INFO("Wrote baked lighting to \"{}\"", BAKED_LIGHTING_FILE);
+
+	// We are an offline tool, so we shut down as soon as the bake is done
+	florp::app::Application::Get()->Close();
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "florp/app/ApplicationLayer.h"
+#include "florp/bake/LightBaker.h"
+
+/*
+ * Bakes the static lighting for the scene and writes it to disk, then closes the application. This layer is only added
+ * when the application is launched with --bake, and must come after the SceneBuilder so that the scene exists
+ */
+class LightBakeLayer : public florp::app::ApplicationLayer {
+public:
+	LightBakeLayer();
+
+	// Handles baking the lighting for the scene that was just built
+	void Initialize() override;
+
+protected:
+	florp::bake::BakeSettings mySettings;
+};
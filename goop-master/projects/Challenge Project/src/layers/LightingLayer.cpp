@@ -2,19 +2,139 @@
 #include <florp\game\SceneManager.h>
 #include <florp\game\Transform.h>
 #include <florp\game\RenderableComponent.h>
+#include <florp\game\LodGroup.h>
 #include <ShadowLight.h>
 #include "florp/app/Application.h"
+#include "florp/app/Timing.h"
 #include "FrameState.h"
 #include <imgui.h>
 #include "PointLightComponent.h"
+#include "DirectionalLight.h"
+#include "CameraComponent.h"
+#include "BakedLighting.h"
+#include "RenderTargetPool.h"
+#include "GBufferLayout.h"
+#include <GLM/gtc/matrix_transform.hpp>
+
+/*
+ * Fits the cascades of a directional light to slices of the camera's view frustum
+ * @param light The light to update the cascades for
+ * @param lightDir The direction that the light is shining in, in world space
+ * @param cameraWorld The world transform of the camera that we are fitting the cascades to
+ * @param projection The projection matrix of the camera that we are fitting the cascades to
+ */
+void FitCascades(DirectionalLight& light, const glm::vec3& lightDir, const glm::mat4& cameraWorld, const glm::mat4& projection) {
+	// We can extract our near and far plane by reversing the projection calculation
+	float m22 = projection[2][2];
+	float m32 = projection[3][2];
+	float nearPlane = (2.0f * m32) / (2.0f * m22 - 2.0f);
+	float farPlane = ((m22 - 1.0f) * nearPlane) / (m22 + 1.0);
+	float shadowDistance = glm::min(light.ShadowDistance, farPlane);
+
+	// Get the corners of the camera's frustum in view space, ordered as near/far pairs along each edge of the frustum
+	glm::mat4 projectionInv = glm::inverse(projection);
+	glm::vec3 nearCorners[4], farCorners[4];
+	for (int ix = 0; ix < 4; ix++) {
+		glm::vec2 ndc = glm::vec2((ix & 1) ? 1.0f : -1.0f, (ix & 2) ? 1.0f : -1.0f);
+		glm::vec4 nearCorner = projectionInv * glm::vec4(ndc, -1.0f, 1.0f);
+		glm::vec4 farCorner  = projectionInv * glm::vec4(ndc,  1.0f, 1.0f);
+		nearCorners[ix] = glm::vec3(nearCorner) / nearCorner.w;
+		farCorners[ix]  = glm::vec3(farCorner) / farCorner.w;
+	}
+
+	// The light's orientation does not change between cascades, so we pick an up axis that is not parallel with it
+	glm::vec3 up = glm::abs(lightDir.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	float bufferSize = (float)light.ShadowBuffer->GetSize();
+
+	float splitStart = nearPlane;
+	for (int cascade = 0; cascade < light.NumCascades; cascade++) {
+		// Our split distance is a blend between a uniform and logarithmic split
+		float ratio = (cascade + 1) / (float)light.NumCascades;
+		float uniformSplit = nearPlane + (shadowDistance - nearPlane) * ratio;
+		float logSplit = nearPlane * glm::pow(shadowDistance / nearPlane, ratio);
+		float splitEnd = glm::mix(uniformSplit, logSplit, light.SplitLambda);
+
+		// Determine the corners of this slice in world space. Since view depth is linear along the edges of the frustum, we
+		// can simply interpolate between the near and far corners
+		glm::vec3 corners[8];
+		glm::vec3 center = glm::vec3(0.0f);
+		for (int ix = 0; ix < 4; ix++) {
+			glm::vec3 edge = farCorners[ix] - nearCorners[ix];
+			glm::vec3 start = nearCorners[ix] + edge * ((splitStart - nearPlane) / (farPlane - nearPlane));
+			glm::vec3 end   = nearCorners[ix] + edge * ((splitEnd - nearPlane) / (farPlane - nearPlane));
+			corners[ix * 2 + 0] = glm::vec3(cameraWorld * glm::vec4(start, 1.0f));
+			corners[ix * 2 + 1] = glm::vec3(cameraWorld * glm::vec4(end, 1.0f));
+			center += corners[ix * 2] + corners[ix * 2 + 1];
+		}
+		center /= 8.0f;
+
+		// We fit a sphere around the slice, so that the size of the cascade does not change as the camera rotates
+		float radius = 0.0f;
+		for (int ix = 0; ix < 8; ix++) {
+			radius = glm::max(radius, glm::length(corners[ix] - center));
+		}
+		radius = glm::ceil(radius * 16.0f) / 16.0f;
+
+		// Back the light up so that it can capture casters that are outside of the slice
+		glm::mat4 lightView = glm::lookAt(center - lightDir * (radius + light.CasterPadding), center, up);
+		glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + light.CasterPadding);
+
+		// Snap the projection to whole texels, so that the shadows do not shimmer as the camera moves
+		glm::mat4 viewProjection = lightProjection * lightView;
+		glm::vec2 origin = glm::vec2(viewProjection * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)) * (bufferSize / 2.0f);
+		glm::vec2 offset = (glm::round(origin) - origin) * (2.0f / bufferSize);
+		lightProjection[3][0] += offset.x;
+		lightProjection[3][1] += offset.y;
+
+		light.CascadeViewProjections[cascade] = lightProjection * lightView;
+		light.CascadeSplits[cascade] = splitEnd;
+		splitStart = splitEnd;
+	}
+}
+
+// The size of a single face of a point light's shadow cube, in texels
+#define POINT_SHADOW_SIZE 512
+// The positive and negative exponents to use for EVSM, these are close to the limits of what 32 bit floats can store
+#define EVSM_EXPONENTS glm::vec2(40.0f, 5.0f)
+
+/*
+ * Creates the moment buffer and blur scratch buffer for a shadow light that is using VSM or EVSM
+ * @param light The light to create the moment buffers for, the buffers will match the size of it's shadow buffer
+ */
+void CreateMomentBuffers(ShadowLight& light) {
+	glm::ivec2 size = light.ShadowBuffer->GetSize();
+
+	// VSM only needs 2 moments, while EVSM needs 4
+	RenderBufferDesc moments = RenderBufferDesc();
+	moments.ShaderReadable = true;
+	moments.Attachment = RenderTargetAttachment::Color0;
+	moments.Format = light.Filter == ShadowFilterMode::Evsm ? RenderTargetType::ColorRgba32F : RenderTargetType::ColorRg32F;
+	moments.MipmapLevels = 1 + (uint32_t)glm::floor(glm::log2((float)glm::max(size.x, size.y)));
+
+	// We still need a depth buffer to resolve visibility, but we never read from it
+	RenderBufferDesc depth = RenderBufferDesc();
+	depth.ShaderReadable = false;
+	depth.Attachment = RenderTargetAttachment::Depth;
+	depth.Format = RenderTargetType::Depth24;
+
+	light.MomentBuffer = std::make_shared<FrameBuffer>(size.x, size.y);
+	light.MomentBuffer->AddAttachment(moments);
+	light.MomentBuffer->AddAttachment(depth);
+	light.MomentBuffer->Validate();
+
+	// The scratch buffer only holds the horizontal blur result, so it does not need mips or depth
+	moments.MipmapLevels = 1;
+	light.MomentScratch = std::make_shared<FrameBuffer>(size.x, size.y);
+	light.MomentScratch->AddAttachment(moments);
+	light.MomentScratch->Validate();
+}
 
 void LightingLayer::OnWindowResize(uint32_t width, uint32_t height) {
-	myAccumulationBuffer->Resize(width, height);
+	// The accumulation buffer comes from the shared pool, which is shared with the post processing
+	RenderTargetPool::Get()->Resize(width, height);
 }
 
 void LightingLayer::Initialize() {
-	florp::app::Application* app = florp::app::Application::Get();
-	
 	using namespace florp::graphics;
 
 	isProcessingShadows = isProcessingPointLights = true;
@@ -22,22 +142,79 @@ void LightingLayer::Initialize() {
 	// We'll set our ambient light to be some very small amount (this will be for the entire scene)
 	myAmbientLight = glm::vec3(0.01f);
 	
+	// Our shadow casters are instanced, so we'll need a buffer to store all of their model matrices
+	glCreateBuffers(1, &myShadowInstanceBuffer);
+	myShadowInstanceCapacity = 0;
+
+	// If the scene has baked lighting, we'll upload the light probes once, and skip all of our realtime lighting
+	myProbeBuffer = 0;
+	isUsingBakedLighting = false;
+	if (const BakedLighting* baked = CurrentRegistry().try_ctx<BakedLighting>()) {
+		// This matches the layout of the b_LightProbes block in forward-probes.fs.glsl
+		struct ProbeHeader {
+			glm::vec4  Min;
+			glm::vec4  Max;
+			glm::ivec4 Count;
+		} header = { glm::vec4(baked->Probes.Min, 0.0f), glm::vec4(baked->Probes.Max, 0.0f), glm::ivec4(baked->Probes.Count, 0) };
+
+		size_t coefficientSize = baked->Probes.Coefficients.size() * sizeof(glm::vec4);
+		glCreateBuffers(1, &myProbeBuffer);
+		glNamedBufferStorage(myProbeBuffer, sizeof(ProbeHeader) + coefficientSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glNamedBufferSubData(myProbeBuffer, 0, sizeof(ProbeHeader), &header);
+		if (coefficientSize > 0)
+			glNamedBufferSubData(myProbeBuffer, sizeof(ProbeHeader), coefficientSize, baked->Probes.Coefficients.data());
+		isUsingBakedLighting = true;
+	}
+
 	// The normal shader will handle depth map generation for shadow casting lights (note that we'll just use the default, fallback fragment shader)
 	myShader = std::make_shared<Shader>();
-	myShader->LoadPart(ShaderStageType::VertexShader, "shaders/simple.vs.glsl");
+	myShader->LoadPart(ShaderStageType::VertexShader, "shaders/shadow_instanced.vs.glsl");
 	myShader->Link(); 
 
 	// The masked shader will be used if we have a light that will mask off areas to not cast shadows (for instance, behind a grate)
 	myMaskedShader = std::make_shared<Shader>();
-	myMaskedShader->LoadPart(ShaderStageType::VertexShader, "shaders/simple.vs.glsl");  
+	myMaskedShader->LoadPart(ShaderStageType::VertexShader, "shaders/shadow_instanced.vs.glsl");  
 	myMaskedShader->LoadPart(ShaderStageType::FragmentShader, "shaders/shadow_masked.fs.glsl");  
 	myMaskedShader->Link();
 
+	// The moment shader will be used for lights that are using variance shadow maps (it handles masking as well)
+	myMomentShader = std::make_shared<Shader>();
+	myMomentShader->LoadPart(ShaderStageType::VertexShader, "shaders/shadow_instanced.vs.glsl");
+	myMomentShader->LoadPart(ShaderStageType::FragmentShader, "shaders/shadow_moments.fs.glsl");
+	myMomentShader->Link();
+	myMomentShader->SetUniform("a_EvsmExponents", EVSM_EXPONENTS);
+
+	// The moment blur will be used to pre-filter our moment maps once per update, instead of filtering them per pixel
+	myMomentBlur = std::make_shared<Shader>();
+	myMomentBlur->LoadPart(ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
+	myMomentBlur->LoadPart(ShaderStageType::FragmentShader, "shaders/post/blur_moments.fs.glsl");
+	myMomentBlur->Link();
+
+	// The cascade shader uses a geometry shader to render into every cascade of a directional light at once
+	myCascadeShader = std::make_shared<Shader>();
+	myCascadeShader->LoadPart(ShaderStageType::VertexShader, "shaders/shadow_layered.vs.glsl");
+	myCascadeShader->LoadPart(ShaderStageType::Geometry, "shaders/shadow_cascade.gs.glsl");
+	myCascadeShader->Link();
+
+	// The cube shadow shader renders all 6 faces of a point light's shadow cube at once, storing the linear distance to the light
+	myCubeShadowShader = std::make_shared<Shader>();
+	myCubeShadowShader->LoadPart(ShaderStageType::VertexShader, "shaders/shadow_layered.vs.glsl");
+	myCubeShadowShader->LoadPart(ShaderStageType::Geometry, "shaders/shadow_cube.gs.glsl");
+	myCubeShadowShader->LoadPart(ShaderStageType::FragmentShader, "shaders/shadow_cube.fs.glsl");
+	myCubeShadowShader->Link();
+
 	// The shadow composite shader will handle adding shadow casting and projector lights to our accumulation buffer
 	myShadowComposite = std::make_shared<Shader>();
 	myShadowComposite->LoadPart(ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
 	myShadowComposite->LoadPart(ShaderStageType::FragmentShader, "shaders/post/shadow_post.fs.glsl");
 	myShadowComposite->Link();
+	myShadowComposite->SetUniform("a_EvsmExponents", EVSM_EXPONENTS);
+
+	// The directional composite shader will handle adding directional lights, selecting the correct cascade per pixel
+	myDirectionalComposite = std::make_shared<Shader>();
+	myDirectionalComposite->LoadPart(ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
+	myDirectionalComposite->LoadPart(ShaderStageType::FragmentShader, "shaders/post/directional_shadow_post.fs.glsl");
+	myDirectionalComposite->Link();
 
 	myPointLightComposite = std::make_shared<Shader>();
 	myPointLightComposite->LoadPart(ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
@@ -49,21 +226,11 @@ void LightingLayer::Initialize() {
 	myFinalComposite->LoadPart(ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
 	myFinalComposite->LoadPart(ShaderStageType::FragmentShader, "shaders/post/lighting_composite.fs.glsl");
 	myFinalComposite->Link();
+	// The exposure itself is adapted on the GPU, this is just a manual compensation on top of it
 	myFinalComposite->SetUniform("a_Exposure", 1.0f);
+	myAutoExposure = std::make_shared<AutoExposure>();
 
 
-	// Our accumulation buffer will be a floating-point buffer, so we can do some HDR lighting effects
-	RenderBufferDesc mainColor = RenderBufferDesc();
-	mainColor.ShaderReadable = true;
-	mainColor.Attachment = RenderTargetAttachment::Color0;
-	mainColor.Format = RenderTargetType::ColorRgb16F;
-
-	// We'll use one buffer to accumulate all the lighting
-	myAccumulationBuffer = std::make_shared<FrameBuffer>(app->GetWindow()->GetWidth(), app->GetWindow()->GetHeight());
-	myAccumulationBuffer->AddAttachment(mainColor);
-	myAccumulationBuffer->Validate();
-	myAccumulationBuffer->SetDebugName("Intermediate");
-
 	// Create our fullscreen quad (just like in PostLayer)
 	{
 		float vert[] = {
@@ -85,14 +252,84 @@ void LightingLayer::Initialize() {
 	}
 }
 
+void LightingLayer::Shutdown() {
+	glDeleteBuffers(1, &myShadowInstanceBuffer);
+	if (myProbeBuffer != 0)
+		glDeleteBuffers(1, &myProbeBuffer);
+	myAutoExposure = nullptr;
+}
+
+void LightingLayer::BuildShadowBatches() {
+	using namespace florp::game;
+	auto& ecs = CurrentRegistry();
+
+	// Group all of our shadow casters by mesh, so that each mesh can be drawn with a single instanced call
+	std::unordered_map<florp::graphics::Mesh*, size_t> batchIndices;
+	std::vector<std::vector<glm::mat4>> transforms;
+	myShadowBatches.clear();
+
+	auto view = ecs.view<RenderableComponent>();
+	for (const auto& entity : view) {
+		const RenderableComponent& renderer = ecs.get<RenderableComponent>(entity);
+
+		// Early bail if mesh is invalid (or if if does not cast a shadow)
+		if (renderer.Mesh == nullptr || renderer.Material == nullptr || !renderer.Material->IsShadowCaster)
+			continue;
+
+		// Entities with levels of detail pick a separate (usually coarser) mesh for their shadows
+		const LodGroup* lod = ecs.try_get<LodGroup>(entity);
+		const florp::graphics::Mesh::Sptr& mesh = lod != nullptr && !lod->Levels.empty() ? lod->GetShadowMesh() : renderer.Mesh;
+
+		// Find or create the batch for this mesh
+		auto it = batchIndices.find(mesh.get());
+		if (it == batchIndices.end()) {
+			it = batchIndices.emplace(mesh.get(), myShadowBatches.size()).first;
+			myShadowBatches.push_back({ mesh, 0, 0 });
+			transforms.emplace_back();
+		}
+		const Transform& transform = ecs.get_or_assign<Transform>(entity);
+		transforms[it->second].push_back(transform.GetWorldTransform());
+	}
+
+	// Flatten all the batches into a single list of matrices
+	std::vector<glm::mat4> instances;
+	for (size_t ix = 0; ix < myShadowBatches.size(); ix++) {
+		myShadowBatches[ix].FirstInstance = (uint32_t)instances.size();
+		myShadowBatches[ix].InstanceCount = (uint32_t)transforms[ix].size();
+		instances.insert(instances.end(), transforms[ix].begin(), transforms[ix].end());
+	}
+
+	// Upload our instance matrices, we re-specify the buffer each frame so the driver can orphan last frame's data
+	if (!instances.empty()) {
+		myShadowInstanceCapacity = glm::max(myShadowInstanceCapacity, instances.size());
+		glNamedBufferData(myShadowInstanceBuffer, myShadowInstanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+		glNamedBufferSubData(myShadowInstanceBuffer, 0, instances.size() * sizeof(glm::mat4), instances.data());
+	}
+}
+
+void LightingLayer::DrawShadowBatches() {
+	for (const ShadowBatch& batch : myShadowBatches) {
+		batch.Mesh->DrawDepthInstanced(myShadowInstanceBuffer, batch.FirstInstance * sizeof(glm::mat4), batch.InstanceCount);
+	}
+}
+
 void LightingLayer::PreRender()
 {
+	// With baked lighting, all we need to do is make the probes available to the scene's shaders
+	if (isUsingBakedLighting) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, myProbeBuffer);
+		return;
+	}
+
 	if (isProcessingShadows) {
 		using namespace florp::game;
 		using namespace florp::graphics;
 
 		auto& ecs = CurrentRegistry();
 
+		// Gather our shadow casters once, every light will draw the same batches
+		BuildShadowBatches();
+
 		// We'll only handle stuff if we actually have a shadow casting light in the scene
 		auto view = ecs.view<ShadowLight>();
 		if (view.size() > 0) {
@@ -107,59 +344,224 @@ void LightingLayer::PreRender()
 				// Get the light's transform
 				const Transform& lightTransform = ecs.get<Transform>(entity);
 
+				// Lights using moment based filtering render into their moment buffer instead of the raw depth buffer
+				bool isFiltered = light.Filter != ShadowFilterMode::Pcf;
+				FrameBuffer::Sptr target = light.ShadowBuffer;
+				if (light.Mask != nullptr) {
+					light.Mask->Bind(0);
+				}
+
 				// Select which shader to use depending on if the light has a mask or not
-				if (light.Mask == nullptr) {
+				if (isFiltered) {
+					if (light.MomentBuffer == nullptr) {
+						CreateMomentBuffers(light);
+					}
+					target = light.MomentBuffer;
+					shader = myMomentShader;
+					shader->SetUniform("b_UseMask", light.Mask != nullptr ? 1 : 0);
+					shader->SetUniform("b_Exponential", light.Filter == ShadowFilterMode::Evsm ? 1 : 0);
+				}
+				else if (light.Mask == nullptr) {
 					shader = myShader;
 				}
 				else {
 					shader = myMaskedShader;
-					light.Mask->Bind(0);
 				}
 				// Use the shader, and tell it what our output resolution is
 				shader->Use();
-				shader->SetUniform("a_OutputResolution", (glm::vec2)light.ShadowBuffer->GetSize());
+				shader->SetUniform("a_OutputResolution", (glm::vec2)target->GetSize());
 
 				// Bind, viewport, and clear
-				light.ShadowBuffer->Bind();
-				glViewport(0, 0, light.ShadowBuffer->GetWidth(), light.ShadowBuffer->GetHeight());
-				glClear(GL_DEPTH_BUFFER_BIT);
+				target->Bind();
+				glViewport(0, 0, target->GetWidth(), target->GetHeight());
+				if (isFiltered) {
+					// Empty areas of the moment map should act as if they are at the far plane
+					glm::vec2 exponents = EVSM_EXPONENTS;
+					glm::vec4 clear = light.Filter == ShadowFilterMode::Evsm ?
+						glm::vec4(glm::exp(exponents.x), glm::exp(2.0f * exponents.x), -glm::exp(-exponents.y), glm::exp(-2.0f * exponents.y)) :
+						glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+					glClearColor(clear.r, clear.g, clear.b, clear.a);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				} else {
+					glClear(GL_DEPTH_BUFFER_BIT);
+				}
 
-				// Determine the position and matrices for the light
-				glm::vec3 position = lightTransform.GetLocalPosition();
+				// Determine the matrices for the light
 				glm::mat4 viewMatrix = glm::inverse(lightTransform.GetWorldTransform());
-				glm::mat4 viewProjection = light.Projection * viewMatrix;
+				shader->SetUniform("a_ViewProjection", light.Projection * viewMatrix);
+
+				// Draw all of our casters, one instanced draw per mesh
+				DrawShadowBatches();
+
+				// Unbind so that we can use the texture later
+				target->UnBind();
+
+				// Moment maps get blurred and mip-mapped once here, so that compositing only needs a single fetch
+				if (isFiltered) {
+					BlurMoments(light);
+					glEnable(GL_DEPTH_TEST);
+					glEnable(GL_CULL_FACE);
+					glCullFace(GL_FRONT);
+				}
+				});
 
-				// We're going to iterate over every renderable component
-				auto view = ecs.view<RenderableComponent>();
+			glCullFace(GL_BACK); // enable back face culling
+		}
 
-				for (const auto& entity : view) {
-					// Get our shader
-					const RenderableComponent& renderer = ecs.get<RenderableComponent>(entity);
+		// Directional lights are handled separately, since they need to be fitted to the camera
+		RenderCascades();
+		// Point lights render into a shared cube map array
+		RenderPointShadows();
+	}
+}
 
-					// Early bail if mesh is invalid (or if if does not cast a shadow)
-					if (renderer.Mesh == nullptr || renderer.Material == nullptr || !renderer.Material->IsShadowCaster)
-						continue;
+void LightingLayer::BlurMoments(ShadowLight& light) {
+	// We're drawing fullscreen quads, so we don't want any depth testing or culling
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
 
-					// We'll need some info about the entities position in the world
-					const Transform& transform = ecs.get_or_assign<Transform>(entity);
+	myMomentBlur->Use();
 
-					// Update the MVP using the item's transform
-					shader->SetUniform(
-						"a_ModelViewProjection",
-						viewProjection *
-						transform.GetWorldTransform());
+	// Horizontal pass from the moment buffer into the scratch buffer
+	light.MomentScratch->Bind();
+	myMomentBlur->SetUniform("isHorizontal", 1);
+	light.MomentBuffer->Bind(0, RenderTargetAttachment::Color0);
+	myFullscreenQuad->Draw();
+	light.MomentScratch->UnBind();
 
-					// Draw the item
-					renderer.Mesh->Draw();
-				}
+	// Vertical pass from the scratch buffer back into the top level of the moment buffer
+	light.MomentBuffer->Bind();
+	myMomentBlur->SetUniform("isHorizontal", 0);
+	light.MomentScratch->Bind(0, RenderTargetAttachment::Color0);
+	myFullscreenQuad->Draw();
+	light.MomentBuffer->UnBind();
 
-				// Unbind so that we can use the texture later
-				light.ShadowBuffer->UnBind();
-				});
+	// Regenerate the rest of the mip chain from the blurred moments, so distant lookups are filtered too
+	light.MomentBuffer->GenerateMipmaps(RenderTargetAttachment::Color0);
+}
 
-			glCullFace(GL_BACK); // enable back face culling
+void LightingLayer::RenderCascades() {
+	using namespace florp::game;
+
+	auto& ecs = CurrentRegistry();
+
+	// We'll only handle stuff if we actually have a directional light in the scene
+	auto view = ecs.view<DirectionalLight>();
+	if (view.size() == 0)
+		return;
+
+	// We need the main camera to fit our cascades to. Note that we can't use the frame state, since it has not been
+	// updated for this frame yet
+	glm::mat4 cameraWorld = glm::mat4(1.0f), cameraProjection = glm::mat4(1.0f);
+	bool hasCamera = false;
+	ecs.view<CameraComponent>().each([&](auto entity, const CameraComponent& cam) {
+		if (cam.IsMainCamera) {
+			cameraWorld = ecs.get<Transform>(entity).GetWorldTransform();
+			cameraProjection = cam.Projection;
+			hasCamera = true;
 		}
+	});
+	if (!hasCamera)
+		return;
+
+	// We'll make sure depth testing and culling are enabled
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_FRONT);
+	// Depth clamping will flatten any casters in front of a cascade's near plane onto it, instead of clipping them
+	glEnable(GL_DEPTH_CLAMP);
+
+	myCascadeShader->Use();
+	view.each([&](auto entity, DirectionalLight& light) {
+		LOG_ASSERT(light.NumCascades > 0 && light.NumCascades <= MAX_SHADOW_CASCADES, "Invalid number of cascades!");
+		LOG_ASSERT(light.NumCascades <= (int)light.ShadowBuffer->GetLayerCount(), "Shadow buffer does not have enough layers for the cascades!");
+
+		// The light shines along the -Z axis of its transform
+		const Transform& lightTransform = ecs.get<Transform>(entity);
+		glm::vec3 lightDir = glm::normalize(glm::mat3(lightTransform.GetWorldTransform()) * glm::vec3(0, 0, -1));
+		FitCascades(light, lightDir, cameraWorld, cameraProjection);
+
+		myCascadeShader->SetUniforms("a_LightViewProjection", light.NumCascades, light.CascadeViewProjections);
+		myCascadeShader->SetUniform("a_NumLayers", light.NumCascades);
+
+		// Bind, viewport, and clear all the cascades at once
+		light.ShadowBuffer->Bind();
+		glViewport(0, 0, light.ShadowBuffer->GetSize(), light.ShadowBuffer->GetSize());
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		// Each caster is drawn once, and the geometry shader will replicate it into each cascade that it overlaps
+		DrawShadowBatches();
+
+		light.ShadowBuffer->UnBind();
+	});
+
+	glDisable(GL_DEPTH_CLAMP);
+	glCullFace(GL_BACK);
+}
+
+void LightingLayer::RenderPointShadows() {
+	using namespace florp::game;
+
+	auto& ecs = CurrentRegistry();
+
+	// Assign each shadow casting point light a cube in our cube map array
+	int numShadowed = 0;
+	auto view = ecs.view<PointLightComponent>();
+	view.each([&](auto entity, PointLightComponent& light) {
+		light.ShadowIndex = light.CastShadows ? numShadowed++ : -1;
+	});
+	if (numShadowed == 0)
+		return;
+
+	// Grow our cube map array if we have more lights than will fit
+	if (myPointShadowBuffer == nullptr || (int)myPointShadowBuffer->GetLayerCount() < numShadowed) {
+		myPointShadowBuffer = std::make_shared<LayeredDepthBuffer>(POINT_SHADOW_SIZE, numShadowed, LayeredTargetType::CubeArray);
+		myPointShadowBuffer->SetDebugName("PointShadows");
 	}
+
+	// These are the directions and up vectors for each face of the cube, in the order OpenGL expects them
+	static const glm::vec3 faceDirs[6] = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+	};
+	static const glm::vec3 faceUps[6] = {
+		{ 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 }
+	};
+
+	// We'll make sure depth testing and culling are enabled
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_FRONT);
+
+	// Bind, viewport, and clear every cube at once
+	myPointShadowBuffer->Bind();
+	glViewport(0, 0, POINT_SHADOW_SIZE, POINT_SHADOW_SIZE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	myCubeShadowShader->Use();
+	view.each([&](auto entity, PointLightComponent& light) {
+		if (light.ShadowIndex < 0)
+			return;
+
+		// Build the view-projection for each face of the cube
+		glm::vec3 position = glm::vec3(ecs.get<Transform>(entity).GetWorldTransform() * glm::vec4(0, 0, 0, 1));
+		glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.05f, light.ShadowRange);
+		glm::mat4 faces[6];
+		for (int ix = 0; ix < 6; ix++) {
+			faces[ix] = projection * glm::lookAt(position, position + faceDirs[ix], faceUps[ix]);
+		}
+
+		myCubeShadowShader->SetUniforms("a_FaceViewProjection", 6, faces);
+		myCubeShadowShader->SetUniform("a_CubeIndex", light.ShadowIndex);
+		myCubeShadowShader->SetUniform("a_LightPos", position);
+		myCubeShadowShader->SetUniform("a_ShadowRange", light.ShadowRange);
+
+		// Each caster is drawn once, and the geometry shader will replicate it into each face that it overlaps
+		DrawShadowBatches();
+	});
+
+	myPointShadowBuffer->UnBind();
+	glCullFace(GL_BACK);
 }
 
 void LightingLayer::PostRender() {
@@ -172,19 +574,35 @@ void LightingLayer::PostRender() {
 	const AppFrameState& state = ecs.ctx<AppFrameState>();
 	FrameBuffer::Sptr mainBuffer = state.Current.Output;
 	
+	// Our accumulation buffer will be a floating-point buffer, so we can do some HDR lighting effects. It is only
+	// needed until the composite, so we borrow it from the pool, and any later pass with the same format can re-use it
+	TransientTargetDesc accumulation;
+	accumulation.Format = GBufferLayout::Get().Accumulation;
+	myAccumulationBuffer = RenderTargetPool::Get()->Acquire(accumulation);
+
 	// Bind and clear our lighting accumulation buffer
 	myAccumulationBuffer->Bind();
 	glClearColor(myAmbientLight.r, myAmbientLight.g, myAmbientLight.b, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
+
+	// We only need to light the region of the buffers that the camera rendered to this frame
+	glViewport(0, 0, state.Current.Viewport.x, state.Current.Viewport.y);
+	glm::vec2 uvScale = state.GetUvScale();
+	myShadowComposite->SetUniform("a_UvScale", uvScale);
+	myDirectionalComposite->SetUniform("a_UvScale", uvScale);
+	myPointLightComposite->SetUniform("a_UvScale", uvScale);
+	myFinalComposite->SetUniform("a_UvScale", uvScale);
 	
 	// Disable Depth testing, and enable additive blending
 	glDisable(GL_DEPTH_TEST);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_ONE, GL_ONE);
 	
-	// Do our light post processing
-	if (isProcessingShadows) { PostProcessShadows(); }
-	if (isProcessingPointLights) { PostProcessLights(); }
+	// Do our light post processing (baked lighting has already been written to the emissive buffer by the scene's shaders)
+	if (!isUsingBakedLighting) {
+		if (isProcessingShadows) { PostProcessShadows(); PostProcessDirectionalLights(); }
+		if (isProcessingPointLights) { PostProcessLights(); }
+	}
 	
 	// Unbind the accumulation buffer so we can blend it with the main scene
 	myAccumulationBuffer->UnBind();
@@ -192,6 +610,11 @@ void LightingLayer::PostRender() {
 	// Disable blending, we will overwrite the contents now
 	glDisable(GL_BLEND);
 
+	// Meter the lighting and adapt our exposure to it, the result stays in a buffer that the composite reads directly
+	myAccumulationBuffer->Bind(0);
+	mainBuffer->Bind(1, RenderTargetAttachment::Color2); // The emissive buffer
+	myAutoExposure->Apply(state.Current.Viewport, florp::app::Timing::DeltaTime);
+
 	// Set the main buffer as the output again
 	mainBuffer->Bind();
 	// We'll use an additive shader for now, this should be a multiply with the albedo of the scene
@@ -202,8 +625,12 @@ void LightingLayer::PostRender() {
 	mainBuffer->Bind(3, RenderTargetAttachment::Color2); // The emissive buffer
 	// Render the quad
 	myFullscreenQuad->Draw();
-	// Unbind main buffer to perform multisample blitting
+	// Unbind the main buffer, post processing will resolve whichever attachments it reads from
 	mainBuffer->UnBind();   
+
+	// We're done with the accumulation buffer for this frame
+	RenderTargetPool::Get()->Release(myAccumulationBuffer);
+	myAccumulationBuffer = nullptr;
 }
 
 void LightingLayer::RenderGUI()
@@ -211,7 +638,7 @@ void LightingLayer::RenderGUI()
 	//// We'll put all the lighting stuff into it's own ImGUI window
 	//ImGui::Begin("Lighting Settings");
 
-	//// For now, we'll just have a slider to adjust our exposure
+	//// The exposure is adapted automatically, this slider just adjusts the compensation on top of it
 	//static float exposure = 1.0f;
 	//if (ImGui::DragFloat("Exposure", &exposure, 0.1f, 0.1f, 10.0f)) {
 	//	myFinalComposite->SetUniform("a_Exposure", exposure);
@@ -251,12 +678,12 @@ void LightingLayer::PostProcessShadows() {
 	myShadowComposite->SetUniform("a_NearPlane", nearPlane); 
 	myShadowComposite->SetUniform("a_FarPlane", farPlane);
 	myShadowComposite->SetUniform("a_Bias", 0.000001f);
-	myShadowComposite->SetUniform("a_MatShininess", 1.0f); // This should be from the GBuffer
 
 	// Bind our GBuffer textures (note that we skipped 2, since that's the slot for the shadow sampler)
 	mainBuffer->Bind(0, RenderTargetAttachment::Color0);
 	mainBuffer->Bind(1, RenderTargetAttachment::Depth);
 	mainBuffer->Bind(3, RenderTargetAttachment::Color1); // The normal buffer
+	mainBuffer->Bind(6, RenderTargetAttachment::Color3); // The material buffer
 	
 	// Iterate over all the ShadowLights in the scene
 	auto view = CurrentRegistry().view<ShadowLight>();
@@ -284,13 +711,66 @@ void LightingLayer::PostProcessShadows() {
 			myShadowComposite->SetUniform("a_LightColor", light.Color);
 			myShadowComposite->SetUniform("a_LightAttenuation", light.Attenuation); 
 			
-			// Bind the light's depth and render the quad
-			light.ShadowBuffer->Bind(2, RenderTargetAttachment::Depth);
+			// Bind the light's depth (or moments if it is pre-filtered) and render the quad
+			if (light.Filter != ShadowFilterMode::Pcf && light.MomentBuffer != nullptr) {
+				myShadowComposite->SetUniform("a_FilterMode", (int)*light.Filter);
+				myShadowComposite->SetUniform("a_LightBleedReduction", light.LightBleedReduction);
+				light.MomentBuffer->Bind(5, RenderTargetAttachment::Color0);
+			} else {
+				myShadowComposite->SetUniform("a_FilterMode", 0);
+				light.ShadowBuffer->Bind(2, RenderTargetAttachment::Depth);
+			}
 			myFullscreenQuad->Draw();
 		});
 	}
 }
 
+void LightingLayer::PostProcessDirectionalLights() {
+	auto& ecs = CurrentRegistry();
+
+	// We'll only handle stuff if we actually have a directional light in the scene
+	auto view = ecs.view<DirectionalLight>();
+	if (view.size() == 0)
+		return;
+
+	// We'll get the back buffer from the frame state
+	const AppFrameState& state = ecs.ctx<AppFrameState>();
+	FrameBuffer::Sptr mainBuffer = state.Current.Output;
+	glm::mat4 viewInv = glm::inverse(state.Current.View);
+
+	// We set up all the camera state once, since we use the same shader for compositing all directional lights
+	myDirectionalComposite->Use();
+	myDirectionalComposite->SetUniform("a_ProjectionInv", glm::inverse(state.Current.Projection));
+
+	// Bind our GBuffer textures (note that we skipped 2, since that's the slot for the cascades)
+	mainBuffer->Bind(1, RenderTargetAttachment::Depth);
+	mainBuffer->Bind(3, RenderTargetAttachment::Color1); // The normal buffer
+	mainBuffer->Bind(4, RenderTargetAttachment::Color3); // The material buffer
+
+	view.each([&](auto entity, DirectionalLight& light) {
+		const florp::game::Transform& transform = ecs.get<florp::game::Transform>(entity);
+
+		// Our composite works in view space, so we fold the inverse view into the cascade matrices
+		glm::mat4 cascades[MAX_SHADOW_CASCADES];
+		for (int ix = 0; ix < light.NumCascades; ix++) {
+			cascades[ix] = light.CascadeViewProjections[ix] * viewInv;
+		}
+		glm::vec3 lightDir = glm::normalize(glm::mat3(state.Current.View) * glm::mat3(transform.GetWorldTransform()) * glm::vec3(0, 0, -1));
+
+		// Upload the light info to the shader
+		myDirectionalComposite->SetUniforms("a_CascadeViewProjection", light.NumCascades, cascades);
+		myDirectionalComposite->SetUniforms("a_CascadeSplits", light.NumCascades, light.CascadeSplits);
+		myDirectionalComposite->SetUniform("a_NumCascades", light.NumCascades);
+		myDirectionalComposite->SetUniform("a_LightDir", lightDir);
+		myDirectionalComposite->SetUniform("a_LightColor", light.Color);
+		myDirectionalComposite->SetUniform("a_Bias", light.Bias);
+
+		// Bind the light's cascades and render the quad
+		light.ShadowBuffer->Bind(2);
+		myFullscreenQuad->Draw();
+	});
+}
+
 void LightingLayer::PostProcessLights() { 
 	// We grab the application singleton to get the size of the screen
 	florp::app::Application* app = florp::app::Application::Get(); 
@@ -305,12 +785,17 @@ void LightingLayer::PostProcessLights() {
 	myPointLightComposite->SetUniform("a_View", state.Current.View);
 	myPointLightComposite->SetUniform("a_ProjectionInv", glm::inverse(state.Current.Projection));
 	myPointLightComposite->SetUniform("a_ViewProjectionInv", glm::inverse(state.Current.ViewProjection));
-	myPointLightComposite->SetUniform("a_MatShininess", 1.0f); // This should be from the GBuffer
+	myPointLightComposite->SetUniform("a_ViewInv", glm::inverse(state.Current.View));
 
 	// Bind our G-Buffer to our texture slots
 	mainBuffer->Bind(0, RenderTargetAttachment::Color0); // The color buffer
 	mainBuffer->Bind(1, RenderTargetAttachment::Depth);
 	mainBuffer->Bind(2, RenderTargetAttachment::Color1); // The normal buffer
+	mainBuffer->Bind(4, RenderTargetAttachment::Color3); // The material buffer
+	// Bind our shadow cubes if any point lights are casting shadows
+	if (myPointShadowBuffer != nullptr) {
+		myPointShadowBuffer->Bind(3);
+	}
 
 	// Iterate over all the ShadowLights in the scene
 	auto view = CurrentRegistry().view<PointLightComponent>();
@@ -324,6 +809,10 @@ void LightingLayer::PostProcessLights() {
 			myPointLightComposite->SetUniform("a_LightPos", pos);
 			myPointLightComposite->SetUniform("a_LightColor", light.Color);
 			myPointLightComposite->SetUniform("a_LightAttenuation", light.Attenuation);
+			// Lights that did not render a shadow cube this frame will have an index of -1
+			myPointLightComposite->SetUniform("a_ShadowIndex", isProcessingShadows ? light.ShadowIndex : -1);
+			myPointLightComposite->SetUniform("a_ShadowRange", light.ShadowRange);
+			myPointLightComposite->SetUniform("a_ShadowBias", light.ShadowBias);
 
 			myFullscreenQuad->Draw();
 		});
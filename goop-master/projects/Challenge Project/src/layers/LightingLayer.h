@@ -3,6 +3,9 @@
 #include <florp\graphics\Shader.h>
 #include <florp\graphics\Mesh.h>
 #include "FrameBuffer.h"
+#include "LayeredDepthBuffer.h"
+#include "ShadowLight.h"
+#include "AutoExposure.h"
 
 class LightingLayer : public florp::app::ApplicationLayer {
 public:
@@ -10,6 +13,8 @@ public:
 	virtual void OnWindowResize(uint32_t width, uint32_t height) override;
 	// Sets up this layer
 	virtual void Initialize() override;
+	// Cleans up the resources that are not managed by shared pointers
+	virtual void Shutdown() override;
 	// Pre render will handle generating all the shadow casting light's buffers
 	virtual void PreRender() override;
 	// Post Render will handle processing the camera's output
@@ -22,17 +27,49 @@ protected:
 	florp::graphics::Mesh::Sptr myFullscreenQuad;        // Used for our post processing passes
 	florp::graphics::Shader::Sptr myShader;              // Used to handle depth generation for regular shadow casters
 	florp::graphics::Shader::Sptr myMaskedShader;        // Used to handle depth generation for shadow casters that have a mask applied
+	florp::graphics::Shader::Sptr myMomentShader;        // Used to handle moment generation for shadow casters using VSM or EVSM
+	florp::graphics::Shader::Sptr myMomentBlur;          // Used to pre-filter moment maps with a separable blur
+	florp::graphics::Shader::Sptr myCascadeShader;       // Used to render all the cascades of a directional light in a single pass
+	florp::graphics::Shader::Sptr myCubeShadowShader;    // Used to render all 6 faces of a point light's shadow cube in a single pass
 	florp::graphics::Shader::Sptr myShadowComposite;     // Used to handle adding a shadow cast
+	florp::graphics::Shader::Sptr myDirectionalComposite;// Used to handle adding a directional light with cascaded shadows
 	florp::graphics::Shader::Sptr myPointLightComposite; // Used to handle adding a point light
 	florp::graphics::Shader::Sptr myFinalComposite;      // Used to perform final compositing of the light buffer and the color buffer 
-	FrameBuffer::Sptr myAccumulationBuffer;              // Our buffer for accumulating our lighting factors
+	AutoExposure::Sptr myAutoExposure;                   // Adapts the exposure used by the final composite to the scene's lighting
+	FrameBuffer::Sptr myAccumulationBuffer;              // Our buffer for accumulating our lighting factors (only held during PostRender)
+	LayeredDepthBuffer::Sptr myPointShadowBuffer;        // The cube map array shared by all shadow casting point lights
+
+	// Stores a single instanced draw for all the shadow casters sharing a mesh
+	struct ShadowBatch {
+		florp::graphics::Mesh::Sptr Mesh;
+		uint32_t FirstInstance;
+		uint32_t InstanceCount;
+	};
+	std::vector<ShadowBatch> myShadowBatches;            // The shadow casters for this frame, grouped by mesh
+	GLuint myShadowInstanceBuffer;                       // Stores the model matrices for all the shadow casters
+	size_t myShadowInstanceCapacity;                     // The number of matrices that our instance buffer can currently hold
+	GLuint myProbeBuffer;                                // Stores the baked light probes, when the scene is using baked lighting
 
 	bool isProcessingShadows, isProcessingPointLights;
+	// True if the scene has baked lighting, in which case we skip all of our shadow and light passes
+	bool isUsingBakedLighting;
 	
 	glm::vec3 myAmbientLight; // Stores our ambient light color
 
+	// Gathers all the shadow casters into instanced batches, and uploads their matrices
+	void BuildShadowBatches();
+	// Draws all of the shadow casting batches with the currently bound shader (which must take a per-instance model matrix)
+	void DrawShadowBatches();
+	// Handles blurring and mip-mapping a shadow light's moment map after it has been rendered
+	void BlurMoments(ShadowLight& light);
+	// Handles rendering the cascades for all directional lights
+	void RenderCascades();
+	// Handles rendering the shadow cubes for all shadow casting point lights
+	void RenderPointShadows();
 	// Handles post-processing shadows
 	void PostProcessShadows();
+	// Handles post-processing directional lights with cascaded shadows
+	void PostProcessDirectionalLights();
 	// Handles post-processing lights (will come later, dun dun daaaa)
 	void PostProcessLights();
 };
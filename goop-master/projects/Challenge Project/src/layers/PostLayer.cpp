@@ -2,7 +2,13 @@
 #include "florp/app/Application.h"
 #include "florp/game/SceneManager.h"
 #include "FrameState.h"
+#include "BloomChain.h"
+#include "DynamicResolution.h"
+#include "SeparableKernel.h"
 #include <imgui.h>
+#include <regex>
+#include <sstream>
+#include "florp/utils/FileUtils.h"
 
 PostLayer::PostPass::ShaderParameter PostLayer::__CreateFloatParam(const std::string& name, float defaultValue, float min, float max) {
 	PostLayer::PostPass::ShaderParameter result;
@@ -46,45 +52,55 @@ void PostLayer::Initialize() {
 		myFullscreenQuad = std::make_shared<florp::graphics::Mesh>(vert, 4, layout, indices, 6);
 	}
 
-	if (false) {
-		auto highlight = __CreatePass("shaders/post/bloom_highlight.fs.glsl");
-		highlight->Name = "Bloom Highlight";
-		highlight->Shader->SetUniform("a_BloomThreshold", 1.0f);
-		highlight->ConfParameters.push_back(__CreateFloatParam("a_BloomThreshold", 1.0f, 0.0f, 2.0f));
-		// Add the pass to the post processing stack
-		myPasses.push_back(highlight);
-
-		// Horizontal blur pass
-		auto hBlur = __CreatePass("shaders/post/blur_gaussian_5.fs.glsl");
-		hBlur->Shader->SetUniform("isHorizontal", 1);
-		hBlur->Output->SetDebugName("HorizontalBuffer");
-
-		// Vertical blur pass
-		auto vBlur = __CreatePass("shaders/post/blur_gaussian_5.fs.glsl");
-		vBlur->Shader->SetUniform("isHorizontal", 0);
-		vBlur->Output->SetDebugName("VerticalBuffer");
-
-		// Perform 10 passes of blurring
-		for (int ix = 0; ix < 10; ix++) {
-			myPasses.push_back(hBlur);
-			myPasses.push_back(vBlur);
-		}
+	myUpscaleShader = std::make_shared<florp::graphics::Shader>();
+	myUpscaleShader->LoadPart(florp::graphics::ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
+	myUpscaleShader->LoadPart(florp::graphics::ShaderStageType::FragmentShader, "shaders/post/upscale.fs.glsl");
+	myUpscaleShader->Link();
+
+	myBilateralUpsample = std::make_shared<florp::graphics::Shader>();
+	myBilateralUpsample->LoadPart(florp::graphics::ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
+	myBilateralUpsample->LoadPart(florp::graphics::ShaderStageType::FragmentShader, "shaders/post/bilateral_upsample.fs.glsl");
+	myBilateralUpsample->Link();
+
+	myConvolutionSeparable = std::make_shared<florp::graphics::Shader>();
+	myConvolutionSeparable->LoadPart(florp::graphics::ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
+	myConvolutionSeparable->LoadPart(florp::graphics::ShaderStageType::FragmentShader, "shaders/post/convolution_separable.fs.glsl");
+	myConvolutionSeparable->Link();
+
+	myConvolution2D = std::make_shared<florp::graphics::Shader>();
+	myConvolution2D->LoadPart(florp::graphics::ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
+	myConvolution2D->LoadPart(florp::graphics::ShaderStageType::FragmentShader, "shaders/post/convolution.fs.glsl");
+	myConvolution2D->Link();
+
+	// All of our passes are built into a render graph, which will work out which passes need to run and share
+	// their targets for us
+	myGraph = std::make_shared<RenderGraph>(RenderTargetPool::Get());
+	mySceneColor = myGraph->Import("Scene");
+	myPrevFrame = myGraph->Import("Previous Frame");
+	myLastOutput = mySceneColor;
 
-		// Our additive pass will add the color from the scene, and add the blurred highlight to it
-		auto additive = __CreatePass("shaders/post/additive_blend.fs.glsl");
-		additive->Inputs.push_back({ nullptr });
-		additive->Inputs.push_back({ vBlur });
+	if (false) {
+		// The bloom is generated by a compute mip chain (see BloomChain), so we only need one pass to add it onto the scene
+		BloomChain::Sptr chain = std::make_shared<BloomChain>();
+		auto bloom = __CreatePass("shaders/post/bloom_composite.fs.glsl");
+		bloom->PreDraw = [chain](const FrameBuffer::Sptr& output) {
+			chain->Apply(output->GetWidth(), output->GetHeight());
+		};
+		bloom->Name = "Bloom";
+		bloom->Shader->SetUniform("a_BloomStrength", 0.2f);
+		bloom->ConfParameters.push_back(__CreateFloatParam("a_BloomStrength", 0.2f, 0.0f, 1.0f));
 		// Add the pass to the post processing stack
-		myPasses.push_back(additive);
+		myPasses.push_back(bloom);
 
 		// We will toggle all the bloom stuff with one key
-		myToggleInputs[florp::app::Key::B] = { additive, hBlur, vBlur, highlight };
+		myToggleInputs[florp::app::Key::B] = { bloom };
 	}
 
 	if (false) {
-		// Our additive pass will add the color from the scene, and add the blurred highlight to it
-		auto motionBlur = __CreatePass("shaders/post/motion_blur.fs.glsl");
-		motionBlur->Inputs.push_back({ nullptr, RenderTargetAttachment::Depth }); // 1 will hold this frame's depth
+		// Motion blur is smooth enough that we can get away with running it at half resolution
+		auto motionBlur = __CreateReducedPass("shaders/post/motion_blur.fs.glsl", {
+			{ mySceneColor, RenderTargetAttachment::Depth } // 1 will hold this frame's depth
+		}, 0.5f);
 		// Add the pass to the post processing stack
 		myPasses.push_back(motionBlur);
 
@@ -95,9 +111,11 @@ void PostLayer::Initialize() {
 	// Depth of field effect
 	if (false) {
 
-		// Our inputs will be the previous pass, and the depth buffer from the main pass
-		auto dof = __CreatePass("shaders/post/depth_of_field.fs.glsl");
-		dof->Inputs.push_back({ nullptr, RenderTargetAttachment::Depth }); // 1 will hold this frame's depth
+		// Our inputs will be the previous pass, and the depth buffer from the main pass. The bokeh is very blurry
+		// anyways, so we run it at half resolution and let the upsample keep the edges of in-focus objects sharp
+		auto dof = __CreateReducedPass("shaders/post/depth_of_field.fs.glsl", {
+			{ mySceneColor, RenderTargetAttachment::Depth } // 1 will hold this frame's depth
+		}, 0.5f);
 		// Add the pass to the post processing stack 
 		myPasses.push_back(dof);
 
@@ -115,16 +133,60 @@ void PostLayer::Initialize() {
 		// We will toggle DOF on and off with one key
 		myToggleInputs[florp::app::Key::T] = { dof };
 	}
+
+	// Sharpening filter, this is 2x the image minus a 7x7 gaussian blur, which decomposes into 2 separable terms
+	if (false) {
+		const int size = 7;
+		float gaussian[size];
+		float total = 0.0f;
+		for (int ix = 0; ix < size; ix++) {
+			gaussian[ix] = glm::exp(-(ix - size / 2) * (ix - size / 2) / 4.0f);
+			total += gaussian[ix];
+		}
+		std::vector<float> kernel(size * size);
+		for (int row = 0; row < size; row++) {
+			for (int col = 0; col < size; col++) {
+				kernel[row * size + col] = -gaussian[row] * gaussian[col] / (total * total);
+			}
+		}
+		kernel[(size / 2) * size + size / 2] += 2.0f;
+
+		auto sharpen = __CreateConvolutionPass(kernel);
+		myPasses.push_back(sharpen);
+
+		myToggleInputs[florp::app::Key::K] = { sharpen };
+	}
+
+	// Simple color effects, these only look at one pixel at a time, so they will all be drawn in a single pass
+	if (false) {
+		auto adjust = __CreatePointwisePass("shaders/post/pointwise/color_adjust.glsl");
+		adjust->Name = "Color Adjustment";
+		adjust->ConfParameters.push_back(__CreateFloatParam("a_Brightness", 0.0f, -1.0f, 1.0f));
+		adjust->ConfParameters.push_back(__CreateFloatParam("a_Contrast", 1.0f, 0.0f, 2.0f));
+		adjust->ConfParameters.push_back(__CreateFloatParam("a_Saturation", 1.0f, 0.0f, 2.0f));
+		myPasses.push_back(adjust);
+
+		auto invert = __CreatePointwisePass("shaders/post/pointwise/invert.glsl");
+		invert->Enabled = false;
+		myPasses.push_back(invert);
+
+		auto checker = __CreatePointwisePass("shaders/post/pointwise/checker.glsl");
+		checker->SetUniform("a_CheckerSize", 8);
+		checker->SetUniform("a_CheckerColor", glm::vec3(0.0f));
+		checker->Enabled = false;
+		myPasses.push_back(checker);
+
+		myToggleInputs[florp::app::Key::I] = { invert };
+		myToggleInputs[florp::app::Key::C] = { checker };
+	}
+
+	// Whatever pass was added last is the result of post processing
+	myGraph->SetFinalOutput(myLastOutput);
 }
 
 void PostLayer::OnWindowResize(uint32_t width, uint32_t height) {
-	//myMainFrameBuffer->Resize(width, height);
-	for (auto& pass : myPasses) {
-		pass->Output->Resize(
-			(uint32_t)(width * pass->ResolutionMultiplier),
-			(uint32_t)(height * pass->ResolutionMultiplier)
-		);
-	}
+	// Our targets all come from the shared pool, so we only need to resize that
+	RenderTargetPool::Get()->Resize(width, height);
 }
 
 void PostLayer::RenderGUI()
@@ -144,7 +206,7 @@ void PostLayer::RenderGUI()
 					case florp::graphics::ShaderDataType::Float: {
 						float* data = (float*)&param.RawDataBuffer;
 						if (ImGui::SliderFloat(param.Name.c_str(), &data[0], data[1], data[2])) {
-							pass->Shader->SetUniform(param.Name, data[0]);
+							pass->SetUniform(param.Name, data[0]);
 						}
 						break;
 					}
@@ -176,84 +238,48 @@ void PostLayer::PostRender() {
 
 	// We'll get the back buffer from the frame state
 	const AppFrameState& state = CurrentRegistry().ctx<AppFrameState>();
-	FrameBuffer::Sptr mainBuffer = state.Current.Output;
 	
-	// Unbind the main framebuffer, so that we can read from it
-	//mainBuffer->UnBind();
 	glDisable(GL_DEPTH_TEST);
 
-	// The last output will start as the output from the rendering
-	FrameBuffer::Sptr lastPass = mainBuffer;
+	// Hand the graph this frame's buffers, if we don't have a last frame yet we'll just use this one
+	myGraph->SetImported(mySceneColor, state.Current.Output);
+	myGraph->SetImported(myPrevFrame, state.Last.Output != nullptr ? state.Last.Output : state.Current.Output);
 
-	float m22 = state.Current.Projection[2][2];
-	float m32 = state.Current.Projection[3][2];
-	float nearPlane = (2.0f * m32) / (2.0f * m22 - 2.0f);
-	float farPlane = ((m22 - 1.0f) * nearPlane) / (m22 + 1.0);
+	// Our passes only need to fill the region that the camera rendered to
+	glm::vec2 uvScale = state.GetUvScale();
+	myGraph->SetViewport(state.Current.Viewport, glm::uvec2(state.Current.Output->GetWidth(), state.Current.Output->GetHeight()));
 
-	// We'll iterate over all of our render passes
-	for (const PostPass::Sptr& pass : myPasses) {
-		if (pass->Enabled) {
-			// We'll bind our post-processing output as the current render target and clear it
-			pass->Output->Bind(RenderTargetBinding::Draw);
-			glClear(GL_COLOR_BUFFER_BIT);
-			// Set the viewport to be the entire size of the passes output
-			glViewport(0, 0, pass->Output->GetWidth(), pass->Output->GetHeight());
-
-			// Use the post processing shader to draw the fullscreen quad
-			pass->Shader->Use();
-			lastPass->Bind(0);
-			pass->Shader->SetUniform("xImage", 0); 
-
-			// Expose camera state to shaders
-			pass->Shader->SetUniform("a_View", state.Current.View);
-			pass->Shader->SetUniform("a_Projection", state.Current.Projection); 
-			pass->Shader->SetUniform("a_ProjectionInv", glm::inverse(state.Current.Projection));
-			pass->Shader->SetUniform("a_ViewProjection", state.Current.ViewProjection);
-			pass->Shader->SetUniform("a_ViewProjectionInv", glm::inverse(state.Current.ViewProjection));
-
-			pass->Shader->SetUniform("a_PrevView", state.Last.View); 
-			pass->Shader->SetUniform("a_PrevProjection", state.Last.Projection);
-			pass->Shader->SetUniform("a_PrevProjectionInv", glm::inverse(state.Last.Projection));
-			pass->Shader->SetUniform("a_PrevViewProjection", state.Last.ViewProjection);
-			pass->Shader->SetUniform("a_PrevViewProjectionInv", glm::inverse(state.Last.ViewProjection));
-
-			pass->Shader->SetUniform("a_NearPlane", nearPlane);
-			pass->Shader->SetUniform("a_FarPlane", farPlane);
-
-			// We'll bind all the inputs as textures in the order they were added (starting at index 1)
-			for (size_t ix = 0; ix < pass->Inputs.size(); ix++) {
-				const auto& input = pass->Inputs[ix];
-				if (input.Pass == nullptr) {
-					if (input.UsePrevFrame && state.Last.Output != nullptr) {
-						state.Last.Output->Bind(ix + 1, input.Attachment);
-					}
-					else {
-						mainBuffer->Bind(ix + 1, input.Attachment);
-					}
-				}
-				else {
-					input.Pass->Output->Bind(ix + 1, input.Attachment);
-				}
-			}
-			pass->Shader->SetUniform("xScreenRes", glm::ivec2(pass->Output->GetWidth(), pass->Output->GetHeight()));
-			myFullscreenQuad->Draw();
+	// Run all the enabled passes, if they are all disabled this will just be the main buffer
+	FrameBuffer::Sptr lastPass = myGraph->Execute();
 
-			// Unbind the output pass so that we can read from it
-			pass->Output->UnBind();
+	glm::ivec2 windowSize = glm::ivec2(app->GetWindow()->GetWidth(), app->GetWindow()->GetHeight());
+	if (glm::ivec2(state.Current.Viewport) == windowSize) {
+		// Bind the last buffer we wrote to as our source for read operations
+		lastPass->Bind(RenderTargetBinding::Read);
+		// Copies the region we rendered to from lastPass into the default back buffer, our buffers may be larger than the window
+		FrameBuffer::Blit({ 0, 0, windowSize.x, windowSize.y },
+			{ 0, 0, windowSize.x, windowSize.y }, BufferFlags::All, florp::graphics::MagFilter::Nearest);
 
-			// Update the last pass output to be this passes output
-			lastPass = pass->Output;
-		}
+		// Unbind the last buffer from read operations, so we can write to it again later
+		lastPass->UnBind();
+	}
+	else {
+		// We rendered at a reduced resolution, so we need to filter the image up to the size of the screen
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glViewport(0, 0, app->GetWindow()->GetWidth(), app->GetWindow()->GetHeight());
+		lastPass->Bind(0);
+		myUpscaleShader->Use();
+		myUpscaleShader->SetUniform("xImage", 0);
+		myUpscaleShader->SetUniform("a_UvScale", uvScale);
+		myUpscaleShader->SetUniform("xScreenRes", glm::ivec2(app->GetWindow()->GetWidth(), app->GetWindow()->GetHeight()));
+		myFullscreenQuad->Draw();
 	}
-		
-	// Bind the last buffer we wrote to as our source for read operations
-	lastPass->Bind(RenderTargetBinding::Read);
-	// Copies the image from lastPass into the default back buffer
-	FrameBuffer::Blit({ 0, 0, lastPass->GetWidth(), lastPass->GetHeight()},
-		{0, 0, app->GetWindow()->GetWidth(), app->GetWindow()->GetHeight()}, BufferFlags::All, florp::graphics::MagFilter::Nearest);
-
-	// Unbind the last buffer from read operations, so we can write to it again later
-	lastPass->UnBind();
+
+	// Give all our targets back to the pool
+	myGraph->EndFrame();
+
+	// That's all of our GPU work for the frame, the controller can pick our resolution for the coming frames
+	DynamicResolution::Get()->EndFrame();
 }
 
 void PostLayer::Update() {
@@ -264,36 +290,294 @@ void PostLayer::Update() {
 	for (auto it = myToggleInputs.begin(); it != myToggleInputs.end(); ++it) {
 		// If the key is pressed this frame
 		if (window->GetKeyState(it->first) == florp::app::ButtonState::Pressed) {
-			// Iterate over each pass associated with the key and toggle it
+			// Iterate over each pass associated with the key and toggle it, the graph will skip it from now on
 			for (auto& ptr : it->second) {
 				// Invert the enabled state
-				ptr->Enabled = !ptr->Enabled;
+				if (ptr->IsPointwise)
+					ptr->Enabled = !ptr->Enabled;
+				else
+					myGraph->SetEnabled(ptr->Handle, !myGraph->IsEnabled(ptr->Handle));
 			}
 		}
 	}
+
+	// Pointwise groups only need to be drawn if at least one of their stages is enabled
+	for (const PointwiseGroup::Sptr& group : myGroups) {
+		bool enabled = false;
+		for (const PostPass::Sptr& stage : group->Stages)
+			enabled |= stage->Enabled;
+		myGraph->SetEnabled(group->Handle, enabled);
+	}
 }
 
-PostLayer::PostPass::Sptr PostLayer::__CreatePass(const char* fragmentShader, float scale) const {	
-	florp::app::Application* app = florp::app::Application::Get();
-	
-	RenderBufferDesc mainColor = RenderBufferDesc();
-	mainColor.ShaderReadable = true;
-	mainColor.Attachment = RenderTargetAttachment::Color0;
-	mainColor.Format = RenderTargetType::ColorRgb8;
-	
+void PostLayer::__ExecutePass(const florp::graphics::Shader::Sptr& shader, const FrameBuffer::Sptr& output) {
+	const AppFrameState& state = CurrentRegistry().ctx<AppFrameState>();
+
+	float m22 = state.Current.Projection[2][2];
+	float m32 = state.Current.Projection[3][2];
+	float nearPlane = (2.0f * m32) / (2.0f * m22 - 2.0f);
+	float farPlane = ((m22 - 1.0f) * nearPlane) / (m22 + 1.0);
+
+	// Use the post processing shader to draw the fullscreen quad, the graph has already bound our inputs
+	shader->Use();
+	shader->SetUniform("xImage", 0); 
+	shader->SetUniform("a_UvScale", state.GetUvScale());
+
+	// Expose camera state to shaders
+	shader->SetUniform("a_View", state.Current.View);
+	shader->SetUniform("a_Projection", state.Current.Projection); 
+	shader->SetUniform("a_ProjectionInv", glm::inverse(state.Current.Projection));
+	shader->SetUniform("a_ViewProjection", state.Current.ViewProjection);
+	shader->SetUniform("a_ViewProjectionInv", glm::inverse(state.Current.ViewProjection));
+
+	shader->SetUniform("a_PrevView", state.Last.View); 
+	shader->SetUniform("a_PrevProjection", state.Last.Projection);
+	shader->SetUniform("a_PrevProjectionInv", glm::inverse(state.Last.Projection));
+	shader->SetUniform("a_PrevViewProjection", state.Last.ViewProjection);
+	shader->SetUniform("a_PrevViewProjectionInv", glm::inverse(state.Last.ViewProjection));
+
+	shader->SetUniform("a_NearPlane", nearPlane);
+	shader->SetUniform("a_FarPlane", farPlane);
+
+	shader->SetUniform("xScreenRes", glm::ivec2(output->GetWidth(), output->GetHeight()));
+	myFullscreenQuad->Draw();
+}
+
+PostLayer::PostPass::Sptr PostLayer::__CreatePass(const char* fragmentShader, const std::vector<RenderGraph::Input>& extraInputs, float scale) {
 	auto shader = std::make_shared<florp::graphics::Shader>();
 	shader->LoadPart(florp::graphics::ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
 	shader->LoadPart(florp::graphics::ShaderStageType::FragmentShader, fragmentShader);
 	shader->Link();
 
-	// Each pass gets it's own copy of the frame buffer to avoid pipeline stalls
-	auto output = std::make_shared<FrameBuffer>(app->GetWindow()->GetWidth() * scale, app->GetWindow()->GetHeight() * scale);
-	output->AddAttachment(mainColor);
-	output->Validate();
+	// Name the pass after its shader's file, without the folder or extensions (ex: shaders/post/bloom.fs.glsl is bloom)
+	std::string name = fragmentShader;
+	name = name.substr(name.find_last_of("/\\") + 1);
+	name = name.substr(0, name.find('.'));
+	return __CreatePass(name, shader, extraInputs, scale);
+}
 
-	// Return the pass that we just created
+PostLayer::PostPass::Sptr PostLayer::__CreatePass(const std::string& name, const florp::graphics::Shader::Sptr& shader, const std::vector<RenderGraph::Input>& extraInputs, float scale) {
 	auto result = std::make_shared<PostPass>();
+	result->Name = name;
 	result->Shader = shader;
-	result->Output = output;
+
+	// The previous pass is always our first input, so that it becomes xImage and so that the graph can read through us when we're disabled
+	std::vector<RenderGraph::Input> inputs;
+	inputs.reserve(extraInputs.size() + 1);
+	inputs.push_back({ myLastOutput });
+	inputs.insert(inputs.end(), extraInputs.begin(), extraInputs.end());
+
+	// Each pass gets a target from the pool, which it will share with any passes that have finished by the time it runs
+	TransientTargetDesc output;
+	output.Format = RenderTargetType::ColorRgb8;
+	output.ResolutionMultiplier = scale;
+	result->Handle = myGraph->AddPass(name, inputs, output, [this, result](const FrameBuffer::Sptr& target) {
+		if (result->PreDraw)
+			result->PreDraw(target);
+		__ExecutePass(result->Shader, target);
+	});
+
+	// Any pointwise passes after this one can't be fused with the ones before it
+	myOpenGroup = nullptr;
+
+	// Return the pass that we just created
+	myLastOutput = myGraph->GetOutput(result->Handle);
+	return result;
+}
+
+PostLayer::PostPass::Sptr PostLayer::__CreateReducedPass(const char* fragmentShader, const std::vector<RenderGraph::Input>& extraInputs, float scale) {
+	// The upsample reads through to the pass before the effect when it is disabled, so we need to remember it
+	RenderGraph::ResourceHandle source = myLastOutput;
+
+	PostPass::Sptr result = __CreatePass(fragmentShader, extraInputs, scale);
+
+	// The upsample weights the low resolution texels by how well their depth matches the pixel's depth
+	TransientTargetDesc output;
+	output.Format = RenderTargetType::ColorRgb8;
+	result->Handle = myGraph->AddPass(result->Name + " Upsample", {
+		{ source },                                      // 0 is the full resolution image, for when the effect is disabled
+		{ myLastOutput },                                // 1 is the result of the reduced resolution pass
+		{ mySceneColor, RenderTargetAttachment::Depth }  // 2 is this frame's depth
+	}, output, [this](const FrameBuffer::Sptr& target) {
+		__ExecutePass(myBilateralUpsample, target);
+	});
+
+	myLastOutput = myGraph->GetOutput(result->Handle);
 	return result;
 }
+
+PostLayer::PostPass::Sptr PostLayer::__CreateConvolutionPass(const std::vector<float>& kernel, float tolerance) {
+	uint32_t size = (uint32_t)glm::round(glm::sqrt((float)kernel.size()));
+	LOG_ASSERT(size * size == kernel.size(), "Convolution kernels must be square!");
+	SeparableKernel decomposed = SeparableKernel::Decompose(kernel.data(), size, tolerance);
+
+	// Kernels that aren't close enough to separable are applied all at once
+	if (!decomposed.IsSeparable()) {
+		std::vector<glm::vec4> packed((size * size + 3) / 4, glm::vec4(0.0f));
+		memcpy(packed.data(), kernel.data(), kernel.size() * sizeof(float));
+
+		PostPass::Sptr result = __CreatePass("Convolution", myConvolution2D);
+		// The shader is shared by all 2D convolutions, so we need to send the kernel every time we draw
+		result->PreDraw = [this, packed, size](const FrameBuffer::Sptr& output) {
+			myConvolution2D->SetUniforms("a_Kernel", (int)packed.size(), packed.data());
+			myConvolution2D->SetUniform("a_KernelSize", (int)size);
+		};
+		LOG_INFO("Applying {}x{} convolution as a 2D kernel ({} taps)", size, size, size * size);
+		return result;
+	}
+
+	// The terms have negative weights in them, so the partial results need a signed format
+	TransientTargetDesc intermediate;
+	intermediate.Format = RenderTargetType::ColorRgb16F;
+
+	// Each term is a horizontal pass over the source, followed by a vertical pass that adds it to the terms before it
+	RenderGraph::ResourceHandle source = myLastOutput;
+	RenderGraph::ResourceHandle accumulated = RenderGraph::InvalidHandle;
+	RenderGraph::PassHandle last = RenderGraph::InvalidHandle;
+	const std::vector<SeparableKernel::Term>& terms = decomposed.GetTerms();
+	for (size_t ix = 0; ix < terms.size(); ix++) {
+		std::vector<glm::vec2> horizontal, vertical;
+		for (const KernelTap& tap : terms[ix].Horizontal)
+			horizontal.push_back({ tap.Offset, tap.Weight });
+		for (const KernelTap& tap : terms[ix].Vertical)
+			vertical.push_back({ tap.Offset, tap.Weight });
+
+		RenderGraph::PassHandle pass = myGraph->AddPass("Convolution Horizontal", { { source } }, intermediate, [this, horizontal](const FrameBuffer::Sptr& target) {
+			__ExecuteConvolution(horizontal, glm::vec2(1.0f, 0.0f), 0, false, target);
+		});
+
+		// The source stays our first input, so that the graph reads straight through us when we are disabled
+		std::vector<RenderGraph::Input> inputs = { { source }, { myGraph->GetOutput(pass) } };
+		bool accumulate = accumulated != RenderGraph::InvalidHandle;
+		if (accumulate)
+			inputs.push_back({ accumulated });
+
+		TransientTargetDesc output = intermediate;
+		if (ix == terms.size() - 1)
+			output.Format = RenderTargetType::ColorRgb8;
+		last = myGraph->AddPass("Convolution Vertical", inputs, output, [this, vertical, accumulate](const FrameBuffer::Sptr& target) {
+			__ExecuteConvolution(vertical, glm::vec2(0.0f, 1.0f), 1, accumulate, target);
+		});
+		accumulated = myGraph->GetOutput(last);
+	}
+	LOG_INFO("Applying {}x{} convolution as {} separable terms ({} taps instead of {}, error {:.4f})",
+		size, size, terms.size(), decomposed.GetTapCount(), size * size, decomposed.GetError());
+
+	auto result = std::make_shared<PostPass>();
+	result->Shader = myConvolutionSeparable;
+	result->Handle = last;
+	result->Name = "Convolution";
+
+	myOpenGroup = nullptr;
+	myLastOutput = accumulated;
+	return result;
+}
+
+void PostLayer::__ExecuteConvolution(const std::vector<glm::vec2>& taps, const glm::vec2& direction, int input, bool accumulate, const FrameBuffer::Sptr& output) {
+	myConvolutionSeparable->SetUniforms("a_Taps", (int)taps.size(), taps.data());
+	myConvolutionSeparable->SetUniform("a_TapCount", (int)taps.size());
+	myConvolutionSeparable->SetUniform("a_Direction", direction);
+	myConvolutionSeparable->SetUniform("s_Input", input);
+	myConvolutionSeparable->SetUniform("b_Accumulate", accumulate ? 1 : 0);
+	__ExecutePass(myConvolutionSeparable, output);
+}
+
+PostLayer::PostPass::Sptr PostLayer::__CreatePointwisePass(const char* source) {
+	auto result = std::make_shared<PostPass>();
+	result->IsPointwise = true;
+	result->PointwiseSource = source;
+	result->Name = source;
+
+	// If the last pass wasn't pointwise, we need to start a new group for this pass (and any that follow it)
+	if (myOpenGroup == nullptr) {
+		PointwiseGroup::Sptr group = std::make_shared<PointwiseGroup>();
+
+		TransientTargetDesc output;
+		output.Format = RenderTargetType::ColorRgb8;
+		group->Handle = myGraph->AddPass("Pointwise Group", { { myLastOutput } }, output, [this, group](const FrameBuffer::Sptr& target) {
+			__ExecuteGroup(*group, target);
+		});
+
+		myGroups.push_back(group);
+		myOpenGroup = group;
+		myLastOutput = myGraph->GetOutput(group->Handle);
+	}
+
+	myOpenGroup->Stages.push_back(result);
+	result->Handle = myOpenGroup->Handle;
+	return result;
+}
+
+void PostLayer::__ExecuteGroup(const PointwiseGroup& group, const FrameBuffer::Sptr& output) {
+	std::vector<PostPass*> stages;
+	stages.reserve(group.Stages.size());
+	for (const PostPass::Sptr& stage : group.Stages) {
+		if (stage->Enabled)
+			stages.push_back(stage.get());
+	}
+
+	// Send each stage's uniforms to the fused shader, under that stage's namespace
+	const florp::graphics::Shader::Sptr& shader = __GetFusedShader(stages);
+	for (size_t ix = 0; ix < stages.size(); ix++) {
+		std::string prefix = "s" + std::to_string(ix) + "_";
+		for (const auto& kvp : stages[ix]->Uniforms)
+			kvp.second(*shader, prefix + kvp.first);
+	}
+
+	__ExecutePass(shader, output);
+}
+
+const florp::graphics::Shader::Sptr& PostLayer::__GetFusedShader(const std::vector<PostPass*>& stages) {
+	// The signature of a chain is just the list of sources in it, in order
+	std::string signature;
+	for (const PostPass* stage : stages) {
+		signature += stage->PointwiseSource;
+		signature += ';';
+	}
+	auto it = myFusedShaders.find(signature);
+	if (it != myFusedShaders.end())
+		return it->second;
+
+	// Each stage's uniforms, constants and functions (including Apply) get prefixed with the stage's index, so they can't
+	// collide. Only the names that the stage declares itself are renamed, so the shared inputs like xImage are left alone
+	static const std::regex declaration("\\b(?:uniform|const)\\s+\\w+\\s+(\\w+)|(?:^|\\n)\\w+\\s+(\\w+)\\s*\\(");
+
+	std::stringstream source;
+	source << "#version 440\n\n";
+	source << "layout (location = 0) in vec2 inUV;\n";
+	source << "layout (location = 1) in vec2 inScreenCoords;\n\n";
+	source << "layout (location = 0) out vec4 outColor;\n\n";
+	source << "uniform sampler2D xImage;\n";
+	source << "uniform ivec2 xScreenRes;\n\n";
+	for (size_t ix = 0; ix < stages.size(); ix++) {
+		char* data = florp::utils::ReadFile(stages[ix]->PointwiseSource.c_str());
+		std::string stageSource = data;
+		delete[] data;
+
+		std::string names = "Apply";
+		for (std::sregex_iterator it(stageSource.begin(), stageSource.end(), declaration), end; it != end; ++it) {
+			const std::string name = (*it)[1].matched ? (*it)[1].str() : (*it)[2].str();
+			if (name != "Apply")
+				names += "|" + name;
+		}
+		const std::regex namespaced("\\b(" + names + ")\\b");
+
+		source << "// " << stages[ix]->PointwiseSource << "\n";
+		source << std::regex_replace(stageSource, namespaced, "s" + std::to_string(ix) + "_$1") << "\n\n";
+	}
+	source << "void main() {\n";
+	source << "\tvec4 color = texture(xImage, inUV);\n";
+	for (size_t ix = 0; ix < stages.size(); ix++)
+		source << "\tcolor = s" << ix << "_Apply(color);\n";
+	source << "\toutColor = color;\n";
+	source << "}\n";
+
+	auto shader = std::make_shared<florp::graphics::Shader>();
+	shader->LoadPart(florp::graphics::ShaderStageType::VertexShader, "shaders/post/post.vs.glsl");
+	shader->CompilePart(florp::graphics::ShaderStageType::FragmentShader, source.str());
+	shader->Link();
+	shader->SetDebugName("Fused Post " + signature);
+
+	LOG_INFO("Generated fused post processing shader for {} pointwise passes", stages.size());
+	return myFusedShaders.emplace(signature, shader).first->second;
+}
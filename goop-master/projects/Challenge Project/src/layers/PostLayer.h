@@ -2,6 +2,7 @@
 #include "florp/app/ApplicationLayer.h"
 #include "florp/app/Window.h"
 #include "FrameBuffer.h"
+#include "RenderGraph.h"
 #include "florp/graphics/Mesh.h"
 #include "florp/graphics/Shader.h"
 
@@ -16,18 +17,51 @@ public:
 
 protected:
 	florp::graphics::Mesh::Sptr myFullscreenQuad;
+	// Used to stretch the image to the screen when we are rendering at a reduced resolution
+	florp::graphics::Shader::Sptr myUpscaleShader;
+	// Used to bring passes that run at a reduced resolution back up to full resolution, without bleeding across edges
+	florp::graphics::Shader::Sptr myBilateralUpsample;
+	// Used for convolution passes, the separable shader runs half of a separable term, the other runs the full 2D kernel
+	florp::graphics::Shader::Sptr myConvolutionSeparable;
+	florp::graphics::Shader::Sptr myConvolution2D;
+
+	// The graph that all of our passes are built into, and the resources that come from the rest of the frame
+	RenderGraph::Sptr            myGraph;
+	RenderGraph::ResourceHandle  mySceneColor; // This frame's G-Buffer, after lighting
+	RenderGraph::ResourceHandle  myPrevFrame;  // The last frame's G-Buffer (or this frame's if there was no last frame)
+	// The last resource that was added to the graph, new passes will read from this by default
+	RenderGraph::ResourceHandle  myLastOutput;
 
 	struct PostPass {
 		typedef std::shared_ptr<PostPass> Sptr;
+		// Sends a stored uniform value to a shader, under the given (possibly namespaced) name
+		typedef std::function<void(florp::graphics::Shader& shader, const std::string& name)> UniformSetter;
 
-		florp::graphics::Shader::Sptr Shader;
-		FrameBuffer::Sptr             Output;
-		struct Input {
-			Sptr                      Pass;
-			RenderTargetAttachment    Attachment = RenderTargetAttachment::Color0;
-			bool                      UsePrevFrame = false; 
-		};
-		std::vector<Input>            Inputs;
+		florp::graphics::Shader::Sptr Shader; // Null for pointwise passes, which are drawn with their group's fused shader
+		RenderGraph::PassHandle       Handle; // For pointwise passes, this is the graph pass of the group they belong to
+		// Optional extra work to do before the pass is drawn (like dispatching compute shaders), once the inputs are bound
+		std::function<void(const FrameBuffer::Sptr& output)> PreDraw;
+
+		// Pointwise passes only look at their own pixel from the previous pass, so runs of them can be fused into one shader
+		bool                          IsPointwise = false;
+		std::string                   PointwiseSource; // The path to the file with the pass's Apply function
+		bool                          Enabled = true;  // Pointwise passes are toggled within their group, rather than in the graph
+		std::unordered_map<std::string, UniformSetter> Uniforms; // The uniform values for a pointwise pass
+
+		/*
+		 * Sets a uniform for this pass. Pointwise passes will hold onto the value, and send it to whichever fused shader
+		 * they end up being drawn with
+		 */
+		template <typename T>
+		void SetUniform(const std::string& name, const T& value) {
+			if (IsPointwise) {
+				Uniforms[name] = [value](florp::graphics::Shader& shader, const std::string& fullName) {
+					shader.SetUniform(fullName, value);
+				};
+			} else {
+				Shader->SetUniform(name, value);
+			}
+		}
 
 		std::string                   Name;
 		
@@ -40,14 +74,70 @@ protected:
 			char                            RawDataBuffer[4 * 4 * sizeof(float)];
 		};
 		std::vector<ShaderParameter>  ConfParameters;
-
-		float                         ResolutionMultiplier = 1.0f;
-		bool                          Enabled = true;
 	};
 	std::vector<PostPass::Sptr> myPasses;
 	std::unordered_map<florp::app::Key, std::vector<PostPass::Sptr>> myToggleInputs;
-	
-	PostPass::Sptr __CreatePass(const char* fragmentShader, float scale = 1.0f) const;
+
+	// A run of adjacent pointwise passes, which is drawn as a single pass in the graph
+	struct PointwiseGroup {
+		typedef std::shared_ptr<PointwiseGroup> Sptr;
+
+		std::vector<PostPass::Sptr> Stages;
+		RenderGraph::PassHandle     Handle;
+	};
+	std::vector<PointwiseGroup::Sptr> myGroups;
+	// The group that new pointwise passes will be added to, this is cleared whenever a regular pass is added
+	PointwiseGroup::Sptr myOpenGroup;
+	// The shaders we have generated for our groups, keyed by the sources of the enabled stages in them
+	std::unordered_map<std::string, florp::graphics::Shader::Sptr> myFusedShaders;
+
+	/*
+	 * Adds a new pass to the end of the post processing chain
+	 * @param fragmentShader The path to the fragment shader for the pass
+	 * @param extraInputs Any resources to read from besides the previous pass, these are bound starting at slot 1
+	 * @param scale The resolution of the pass's output, relative to the window
+	 */
+	PostPass::Sptr __CreatePass(const char* fragmentShader, const std::vector<RenderGraph::Input>& extraInputs = {}, float scale = 1.0f);
+	/*
+	 * Adds a new pass to the end of the post processing chain that re-uses an existing shader (for instance, for
+	 * repeated blur passes)
+	 * @param name The name of the pass, for the render graph and the debug UI
+	 */
+	PostPass::Sptr __CreatePass(const std::string& name, const florp::graphics::Shader::Sptr& shader, const std::vector<RenderGraph::Input>& extraInputs = {}, float scale = 1.0f);
+	/*
+	 * Adds a new pass that runs at a fraction of the screen's resolution, followed by a depth aware upsample back to
+	 * full resolution. This is meant for expensive, low frequency effects (depth of field, motion blur, SSAO, etc...)
+	 * The returned pass's shader is the reduced resolution one, while its handle is the upsample, so toggling the
+	 * pass will skip both of them
+	 * @param fragmentShader The path to the fragment shader for the pass
+	 * @param extraInputs Any resources to read from besides the previous pass, these are bound starting at slot 1
+	 * @param scale The resolution to run the pass at, relative to the window (ex: 0.5 for half, 0.25 for quarter)
+	 */
+	PostPass::Sptr __CreateReducedPass(const char* fragmentShader, const std::vector<RenderGraph::Input>& extraInputs = {}, float scale = 0.5f);
+	/*
+	 * Adds a convolution with an arbitrary kernel to the end of the post processing chain. The kernel is decomposed
+	 * on the CPU (see SeparableKernel), and if it is close enough to separable it is applied as pairs of 1D passes.
+	 * Otherwise it falls back to a single pass applying the whole 2D kernel
+	 * @param kernel The weights of the kernel, row by row starting from the top. Must be square, with an odd size
+	 * @param tolerance The largest error we will accept from the separable approximation, relative to the kernel
+	 */
+	PostPass::Sptr __CreateConvolutionPass(const std::vector<float>& kernel, float tolerance = 0.01f);
+	// Draws one half of a separable convolution term, with the input read from the given texture slot
+	void __ExecuteConvolution(const std::vector<glm::vec2>& taps, const glm::vec2& direction, int input, bool accumulate, const FrameBuffer::Sptr& output);
+	/*
+	 * Adds a new pointwise pass to the end of the post processing chain. If the last pass was also pointwise, they will
+	 * be drawn together in a single shader
+	 * @param source The path to a file declaring the pass's "vec4 Apply(vec4 color)" function and any uniforms it needs
+	 *               The uniforms, constants and functions that it declares are namespaced when fused, so other
+	 *               stages can use the same names. Functions must start at the beginning of a line to be found
+	 */
+	PostPass::Sptr __CreatePointwisePass(const char* source);
+	// Draws all the enabled stages of a pointwise group
+	void __ExecuteGroup(const PointwiseGroup& group, const FrameBuffer::Sptr& output);
+	// Gets the fused shader for a list of pointwise stages, generating it if we haven't seen that chain before
+	const florp::graphics::Shader::Sptr& __GetFusedShader(const std::vector<PostPass*>& stages);
+	// Sets up the shared uniforms for a shader and draws the fullscreen quad into the bound output
+	void __ExecutePass(const florp::graphics::Shader::Sptr& shader, const FrameBuffer::Sptr& output);
 
 	PostPass::ShaderParameter __CreateFloatParam(const std::string& name, float defaultVal, float min, float max);
 
@@ -3,14 +3,18 @@
 #include <florp\game\RenderableComponent.h>
 #include <florp\app\Timing.h>
 #include <florp\game\Transform.h>
+#include <florp\game\LodGroup.h>
 #include "CameraComponent.h"
 #include "FrameState.h"
+#include "DynamicResolution.h"
+#include "RenderTargetPool.h"
+#include "florp/app/Application.h"
 
 typedef florp::game::RenderableComponent Renderable;
 
 void sortRenderers(entt::registry& reg) {
 	// We sort our mesh renderers based on material properties
-	// This will group all of our meshes based on shader first, then material second
+	// This will group all of our meshes based on shader first, then material second, then the mesh arena
 	reg.sort<florp::game::RenderableComponent>([](const florp::game::RenderableComponent& lhs, const florp::game::RenderableComponent& rhs) {
 		if (rhs.Material == nullptr || rhs.Mesh == nullptr)
 			return false;
@@ -22,8 +26,11 @@ void sortRenderers(entt::registry& reg) {
 			return true;
 		else if (lhs.Material->GetShader() != rhs.Material->GetShader())
 			return lhs.Material->GetShader() < rhs.Material->GetShader();
-		else
+		else if (lhs.Material != rhs.Material)
 			return lhs.Material < rhs.Material;
+		else
+			// Meshes in the same arena share a vertex array, so we keep them together as well
+			return lhs.Mesh->GetArena() < rhs.Mesh->GetArena();
 		});
 }
 
@@ -34,13 +41,27 @@ void dtorSort(entt::entity, entt::registry& ecs) {
 	sortRenderers(ecs);
 }
 
+void RenderLayer::Initialize() {
+	myRenderer = std::make_shared<IndirectRenderer>();
+}
+
+void RenderLayer::Shutdown() {
+	myRenderer = nullptr;
+}
+
 void RenderLayer::OnWindowResize(uint32_t width, uint32_t height)
 {
+	// The pool decides how large our window sized buffers are (with some room to grow), so that our G-Buffer matches
+	// the targets used for lighting and post processing. This will do nothing unless the window outgrew them
+	const RenderTargetPool::Sptr& pool = RenderTargetPool::Get();
+	pool->Resize(width, height);
+	glm::uvec2 size = pool->GetSize();
+
 	CurrentRegistry().view<CameraComponent>().each([&](auto entity, CameraComponent& cam) {
 		if (cam.IsMainCamera) {
-			cam.BackBuffer->Resize(width, height);
+			cam.BackBuffer->Resize(size.x, size.y);
 			if (cam.FrontBuffer != nullptr) {
-				cam.FrontBuffer->Resize(width, height);
+				cam.FrontBuffer->Resize(size.x, size.y);
 			}
 		}
 	});
@@ -51,6 +72,27 @@ void RenderLayer::OnSceneEnter() {
 	CurrentRegistry().on_destroy<Renderable>().connect<&::dtorSort>();
 }
 
+void RenderLayer::PreRender() {
+	// The lighting layer renders shadows in PreRender, so we need to start timing before that (we're added first)
+	DynamicResolution::Get()->BeginFrame();
+
+	// Pick our levels of detail before anything is drawn, so that the shadow and camera passes agree on them this frame
+	using namespace florp::game;
+	auto& ecs = CurrentRegistry();
+	ecs.view<CameraComponent>().each([&](auto entity, const CameraComponent& cam) {
+		if (!cam.IsMainCamera)
+			return;
+		glm::vec3 cameraPosition = glm::vec3(ecs.get<Transform>(entity).GetWorldTransform()[3]);
+		ecs.view<LodGroup, Renderable>().each([&](auto entity, LodGroup& lod, Renderable& renderable) {
+			if (lod.Levels.empty())
+				return;
+			const Transform& transform = ecs.get_or_assign<Transform>(entity);
+			lod.Update(lod.GetScreenSize(transform.GetWorldTransform(), cameraPosition, cam.Projection));
+			renderable.Mesh = lod.GetCameraMesh();
+		});
+	});
+}
+
 void RenderLayer::Render()
 {
 	using namespace florp::game;
@@ -58,8 +100,8 @@ void RenderLayer::Render()
 
 	auto& ecs = CurrentRegistry();
 
-	Material::Sptr material = nullptr;
-	Shader::Sptr boundShader = nullptr;
+	// Our objects are the same for every camera, so we only need to gather them once
+	myRenderer->Gather(ecs);
 
 	ecs.sort<CameraComponent>([](const CameraComponent& lhs, const CameraComponent& rhs) {
 		return rhs.IsMainCamera;
@@ -68,64 +110,29 @@ void RenderLayer::Render()
 	ecs.view<CameraComponent>().each([&](auto entity, CameraComponent& cam) {
 		const Transform& camTransform = ecs.get<florp::game::Transform>(entity);
 		
+		// The main camera only renders into the part of its buffer that covers the window (scaled down if we are running
+		// at a reduced resolution), since the buffer is allocated with some room to grow
+		glm::uvec2 viewport = glm::uvec2(cam.BackBuffer->GetWidth(), cam.BackBuffer->GetHeight());
+		if (cam.IsMainCamera) {
+			const florp::app::Window::Sptr& window = florp::app::Application::Get()->GetWindow();
+			viewport = glm::min(viewport, glm::uvec2(window->GetWidth(), window->GetHeight()));
+			float scale = DynamicResolution::Get()->GetScale();
+			// This is rounded up like the post passes' regions are (see RenderGraph::SetViewport)
+			viewport = glm::max(glm::uvec2(glm::ceil(glm::vec2(viewport) * scale)), glm::uvec2(1));
+		}
+		
 		cam.BackBuffer->Bind();
-		glViewport(0, 0, cam.BackBuffer->GetWidth(), cam.BackBuffer->GetHeight());
+		glViewport(0, 0, viewport.x, viewport.y);
 		glClearColor(cam.ClearCol.x, cam.ClearCol.y, cam.ClearCol.z, cam.ClearCol.w);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 		glEnable(GL_DEPTH_TEST);
 		glEnable(GL_CULL_FACE);
 
-		glm::vec3 position = camTransform.GetLocalPosition();
 		glm::mat4 viewMatrix = glm::inverse(camTransform.GetWorldTransform());
 		glm::mat4 viewProjection = cam.Projection * viewMatrix;
 
-		// A view will let us iterate over all of our entities that have the given component types
-		auto view = ecs.view<Renderable>();
-
-		for (const auto& entity : view) {
-
-			// Get our shader
-			const Renderable& renderer = ecs.get<Renderable>(entity);
-
-			// Early bail if mesh is invalid
-			if (renderer.Mesh == nullptr || renderer.Material == nullptr)
-				continue;
-
-			// If our shader has changed, we need to bind it and update our frame-level uniforms
-			if (renderer.Material->GetShader() != boundShader) {
-				boundShader = renderer.Material->GetShader();
-				boundShader->Use();
-				//boundShader->SetUniform("a_CameraPos", position);
-				boundShader->SetUniform("a_Time", florp::app::Timing::GameTime);
-			}
-
-			// If our material has changed, we need to apply it to the shader
-			if (renderer.Material != material) {
-				material = renderer.Material;
-				material->Apply();
-			}
-
-			// We'll need some info about the entities position in the world
-			const Transform& transform = ecs.get_or_assign<Transform>(entity);
-
-			// Our normal matrix is the inverse-transpose of our object's world rotation
-			glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(viewMatrix * transform.GetWorldTransform())));
-
-			// Update the MVP using the item's transform
-			boundShader->SetUniform(
-				"a_ModelViewProjection",
-				viewProjection *
-				transform.GetWorldTransform());
-
-			// Update the model matrix to the item's world transform
-			boundShader->SetUniform("a_Model", transform.GetWorldTransform());
-
-			// Update the model matrix to the item's world transform
-			boundShader->SetUniform("a_NormalMatrix", normalMatrix);
-
-			// Draw the item
-			renderer.Mesh->Draw();
-		}
+		// Cull and draw everything, this is a handful of draw calls no matter how many objects are in the scene
+		myRenderer->Render(viewMatrix, viewProjection);
 		
 		cam.BackBuffer->UnBind();
 		
@@ -147,6 +154,7 @@ void RenderLayer::Render()
 			state.Current.View = viewMatrix;
 			state.Current.Projection = cam.Projection;
 			state.Current.ViewProjection = viewProjection;
+			state.Current.Viewport = viewport;
 		}
 	});
 }
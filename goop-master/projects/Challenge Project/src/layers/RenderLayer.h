@@ -1,14 +1,26 @@
 #pragma once
 #include "florp/app/ApplicationLayer.h"
 #include "FrameBuffer.h"
+#include "IndirectRenderer.h"
 
 class RenderLayer : public florp::app::ApplicationLayer
 {
 public:
+	// Sets up the renderer that draws our scene
+	virtual void Initialize() override;
+	// Cleans up the renderer, while we still have a context
+	virtual void Shutdown() override;
+
 	virtual void OnWindowResize(uint32_t width, uint32_t height) override;
 	
 	virtual void OnSceneEnter() override;
+
+	// Starts timing the GPU work for the frame, for dynamic resolution
+	virtual void PreRender() override;
 	
 	// Render will be where we actually perform our rendering
 	virtual void Render() override;
+
+protected:
+	IndirectRenderer::Sptr myRenderer; // Culls and draws all of our renderables with multi-draw indirect
 };
@@ -4,6 +4,9 @@
 #include <florp\graphics\MeshData.h>
 #include <florp\graphics\MeshBuilder.h>
 #include <florp\graphics\ObjLoader.h>
+#include <florp\graphics\MeshSimplifier.h>
+#include <florp\game\LodGroup.h>
+#include <florp\game\StaticBatcher.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
@@ -16,6 +19,11 @@
 #include <ShadowLight.h>
 #include "PointLightComponent.h"
 #include "LightFlickerBehaviour.h"
+#include "DirectionalLight.h"
+#include "LightmapComponent.h"
+#include "BakedLighting.h"
+#include "GBufferLayout.h"
+#include "florp/bake/LightmapUnwrapper.h"
 
 /*
  * Helper function for creating a shadow casting light
@@ -103,18 +111,122 @@ florp::graphics::Texture2D::Sptr CreateSolidTexture(glm::vec4 color)
 	}
 }
 
+/*
+ * Marks an entity as static geometry that will receive a baked lightmap
+ * @param scene The scene that the entity belongs to
+ * @param entity The entity to attach the lightmap to
+ * @param source The mesh data for the entity, which must have already been unwrapped with the LightmapUnwrapper
+ * @param size The width and height of the entity's lightmap, in texels
+ * @param albedo The average color of the surface, used for bouncing light
+ */
+void AttachLightmap(florp::game::Scene* scene, entt::entity entity, const std::shared_ptr<florp::graphics::MeshData>& source, uint32_t size, glm::vec3 albedo)
+{
+	LightmapComponent& lightmap = scene->Registry().assign<LightmapComponent>(entity);
+	lightmap.Source = source;
+	lightmap.Size = size;
+	lightmap.Albedo = albedo;
+	// Lightmaps are stored in the bake in the order that they were attached
+	lightmap.Index = (uint32_t)scene->Registry().size<LightmapComponent>() - 1;
+}
+
+/*
+ * Marks an entity as static geometry that can be merged with other static geometry that uses the same material, see
+ * florp::game::StaticBatcher
+ * @param scene The scene that the entity belongs to
+ * @param entity The entity to mark as static, it must not move once the scene has been built
+ * @param source The mesh data for the entity, in its local space
+ */
+void MarkStatic(florp::game::Scene* scene, entt::entity entity, const std::shared_ptr<florp::graphics::MeshData>& source)
+{
+	florp::game::StaticComponent& component = scene->Registry().assign<florp::game::StaticComponent>(entity);
+	component.Source = source;
+}
+
+/*
+ * Switches a scene over to baked lighting. Every lightmapped entity gets a copy of its material that samples its lightmap,
+ * and all other materials are switched to sample the light probes instead
+ * @param scene The scene to apply the baked lighting to
+ * @param bake The baked lighting that was loaded for the scene
+ * @param lightmapShader The shader to use for lightmapped entities
+ * @param probeShader The shader to use for everything else
+ * @returns True if the bake was applied, false if it does not match the scene
+ */
+bool ApplyBakedLighting(florp::game::Scene* scene, const florp::bake::BakeResult& bake, const florp::graphics::Shader::Sptr& lightmapShader, const florp::graphics::Shader::Sptr& probeShader)
+{
+	using namespace florp::game;
+	using namespace florp::graphics;
+	auto& ecs = scene->Registry();
+
+	// Make sure that the bake actually lines up with our scene, the scene may have changed since it was baked
+	bool isValid = bake.Lightmaps.size() == ecs.size<LightmapComponent>();
+	ecs.view<LightmapComponent>().each([&](auto entity, const LightmapComponent& lightmap) {
+		isValid = isValid && bake.Lightmaps[lightmap.Index].Size == lightmap.Size;
+	});
+	if (!isValid) {
+		LOG_WARN("Baked lighting in \"{}\" does not match the scene, re-run with --bake to update it", BAKED_LIGHTING_FILE);
+		return false;
+	}
+
+	// Shared materials should stay shared, so we only convert each one once
+	std::unordered_map<Material*, Material::Sptr> probeMaterials;
+	ecs.view<RenderableComponent>().each([&](auto entity, RenderableComponent& renderable) {
+		if (renderable.Material == nullptr)
+			return;
+
+		if (ecs.has<LightmapComponent>(entity)) {
+			const florp::bake::Lightmap& baked = bake.Lightmaps[ecs.get<LightmapComponent>(entity).Index];
+
+			// Our lightmaps are HDR, and are small enough that we will just use linear filtering without mips
+			Texture2dDescription desc = Texture2dDescription();
+			desc.Width = desc.Height = baked.Size;
+			desc.Format = InternalFormat::RGB16F;
+			desc.MagFilter = MagFilter::Linear;
+			desc.MinFilter = MinFilter::Linear;
+			desc.MipmapLevels = 1;
+			desc.WrapS = desc.WrapT = WrapMode::ClampToEdge;
+
+			Texture2dData data = Texture2dData();
+			data.Width = data.Height = baked.Size;
+			data.Format = PixelFormat::Rgb;
+			data.Type = PixelType::Float;
+			data.Data = (void*)baked.Texels.data();
+
+			Texture2D::Sptr lightmap = std::make_shared<Texture2D>(desc);
+			lightmap->SetData(data);
+
+			// Every lightmapped entity needs its own material, since they all have their own lightmap
+			renderable.Material = renderable.Material->Clone(lightmapShader);
+			renderable.Material->Set("s_Lightmap", lightmap);
+		} else {
+			Material::Sptr& converted = probeMaterials[renderable.Material.get()];
+			if (converted == nullptr)
+				converted = renderable.Material->Clone(probeShader);
+			renderable.Material = converted;
+		}
+	});
+
+	// The LightingLayer will pick this up, upload our probes, and stop doing realtime lighting
+	ecs.set<BakedLighting>(BakedLighting{ bake.Probes });
+	LOG_INFO("Using baked lighting with {} lightmaps and {} probes", bake.Lightmaps.size(), bake.Probes.GetProbeCount());
+	return true;
+}
+
 void SceneBuilder::Initialize()
 {
 	florp::app::Application* app = florp::app::Application::Get();
 	
 	using namespace florp::game;
 	using namespace florp::graphics;
+	using namespace florp::bake;
 	
 	auto* scene = SceneManager::RegisterScene("main");
 	SceneManager::SetCurrentScene("main");
 
-	// We'll load in a monkey head to render something interesting
-	MeshData data = ObjLoader::LoadObj("monkey.obj", glm::vec4(1.0f));
+	// We'll load in a monkey head to render something interesting, with a few levels of detail for when it's far away (or
+	// only casting a shadow). Every monkey can share the same meshes
+	LodGroup monkeyLods = LodGroup::Create(
+		MeshSimplifier::GenerateLods(ObjLoader::LoadObj("monkey.obj", glm::vec4(1.0f)), 4),
+		VertexFormat::Packed);
 
 	Shader::Sptr shader = std::make_shared<Shader>();
 	shader->LoadPart(ShaderStageType::VertexShader, "shaders/lighting.vs.glsl");
@@ -126,6 +238,16 @@ void SceneBuilder::Initialize()
 	emissiveShader->LoadPart(ShaderStageType::VertexShader, "shaders/lighting.vs.glsl");
 	emissiveShader->LoadPart(ShaderStageType::FragmentShader, "shaders/forward-emissive.fs.glsl");
 	emissiveShader->Link();
+
+	// These are used instead of the above when we have baked lighting
+	Shader::Sptr lightmapShader = std::make_shared<Shader>();
+	lightmapShader->LoadPart(ShaderStageType::VertexShader, "shaders/lighting.vs.glsl");
+	lightmapShader->LoadPart(ShaderStageType::FragmentShader, "shaders/forward-lightmapped.fs.glsl");
+	lightmapShader->Link();
+	Shader::Sptr probeShader = std::make_shared<Shader>();
+	probeShader->LoadPart(ShaderStageType::VertexShader, "shaders/lighting.vs.glsl");
+	probeShader->LoadPart(ShaderStageType::FragmentShader, "shaders/forward-probes.fs.glsl");
+	probeShader->Link();
 	/*
 	// Creating our 'console'
 	{
@@ -141,7 +263,7 @@ void SceneBuilder::Initialize()
 		// Create the entity, attach renderable, set position
 		entt::entity consoleEntt = scene->CreateEntity();
 		RenderableComponent& consoleRenderable = scene->Registry().assign<RenderableComponent>(consoleEntt);
-		consoleRenderable.Mesh = MeshBuilder::Bake(console);
+		consoleRenderable.Mesh = MeshBuilder::Bake(console, VertexFormat::Packed);
 		consoleRenderable.Material = consoleMat;
 		Transform& t = scene->Registry().get<Transform>(consoleEntt);
 		t.SetPosition(glm::vec3(0.0f, -1.0f, -4.0f));
@@ -162,7 +284,7 @@ void SceneBuilder::Initialize()
 		// We'll make a plane out of a flattened cube
 		MeshData data = MeshBuilder::Begin("Monitor");
 		MeshBuilder::AddAlignedCube(data, glm::vec3(0.0f), glm::vec3(0.41f, 0.36f, 0.0f));
-		Mesh::Sptr mesh = MeshBuilder::Bake(data);
+		Mesh::Sptr mesh = MeshBuilder::Bake(data, VertexFormat::Packed);
 
 		// Attach a new entity to the console, give it a renderable, and position it juust right
 		entt::entity monitor = scene->CreateEntity();
@@ -184,6 +306,9 @@ void SceneBuilder::Initialize()
 	// We'll have another material for the marble without any emissive spots
 	Material::Sptr marbleMat = std::make_shared<Material>(shader);
 	marbleMat->Set("s_Albedo", Texture2D::LoadFromFile("marble.png", false, true, true));
+	// The probe shader also handles emissive materials, so we give this a black emissive for when we use baked lighting
+	marbleMat->Set("s_Emissive", CreateSolidTexture(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+	marbleMat->Set("a_EmissiveStrength", 0.0f);
 
 	// This will be for the polka-cube
 	Material::Sptr mat2 = std::make_shared<Material>(emissiveShader);
@@ -200,8 +325,9 @@ void SceneBuilder::Initialize()
 	for (int ix = 0; ix < numMonkeys; ix++) {
 		entt::entity test = scene->CreateEntity();
 		RenderableComponent& renderable = scene->Registry().assign<RenderableComponent>(test);
-		renderable.Mesh = MeshBuilder::Bake(data);
+		renderable.Mesh = monkeyLods.GetCameraMesh();
 		renderable.Material = monkeyMat;
+		scene->Registry().assign<LodGroup>(test, monkeyLods);
 		Transform& t = scene->Registry().get<Transform>(test);
 		t.SetPosition(glm::vec3(glm::cos(step * ix) * 5.0f, 0.0f, glm::sin(step * ix) * 5.0f));
 		t.SetEulerAngles(glm::vec3(-90.0f, glm::degrees(-step * ix), 0.0f));
@@ -218,6 +344,9 @@ void SceneBuilder::Initialize()
 			glm::cos(-ix * step) + 1.0f, 
 			glm::sin((-ix * step) + glm::pi<float>()) + 1.0f) / 2.0f * 0.1f;
 		light.Attenuation = 1.0f / 10.0f;
+		// The ring lights will cast shadows in every direction, out to just past the center of the scene
+		light.CastShadows = true;
+		light.ShadowRange = 30.0f;
 		Transform& t = scene->Registry().get<Transform>(entity);
 		t.SetPosition(glm::vec3(glm::cos(step * ix) * 20.0f, 2.0f, glm::sin(step * ix) * 20.0f));
 		scene->AddBehaviour<LightFlickerBehaviour>(entity, 2.0f, 0.6f, 1.2f);
@@ -227,8 +356,9 @@ void SceneBuilder::Initialize()
 	{
 		entt::entity test = scene->CreateEntity();
 		RenderableComponent& renderable = scene->Registry().assign<RenderableComponent>(test);
-		renderable.Mesh = MeshBuilder::Bake(data);
+		renderable.Mesh = monkeyLods.GetCameraMesh();
 		renderable.Material = monkeyMat;
+		scene->Registry().assign<LodGroup>(test, monkeyLods);
 		Transform& t = scene->Registry().get<Transform>(test);
 		// Make our monkeys spin around the center
 		scene->AddBehaviour<ControlBehaviour>(test, glm::vec3(1.0f));
@@ -240,7 +370,7 @@ void SceneBuilder::Initialize()
 	{
 		MeshData indicatorCube = MeshBuilder::Begin();
 		MeshBuilder::AddAlignedCube(indicatorCube, glm::vec3(0.0f, 0, 0.0), glm::vec3(2.0f, 2.0f, 2.0f));
-		Mesh::Sptr indicatorMesh = MeshBuilder::Bake(indicatorCube);
+		Mesh::Sptr indicatorMesh = MeshBuilder::Bake(indicatorCube, VertexFormat::Packed);
 		
 		entt::entity test = scene->CreateEntity();
 		RenderableComponent& renderable = scene->Registry().assign<RenderableComponent>(test);
@@ -254,41 +384,15 @@ void SceneBuilder::Initialize()
 	// We'll use a tiny cube to cast a shadow from our camera, and to indicate where the light sources are
 	MeshData indicatorCube = MeshBuilder::Begin();
 	MeshBuilder::AddAlignedCube(indicatorCube, glm::vec3(0.0f, 0, 0.0), glm::vec3(0.1f, 0.1f, 0.1f));
-	Mesh::Sptr indicatorMesh = MeshBuilder::Bake(indicatorCube);
+	// The indicators for the spot lights are static, so they get lightmaps as well
+	LightmapUnwrapper::Unwrap(indicatorCube, 16, 1);
+	std::shared_ptr<MeshData> indicatorSource = std::make_shared<MeshData>(indicatorCube);
+	Mesh::Sptr indicatorMesh = MeshBuilder::Bake(indicatorCube, VertexFormat::Packed);
 		
 	// Creates our main camera
 	{
-		// The color buffer should be marked as shader readable, so that we generate a texture for it
-		RenderBufferDesc mainColor = RenderBufferDesc();
-		mainColor.ShaderReadable = true;
-		mainColor.Attachment = RenderTargetAttachment::Color0;
-		mainColor.Format = RenderTargetType::ColorRgb8;
-
-		// The normal buffer
-		RenderBufferDesc normalBuffer = RenderBufferDesc();
-		normalBuffer.ShaderReadable = true;
-		normalBuffer.Attachment = RenderTargetAttachment::Color1;
-		normalBuffer.Format = RenderTargetType::ColorRgb10; // Note: this format is 10 bits per component
-
-		// The normal buffer
-		RenderBufferDesc emissiveBuffer = RenderBufferDesc();
-		emissiveBuffer.ShaderReadable = true;
-		emissiveBuffer.Attachment = RenderTargetAttachment::Color2;
-		emissiveBuffer.Format = RenderTargetType::ColorRgb10; // Note: this format is 10 bits per component
-
-		// The depth attachment does not need to be a texture (and would cause issues since the format is DepthStencil)
-		RenderBufferDesc depth = RenderBufferDesc();
-		depth.ShaderReadable = true;
-		depth.Attachment = RenderTargetAttachment::Depth;
-		depth.Format = RenderTargetType::Depth32;
-
-		// Our main frame buffer needs a color output, and a depth output
-		FrameBuffer::Sptr buffer = std::make_shared<FrameBuffer>(app->GetWindow()->GetWidth(), app->GetWindow()->GetHeight(), 4);
-		buffer->AddAttachment(mainColor);
-		buffer->AddAttachment(normalBuffer);
-		buffer->AddAttachment(emissiveBuffer);
-		buffer->AddAttachment(depth);
-		buffer->Validate();
+		// Our main frame buffer is the G-Buffer for the deferred lighting, its formats come from the scene's layout
+		FrameBuffer::Sptr buffer = GBufferLayout::Get().CreateBuffer(app->GetWindow()->GetWidth(), app->GetWindow()->GetHeight());
 		buffer->SetDebugName("MainBuffer");
 
 		// We'll create an entity, and attach a camera component to it
@@ -336,6 +440,8 @@ void SceneBuilder::Initialize()
 		// We'll generate a color for the light
 		light.Color = glm::vec3(1.0f, 0.64f, 0.0f) * 0.2f; 
 		light.Attenuation = 1.0f / 5.0f;
+		// We'll use pre-filtered exponential shadow maps, since these lights overlap a lot
+		light.Filter = ShadowFilterMode::Evsm;
 		scene->AddBehaviour<LightFlickerBehaviour>(lightEnt, 5.0f, 0.5f, 1.0f);
 
 		// We'll attach an indicator cube to all the lights, and align it with the light's facing
@@ -345,6 +451,28 @@ void SceneBuilder::Initialize()
 		renderable.Material = marbleMat;
 		Transform& t = scene->Registry().get<Transform>(entity);
 		t.SetPosition(glm::vec3(glm::cos(step * ix) * 9.0f, 2.0f, glm::sin(step * ix) * 9.0f));
+		AttachLightmap(scene, entity, indicatorSource, 16, glm::vec3(0.7f));
+		MarkStatic(scene, entity, indicatorSource);
+	}
+
+	// A ring of marble pillars around the outside of the scene. There are a lot of these, but they never move, so they
+	// will be merged into a few static batches. The batcher bakes the meshes, so we only need to give it the source
+	{
+		MeshData data = MeshBuilder::Begin("Pillar");
+		MeshBuilder::AddAlignedCube(data, glm::vec3(0.0f, 2.5f, 0.0f), glm::vec3(0.5f, 3.5f, 0.5f));
+		std::shared_ptr<MeshData> pillarSource = std::make_shared<MeshData>(data);
+
+		const int numPillars = 48;
+		const float pillarStep = glm::two_pi<float>() / numPillars;
+		for (int ix = 0; ix < numPillars; ix++) {
+			entt::entity entity = scene->CreateEntity();
+			RenderableComponent& renderable = scene->Registry().assign<RenderableComponent>(entity);
+			renderable.Material = marbleMat;
+			Transform& t = scene->Registry().get<Transform>(entity);
+			t.SetPosition(glm::vec3(glm::cos(pillarStep * ix) * 35.0f, 0.0f, glm::sin(pillarStep * ix) * 35.0f));
+			t.SetEulerAngles(glm::vec3(0.0f, glm::degrees(-pillarStep * ix), 0.0f));
+			MarkStatic(scene, entity, pillarSource);
+		}
 	}
 			
 	// Our floor plane
@@ -352,13 +480,44 @@ void SceneBuilder::Initialize()
 		// Building the mesh
 		MeshData data = MeshBuilder::Begin();
 		MeshBuilder::AddAlignedCube(data, glm::vec3(0.0f, -1.0f, 0.0), glm::vec3(100.0f, 0.1f, 100.0f));
-		Mesh::Sptr mesh = MeshBuilder::Bake(data);
+		LightmapUnwrapper::Unwrap(data, 1024);
 
-		// Creating the entity and attaching the renderable 
+		// Creating the entity and attaching the renderable, the mesh is baked (or batched) by the StaticBatcher
 		entt::entity entity = scene->CreateEntity();
 		RenderableComponent& renderable = scene->Registry().assign<RenderableComponent>(entity);
-		renderable.Mesh = MeshBuilder::Bake(data);
 		renderable.Material = marbleMat;
+		std::shared_ptr<MeshData> source = std::make_shared<MeshData>(data);
+		AttachLightmap(scene, entity, source, 1024, glm::vec3(0.7f));
+		MarkStatic(scene, entity, source);
+	}
+
+	// Our sun, which will cast shadows over the entire floor using cascaded shadow maps
+	{
+		// All the cascades will share a single depth texture array
+		LayeredDepthBuffer::Sptr cascades = std::make_shared<LayeredDepthBuffer>(2048, MAX_SHADOW_CASCADES);
+		cascades->SetDebugName("SunCascades");
+
+		entt::entity entity = scene->CreateEntity();
+		DirectionalLight& light = scene->Registry().assign<DirectionalLight>(entity);
+		light.ShadowBuffer = cascades;
+		light.NumCascades = MAX_SHADOW_CASCADES;
+		light.ShadowDistance = 80.0f;
+		light.Color = glm::vec3(1.0f, 0.95f, 0.85f) * 0.15f;
+
+		// The sun shines along it's -Z axis, so we just need to point it down at an angle
+		Transform& t = scene->Registry().get<Transform>(entity);
+		t.SetPosition(glm::vec3(10.0f, 20.0f, 5.0f));
+		t.LookAt(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	// If the lighting has been baked (by running with --bake), we'll switch over to it
+	florp::bake::BakeResult bake;
+	if (florp::bake::BakeResult::Load(BAKED_LIGHTING_FILE, bake)) {
+		ApplyBakedLighting(scene, bake, lightmapShader, probeShader);
 	}
+
+	// Now that every material is final, we can merge our static geometry. Lightmapped entities have their own materials
+	// once the lighting is baked, so they are only merged when we are running without baked lighting
+	StaticBatcher::Build(scene->Registry(), VertexFormat::Packed);
 }
 
@@ -6,10 +6,19 @@
 #include "layers/PostLayer.h"
 #include "layers/AudioLayer.h"
 #include "layers/LightingLayer.h"
+#include "layers/LightBakeLayer.h"
 #include "florp/graphics/TextureCube.h"
+#include <cstring>
 
-int main()
+int main(int argc, char** argv)
 {
+	// Running with --bake will bake the scene's static lighting to disk, instead of running the game
+	bool isBaking = false;
+	for (int ix = 1; ix < argc; ix++) {
+		if (strcmp(argv[ix], "--bake") == 0)
+			isBaking = true;
+	}
+
 	{
 		// Create our application
 		florp::app::Application* app = new florp::app::Application();
@@ -19,6 +28,8 @@ int main()
 		app->AddLayer<florp::game::ImGuiLayer>();
 		app->AddLayer<AudioLayer>();
 		app->AddLayer<SceneBuilder>();
+		if (isBaking)
+			app->AddLayer<LightBakeLayer>();
 		app->AddLayer<RenderLayer>();
 		app->AddLayer<LightingLayer>();
 		app->AddLayer<PostLayer>();